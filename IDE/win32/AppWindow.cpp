@@ -10,12 +10,17 @@
 #include <ShlObj_core.h>
 #include <Shlwapi.h>
 #include <commdlg.h>
+#include <dlgs.h>
 #include <Richedit.h>
+#include <string>
+#include <vector>
 
 #pragma comment(lib, "Shlwapi.lib")
 
 #define APP_WINDOW_CLASS L"IDEAppWindow"
 
+#define OPEN_FILES_BUFSIZ 32768
+
 static HRESULT RegisterAppWindowClass(HINSTANCE hInstance);
 static LRESULT CALLBACK AppWindowProcedure(HWND hWnd, UINT uMessage, WPARAM wParam, LPARAM lParam);
 
@@ -25,6 +30,32 @@ UINT g_uFindReplaceMsg = NULL;
 // This needs to be global otherwise the dialog commits suicide
 FINDREPLACE g_FindReplace;
 
+/// <summary>
+/// Hooks the find and replace dialogs to search while the user types,
+/// the dialogs only tell their owner when a button is pressed
+/// </summary>
+static UINT_PTR CALLBACK FindDialogHookProcedure(HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	if (uMsg == WM_INITDIALOG)
+	{
+		return TRUE;
+	}
+
+	if (uMsg == WM_COMMAND)
+	{
+		const WORD wControl = LOWORD(wParam);
+		const WORD wNotification = HIWORD(wParam);
+
+		if ((wControl == edt1 && wNotification == EN_CHANGE) ||
+			((wControl == chx1 || wControl == chx2) && wNotification == BN_CLICKED))
+		{
+			reinterpret_cast<AppWindow*>(g_FindReplace.lCustData)->OnFindTextChanged(hDlg);
+		}
+	}
+
+	return FALSE;
+}
+
 AppWindow::~AppWindow(void)
 {
 	SAFE_DELETE_PTR(m_pExplorer);
@@ -169,9 +200,33 @@ HRESULT AppWindow::InitializeWindow(HINSTANCE hInstance)
 	ShowWindow(m_hWndSelf, SW_SHOWMAXIMIZED);
 	UpdateWindow(m_hWndSelf);
 
+	RecoverUnsavedFiles();
+
 	return S_OK;
 }
 
+/// <summary>
+/// Opens the files whose edits were left unsaved by a crash, with the
+/// text rebuilt from their journals
+/// </summary>
+void AppWindow::RecoverUnsavedFiles(void)
+{
+	std::vector<RecoveredFile> files = EditJournal::Recover();
+
+	for (RecoveredFile& file : files)
+	{
+		SourceTab* pSourceTab = m_pWorkArea->CreateTab(&file.path[0]);
+		pSourceTab->RestoreRecoveredText(std::move(file.text));
+	}
+
+	if (!files.empty())
+	{
+		const std::wstring text = L"Recovered unsaved changes of " + std::to_wstring(files.size()) +
+			                      (files.size() == 1 ? L" file." : L" files.");
+		m_pStatusBar->SetText(text.c_str(), 0);
+	}
+}
+
 HRESULT AppWindow::InitializeComponents(void)
 {
 	HRESULT hr = E_FAIL;
@@ -265,23 +320,50 @@ void AppWindow::HandleFRMessage(HWND hWnd, WPARAM wParam, LPARAM lParam)
 	// dialog will not open again because it was not nulled, and therefore the program
 	// tries to set focus to a window that does not exist
 	if (lpfr->Flags & FR_DIALOGTERM)
+	{
 		*m_pFindDialog = nullptr;
 
+		for (TabList* pTabs : { &m_pWorkArea->GetVisibleTabs(), &m_pWorkArea->GetHiddenTabs() })
+		{
+			for (SourceTab* pSourceTab : *pTabs)
+			{
+				if (pSourceTab->GetSourceEdit() != nullptr)
+				{
+					FR::EndIncrementalSearch(pSourceTab->GetSourceEdit());
+				}
+			}
+		}
+	}
+
 	if (pTab != nullptr)
 	{
-		HWND hEditWindow = pTab->GetSourceEdit()->GetHandle();
-
 		if (lpfr->Flags & FR_FINDNEXT) 
 		{
-			if (!FR::Find(lpfr->lpstrFindWhat,
-				          hEditWindow,
-				          lpfr->Flags))
+			if (FR::Find(lpfr->lpstrFindWhat,
+				         pTab->GetSourceEdit(),
+				         lpfr->Flags))
+			{
+				m_pStatusBar->SetText(FR::GetMatchStatus(pTab->GetSourceEdit()).c_str(), 0);
+			}
+
+			else
 			{
 				g_dwFlags = lpfr->Flags;
 
-				std::wstring not_found_msg = L"Cannot find \"";
-				not_found_msg.append(lpfr->lpstrFindWhat);
-				not_found_msg.push_back(L'\"');
+				const std::wstring error = FR::GetPatternError(lpfr->lpstrFindWhat, lpfr->Flags);
+				std::wstring not_found_msg;
+
+				if (!error.empty())
+				{
+					not_found_msg = L"Invalid regular expression: " + error;
+				}
+
+				else
+				{
+					not_found_msg = L"Cannot find \"";
+					not_found_msg.append(lpfr->lpstrFindWhat);
+					not_found_msg.push_back(L'\"');
+				}
 
 				MessageBox(
 					*m_pFindDialog, not_found_msg.c_str(), L"Editor", MB_OK | MB_ICONINFORMATION
@@ -291,8 +373,9 @@ void AppWindow::HandleFRMessage(HWND hWnd, WPARAM wParam, LPARAM lParam)
 
 		else if (lpfr->Flags & FR_REPLACE)
 		{
-			if (FR::Replace(lpfr->lpstrReplaceWith,
-				            hEditWindow,
+			if (FR::Replace(lpfr->lpstrFindWhat,
+				            lpfr->lpstrReplaceWith,
+				            pTab->GetSourceEdit(),
 				            lpfr->Flags))
 			{
 				::MarkSourceAsEdited(pTab->GetSourceEdit());
@@ -301,14 +384,21 @@ void AppWindow::HandleFRMessage(HWND hWnd, WPARAM wParam, LPARAM lParam)
 
 		else if (lpfr->Flags & FR_REPLACEALL)
 		{
-			if (FR::ReplaceAll(lpfr->lpstrFindWhat,
-				               lpfr->lpstrReplaceWith,
-				               hEditWindow,
-				               lpfr->Flags))
+			const size_t count = FR::ReplaceAll(lpfr->lpstrFindWhat,
+				                                lpfr->lpstrReplaceWith,
+				                                pTab->GetSourceEdit(),
+				                                lpfr->Flags);
+
+			if (count > 0)
 			{
 				::MarkSourceAsEdited(pTab->GetSourceEdit());
-				
 			}
+
+			const std::wstring error = FR::GetPatternError(lpfr->lpstrFindWhat, lpfr->Flags);
+
+			const std::wstring sbMsg = !error.empty() ? L"Invalid regular expression: " + error
+				                     : count == 1 ? L"Replaced 1 occurrence" : L"Replaced " + std::to_wstring(count) + L" occurrences";
+			m_pStatusBar->SetText(sbMsg.c_str(), 0);
 		}
 	}
 }
@@ -408,11 +498,27 @@ LRESULT AppWindow::OnCommand(HWND hWnd, WPARAM wParam)
 		return HandleFileMenuCommands(hWnd, wIdentifier);
 	}
 	
-	if (wIdentifier >= ID_EDIT && wIdentifier <= ID_EDIT_SELECTALL)
+	if ((wIdentifier >= ID_EDIT && wIdentifier <= ID_EDIT_SELECTALL) || wIdentifier == ID_EDIT_REDO)
 	{
 		return HandleEditMenuCommands(hWnd, wIdentifier);
 	}
 
+	// Doesn't need a tab, it's for the next search
+	if (wIdentifier == ID_EDIT_REGEX)
+	{
+		return OnEditRegex();
+	}
+
+	if (wIdentifier == ID_EDIT_FINDINFILES)
+	{
+		return OnFindInFiles();
+	}
+
+	if (wIdentifier == ID_FILE_GOTOFILE)
+	{
+		return OnGotoFile();
+	}
+
 	if (wIdentifier >= ID_VIEW && wIdentifier <= ID_VIEW_STATUSBAR)
 	{
 		return HandleViewMenuCommands(hWnd, wIdentifier);
@@ -512,6 +618,173 @@ static INT_PTR CALLBACK GotoLineDialogProcedure(HWND hWnd, UINT uMsg, WPARAM wPa
 	return 0;
 }
 
+/* What the Find in Files dialog starts with and what it was left with */
+struct FindInFilesDialogData {
+	wchar_t lpszPattern[FIND_BUFFER_SIZE] = {};
+	bool matchCase = false;
+	bool wholeWord = false;
+	bool isRegex = false;
+};
+
+static INT_PTR CALLBACK FindInFilesDialogProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	static FindInFilesDialogData* pData;
+
+	switch (uMsg)
+	{
+	case WM_INITDIALOG:
+	{
+		pData = reinterpret_cast<FindInFilesDialogData*>(lParam);
+		HWND hEdit = GetDlgItem(hWnd, IDC_FIND_IN_FILES_EDIT);
+		SendMessage(hEdit, EM_SETLIMITTEXT, FIND_BUFFER_SIZE - 1, NULL);
+		SetWindowText(hEdit, pData->lpszPattern);
+		SendMessage(hEdit, EM_SETSEL, 0, -1);
+		CheckDlgButton(hWnd, IDC_MATCH_CASE_CHECK, pData->matchCase ? BST_CHECKED : BST_UNCHECKED);
+		CheckDlgButton(hWnd, IDC_WHOLE_WORD_CHECK, pData->wholeWord ? BST_CHECKED : BST_UNCHECKED);
+		CheckDlgButton(hWnd, IDC_REGEX_CHECK, pData->isRegex ? BST_CHECKED : BST_UNCHECKED);
+		SetFocus(hEdit);
+	}
+		return FALSE;
+
+	case WM_CLOSE:
+		EndDialog(hWnd, IDCLOSE);
+		break;
+
+	case WM_COMMAND:
+		switch (LOWORD(wParam))
+		{
+		case IDCANCEL:
+			EndDialog(hWnd, IDCANCEL);
+			break;
+
+		// There's nothing to look for until something is typed
+		case IDC_FIND_IN_FILES_EDIT:
+			if (HIWORD(wParam) == EN_CHANGE)
+			{
+				EnableWindow(GetDlgItem(hWnd, IDOK), GetWindowTextLength(GetDlgItem(hWnd, IDC_FIND_IN_FILES_EDIT)) > 0);
+			}
+			break;
+
+		// Find All Button
+		case IDOK:
+			GetDlgItemText(hWnd, IDC_FIND_IN_FILES_EDIT, pData->lpszPattern, FIND_BUFFER_SIZE);
+			pData->matchCase = IsDlgButtonChecked(hWnd, IDC_MATCH_CASE_CHECK) == BST_CHECKED;
+			pData->wholeWord = IsDlgButtonChecked(hWnd, IDC_WHOLE_WORD_CHECK) == BST_CHECKED;
+			pData->isRegex = IsDlgButtonChecked(hWnd, IDC_REGEX_CHECK) == BST_CHECKED;
+			EndDialog(hWnd, IDOK);
+			break;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+/* The files Go to File picks from and the one that was picked */
+struct GotoFileDialogData {
+	const FileFinder* pFileFinder = nullptr;
+	std::vector<FileMatch> matches;
+	std::wstring path;
+};
+
+/* Up and down move through the list while typing in the edit control */
+static LRESULT CALLBACK GotoFileEditSubclassProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR, DWORD_PTR)
+{
+	if (uMsg == WM_KEYDOWN && (wParam == VK_UP || wParam == VK_DOWN || wParam == VK_PRIOR || wParam == VK_NEXT))
+	{
+		SendMessage(GetDlgItem(GetParent(hWnd), IDC_GOTO_FILE_LIST), uMsg, wParam, lParam);
+		return 0;
+	}
+
+	return DefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
+/* Lists the files that best match what is typed, the best one selected */
+static void ListGotoFileMatches(HWND hWnd, GotoFileDialogData* pData)
+{
+	HWND hList = GetDlgItem(hWnd, IDC_GOTO_FILE_LIST);
+
+	std::wstring query(GetWindowTextLength(GetDlgItem(hWnd, IDC_GOTO_FILE_EDIT)) + 1, L'\0');
+	query.resize(GetDlgItemText(hWnd, IDC_GOTO_FILE_EDIT, &query[0], static_cast<int>(query.length())));
+
+	pData->pFileFinder->Find(query, FILE_FINDER_MAX_RESULTS, pData->matches);
+
+	SendMessage(hList, WM_SETREDRAW, FALSE, NULL);
+	SendMessage(hList, LB_RESETCONTENT, NULL, NULL);
+
+	for (const FileMatch& match : pData->matches)
+	{
+		SendMessage(hList, LB_ADDSTRING, NULL, reinterpret_cast<LPARAM>(pData->pFileFinder->GetRelativePath(match.file).c_str()));
+	}
+
+	SendMessage(hList, LB_SETCURSEL, 0, NULL);
+	SendMessage(hList, WM_SETREDRAW, TRUE, NULL);
+	InvalidateRect(hList, NULL, TRUE);
+
+	EnableWindow(GetDlgItem(hWnd, IDOK), !pData->matches.empty());
+}
+
+static INT_PTR CALLBACK GotoFileDialogProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	static GotoFileDialogData* pData;
+
+	switch (uMsg)
+	{
+	case WM_INITDIALOG:
+	{
+		pData = reinterpret_cast<GotoFileDialogData*>(lParam);
+		HWND hEdit = GetDlgItem(hWnd, IDC_GOTO_FILE_EDIT);
+		SendMessage(hEdit, EM_SETLIMITTEXT, MAX_PATH, NULL);
+		SetWindowSubclass(hEdit, GotoFileEditSubclassProcedure, NULL, NULL);
+		ListGotoFileMatches(hWnd, pData);
+		SetFocus(hEdit);
+	}
+		return FALSE;
+
+	case WM_CLOSE:
+		EndDialog(hWnd, IDCLOSE);
+		break;
+
+	case WM_COMMAND:
+		switch (LOWORD(wParam))
+		{
+		case IDCANCEL:
+			EndDialog(hWnd, IDCANCEL);
+			break;
+
+		case IDC_GOTO_FILE_EDIT:
+			if (HIWORD(wParam) == EN_CHANGE)
+			{
+				ListGotoFileMatches(hWnd, pData);
+			}
+			break;
+
+		case IDC_GOTO_FILE_LIST:
+			if (HIWORD(wParam) == LBN_DBLCLK)
+			{
+				SendMessage(hWnd, WM_COMMAND, IDOK, NULL);
+			}
+			break;
+
+		// Open Button
+		case IDOK:
+		{
+			const LRESULT selected = SendDlgItemMessage(hWnd, IDC_GOTO_FILE_LIST, LB_GETCURSEL, NULL, NULL);
+
+			if (selected != LB_ERR && static_cast<size_t>(selected) < pData->matches.size())
+			{
+				pData->path = pData->pFileFinder->GetAbsolutePath(pData->matches[selected].file);
+				EndDialog(hWnd, IDOK);
+			}
+		}
+			break;
+		}
+		break;
+	}
+
+	return 0;
+}
+
 LRESULT AppWindow::HandleEditMenuCommands(HWND hWnd, WPARAM wIdentifier)
 {
 	SourceTab* pTab = m_pWorkArea->GetSelectedTab();
@@ -523,8 +796,11 @@ LRESULT AppWindow::HandleEditMenuCommands(HWND hWnd, WPARAM wIdentifier)
 		switch (wIdentifier)
 		{
 		case ID_EDIT_UNDO:
-			SendMessage(hEditWnd, EM_UNDO, NULL, NULL);
-			Utility::UpdateUndoMenuButton(hEditWnd);
+			pTab->GetSourceEdit()->Undo();
+			break;
+
+		case ID_EDIT_REDO:
+			pTab->GetSourceEdit()->Redo();
 			break;
 
 		case ID_EDIT_SELECTALL:
@@ -533,7 +809,6 @@ LRESULT AppWindow::HandleEditMenuCommands(HWND hWnd, WPARAM wIdentifier)
 
 		case ID_EDIT_PASTE:
 			SendMessage(hEditWnd, EM_PASTESPECIAL, CF_UNICODETEXT, NULL);
-			Utility::UpdateUndoMenuButton(hEditWnd);
 			break;
 
 		case ID_EDIT_COPY:
@@ -556,24 +831,20 @@ LRESULT AppWindow::HandleEditMenuCommands(HWND hWnd, WPARAM wIdentifier)
 			break;
 
 		case ID_EDIT_FINDNEXT:
-			if (g_uFindReplaceMsg != NULL)
+			if (g_uFindReplaceMsg != NULL && FR::Find(g_FindReplace.lpstrFindWhat,
+				                                      pTab->GetSourceEdit(),
+				                                      g_dwFlags | FR_DOWN))
 			{
-				FR::Find(
-					g_FindReplace.lpstrFindWhat,
-					hEditWnd,
-					g_dwFlags | FR_DOWN
-				);
+				m_pStatusBar->SetText(FR::GetMatchStatus(pTab->GetSourceEdit()).c_str(), 0);
 			}
 			break;
 
 		case ID_EDIT_FINDPREVIOUS:
-			if (g_uFindReplaceMsg != NULL)
+			if (g_uFindReplaceMsg != NULL && FR::Find(g_FindReplace.lpstrFindWhat,
+				                                      pTab->GetSourceEdit(),
+				                                      g_dwFlags ^ FR_DOWN))
 			{
-				FR::Find(
-					g_FindReplace.lpstrFindWhat,
-					hEditWnd,
-					g_dwFlags ^ FR_DOWN
-				);
+				m_pStatusBar->SetText(FR::GetMatchStatus(pTab->GetSourceEdit()).c_str(), 0);
 			}
 			break;
 			
@@ -582,7 +853,7 @@ LRESULT AppWindow::HandleEditMenuCommands(HWND hWnd, WPARAM wIdentifier)
 				               MAKEINTRESOURCE(IDD_GOTO_LINE),
 				               hWnd,
 				               GotoLineDialogProcedure,
-				               SendMessage(hEditWnd, EM_GETLINECOUNT, NULL, NULL)) == IDOK)
+				               pTab->GetSourceEdit()->GetLineCount()) == IDOK)
 			{
 				pTab->GetSourceEdit()->ScrollTo(g_iLineToGoTo);
 				std::wstring sbMsg = L"Went to line " + std::to_wstring(g_iLineToGoTo);
@@ -603,7 +874,9 @@ void AppWindow::OnFind(void)
 		g_FindReplace.hwndOwner = m_hWndSelf;
 		g_FindReplace.lpstrFindWhat = find_buffer;
 		g_FindReplace.wFindWhatLen = FIND_BUFFER_SIZE;
-		g_FindReplace.Flags = g_dwFlags;
+		g_FindReplace.Flags = g_dwFlags | FR_ENABLEHOOK;
+		g_FindReplace.lpfnHook = FindDialogHookProcedure;
+		g_FindReplace.lCustData = reinterpret_cast<LPARAM>(this);
 
 		*m_pFindDialog = FindText(&g_FindReplace);
 	}
@@ -622,7 +895,9 @@ void AppWindow::OnReplace(void)
 		g_FindReplace.wFindWhatLen = FIND_BUFFER_SIZE;
 		g_FindReplace.lpstrReplaceWith = replace_buffer;
 		g_FindReplace.wReplaceWithLen = FIND_BUFFER_SIZE;
-		g_FindReplace.Flags = g_dwFlags;
+		g_FindReplace.Flags = g_dwFlags | FR_ENABLEHOOK;
+		g_FindReplace.lpfnHook = FindDialogHookProcedure;
+		g_FindReplace.lCustData = reinterpret_cast<LPARAM>(this);
 
 		*m_pFindDialog = ReplaceText(&g_FindReplace);
 	}
@@ -631,6 +906,31 @@ void AppWindow::OnReplace(void)
 	}
 }
 
+void AppWindow::OnFindTextChanged(HWND hDlg)
+{
+	SourceTab* pTab = m_pWorkArea->GetSelectedTab();
+
+	if (pTab == nullptr || pTab->GetSourceEdit() == nullptr)
+	{
+		return;
+	}
+
+	wchar_t lpszFind[FIND_BUFFER_SIZE];
+	GetDlgItemText(hDlg, edt1, lpszFind, FIND_BUFFER_SIZE);
+
+	DWORD dwFlags = 0;
+
+	if (IsDlgButtonChecked(hDlg, chx1) == BST_CHECKED)
+		dwFlags |= FR_WHOLEWORD;
+
+	if (IsDlgButtonChecked(hDlg, chx2) == BST_CHECKED)
+		dwFlags |= FR_MATCHCASE;
+
+	FR::FindAsYouType(lpszFind, pTab->GetSourceEdit(), dwFlags);
+
+	m_pStatusBar->SetText(FR::GetMatchStatus(pTab->GetSourceEdit()).c_str(), 0);
+}
+
 void AppWindow::OnSelectAll(HWND hEditWnd)
 {
 	int iTextLength = GetWindowTextLength(hEditWnd);
@@ -711,9 +1011,93 @@ LRESULT AppWindow::OnViewStatusBar(void)
 	return 0;
 }
 
+LRESULT AppWindow::OnEditRegex(void)
+{
+	HMENU hMenu = GetMenu(m_hWndSelf);
+	DWORD dwState = CheckMenuItem(hMenu, ID_EDIT_REGEX, MF_BYCOMMAND);
+
+	CheckMenuItem(hMenu, ID_EDIT_REGEX, dwState == MF_CHECKED ? MF_UNCHECKED : MF_CHECKED);
+	FR::SetRegexMode(dwState != MF_CHECKED);
+
+	m_pStatusBar->SetText(FR::IsRegexMode() ? L"Searching with regular expressions" : L"Searching for plain text", 0);
+
+	return 0;
+}
+
+LRESULT AppWindow::OnFindInFiles(void)
+{
+	// The same command stops the search while it runs
+	if (m_pExplorer->IsFindInFilesRunning())
+	{
+		m_pExplorer->CancelFindInFiles();
+		return 0;
+	}
+
+	// Starts with what the find dialog last looked for
+	FindInFilesDialogData data;
+	data.matchCase = (g_dwFlags & FR_MATCHCASE) != 0;
+	data.wholeWord = (g_dwFlags & FR_WHOLEWORD) != 0;
+	data.isRegex = FR::IsRegexMode();
+
+	if (g_FindReplace.lpstrFindWhat != nullptr)
+	{
+		lstrcpyn(data.lpszPattern, g_FindReplace.lpstrFindWhat, FIND_BUFFER_SIZE);
+	}
+
+	if (DialogBoxParam(NULL,
+		               MAKEINTRESOURCE(IDD_FIND_IN_FILES),
+		               m_hWndSelf,
+		               FindInFilesDialogProcedure,
+		               reinterpret_cast<LPARAM>(&data)) == IDOK)
+	{
+		FileSearchQuery query;
+		query.pattern = data.lpszPattern;
+		query.options.matchCase = data.matchCase;
+		query.options.wholeWord = data.wholeWord;
+		query.isRegex = data.isRegex;
+
+		m_pExplorer->FindInFiles(query, m_pWorkArea);
+	}
+
+	return 0;
+}
+
+LRESULT AppWindow::OnGotoFile(void)
+{
+	GotoFileDialogData data;
+	data.pFileFinder = m_pExplorer->GetFileFinder();
+
+	if (data.pFileFinder->GetFileCount() == 0)
+	{
+		m_pStatusBar->SetText(L"No project folder files to go to.", 0);
+		return 0;
+	}
+
+	if (DialogBoxParam(NULL,
+		               MAKEINTRESOURCE(IDD_GOTO_FILE),
+		               m_hWndSelf,
+		               GotoFileDialogProcedure,
+		               reinterpret_cast<LPARAM>(&data)) == IDOK)
+	{
+		// The list follows the explorer, the file could have been removed outside of it
+		if (GetFileAttributes(data.path.c_str()) == INVALID_FILE_ATTRIBUTES)
+		{
+			m_pStatusBar->SetText(L"File not found.", 0);
+		}
+
+		else
+		{
+			m_pWorkArea->SelectFileFromName(&data.path[0]);
+		}
+	}
+
+	return 0;
+}
+
 LRESULT AppWindow::OnOpenFile(void)
 {
-	wchar_t buffer[MAX_PATH] = { 0 };
+	// Holds the directory followed by the names of all the selected files
+	std::vector<wchar_t> buffer(OPEN_FILES_BUFSIZ, L'\0');
 
 	OPENFILENAME ofn;
 	ZeroMemory(&ofn, sizeof(OPENFILENAME));
@@ -721,17 +1105,39 @@ LRESULT AppWindow::OnOpenFile(void)
 	ofn.hwndOwner = m_hWndSelf;
 	ofn.lpstrFilter = L"Source Code Files (*.*)\0*.*\0";
 	ofn.nFilterIndex = 1;
-	ofn.lpstrFile = buffer;
-	ofn.nMaxFile = MAX_PATH;
-	ofn.Flags = OFN_ENABLESIZING | OFN_FILEMUSTEXIST | OFN_NONETWORKBUTTON | OFN_PATHMUSTEXIST;
+	ofn.lpstrFile = buffer.data();
+	ofn.nMaxFile = static_cast<DWORD>(buffer.size());
+	ofn.Flags = OFN_ENABLESIZING | OFN_FILEMUSTEXIST | OFN_NONETWORKBUTTON | OFN_PATHMUSTEXIST |
+		        OFN_ALLOWMULTISELECT | OFN_EXPLORER;
 	ofn.lpstrDefExt = L".txt";
 
 	m_pStatusBar->SetText(L"Browsing files...", 0);
 
 	if (GetOpenFileName(&ofn))
 	{
-		m_pWorkArea->CreateTab(ofn.lpstrFile);
-		m_pStatusBar->SetText(L"File opened.", 0);
+		std::vector<std::wstring> paths;
+
+		// A single file comes back as a full path, several as the directory and then each name
+		const std::wstring directory = buffer.data();
+
+		for (const wchar_t* lpszName = buffer.data() + directory.length() + 1; *lpszName != L'\0'; lpszName += lstrlen(lpszName) + 1)
+		{
+			paths.push_back(directory + L'\\' + lpszName);
+		}
+
+		if (paths.empty())
+		{
+			paths.push_back(directory);
+		}
+
+		// Only the last file is loaded now, the rest are loaded once they are selected
+		for (size_t i = 0; i + 1 < paths.size(); ++i)
+		{
+			m_pWorkArea->CreateDeferredTab(&paths[i][0]);
+		}
+
+		m_pWorkArea->CreateTab(&paths.back()[0]);
+		m_pStatusBar->SetText(paths.size() > 1 ? L"Files opened." : L"File opened.", 0);
 	}
 
 	else 
@@ -28,12 +28,16 @@ private:
 	LRESULT OnCloseProject(void);
 	LRESULT OnOpenFile(void);
 	LRESULT OnViewStatusBar(void);
+	LRESULT OnEditRegex(void);
+	LRESULT OnFindInFiles(void);
+	LRESULT OnGotoFile(void);
 	void OnSelectAll(HWND hEditWnd);
 	void OnFind(void);
 	void OnReplace(void);
 	void HandleFRMessage(HWND hWnd, WPARAM wParam, LPARAM lParam);
 
 	HRESULT InitializeComponents(void);
+	void RecoverUnsavedFiles(void);
 
 	LRESULT HandleFileMenuCommands(HWND hWnd, WPARAM wIdentifier);
 	LRESULT HandleViewMenuCommands(HWND hWnd, WPARAM wIdentifier);
@@ -48,6 +52,9 @@ public:
 	void Initialize(HINSTANCE hInstance, LPWSTR lpCmdLine);
 	HWND* m_pFindDialog = nullptr;
 
+	/* Searches as the text or the options of the find dialog change */
+	void OnFindTextChanged(HWND hDlg);
+
 	LRESULT WindowProcedure(HWND hWnd, UINT uMessage, WPARAM wParam, LPARAM lParam);
 
 	inline WorkArea* GetWorkArea(void) const {
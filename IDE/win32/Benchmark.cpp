@@ -0,0 +1,24 @@
+#include "Benchmark.h"
+
+double Benchmark::GetMicroseconds(Clock::duration duration)
+{
+	return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+double Benchmark::GetMilliseconds(Clock::duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+FILE* Benchmark::OpenOutputFile(const wchar_t* lpszPath, const wchar_t* lpszMode)
+{
+	FILE* pFile = nullptr;
+	_wfopen_s(&pFile, lpszPath, lpszMode);
+
+	return pFile;
+}
+
+void Benchmark::WriteResult(FILE* pFile, const char* lpszPrefix, const OperationResult& result)
+{
+	fprintf(pFile, "\"%savg_us\":%.3f,\"%smax_us\":%.3f", lpszPrefix, result.averageMicroseconds, lpszPrefix, result.maxMicroseconds);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#define BYTES_PER_MEGABYTE (1024.0 * 1024.0)
+
+/// <summary>
+/// What every benchmark is timed and written with. Each benchmark writes
+/// its results to a file of its own, one line of JSON per measurement.
+/// </summary>
+namespace Benchmark
+{
+	typedef std::chrono::steady_clock Clock;
+
+	/* What one kind of call cost */
+	struct OperationResult {
+		double averageMicroseconds = 0;
+		double maxMicroseconds = 0;
+	};
+
+	extern double GetMicroseconds(Clock::duration duration);
+	extern double GetMilliseconds(Clock::duration duration);
+
+	/* nullptr if the file couldn't be opened, the mode is the one of _wfopen_s */
+	extern FILE* OpenOutputFile(const wchar_t* lpszPath, const wchar_t* lpszMode = L"w");
+
+	/// <summary>
+	/// Writes the result as the members "<prefix>avg_us" and "<prefix>max_us"
+	/// of a JSON object, without a comma before or after them
+	/// </summary>
+	extern void WriteResult(FILE* pFile, const char* lpszPrefix, const OperationResult& result);
+
+	/// <summary>
+	/// Times each call on its own, the index of the call is passed to both
+	/// functions. The second one is called after each call, outside of its time.
+	/// </summary>
+	template <typename Function, typename AfterFunction>
+	OperationResult MeasureOperation(size_t count, Function operation, AfterFunction after)
+	{
+		OperationResult result;
+		Clock::duration total = Clock::duration::zero();
+		Clock::duration slowest = Clock::duration::zero();
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Clock::time_point start = Clock::now();
+			operation(i);
+			const Clock::duration elapsed = Clock::now() - start;
+
+			total += elapsed;
+			slowest = std::max(slowest, elapsed);
+
+			after(i);
+		}
+
+		result.averageMicroseconds = GetMicroseconds(total) / count;
+		result.maxMicroseconds = GetMicroseconds(slowest);
+
+		return result;
+	}
+
+	template <typename Function>
+	OperationResult MeasureOperation(size_t count, Function operation)
+	{
+		return MeasureOperation(count, operation, [](size_t) {});
+	}
+}
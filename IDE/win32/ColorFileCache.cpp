@@ -0,0 +1,199 @@
+#include "ColorFileCache.h"
+#include "Logger.h"
+#include "Hash.h"
+
+#include <vector>
+#include <cstring>
+
+#include <ShlObj.h>
+
+#define COMPILED_MAGIC 0x43434449 // "IDCC"
+#define COMPILED_FORMAT_VERSION 1
+#define COMPILED_EXTENSION L".bin"
+
+/* Followed by the serialized keyword table, which has to start 8 byte aligned */
+struct CompiledHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t charSize;
+	uint32_t tableSize;
+	uint64_t sourceSize;
+	uint64_t sourceWriteTime;
+	uint64_t sourceHash;
+
+	// Compiled copies are named after the color file, this tells apart color files of different installs
+	uint64_t pathHash;
+};
+
+static const std::wstring& GetCacheDirectory(void)
+{
+	static std::wstring directory;
+
+	if (directory.empty())
+	{
+		PWSTR lpszLocalAppData = nullptr;
+
+		if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &lpszLocalAppData)))
+		{
+			directory = lpszLocalAppData;
+			directory.append(L"\\IDE\\Cache");
+			SHCreateDirectoryEx(nullptr, directory.c_str(), nullptr);
+		}
+
+		CoTaskMemFree(lpszLocalAppData);
+	}
+
+	return directory;
+}
+
+static std::wstring GetCompiledPath(const std::wstring& sourcePath)
+{
+	const size_t separator = sourcePath.find_last_of(L"\\/");
+	const std::wstring name = separator == std::wstring::npos ? sourcePath : sourcePath.substr(separator + 1);
+
+	return GetCacheDirectory() + L"\\" + name + COMPILED_EXTENSION;
+}
+
+bool ColorFileCache::GetSourceStamp(const std::wstring& sourcePath, SourceStamp& stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+
+	if (!GetFileAttributesEx(sourcePath.c_str(), GetFileExInfoStandard, &data))
+	{
+		return false;
+	}
+
+	stamp.size = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	stamp.writeTime = (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+
+	return true;
+}
+
+/* Rewrites the header of a compiled file in place, the table that follows it stays the same */
+static bool WriteHeader(const std::wstring& path, const CompiledHeader& header)
+{
+	// Shared because the file is mapped at the same time
+	const HANDLE hFile = CreateFile(path.c_str(),
+		                            GENERIC_WRITE,
+		                            FILE_SHARE_READ | FILE_SHARE_WRITE,
+		                            nullptr,
+		                            OPEN_EXISTING,
+		                            FILE_ATTRIBUTE_NORMAL,
+		                            nullptr);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	DWORD dwWritten = 0;
+	const bool succeeded = WriteFile(hFile, &header, sizeof(header), &dwWritten, nullptr) && dwWritten == sizeof(header);
+
+	CloseHandle(hFile);
+
+	return succeeded;
+}
+
+bool ColorFileCache::Load(const std::wstring& sourcePath, const SourceStamp& stamp, const uint64_t* pSourceHash, MappedFile& file, KeywordTable& table)
+{
+	const std::wstring path = GetCompiledPath(sourcePath);
+
+	// Not having been compiled yet isn't worth logging
+	if (GetFileAttributes(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+	{
+		return false;
+	}
+
+	if (!file.Open(path.c_str()))
+	{
+		return false;
+	}
+
+	const char* pData = file.GetView(0, static_cast<size_t>(file.GetSize()));
+	CompiledHeader header;
+
+	if (pData == nullptr || file.GetSize() < sizeof(header))
+	{
+		file.Close();
+		return false;
+	}
+
+	memcpy(&header, pData, sizeof(header));
+
+	if (header.magic != COMPILED_MAGIC || header.version != COMPILED_FORMAT_VERSION || header.charSize != sizeof(wchar_t) ||
+		header.pathHash != Hash::Fnv1a64(sourcePath.data(), sourcePath.length()) || file.GetSize() != sizeof(header) + header.tableSize)
+	{
+		file.Close();
+		return false;
+	}
+
+	const bool isStampEqual = header.sourceSize == stamp.size && header.sourceWriteTime == stamp.writeTime;
+
+	if (!isStampEqual && (pSourceHash == nullptr || *pSourceHash != header.sourceHash))
+	{
+		file.Close();
+		return false;
+	}
+
+	if (!table.Attach(pData + sizeof(header), header.tableSize))
+	{
+		Logger::Write(L"The compiled copy of %ls is corrupted and will be compiled again", sourcePath.c_str());
+		file.Close();
+		return false;
+	}
+
+	// The file was only touched, e.g. copied over with the same contents, so the next start won't have to read it
+	if (!isStampEqual)
+	{
+		header.sourceSize = stamp.size;
+		header.sourceWriteTime = stamp.writeTime;
+
+		WriteHeader(path, header);
+	}
+
+	return true;
+}
+
+bool ColorFileCache::Save(const std::wstring& sourcePath, const SourceStamp& stamp, uint64_t sourceHash, const KeywordTable& table)
+{
+	std::vector<char> data(sizeof(CompiledHeader));
+	table.Serialize(data);
+
+	CompiledHeader header;
+	header.magic = COMPILED_MAGIC;
+	header.version = COMPILED_FORMAT_VERSION;
+	header.charSize = sizeof(wchar_t);
+	header.tableSize = static_cast<uint32_t>(data.size() - sizeof(header));
+	header.sourceSize = stamp.size;
+	header.sourceWriteTime = stamp.writeTime;
+	header.sourceHash = sourceHash;
+	header.pathHash = Hash::Fnv1a64(sourcePath.data(), sourcePath.length());
+
+	memcpy(data.data(), &header, sizeof(header));
+
+	// Written next to it first, so that a running instance never maps a half written file
+	const std::wstring path = GetCompiledPath(sourcePath);
+	const std::wstring temporaryPath = path + L".tmp";
+
+	const HANDLE hFile = CreateFile(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	DWORD dwWritten = 0;
+	bool succeeded = WriteFile(hFile, data.data(), static_cast<DWORD>(data.size()), &dwWritten, nullptr) && dwWritten == data.size();
+
+	CloseHandle(hFile);
+
+	succeeded = succeeded && MoveFileEx(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+
+	if (!succeeded)
+	{
+		DeleteFile(temporaryPath.c_str());
+		Logger::Write(L"Failed to compile %ls", sourcePath.c_str());
+	}
+
+	return succeeded;
+}
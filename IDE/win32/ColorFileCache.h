@@ -0,0 +1,37 @@
+#pragma once
+
+#include "KeywordTable.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <cstdint>
+
+/* What is compared to tell whether a color file changed since it was compiled */
+struct SourceStamp {
+	unsigned long long size = 0;
+	unsigned long long writeTime = 0;
+};
+
+/// <summary>
+/// Compiled copies of the color files, kept in the user's local app data.
+/// A compiled file holds the keyword table exactly as it is laid out in
+/// memory, so loading it is mapping it and checking its header. It is used
+/// only if the color file still has the size and write time it was compiled
+/// from, or failing that, the same contents.
+/// </summary>
+namespace ColorFileCache
+{
+	bool GetSourceStamp(const std::wstring& sourcePath, SourceStamp& stamp);
+
+	/// <summary>
+	/// Maps the compiled copy of a color file and attaches the table to it,
+	/// the file has to stay open for as long as the table is used. Without a
+	/// hash, only the stamp is compared. With one, a file whose stamp changed
+	/// but whose contents didn't is accepted too, and its stamp is updated.
+	/// </summary>
+	/// <returns> False if there's no compiled copy or it is out of date </returns>
+	bool Load(const std::wstring& sourcePath, const SourceStamp& stamp, const uint64_t* pSourceHash, MappedFile& file, KeywordTable& table);
+
+	/* Compiles the table of a color file, replacing the previous copy */
+	bool Save(const std::wstring& sourcePath, const SourceStamp& stamp, uint64_t sourceHash, const KeywordTable& table);
+}
@@ -1,4 +1,6 @@
 #include "ColorFormatParser.h"
+#include "ColorFileCache.h"
+#include "Hash.h"
 #include "Wordifier.h"
 #include "Logger.h"
 #include "Utility.h"
@@ -10,6 +12,7 @@
 /* Words are expected to be encountered in the following order: */
 /* keyword number (r) number (g) number (b) */
 /* e.g. int 0 255 0 */
+/* The parsed table is compiled, and later starts map the compiled copy instead */
 void ColorFormatParser::ParseFile(const wchar_t* lpszFileName)
 {
 	wchar_t buf[MAX_PATH];
@@ -22,6 +25,14 @@ void ColorFormatParser::ParseFile(const wchar_t* lpszFileName)
 	full_path.push_back(L'\\');
 	full_path.append(lpszFileName);
 
+	SourceStamp stamp;
+	const bool hasStamp = ColorFileCache::GetSourceStamp(full_path, stamp);
+
+	if (hasStamp && ColorFileCache::Load(full_path, stamp, nullptr, m_CompiledFile, m_ColorTable))
+	{
+		return;
+	}
+
 	std::wifstream t(full_path);
 	
 	if (t.fail())
@@ -32,8 +43,17 @@ void ColorFormatParser::ParseFile(const wchar_t* lpszFileName)
 
 	std::wstringstream buffer;
 	buffer << t.rdbuf();
+
+	const std::wstring text = buffer.str();
+	const uint64_t hash = Hash::Fnv1a64(text.data(), text.length());
+
+	// Only the write time changed
+	if (hasStamp && ColorFileCache::Load(full_path, stamp, &hash, m_CompiledFile, m_ColorTable))
+	{
+		return;
+	}
 	
-	Wordifier wordifier(buffer.str());
+	Wordifier wordifier(text);
 	const word_list_t& list = wordifier.GetWords();
 
 	/* if the number count is not a multiple of 4 then there is an error */
@@ -45,6 +65,9 @@ void ColorFormatParser::ParseFile(const wchar_t* lpszFileName)
 
 	bool success = true;
 
+	std::vector<std::pair<std::wstring, uint32_t>> colors;
+	colors.reserve(list.size() / 4);
+
 	for (size_t i = 0; i < list.size(); i += 4)
 	{
 		/* If one of the values following the keyword aren't a valid integer */
@@ -63,22 +86,36 @@ void ColorFormatParser::ParseFile(const wchar_t* lpszFileName)
 
 		else
 		{
-			m_ColorMap[list[i]] = RGB(
+			colors.emplace_back(list[i], RGB(
 				_wtoi(list[i + 1].c_str()),
 				_wtoi(list[i + 2].c_str()),
 				_wtoi(list[i + 3].c_str())
-			);
+			));
 		}
 	}
+
+	m_ColorTable.Build(colors);
+
+	/* A file with errors isn't compiled, so they are reported again on every start */
+	if (success && hasStamp)
+	{
+		ColorFileCache::Save(full_path, stamp, hash, m_ColorTable);
+	}
 }
 
-CRSTATUS ColorFormatParser::GetKeywordColor(const wchar_t* lpszKeyword)
+CRSTATUS ColorFormatParser::GetKeywordColor(const wchar_t* lpszKeyword) const
+{
+	return GetKeywordColor(lpszKeyword, lstrlen(lpszKeyword));
+}
+
+CRSTATUS ColorFormatParser::GetKeywordColor(const wchar_t* pWord, size_t length) const
 {
 	CRSTATUS status;
+	uint32_t color;
 
-	if (m_ColorMap.find(lpszKeyword) != m_ColorMap.end()) // exists
+	if (m_ColorTable.Find(pWord, length, color))
 	{
-		status.cr = m_ColorMap[lpszKeyword];
+		status.cr = color;
 		status.wasFound = true;
 	}
 
@@ -87,17 +124,5 @@ CRSTATUS ColorFormatParser::GetKeywordColor(const wchar_t* lpszKeyword)
 
 int ColorFormatParser::GetMaxLength(void) const
 {
-	size_t max_length = 0;
-
-	for (const std::pair<std::wstring, COLORREF>& pair : m_ColorMap)
-	{
-		const size_t curr_len = pair.first.length();
-
-		if (max_length < curr_len)
-		{
-			max_length = curr_len;
-		}
-	}
-
-	return max_length;
+	return static_cast<int>(m_ColorTable.GetMaxLength());
 }
\ No newline at end of file
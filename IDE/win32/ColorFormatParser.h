@@ -2,7 +2,9 @@
 
 #define WIN32_LEAN_AND_MEAN
 
-#include <unordered_map>
+#include "KeywordTable.h"
+#include "MappedFile.h"
+
 #include <Windows.h>
 
 struct CRSTATUS {
@@ -13,7 +15,10 @@ struct CRSTATUS {
 class ColorFormatParser
 {
 private:
-	std::unordered_map<std::wstring, COLORREF> m_ColorMap;
+	KeywordTable m_ColorTable;
+
+	// The compiled copy of the file the table is attached to, if it was up to date
+	MappedFile m_CompiledFile;
 
 public:
 	void ParseFile(const wchar_t* lpszFileName);
@@ -22,7 +27,10 @@ public:
 	/* Otherwise the wasFound variable is set to false and cr is equal to 0*/
 	/* This is done so the program will try to identify the word as something else */
 	/* e.g. a variable to use a different color */
-	CRSTATUS GetKeywordColor(const wchar_t* lpszKeyword);
+	CRSTATUS GetKeywordColor(const wchar_t* lpszKeyword) const;
+
+	/* Same as above for a word that isn't null terminated, e.g. a token in the middle of a line */
+	CRSTATUS GetKeywordColor(const wchar_t* pWord, size_t length) const;
 
 	int GetMaxLength(void) const;
 };
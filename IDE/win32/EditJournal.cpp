@@ -0,0 +1,771 @@
+#include "EditJournal.h"
+#include "Logger.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <cwctype>
+#include <mutex>
+#include <thread>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <ShlObj.h>
+
+#define JOURNAL_MAGIC 0x4A444549 // "IEDJ"
+#define JOURNAL_FORMAT_VERSION 1
+#define JOURNAL_EXTENSION L".journal"
+
+#define RECORD_EDIT 1
+
+// Characters of the checkpoint encoded at a time
+#define CHECKPOINT_BLOCK_SIZE 65536
+
+static const std::wstring& GetJournalDirectory(void)
+{
+	static std::wstring directory;
+
+	if (directory.empty())
+	{
+		PWSTR lpszLocalAppData = nullptr;
+
+		if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &lpszLocalAppData)))
+		{
+			directory = lpszLocalAppData;
+			directory.append(L"\\IDE\\Journal");
+			SHCreateDirectoryEx(nullptr, directory.c_str(), nullptr);
+		}
+
+		CoTaskMemFree(lpszLocalAppData);
+	}
+
+	return directory;
+}
+
+/* Opens a journal for writing, without sharing it so that another instance won't recover it */
+static HANDLE OpenJournalForWriting(const std::wstring& path, bool truncate)
+{
+	const HANDLE hFile = CreateFile(path.c_str(),
+		                            GENERIC_WRITE,
+		                            0,
+		                            nullptr,
+		                            truncate ? CREATE_ALWAYS : OPEN_EXISTING,
+		                            FILE_ATTRIBUTE_NORMAL,
+		                            nullptr);
+
+	if (hFile != INVALID_HANDLE_VALUE && !truncate)
+	{
+		SetFilePointer(hFile, 0, nullptr, FILE_END);
+	}
+
+	return hFile;
+}
+
+static bool WriteToFile(HANDLE hFile, const char* pData, size_t length)
+{
+	while (length > 0)
+	{
+		DWORD dwWritten = 0;
+
+		if (!WriteFile(hFile, pData, static_cast<DWORD>(length), &dwWritten, nullptr))
+		{
+			return false;
+		}
+
+		pData += dwWritten;
+		length -= static_cast<size_t>(dwWritten);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Reads a whole journal. It's opened without sharing, so a journal that
+/// another instance is still writing can't be opened.
+/// </summary>
+static bool ReadJournal(const std::wstring& path, std::string& bytes, bool& isInUse)
+{
+	isInUse = false;
+
+	const HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		isInUse = GetLastError() == ERROR_SHARING_VIOLATION;
+		return false;
+	}
+
+	LARGE_INTEGER liSize;
+	bool succeeded = GetFileSizeEx(hFile, &liSize) != FALSE;
+
+	if (succeeded)
+	{
+		bytes.resize(static_cast<size_t>(liSize.QuadPart));
+
+		size_t offset = 0;
+
+		while (succeeded && offset < bytes.size())
+		{
+			DWORD dwRead = 0;
+			succeeded = ReadFile(hFile, &bytes[offset], static_cast<DWORD>(bytes.size() - offset), &dwRead, nullptr) && dwRead > 0;
+			offset += dwRead;
+		}
+	}
+
+	CloseHandle(hFile);
+
+	return succeeded;
+}
+
+static std::vector<std::wstring> ListJournalDirectory(void)
+{
+	std::vector<std::wstring> names;
+
+	WIN32_FIND_DATA find_data;
+	const HANDLE hFind = FindFirstFile((GetJournalDirectory() + L"\\*").c_str(), &find_data);
+
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			{
+				names.push_back(find_data.cFileName);
+			}
+		} while (FindNextFile(hFind, &find_data));
+
+		FindClose(hFind);
+	}
+
+	return names;
+}
+
+static bool EndsWith(const std::wstring& text, const wchar_t* lpszSuffix)
+{
+	const size_t length = wcslen(lpszSuffix);
+
+	return text.length() >= length && text.compare(text.length() - length, length, lpszSuffix) == 0;
+}
+
+/// <summary>
+/// Every journal starts with a header and a checkpoint:
+///   u32 magic, u32 version, u32 path length, path, u64 text length, text, u32 checksum
+/// followed by any number of records:
+///   u8 type, u32 position, u32 removed length, u32 inserted length, inserted text, u32 checksum
+/// Text is stored as UTF-16 and numbers as little endian. The checksums
+/// (FNV-1a) cover everything in the header or record before them, so a record that
+/// was only partly written when the program crashed is recognized.
+/// </summary>
+template <typename T>
+static void AppendNumber(std::string& bytes, T value)
+{
+	for (size_t i = 0; i < sizeof(T); ++i)
+	{
+		bytes.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (i * 8)) & 0xFF));
+	}
+}
+
+static void AppendText(std::string& bytes, const wchar_t* pText, size_t length)
+{
+	bytes.append(reinterpret_cast<const char*>(pText), length * sizeof(wchar_t));
+}
+
+/* Reads what the Append functions wrote, failing instead of reading past the end */
+class JournalReader
+{
+private:
+	const std::string& m_Bytes;
+	size_t m_Offset = 0;
+
+public:
+	explicit JournalReader(const std::string& bytes)
+		: m_Bytes(bytes) {}
+
+	size_t GetOffset(void) const { return m_Offset; }
+	bool IsAtEnd(void) const { return m_Offset >= m_Bytes.size(); }
+
+	template <typename T>
+	bool ReadNumber(T& value)
+	{
+		if (m_Bytes.size() - m_Offset < sizeof(T))
+		{
+			return false;
+		}
+
+		uint64_t result = 0;
+
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			result |= static_cast<uint64_t>(static_cast<unsigned char>(m_Bytes[m_Offset + i])) << (i * 8);
+		}
+
+		value = static_cast<T>(result);
+		m_Offset += sizeof(T);
+
+		return true;
+	}
+
+	bool ReadText(std::wstring& text, uint64_t length)
+	{
+		if ((m_Bytes.size() - m_Offset) / sizeof(wchar_t) < length)
+		{
+			return false;
+		}
+
+		text.resize(static_cast<size_t>(length));
+		memcpy(&text[0], m_Bytes.data() + m_Offset, text.length() * sizeof(wchar_t));
+
+		m_Offset += text.length() * sizeof(wchar_t);
+
+		return true;
+	}
+
+	/* Checksum of the bytes from 'start' up to where the reader is */
+	uint32_t GetChecksum(size_t start) const
+	{
+		return Hash::Fnv1a32(m_Bytes.data() + start, m_Offset - start);
+	}
+};
+
+/* Applies the records to the document up to the end, or up to the first one that is torn or corrupted */
+static void ApplyRecords(JournalReader& reader, PieceTable& document)
+{
+	std::wstring inserted;
+
+	while (!reader.IsAtEnd())
+	{
+		const size_t start = reader.GetOffset();
+
+		uint8_t type = 0;
+		uint32_t position = 0, removed = 0, insertedLength = 0, checksum = 0;
+
+		if (!reader.ReadNumber(type) || type != RECORD_EDIT ||
+			!reader.ReadNumber(position) || !reader.ReadNumber(removed) ||
+			!reader.ReadNumber(insertedLength) || !reader.ReadText(inserted, insertedLength))
+		{
+			break;
+		}
+
+		const uint32_t expected = reader.GetChecksum(start);
+
+		// The rest was being written when the program stopped
+		if (!reader.ReadNumber(checksum) || checksum != expected ||
+			static_cast<size_t>(position) + removed > document.GetLength())
+		{
+			break;
+		}
+
+		document.Replace(position, removed, inserted.data(), inserted.length());
+	}
+}
+
+/// <summary>
+/// State of one journal, shared by the EditJournal on the UI thread and
+/// the thread that writes it
+/// </summary>
+struct JournalFile {
+	std::wstring path;
+	std::wstring sourcePath;
+
+	// Guards the two members below, which are filled in by the UI thread
+	std::mutex mutex;
+	std::string pending;
+	std::unique_ptr<PieceTable> pCheckpoint;
+
+	// Guards the file and the members below, the UI thread only takes it to close the journal
+	std::mutex writeMutex;
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	bool hasFailed = false;
+	bool isClosed = false;
+
+	// The text the journal on the disk rebuilds to, and the bytes of records after its checkpoint
+	std::unique_ptr<PieceTable> pText;
+	size_t recordBytes = 0;
+};
+
+/// <summary>
+/// Starts the journal over: the checkpoint goes to a temporary file that
+/// then replaces the old journal, so there is a complete journal on the
+/// disk at any point.
+/// </summary>
+static bool WriteCheckpoint(JournalFile& file, const PieceTable& document, const std::string& records)
+{
+	const std::wstring temporaryPath = file.path + L".tmp";
+
+	const HANDLE hFile = OpenJournalForWriting(temporaryPath, true);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	std::string bytes;
+	AppendNumber<uint32_t>(bytes, JOURNAL_MAGIC);
+	AppendNumber<uint32_t>(bytes, JOURNAL_FORMAT_VERSION);
+	AppendNumber<uint32_t>(bytes, static_cast<uint32_t>(file.sourcePath.length()));
+	AppendText(bytes, file.sourcePath.data(), file.sourcePath.length());
+	AppendNumber<uint64_t>(bytes, document.GetLength());
+
+	uint32_t checksum = FNV1A_32_OFFSET_BASIS;
+	bool succeeded = true;
+
+	std::vector<wchar_t> block(CHECKPOINT_BLOCK_SIZE);
+	size_t position = 0;
+
+	do
+	{
+		const size_t copied = document.CopyTextRange(position, block.size(), block.data());
+		AppendText(bytes, block.data(), copied);
+		position += copied;
+
+		checksum = Hash::Fnv1a32(bytes.data(), bytes.size(), checksum);
+		succeeded = WriteToFile(hFile, bytes.data(), bytes.size());
+		bytes.clear();
+	} while (succeeded && position < document.GetLength());
+
+	AppendNumber<uint32_t>(bytes, checksum);
+	bytes.append(records);
+
+	succeeded = succeeded && WriteToFile(hFile, bytes.data(), bytes.size()) && FlushFileBuffers(hFile);
+	CloseHandle(hFile);
+
+	if (!succeeded)
+	{
+		DeleteFile(temporaryPath.c_str());
+		return false;
+	}
+
+	// The journal can't be replaced while it's open
+	if (file.hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file.hFile);
+		file.hFile = INVALID_HANDLE_VALUE;
+	}
+
+	if (!MoveFileEx(temporaryPath.c_str(), file.path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		DeleteFile(temporaryPath.c_str());
+		return false;
+	}
+
+	file.hFile = OpenJournalForWriting(file.path, false);
+
+	return file.hFile != INVALID_HANDLE_VALUE;
+}
+
+/* Writes the records that came in since the last time, the caller holds the write mutex of the journal */
+static void FlushJournalFile(JournalFile& file)
+{
+	if (file.isClosed)
+	{
+		return;
+	}
+
+	std::string records;
+	std::unique_ptr<PieceTable> pCheckpoint;
+
+	{
+		std::lock_guard<std::mutex> lock(file.mutex);
+		records.swap(file.pending);
+		pCheckpoint = std::move(file.pCheckpoint);
+	}
+
+	bool succeeded = true;
+
+	if (pCheckpoint != nullptr)
+	{
+		succeeded = WriteCheckpoint(file, *pCheckpoint, records);
+
+		file.pText = std::move(pCheckpoint);
+		file.recordBytes = 0;
+	}
+
+	else if (!records.empty())
+	{
+		// Records that follow a checkpoint that couldn't be written are useless
+		succeeded = file.hFile != INVALID_HANDLE_VALUE &&
+			        WriteToFile(file.hFile, records.data(), records.size()) &&
+			        FlushFileBuffers(file.hFile);
+	}
+
+	// Kept up to date here, so that the journal starts over without copying the document on a keystroke
+	if (file.pText != nullptr && !records.empty())
+	{
+		JournalReader reader(records);
+		ApplyRecords(reader, *file.pText);
+
+		file.recordBytes += records.size();
+	}
+
+	if (succeeded && file.recordBytes >= JOURNAL_COMPACT_THRESHOLD)
+	{
+		succeeded = WriteCheckpoint(file, *file.pText, std::string());
+		file.recordBytes = 0;
+	}
+
+	// Logged only once, the journal is retried with the next checkpoint
+	if (!succeeded && !file.hasFailed)
+	{
+		Logger::Write(L"Failed to write the edit journal of %ls", file.sourcePath.c_str());
+	}
+
+	file.hasFailed = !succeeded;
+}
+
+/// <summary>
+/// Thread that writes and flushes every journal that has new records a few
+/// times per second. Its mutex only guards the list of journals, each one
+/// is written under its own write mutex, so removing or deleting a journal
+/// waits for that journal to be written and never for the others.
+/// </summary>
+class JournalFlusher
+{
+private:
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::vector<std::shared_ptr<JournalFile>> m_Files;
+	bool m_IsStopping = false;
+
+	// Last, so that it starts after everything else has been initialized
+	std::thread m_Thread;
+
+	void Run(void)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		while (!m_IsStopping)
+		{
+			m_Wake.wait_for(lock, std::chrono::milliseconds(JOURNAL_FLUSH_INTERVAL_MS));
+
+			// Written without the lock, so that adding or removing a journal doesn't wait for the disk
+			const std::vector<std::shared_ptr<JournalFile>> files = m_Files;
+			lock.unlock();
+
+			for (const std::shared_ptr<JournalFile>& pFile : files)
+			{
+				std::lock_guard<std::mutex> fileLock(pFile->writeMutex);
+				FlushJournalFile(*pFile);
+			}
+
+			lock.lock();
+		}
+	}
+
+public:
+	JournalFlusher(void)
+		: m_Thread(&JournalFlusher::Run, this) {}
+
+	~JournalFlusher(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_IsStopping = true;
+		}
+
+		m_Wake.notify_all();
+		m_Thread.join();
+	}
+
+	void Add(const std::shared_ptr<JournalFile>& pFile)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Files.push_back(pFile);
+	}
+
+	/* Writes what's left of the journal, or deletes it */
+	void Remove(const std::shared_ptr<JournalFile>& pFile, bool deleteJournal)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			for (size_t i = 0; i < m_Files.size(); ++i)
+			{
+				if (m_Files[i] == pFile)
+				{
+					m_Files.erase(m_Files.begin() + i);
+					break;
+				}
+			}
+		}
+
+		// The thread may still be writing it from its copy of the list, it's skipped once closed
+		std::lock_guard<std::mutex> fileLock(pFile->writeMutex);
+
+		if (!deleteJournal)
+		{
+			FlushJournalFile(*pFile);
+		}
+
+		if (pFile->hFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(pFile->hFile);
+			pFile->hFile = INVALID_HANDLE_VALUE;
+		}
+
+		pFile->isClosed = true;
+
+		if (deleteJournal)
+		{
+			DeleteFile(pFile->path.c_str());
+		}
+	}
+
+	void DeleteJournal(const std::wstring& path)
+	{
+		std::shared_ptr<JournalFile> pFile;
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			for (const std::shared_ptr<JournalFile>& pCurrent : m_Files)
+			{
+				if (pCurrent->path == path)
+				{
+					pFile = pCurrent;
+					break;
+				}
+			}
+		}
+
+		if (pFile != nullptr)
+		{
+			std::lock_guard<std::mutex> fileLock(pFile->writeMutex);
+			DeleteFile(path.c_str());
+		}
+
+		else
+		{
+			DeleteFile(path.c_str());
+		}
+	}
+};
+
+static JournalFlusher& GetFlusher(void)
+{
+	static JournalFlusher flusher;
+
+	return flusher;
+}
+
+/* Journals are named after a hash of the path of their file, so a file always has the same one */
+static std::wstring GetJournalPath(const std::wstring& path)
+{
+	std::wstring folded(path);
+	std::transform(folded.begin(), folded.end(), folded.begin(), towlower);
+
+	const uint64_t hash = Hash::Fnv1a64(folded.data(), folded.length());
+
+	wchar_t name[17];
+	swprintf(name, 17, L"%016llx", static_cast<unsigned long long>(hash));
+
+	return GetJournalDirectory() + L"\\" + name + JOURNAL_EXTENSION;
+}
+
+EditJournal::EditJournal(const PieceTable& document)
+	: m_Document(document)
+{
+}
+
+EditJournal::~EditJournal(void)
+{
+	if (m_pFile != nullptr)
+	{
+		GetFlusher().Remove(m_pFile, false);
+	}
+}
+
+void EditJournal::SetFilePath(const std::wstring& path)
+{
+	if (path == m_FilePath)
+	{
+		return;
+	}
+
+	const bool wasActive = IsActive();
+
+	// The journal of the old path would be recovered into a file that doesn't exist anymore
+	Discard();
+	m_FilePath = path;
+
+	if (wasActive)
+	{
+		Begin();
+	}
+}
+
+void EditJournal::Begin(void)
+{
+	if (IsActive() || m_FilePath.empty() || GetJournalDirectory().empty())
+	{
+		return;
+	}
+
+	m_pFile = std::make_shared<JournalFile>();
+	m_pFile->path = GetJournalPath(m_FilePath);
+	m_pFile->sourcePath = m_FilePath;
+
+	Checkpoint();
+	GetFlusher().Add(m_pFile);
+}
+
+/* Copying the document doesn't copy the text it was loaded with, so this is cheap even for big files */
+void EditJournal::Checkpoint(void)
+{
+	std::unique_ptr<PieceTable> pCheckpoint(new PieceTable(m_Document));
+
+	std::lock_guard<std::mutex> lock(m_pFile->mutex);
+	m_pFile->pCheckpoint = std::move(pCheckpoint);
+	m_pFile->pending.clear();
+}
+
+void EditJournal::Discard(void)
+{
+	if (m_pFile != nullptr)
+	{
+		GetFlusher().Remove(m_pFile, true);
+		m_pFile.reset();
+	}
+}
+
+void EditJournal::DiscardFile(const std::wstring& path)
+{
+	if (!path.empty() && !GetJournalDirectory().empty())
+	{
+		GetFlusher().DeleteJournal(GetJournalPath(path));
+	}
+}
+
+void EditJournal::OnDocumentEdit(const TextEdit& edit)
+{
+	if (m_pFile == nullptr)
+	{
+		return;
+	}
+
+	// Only the length of the removed text is needed to replay the edit
+	std::lock_guard<std::mutex> lock(m_pFile->mutex);
+	std::string& bytes = m_pFile->pending;
+	const size_t start = bytes.size();
+
+	AppendNumber<uint8_t>(bytes, RECORD_EDIT);
+	AppendNumber<uint32_t>(bytes, static_cast<uint32_t>(edit.position));
+	AppendNumber<uint32_t>(bytes, static_cast<uint32_t>(edit.removed.length()));
+	AppendNumber<uint32_t>(bytes, static_cast<uint32_t>(edit.inserted.length()));
+	AppendText(bytes, edit.inserted.data(), edit.inserted.length());
+	AppendNumber<uint32_t>(bytes, Hash::Fnv1a32(bytes.data() + start, bytes.size() - start));
+}
+
+void EditJournal::OnDocumentLoad(const PieceTable& document)
+{
+	if (m_pFile != nullptr)
+	{
+		Checkpoint();
+	}
+}
+
+/* Rebuilds the text of a journal, false if not even its checkpoint is intact */
+static bool ReplayJournal(const std::string& bytes, RecoveredFile& recovered)
+{
+	JournalReader reader(bytes);
+
+	uint32_t magic = 0, version = 0, pathLength = 0;
+	uint64_t textLength = 0;
+	uint32_t checksum = 0;
+	std::wstring text;
+
+	if (!reader.ReadNumber(magic) || magic != JOURNAL_MAGIC ||
+		!reader.ReadNumber(version) || version != JOURNAL_FORMAT_VERSION ||
+		!reader.ReadNumber(pathLength) || !reader.ReadText(recovered.path, pathLength) ||
+		!reader.ReadNumber(textLength) || !reader.ReadText(text, textLength))
+	{
+		return false;
+	}
+
+	const uint32_t expected = reader.GetChecksum(0);
+
+	if (!reader.ReadNumber(checksum) || checksum != expected)
+	{
+		return false;
+	}
+
+	PieceTable document;
+	document.Load(std::move(text));
+
+	ApplyRecords(reader, document);
+
+	recovered.text = document.GetText();
+
+	return true;
+}
+
+std::vector<RecoveredFile> EditJournal::Recover(void)
+{
+	std::vector<RecoveredFile> recovered;
+
+	if (GetJournalDirectory().empty())
+	{
+		return recovered;
+	}
+
+	for (const std::wstring& name : ListJournalDirectory())
+	{
+		const std::wstring path = GetJournalDirectory() + L"\\" + name;
+
+		// Left by a crash in the middle of a checkpoint, the journal it was replacing is still there
+		if (EndsWith(name, JOURNAL_EXTENSION L".tmp"))
+		{
+			DeleteFile(path.c_str());
+			continue;
+		}
+
+		if (!EndsWith(name, JOURNAL_EXTENSION))
+		{
+			continue;
+		}
+
+		std::string bytes;
+		bool isInUse = false;
+
+		// A journal another instance is writing is left alone
+		if (!ReadJournal(path, bytes, isInUse))
+		{
+			if (!isInUse)
+			{
+				DeleteFile(path.c_str());
+			}
+
+			continue;
+		}
+
+		RecoveredFile file;
+
+		if (ReplayJournal(bytes, file))
+		{
+			recovered.push_back(std::move(file));
+		}
+
+		else
+		{
+			Logger::Write(L"The edit journal %ls is corrupted and was deleted", path.c_str());
+			DeleteFile(path.c_str());
+		}
+	}
+
+	return recovered;
+}
+
+bool EditJournal::RecoverFile(const std::wstring& path, RecoveredFile& recovered)
+{
+	if (path.empty() || GetJournalDirectory().empty())
+	{
+		return false;
+	}
+
+	std::string bytes;
+	bool isInUse = false;
+
+	return ReadJournal(GetJournalPath(path), bytes, isInUse) && ReplayJournal(bytes, recovered);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "PieceTable.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Records are written and flushed to the disk at most this often
+#define JOURNAL_FLUSH_INTERVAL_MS 250
+
+// Once the records take up this much, the journal starts over from a new checkpoint
+#define JOURNAL_COMPACT_THRESHOLD (8 * 1024 * 1024)
+
+struct JournalFile;
+
+/* Unsaved text of a file rebuilt from its journal */
+struct RecoveredFile {
+	std::wstring path;
+	std::wstring text;
+};
+
+/// <summary>
+/// Write-ahead journal of the unsaved edits of a document, so that they
+/// survive a crash. While the document has unsaved changes every edit is
+/// appended to a file as a small binary record, after a checkpoint that
+/// holds the whole text the edits apply to. Records only go to memory on
+/// the UI thread, a background thread writes and flushes them in batches
+/// and starts the journal over from a new checkpoint once it grows too big.
+/// The journal is deleted when the document is saved or closed normally,
+/// so the journals found on startup are the ones a crash left behind.
+/// </summary>
+class EditJournal : public DocumentListener
+{
+private:
+	const PieceTable& m_Document;
+	std::wstring m_FilePath;
+
+	// Set while the document has unsaved changes
+	std::shared_ptr<JournalFile> m_pFile;
+
+	void Checkpoint(void);
+
+public:
+	explicit EditJournal(const PieceTable& document);
+
+	/* Keeps the journal, a hibernated tab still has the unsaved changes */
+	~EditJournal(void);
+
+	EditJournal(const EditJournal&) = delete;
+	EditJournal& operator=(const EditJournal&) = delete;
+
+	void OnDocumentEdit(const TextEdit& edit) override;
+	void OnDocumentLoad(const PieceTable& document) override;
+
+	/* Path of the file the document is saved to, the journal is named after it */
+	void SetFilePath(const std::wstring& path);
+
+	/* Called when the document gets unsaved changes, starts journaling from its current text */
+	void Begin(void);
+
+	/* Called when the changes are saved or thrown away, deletes the journal */
+	void Discard(void);
+
+	bool IsActive(void) const { return m_pFile != nullptr; }
+
+	/* Deletes the journal of a file whose document doesn't exist anymore */
+	static void DiscardFile(const std::wstring& path);
+
+	/// <summary>
+	/// Replays the journals left behind by a crash. A journal that is still
+	/// in use by another instance is skipped, one that can't be read at all
+	/// is deleted. Records after a torn or corrupted one are ignored.
+	/// </summary>
+	static std::vector<RecoveredFile> Recover(void);
+
+	/* Replays the journal of one file, false if it has none that can be read */
+	static bool RecoverFile(const std::wstring& path, RecoveredFile& recovered);
+};
@@ -5,11 +5,14 @@
 #include "AppWindow.h"
 #include "resource.h"
 #include "SourceTab.h"
+#include "SaveScheduler.h"
 
 #include <shellapi.h>
 #include <CommCtrl.h>
 #include <windowsx.h>
-#include <fstream>
+#include <vector>
+#include <memory>
+#include <algorithm>
 #include <ShlObj.h>
 #include <atlbase.h>
 
@@ -55,6 +58,11 @@ Explorer::Explorer(HWND hParentWindow)
 		PostQuitMessage(1);
 		return;
 	}
+
+	m_pSaveScheduler = new SaveScheduler(m_hWndSelf);
+	m_pFileSearch = new FileSearch(m_hWndSelf);
+	m_pTrigramIndex = new TrigramIndex;
+	m_pFileFinder = new FileFinder;
 }
 
 void Explorer::SetStatusBar(StatusBar* pStatusBar)
@@ -134,6 +142,14 @@ Explorer::~Explorer(void)
 	ImageList_Destroy(hImageList);
 
 	SAFE_DELETE_GDIOBJ(hFileIcon);
+
+	// Waits for the files that are still being written
+	SAFE_DELETE_PTR(m_pSaveScheduler);
+	SAFE_DELETE_PTR(m_pFileSearch);
+
+	// Saves the index of the open folder
+	SAFE_DELETE_PTR(m_pTrigramIndex);
+	SAFE_DELETE_PTR(m_pFileFinder);
 }
 
 void Explorer::InitializeImageList(void)
@@ -166,6 +182,9 @@ void Explorer::InitializeImageList(void)
 
 void Explorer::CloseProjectFolder(void)
 {
+	CancelFindInFiles();
+	m_pTrigramIndex->Close();
+	m_pFileFinder->Close();
 	TreeView_DeleteAllItems(m_hTreeWindow);
 }
 
@@ -250,6 +269,12 @@ LRESULT Explorer::WindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
 	case WM_DPICHANGED_BEFOREPARENT:
 		InitializeImageList();
 		return 0;
+
+	case WM_FILE_SAVED:
+		return OnFileSavedInBackground(lParam);
+
+	case WM_FILE_SEARCH_RESULTS:
+		return OnFileSearchResults(lParam);
 	}
 
 	return DefWindowProc(hWnd, uMsg, wParam, lParam);
@@ -330,6 +355,7 @@ LRESULT Explorer::OnEndLabelEdit(LPARAM lParam)
 			if (MoveFile(absolute_path.c_str(), new_absolute_path.c_str()))
 			{
 				ChangeSavedAbsolutePath(absolute_path, new_absolute_path, is_directory);
+				m_pFileFinder->RenamePath(absolute_path, new_absolute_path);
 
 				return TRUE;
 			}
@@ -651,8 +677,11 @@ static void DeleteTabFromWorkArea(TABINFO& tabInfo)
 	tabInfo.pSourceTab->Hide();
 	DestroyWindow(tabInfo.pSourceTab->GetHandle());
 
-	tabInfo.pSourceTab->GetSourceEdit()->Hide();
-	DestroyWindow(tabInfo.pSourceTab->GetSourceEdit()->GetHandle());
+	if (tabInfo.pSourceTab->IsMaterialized())
+	{
+		tabInfo.pSourceTab->GetSourceEdit()->Hide();
+		DestroyWindow(tabInfo.pSourceTab->GetSourceEdit()->GetHandle());
+	}
 
 	delete tabInfo.pSourceTab;
 }
@@ -727,6 +756,7 @@ void Explorer::OnDelete(void)
 		{
 			TreeView_DeleteItem(m_hTreeWindow, m_hRightClickedItem);
 			m_hRightClickedItem = nullptr;
+			m_pFileFinder->RemovePath(path);
 			m_pStatusBar->SetText(L"Folder deleted", 0);
 			SelectTabAfterDelete(pWorkArea);
 		}
@@ -738,6 +768,7 @@ void Explorer::OnDelete(void)
 
 		TreeView_DeleteItem(m_hTreeWindow, m_hRightClickedItem);
 		m_hRightClickedItem = nullptr;
+		m_pFileFinder->RemovePath(path);
 
 		WorkArea* pWorkArea = GetAssociatedObject<AppWindow>(m_hWndParent)->GetWorkArea();
 
@@ -936,6 +967,11 @@ void Explorer::ExploreDirectory(const wchar_t* directory, HTREEITEM hParent)
 				else
 				{
 					Utility::AddToTree(m_hTreeWindow, hParent, find_data.cFileName, false);
+
+					std::wstring file_path = directory;
+					file_path += L'\\';
+					file_path += find_data.cFileName;
+					m_pFileFinder->AddFile(file_path);
 				}
 			}
 		} while (FindNextFile(hFind, &find_data));
@@ -949,39 +985,96 @@ void Explorer::ExploreDirectory(const wchar_t* directory, HTREEITEM hParent)
 	}
 }
 
-static void WriteWindowTextToFile(HWND hWindow, std::wofstream& file)
+bool Explorer::SaveFileFromTab(SourceTab* pSourceTab)
 {
-	const size_t length = GetWindowTextLength(hWindow) + 1;
+	std::unique_ptr<SaveJob> pJob = SaveJob::FromTab(pSourceTab);
 
-	wchar_t* buffer = new wchar_t[length];
+	if (pJob == nullptr)
+	{
+		return true;
+	}
 
-	GetWindowText(hWindow, buffer, length);
-	file.write(buffer, length);
+	pJob->Run();
+	OnFileSaved(pJob.get());
 
-	delete[] buffer;
+	return pJob->hasSucceeded;
 }
 
-void Explorer::SaveFileFromTab(SourceTab* pSourceTab)
+/* Tabs can be closed and deleted while their file is being saved, and a new tab can get the same address */
+static SourceTab* FindTabInWorkArea(size_t tabId, WorkArea* pWorkArea)
 {
-	if (pSourceTab != nullptr)
+	for (const TabList* pTabs : { &pWorkArea->GetVisibleTabs(), &pWorkArea->GetHiddenTabs() })
 	{
-		SourceEdit* pSourceEdit = pSourceTab->GetSourceEdit();
-
-		if (pSourceEdit != nullptr)
+		for (SourceTab* pSourceTab : *pTabs)
 		{
-			if (pSourceEdit->HasBeenEdited())
+			if (pSourceTab->GetId() == tabId)
 			{
-				std::wofstream current_file(pSourceTab->GetPath(), std::ios::trunc | std::ios::binary);
-
-				if (current_file.is_open())
-				{
-					WriteWindowTextToFile(pSourceEdit->GetHandle(), current_file);
-					pSourceTab->RemoveAsteriskFromDisplayedName();
-					pSourceEdit->MarkAsUnedited();
-				}
+				return pSourceTab;
 			}
 		}
 	}
+
+	return nullptr;
+}
+
+/// <summary>
+/// Clears the unsaved changes of the tab, unless it was edited after its
+/// text was copied for saving, and reports a file that couldn't be saved.
+/// </summary>
+void Explorer::OnFileSaved(SaveJob* pJob)
+{
+	if (!pJob->hasSucceeded)
+	{
+		Logger::Write(L"Failed to save %ls", pJob->path.c_str());
+
+		const std::wstring text = L"Failed to save " + Utility::GetFileNameFromPath(pJob->path) + L".";
+		m_pStatusBar->SetText(text.c_str(), 0);
+		return;
+	}
+
+	// Doesn't wait for the folder to be watched, the file may not even be in it
+	m_pTrigramIndex->Update(pJob->path);
+
+	AppWindow* pAppWindow = GetAssociatedObject<AppWindow>(m_hWndParent);
+
+	SourceTab* pSourceTab = pAppWindow != nullptr ? FindTabInWorkArea(pJob->tabId, pAppWindow->GetWorkArea()) : nullptr;
+
+	if (pSourceTab != nullptr && pSourceTab->GetVersion() == pJob->version)
+	{
+		pSourceTab->MarkAsSaved();
+	}
+}
+
+LRESULT Explorer::OnFileSavedInBackground(LPARAM lParam)
+{
+	SaveJob* pJob = reinterpret_cast<SaveJob*>(lParam);
+
+	OnFileSaved(pJob);
+
+	if (m_pSaveScheduler->OnJobFinished(pJob))
+	{
+		const size_t failed = m_pSaveScheduler->GetFailedCount();
+
+		if (failed == 0)
+		{
+			m_pStatusBar->SetText(L"All files saved.", 0);
+		}
+
+		else
+		{
+			const std::wstring text = std::to_wstring(failed) + (failed == 1 ? L" file couldn't be saved." : L" files couldn't be saved.");
+			m_pStatusBar->SetText(text.c_str(), 0);
+		}
+	}
+
+	else
+	{
+		const std::wstring text = L"Saving files... (" + std::to_wstring(m_pSaveScheduler->GetFinishedCount()) + L"/" +
+			                      std::to_wstring(m_pSaveScheduler->GetJobCount()) + L")";
+		m_pStatusBar->SetText(text.c_str(), 0);
+	}
+
+	return 0;
 }
 
 void Explorer::SaveCurrentFile(WorkArea* pWorkArea)
@@ -992,35 +1085,200 @@ void Explorer::SaveCurrentFile(WorkArea* pWorkArea)
 
 		if (pSourceTab != nullptr)
 		{
-			if (pSourceTab->GetSourceEdit()->HasBeenEdited())
+			if (pSourceTab->HasUnsavedChanges() && SaveFileFromTab(pSourceTab))
 			{
-				SaveFileFromTab(pSourceTab);
 				m_pStatusBar->SetText(L"Saved file.", 0);
 			}
 		}
 	}
 }
 
+/// <summary>
+/// Copies the text of every tab with unsaved changes and writes the files
+/// in the background. The tabs are marked as saved one by one as their
+/// files are written, see OnFileSavedInBackground.
+/// </summary>
 void Explorer::SaveAllFiles(WorkArea* pWorkArea)
 {
-	TabList& opened_tabs = pWorkArea->GetVisibleTabs();
+	if (m_pSaveScheduler->IsRunning())
+	{
+		m_pStatusBar->SetText(L"Files are still being saved.", 0);
+		return;
+	}
+
+	std::vector<std::unique_ptr<SaveJob>> jobs;
 
-	for (SourceTab* pSourceTab : opened_tabs)
+	for (SourceTab* pSourceTab : pWorkArea->GetVisibleTabs())
 	{
-		SaveFileFromTab(pSourceTab);
+		std::unique_ptr<SaveJob> pJob = SaveJob::FromTab(pSourceTab);
+
+		if (pJob != nullptr)
+		{
+			jobs.push_back(std::move(pJob));
+		}
 	}
 
-	TabList& hidden_tabs = pWorkArea->GetHiddenTabs();
+	for (SourceTab* pSourceTab : pWorkArea->GetHiddenTabs())
+	{
+		std::unique_ptr<SaveJob> pJob = SaveJob::FromTab(pSourceTab);
+
+		if (pJob != nullptr)
+		{
+			jobs.push_back(std::move(pJob));
+		}
+	}
 
-	for (SourceTab* pSourceTab : hidden_tabs)
+	if (jobs.empty())
 	{
-		SaveFileFromTab(pSourceTab);
+		if (!pWorkArea->GetVisibleTabs().empty() || !pWorkArea->GetHiddenTabs().empty())
+		{
+			m_pStatusBar->SetText(L"All files saved.", 0);
+		}
+
+		return;
 	}
 
-	if (!opened_tabs.empty() || !hidden_tabs.empty())
+	m_pStatusBar->SetText(L"Saving files...", 0);
+	m_pSaveScheduler->Start(std::move(jobs));
+}
+
+void Explorer::FindInFiles(const FileSearchQuery& query, WorkArea* pWorkArea)
+{
+	const HTREEITEM hRoot = TreeView_GetRoot(m_hTreeWindow);
+	AppWindow* pAppWindow = GetAssociatedObject<AppWindow>(m_hWndParent);
+
+	if (hRoot == nullptr || pAppWindow == nullptr)
 	{
-		m_pStatusBar->SetText(L"All files saved.", 0);
+		m_pStatusBar->SetText(L"Open a folder to search in.", 0);
+		return;
+	}
+
+	std::wstring folder;
+	GetItemPath(m_hTreeWindow, hRoot, folder);
+
+	std::vector<std::unique_ptr<FileSearchDocument>> documents;
+
+	for (SourceTab* pSourceTab : pWorkArea->GetVisibleTabs())
+	{
+		std::unique_ptr<FileSearchDocument> pDocument = FileSearchDocument::FromTab(pSourceTab);
+
+		if (pDocument != nullptr)
+		{
+			documents.push_back(std::move(pDocument));
+		}
+	}
+
+	for (SourceTab* pSourceTab : pWorkArea->GetHiddenTabs())
+	{
+		std::unique_ptr<FileSearchDocument> pDocument = FileSearchDocument::FromTab(pSourceTab);
+
+		if (pDocument != nullptr)
+		{
+			documents.push_back(std::move(pDocument));
+		}
+	}
+
+	std::wstring error;
+
+	if (!m_pFileSearch->Start(folder, query, std::move(documents), m_pTrigramIndex, error))
+	{
+		const std::wstring text = L"Invalid regular expression: " + error;
+		m_pStatusBar->SetText(text.c_str(), 0);
+		return;
 	}
+
+	OutputContainer* pOutputContainer = pAppWindow->GetOutputWindow();
+	pOutputContainer->ShowOutput();
+
+	Output* pOutput = pOutputContainer->GetOutput();
+	pOutput->Clear();
+	pOutput->WriteLine(L"Find all \"%ls\" in %ls", query.pattern.c_str(), folder.c_str());
+
+	m_pStatusBar->SetText(L"Searching... (Ctrl+Shift+F to stop)", 0);
+}
+
+void Explorer::CancelFindInFiles(void)
+{
+	if (!m_pFileSearch->IsRunning())
+	{
+		return;
+	}
+
+	m_pFileSearch->Cancel();
+
+	AppWindow* pAppWindow = GetAssociatedObject<AppWindow>(m_hWndParent);
+
+	if (pAppWindow != nullptr)
+	{
+		pAppWindow->GetOutputWindow()->GetOutput()->WriteLine(L"Search was stopped.");
+	}
+
+	m_pStatusBar->SetText(L"Find in Files stopped.", 0);
+}
+
+bool Explorer::IsFindInFilesRunning(void) const
+{
+	return m_pFileSearch->IsRunning();
+}
+
+LRESULT Explorer::OnFileSearchResults(LPARAM lParam)
+{
+	const std::unique_ptr<FileSearchBatch> pBatch(reinterpret_cast<FileSearchBatch*>(lParam));
+	AppWindow* pAppWindow = GetAssociatedObject<AppWindow>(m_hWndParent);
+
+	// Found before the search was stopped or started again
+	if (!m_pFileSearch->OnBatch(pBatch.get()) || pAppWindow == nullptr)
+	{
+		return 0;
+	}
+
+	Output* pOutput = pAppWindow->GetOutputWindow()->GetOutput();
+
+	// Written in one go, every write goes through the control
+	std::wstring text;
+
+	for (const FileSearchResult& result : pBatch->results)
+	{
+		text.append(result.path);
+		text.append(L"(" + std::to_wstring(result.line) + L"," + std::to_wstring(result.column) + L"): ");
+		text.append(result.lineText);
+		text.append(L"\r\n");
+	}
+
+	if (!text.empty())
+	{
+		pOutput->Write(L"%ls", text.c_str());
+	}
+
+	const size_t matches = m_pFileSearch->GetMatchCount();
+	const size_t files = m_pFileSearch->GetMatchingFileCount();
+
+	if (!pBatch->isLast)
+	{
+		const std::wstring status = L"Searching... " + std::to_wstring(matches) + L" matching lines in " +
+			                        std::to_wstring(files) + L" files (Ctrl+Shift+F to stop)";
+		m_pStatusBar->SetText(status.c_str(), 0);
+
+		return 0;
+	}
+
+	if (matches > FILE_SEARCH_MAX_RESULTS)
+	{
+		pOutput->WriteLine(L"Only the first %u matching lines are shown.", static_cast<unsigned int>(FILE_SEARCH_MAX_RESULTS));
+	}
+
+	pOutput->WriteLine(L"Matching lines: %u    Matching files: %u    Total files searched: %u%ls    (%u ms)",
+		               static_cast<unsigned int>(matches),
+		               static_cast<unsigned int>(files),
+		               static_cast<unsigned int>(m_pFileSearch->GetFileCount()),
+		               m_pFileSearch->IsIndexed() ? L" (narrowed down by the index)" : L"",
+		               static_cast<unsigned int>(m_pFileSearch->GetElapsedTime()));
+
+	const std::wstring status = matches == 0 ? std::wstring(L"No matches found.")
+		                      : L"Found " + std::to_wstring(matches) + L" matching lines in " + std::to_wstring(files) + L" files.";
+	m_pStatusBar->SetText(status.c_str(), 0);
+
+	return 0;
 }
 
 HWND Explorer::GetTreeHandle(void) const
@@ -1030,6 +1288,7 @@ HWND Explorer::GetTreeHandle(void) const
 
 void Explorer::OpenProjectFolder(std::wstring folder)
 {
+	CancelFindInFiles();
 	TreeView_DeleteAllItems(m_hTreeWindow);
 
 	const size_t last_backslash_index = folder.find_last_of(L'\\');
@@ -1038,11 +1297,16 @@ void Explorer::OpenProjectFolder(std::wstring folder)
 
 	HTREEITEM hRoot = Utility::SetItemAsTreeRoot(m_hTreeWindow, const_cast<wchar_t*>(folder.c_str() + last_backslash_index + 1));
 
+	m_pFileFinder->Open(folder);
+
 	ExploreDirectory(folder.c_str(), hRoot);
 
 	TreeView_Expand(m_hTreeWindow, hRoot, TVE_EXPAND | TVE_EXPANDPARTIAL);
 
 	SetCurrentDirectory(folder.c_str());
+
+	// Loaded and brought up to date in the background, Find in Files reads every file until then
+	m_pTrigramIndex->Open(folder);
 }
 
 enum class SIFD_CODE {
@@ -1253,6 +1517,7 @@ void Explorer::CreateNewFile(void)
 
 			if (status == IDOK) {
 				Utility::AddToTree(m_hTreeWindow, hItem, data.lpszNewItemName, false);
+				m_pFileFinder->AddFile(path + L'\\' + data.lpszNewItemName);
 				UpdateWindow(m_hTreeWindow);
 				free(data.lpszNewItemName);
 				m_pStatusBar->SetText(L"File created.", 0);
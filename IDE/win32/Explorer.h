@@ -4,6 +4,10 @@
 #include "WorkArea.h"
 #include "StatusBar.h"
 #include "FileClipboard.h"
+#include "SaveScheduler.h"
+#include "FileSearch.h"
+#include "TrigramIndex.h"
+#include "FileFinder.h"
 
 #include <string>
 #include <CommCtrl.h>
@@ -23,6 +27,15 @@ public:
 	void CreateNewFolder(void);
 	HWND GetTreeHandle(void) const;
 
+	/// <summary>
+	/// Searches every file of the project folder in the background, and
+	/// the unsaved text of the open tabs instead of their files. The lines
+	/// that match are written to the output as they are found.
+	/// </summary>
+	void FindInFiles(const FileSearchQuery& query, WorkArea* pWorkArea);
+	void CancelFindInFiles(void);
+	bool IsFindInFilesRunning(void) const;
+
 	/// <summary>
 	/// Sets the children of hParent as the 
 	/// files and folders of the specified directory
@@ -40,6 +53,9 @@ public:
 		_Out_ std::wstring& path
 	);
 
+	/* Every file of the open folder, for Go to File */
+	FileFinder* GetFileFinder(void) const { return m_pFileFinder; }
+
 	HTREEITEM GetRightClickedItem(void) const { return m_hRightClickedItem; }
 	HTREEITEM& GetItemToCut(void) { return m_hItemToCut; }
 
@@ -93,10 +109,22 @@ private:
 		LPCWSTR lpFilePath
 	);
 
-	void SaveFileFromTab(
+	bool SaveFileFromTab(
 		SourceTab* pSourceTab
 	);
 
+	void OnFileSaved(
+		SaveJob* pJob
+	);
+
+	LRESULT OnFileSavedInBackground(
+		LPARAM lParam
+	);
+
+	LRESULT OnFileSearchResults(
+		LPARAM lParam
+	);
+
 	HTREEITEM GetClickedTreeItemPath(
 		_In_  HWND hTreeWindow,
 		_In_  POINT ptClick,
@@ -114,6 +142,18 @@ private:
 	StatusBar* m_pStatusBar = nullptr;
 	FileClipboard m_Clipboard;
 
+	// Writes the files of Save All in the background
+	SaveScheduler* m_pSaveScheduler = nullptr;
+
+	// Runs Find in Files
+	FileSearch* m_pFileSearch = nullptr;
+
+	// Tells Find in Files which files of the open folder could match
+	TrigramIndex* m_pTrigramIndex = nullptr;
+
+	// Filled in as the tree is, and kept up to date with it
+	FileFinder* m_pFileFinder = nullptr;
+
 	// The directory in which the root folder is in
 	std::wstring m_RootDirectory;
 };
@@ -124,10 +124,15 @@ void FileClipboard::PasteFilesToTreeAndStorage(Explorer* pExplorer, HDROP hDrop)
                     true
                 );
 
-                pExplorer->ExploreDirectory(lpszFileName, hNewParent);
+                // The copy, so that its files are listed where they were pasted
+                std::wstring directory_paste = paste_directory.substr(0, paste_directory.length() - 1);
+                directory_paste = directory_paste + L'\\' + name;
+
+                pExplorer->ExploreDirectory(directory_paste.c_str(), hNewParent);
 
                 if (m_ShouldDeleteOriginalAfterPaste) {
                     Utility::DeleteDirectory(lpszFileName);
+                    pExplorer->GetFileFinder()->RemovePath(lpszFileName);
                 }
             }
         }
@@ -139,8 +144,11 @@ void FileClipboard::PasteFilesToTreeAndStorage(Explorer* pExplorer, HDROP hDrop)
 
             if (CopyFile(lpszFileName, file_paste.c_str(), false)) {
                 Utility::AddToTree(hTree, hItem, const_cast<wchar_t*>(name.c_str()), false);
-                if (m_ShouldDeleteOriginalAfterPaste)
+                pExplorer->GetFileFinder()->AddFile(file_paste);
+                if (m_ShouldDeleteOriginalAfterPaste) {
                     DeleteFile(lpszFileName);
+                    pExplorer->GetFileFinder()->RemovePath(lpszFileName);
+                }
             }
         }
     }
@@ -0,0 +1,581 @@
+#include "FileFinder.h"
+#include "TextSearch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SEARCH_USE_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+static inline wchar_t FoldPathChar(wchar_t ch)
+{
+	if (ch < 128)
+	{
+		return ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch + (L'a' - L'A')) : ch;
+	}
+
+	return TextSearch::FoldChar(ch);
+}
+
+static inline uint64_t GetCharBit(wchar_t folded)
+{
+	return 1ull << (folded < 128 ? (folded & 63) : FILE_FINDER_NON_ASCII_BIT);
+}
+
+static inline bool IsSeparator(wchar_t ch)
+{
+	return ch == L'\\' || ch == L'/';
+}
+
+static inline bool IsLowerCase(wchar_t ch)
+{
+	return ch >= L'a' && ch <= L'z';
+}
+
+static inline bool IsUpperCase(wchar_t ch)
+{
+	return ch >= L'A' && ch <= L'Z';
+}
+
+static inline bool IsDigit(wchar_t ch)
+{
+	return ch >= L'0' && ch <= L'9';
+}
+
+/* How much better a match is for being at the start of something */
+static int GetBoundaryBonus(const wchar_t* pText, size_t position)
+{
+	if (position == 0 || IsSeparator(pText[position - 1]))
+	{
+		return FILE_FINDER_BONUS_SEPARATOR;
+	}
+
+	const wchar_t previous = pText[position - 1];
+	const wchar_t ch = pText[position];
+
+	if (previous == L'_' || previous == L'-' || previous == L'.' || previous == L' ')
+	{
+		return FILE_FINDER_BONUS_DELIMITER;
+	}
+
+	if ((IsLowerCase(previous) && IsUpperCase(ch)) || (!IsDigit(previous) && IsDigit(ch)))
+	{
+		return FILE_FINDER_BONUS_CAMEL_CASE;
+	}
+
+	return 0;
+}
+
+#ifdef SEARCH_USE_SIMD
+static inline unsigned long GetLowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+/// <summary>
+/// Finds the next character that folds to 'folded'. A path with only
+/// ASCII characters is compared a block at a time against the character
+/// and its upper case, which are the only two that fold to it there.
+/// </summary>
+/// <returns> Its position, or the length if there is none </returns>
+static size_t FindFoldedChar(const wchar_t* pText, size_t start, size_t length, wchar_t folded, bool isAscii)
+{
+#ifdef SEARCH_USE_SIMD
+	if (isAscii)
+	{
+		const size_t width = sizeof(__m128i) / sizeof(wchar_t);
+		const __m128i lowerChars = _mm_set1_epi16(static_cast<short>(folded));
+		const __m128i upperChars = _mm_set1_epi16(static_cast<short>(IsLowerCase(folded) ? folded - (L'a' - L'A') : folded));
+
+		for (; length - start >= width; start += width)
+		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pText + start));
+			const uint32_t mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(block, lowerChars), _mm_cmpeq_epi16(block, upperChars)));
+
+			if (mask != 0)
+			{
+				return start + GetLowestBit(mask) / sizeof(wchar_t);
+			}
+		}
+	}
+#endif
+
+	while (start < length && FoldPathChar(pText[start]) != folded)
+	{
+		++start;
+	}
+
+	return start;
+}
+
+/* Goes back from 'end' and puts each character of the query at the last place it is found */
+static void MatchBackward(const wchar_t* pText, size_t end, const std::wstring& query, uint32_t* pPositions)
+{
+	for (size_t i = query.length(); i-- > 0;)
+	{
+		do
+		{
+			--end;
+		} while (FoldPathChar(pText[end]) != query[i]);
+
+		pPositions[i] = static_cast<uint32_t>(end);
+	}
+}
+
+static int ScorePositions(const wchar_t* pText, uint32_t nameOffset, const uint32_t* pPositions, size_t count)
+{
+	int score = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint32_t position = pPositions[i];
+
+		score += FILE_FINDER_SCORE_MATCH + GetBoundaryBonus(pText, position);
+
+		if (position >= nameOffset)
+		{
+			score += FILE_FINDER_BONUS_FILE_NAME;
+		}
+
+		if (i > 0)
+		{
+			const uint32_t gap = position - pPositions[i - 1] - 1;
+
+			if (gap == 0)
+			{
+				score += FILE_FINDER_BONUS_CONSECUTIVE;
+			}
+
+			else
+			{
+				score -= FILE_FINDER_PENALTY_GAP_START + static_cast<int>(gap - 1) * FILE_FINDER_PENALTY_GAP_EXTENSION;
+			}
+		}
+	}
+
+	return score;
+}
+
+/* End of the first place the characters of the query are found in order from 'start', or 0 if they aren't */
+static size_t FindForward(const wchar_t* pText, size_t start, size_t length, const std::wstring& query, bool isAscii)
+{
+	for (wchar_t ch : query)
+	{
+		start = FindFoldedChar(pText, start, length, ch, isAscii);
+
+		if (start == length)
+		{
+			return 0;
+		}
+
+		++start;
+	}
+
+	return start;
+}
+
+/// <summary>
+/// Finds where the query first ends going forward, then goes back from
+/// there for the shortest run of the path that has it. When that run
+/// starts in the folders, the file name alone is tried the same way, and
+/// the better of the two is the score.
+/// </summary>
+bool FileFinder::ScorePath(const PathEntry& entry, const std::wstring& query, std::vector<uint32_t>& positions, int& score) const
+{
+	const wchar_t* pText = m_Paths.data() + entry.offset;
+	const size_t length = entry.length;
+	const bool isAscii = (entry.mask & (1ull << FILE_FINDER_NON_ASCII_BIT)) == 0;
+
+	const size_t end = FindForward(pText, 0, length, query, isAscii);
+
+	if (end == 0)
+	{
+		return false;
+	}
+
+	const size_t count = query.length();
+
+	MatchBackward(pText, end, query, positions.data());
+	score = ScorePositions(pText, entry.nameOffset, positions.data(), count);
+
+	if (positions[0] < entry.nameOffset)
+	{
+		const size_t nameEnd = FindForward(pText, entry.nameOffset, length, query, isAscii);
+
+		if (nameEnd != 0)
+		{
+			MatchBackward(pText, nameEnd, query, positions.data() + count);
+			score = std::max(score, ScorePositions(pText, entry.nameOffset, positions.data() + count, count));
+		}
+	}
+
+	return true;
+}
+
+bool FileFinder::IsBetter(const FileMatch& a, const FileMatch& b) const
+{
+	if (a.score != b.score)
+	{
+		return a.score > b.score;
+	}
+
+	const uint32_t lengthA = m_Entries[a.file].length;
+	const uint32_t lengthB = m_Entries[b.file].length;
+
+	return lengthA != lengthB ? lengthA < lengthB : a.file < b.file;
+}
+
+void FileFinder::ScoreRange(const std::wstring& query, uint64_t queryMask, size_t first, size_t last, size_t maxResults, std::vector<FileMatch>& best) const
+{
+	const auto isBetter = [this](const FileMatch& a, const FileMatch& b) { return IsBetter(a, b); };
+
+	std::vector<uint32_t> positions(query.length() * 2);
+
+	// Every character at the start of the file name and right after the one before
+	const int bestScore = static_cast<int>(query.length()) * (FILE_FINDER_SCORE_MATCH + FILE_FINDER_BONUS_SEPARATOR + FILE_FINDER_BONUS_FILE_NAME) +
+		                  static_cast<int>(query.length() - 1) * FILE_FINDER_BONUS_CONSECUTIVE;
+
+	for (size_t i = first; i < last; ++i)
+	{
+		const PathEntry& entry = m_Entries[i];
+
+		if (entry.isRemoved || (entry.mask & queryMask) != queryMask)
+		{
+			continue;
+		}
+
+		// Once there are enough matches, a path that couldn't beat the worst of them isn't scored
+		if (best.size() == maxResults && (bestScore < best.front().score ||
+			                              (bestScore == best.front().score && entry.length >= m_Entries[best.front().file].length)))
+		{
+			continue;
+		}
+
+		FileMatch match;
+		match.file = static_cast<uint32_t>(i);
+
+		if (!ScorePath(entry, query, positions, match.score))
+		{
+			continue;
+		}
+
+		if (best.size() < maxResults)
+		{
+			best.push_back(match);
+			std::push_heap(best.begin(), best.end(), isBetter);
+		}
+
+		else if (isBetter(match, best.front()))
+		{
+			std::pop_heap(best.begin(), best.end(), isBetter);
+			best.back() = match;
+			std::push_heap(best.begin(), best.end(), isBetter);
+		}
+	}
+}
+
+/// <summary>
+/// Spaces in the query are ignored, so that words can be typed apart.
+/// Each worker takes the next block of paths until there are none left.
+/// </summary>
+void FileFinder::Find(const std::wstring& query, size_t maxResults, std::vector<FileMatch>& matches) const
+{
+	matches.clear();
+
+	std::wstring folded;
+	uint64_t queryMask = 0;
+
+	for (wchar_t ch : query)
+	{
+		if (ch != L' ')
+		{
+			folded.push_back(FoldPathChar(ch));
+			queryMask |= GetCharBit(folded.back());
+		}
+	}
+
+	if (maxResults == 0)
+	{
+		return;
+	}
+
+	if (folded.empty())
+	{
+		for (size_t i = 0; i < m_Entries.size() && matches.size() < maxResults; ++i)
+		{
+			if (!m_Entries[i].isRemoved)
+			{
+				FileMatch match;
+				match.file = static_cast<uint32_t>(i);
+				matches.push_back(match);
+			}
+		}
+
+		return;
+	}
+
+	const size_t blockCount = (m_Entries.size() + FILE_FINDER_BLOCK_SIZE - 1) / FILE_FINDER_BLOCK_SIZE;
+	const size_t workerCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), blockCount);
+
+	if (workerCount < 2)
+	{
+		ScoreRange(folded, queryMask, 0, m_Entries.size(), maxResults, matches);
+	}
+
+	else
+	{
+		std::atomic<size_t> nextBlock(0);
+		std::vector<std::vector<FileMatch>> results(workerCount);
+
+		const auto work = [&](size_t worker) {
+			for (size_t block = nextBlock++; block < blockCount; block = nextBlock++)
+			{
+				const size_t first = block * FILE_FINDER_BLOCK_SIZE;
+				ScoreRange(folded, queryMask, first, std::min(first + FILE_FINDER_BLOCK_SIZE, m_Entries.size()), maxResults, results[worker]);
+			}
+		};
+
+		std::vector<std::thread> workers;
+
+		for (size_t i = 1; i < workerCount; ++i)
+		{
+			workers.emplace_back(work, i);
+		}
+
+		work(0);
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+
+		for (const std::vector<FileMatch>& result : results)
+		{
+			matches.insert(matches.end(), result.begin(), result.end());
+		}
+	}
+
+	std::sort(matches.begin(), matches.end(), [this](const FileMatch& a, const FileMatch& b) { return IsBetter(a, b); });
+
+	if (matches.size() > maxResults)
+	{
+		matches.resize(maxResults);
+	}
+}
+
+void FileFinder::Add(const wchar_t* pRelativePath, size_t length)
+{
+	// Offsets are 32 bits, a table that big is far past any project
+	if (length == 0 || m_Paths.length() + length > UINT32_MAX)
+	{
+		return;
+	}
+
+	PathEntry entry;
+	entry.offset = static_cast<uint32_t>(m_Paths.length());
+	entry.length = static_cast<uint32_t>(length);
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		const wchar_t ch = pRelativePath[i];
+
+		if (IsSeparator(ch))
+		{
+			entry.nameOffset = static_cast<uint32_t>(i + 1);
+		}
+
+		entry.mask |= GetCharBit(FoldPathChar(ch));
+
+		// A character past ASCII can fold to one in it, so the path isn't compared a block at a time
+		if (ch >= 128)
+		{
+			entry.mask |= 1ull << FILE_FINDER_NON_ASCII_BIT;
+		}
+	}
+
+	m_Paths.append(pRelativePath, length);
+	m_Entries.push_back(entry);
+}
+
+void FileFinder::Compact(void)
+{
+	std::wstring paths;
+	std::vector<PathEntry> entries;
+	paths.reserve(m_Paths.length());
+	entries.reserve(m_Entries.size() - m_RemovedCount);
+
+	for (PathEntry entry : m_Entries)
+	{
+		if (!entry.isRemoved)
+		{
+			const uint32_t offset = static_cast<uint32_t>(paths.length());
+			paths.append(m_Paths, entry.offset, entry.length);
+			entry.offset = offset;
+			entries.push_back(entry);
+		}
+	}
+
+	m_Paths.swap(paths);
+	m_Entries.swap(entries);
+	m_RemovedCount = 0;
+}
+
+bool FileFinder::GetRelativePath(const std::wstring& path, std::wstring& relative) const
+{
+	if (m_Root.empty())
+	{
+		return false;
+	}
+
+	// The folder itself, without the backslash
+	if (path.length() + 1 == m_Root.length() && m_Root.compare(0, path.length(), path) == 0)
+	{
+		relative.clear();
+		return true;
+	}
+
+	if (path.length() > m_Root.length() && path.compare(0, m_Root.length(), m_Root) == 0)
+	{
+		relative.assign(path, m_Root.length(), std::wstring::npos);
+		return true;
+	}
+
+	return false;
+}
+
+template <typename Function>
+void FileFinder::ForEachUnder(const std::wstring& relative, Function function)
+{
+	for (size_t i = 0; i < m_Entries.size(); ++i)
+	{
+		const PathEntry& entry = m_Entries[i];
+
+		if (entry.isRemoved)
+		{
+			continue;
+		}
+
+		const wchar_t* pPath = m_Paths.data() + entry.offset;
+
+		if (relative.empty() ||
+			(entry.length == relative.length() && relative.compare(0, relative.length(), pPath, entry.length) == 0) ||
+			(entry.length > relative.length() && pPath[relative.length()] == L'\\' && relative.compare(0, relative.length(), pPath, relative.length()) == 0))
+		{
+			function(i);
+		}
+	}
+}
+
+void FileFinder::Open(const std::wstring& folder)
+{
+	Close();
+
+	m_Root = folder;
+
+	if (m_Root.empty() || m_Root.back() != L'\\')
+	{
+		m_Root.push_back(L'\\');
+	}
+}
+
+void FileFinder::Close(void)
+{
+	m_Root.clear();
+
+	std::wstring().swap(m_Paths);
+	std::vector<PathEntry>().swap(m_Entries);
+	m_RemovedCount = 0;
+}
+
+void FileFinder::AddFile(const std::wstring& path)
+{
+	std::wstring relative;
+
+	if (GetRelativePath(path, relative))
+	{
+		Add(relative.c_str(), relative.length());
+	}
+}
+
+void FileFinder::RemovePath(const std::wstring& path)
+{
+	std::wstring relative;
+
+	if (!GetRelativePath(path, relative))
+	{
+		return;
+	}
+
+	ForEachUnder(relative, [this](size_t i) {
+		m_Entries[i].isRemoved = true;
+		++m_RemovedCount;
+	});
+
+	if (m_RemovedCount >= GetFileCount())
+	{
+		Compact();
+	}
+}
+
+void FileFinder::RenamePath(const std::wstring& path, const std::wstring& newPath)
+{
+	std::wstring relative;
+	std::wstring newRelative;
+
+	if (!GetRelativePath(path, relative) || relative.empty())
+	{
+		return;
+	}
+
+	if (!GetRelativePath(newPath, newRelative) || newRelative.empty())
+	{
+		RemovePath(path);
+		return;
+	}
+
+	std::vector<size_t> moved;
+
+	ForEachUnder(relative, [&moved](size_t i) {
+		moved.push_back(i);
+	});
+
+	for (size_t i : moved)
+	{
+		std::wstring renamed = newRelative;
+		renamed.append(m_Paths, m_Entries[i].offset + relative.length(), m_Entries[i].length - relative.length());
+
+		m_Entries[i].isRemoved = true;
+		++m_RemovedCount;
+
+		Add(renamed.c_str(), renamed.length());
+	}
+
+	if (m_RemovedCount >= GetFileCount())
+	{
+		Compact();
+	}
+}
+
+std::wstring FileFinder::GetRelativePath(uint32_t file) const
+{
+	return m_Paths.substr(m_Entries[file].offset, m_Entries[file].length);
+}
+
+std::wstring FileFinder::GetAbsolutePath(uint32_t file) const
+{
+	return m_Root + GetRelativePath(file);
+}
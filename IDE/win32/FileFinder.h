@@ -0,0 +1,130 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Go to File lists at most this many files
+#define FILE_FINDER_MAX_RESULTS 100
+
+// Paths scored by a worker at a time, fewer than two blocks are scored on the calling thread
+#define FILE_FINDER_BLOCK_SIZE 8192
+
+// Every character of the text that matches a character of the query
+#define FILE_FINDER_SCORE_MATCH 16
+
+// A run of characters skipped between two matches, its first one costs more
+#define FILE_FINDER_PENALTY_GAP_START 3
+#define FILE_FINDER_PENALTY_GAP_EXTENSION 1
+
+// A match at the start of a folder or file name, of a word, and of a part of a camelCase word
+#define FILE_FINDER_BONUS_SEPARATOR 10
+#define FILE_FINDER_BONUS_DELIMITER 8
+#define FILE_FINDER_BONUS_CAMEL_CASE 7
+
+// A match right after another, and a match in the name of the file rather than in its folders
+#define FILE_FINDER_BONUS_CONSECUTIVE 5
+#define FILE_FINDER_BONUS_FILE_NAME 2
+
+// Set in the character mask of a path that has characters past ASCII
+#define FILE_FINDER_NON_ASCII_BIT 63
+
+/* A file of the project that has every character of the query in order */
+struct FileMatch {
+	uint32_t file = 0;
+	int score = 0;
+};
+
+/// <summary>
+/// Every file of the open project folder, for Go to File to pick from as
+/// the user types. The paths are relative to the folder and kept back to
+/// back in one string, with a table of where each one starts, so looking
+/// through all of them reads memory in order and a project of hundreds of
+/// thousands of files is only a few allocations. Each path also keeps a
+/// mask of the characters it has, a path that lacks a character of the
+/// query is passed over without reading it.
+/// A file matches when the characters of the query appear in its path in
+/// the same order, ignoring case. Those that do are scored by where the
+/// characters were found: at the start of names and words, one after the
+/// other, and in the file name are better, gaps are worse. Ties go to the
+/// shorter path. The paths are scored in blocks by as many threads as
+/// there are cores, each keeping its own best matches.
+/// Paths that are removed are only marked, and dropped when there are as
+/// many of them as there are files left.
+/// </summary>
+class FileFinder
+{
+private:
+	struct PathEntry {
+		// Bit (ch & 63) of every folded character, and FILE_FINDER_NON_ASCII_BIT
+		uint64_t mask = 0;
+
+		uint32_t offset = 0;
+		uint32_t length = 0;
+
+		// Where the file name starts, from the start of the path
+		uint32_t nameOffset = 0;
+
+		bool isRemoved = false;
+	};
+
+	// The open folder followed by a backslash
+	std::wstring m_Root;
+
+	std::wstring m_Paths;
+	std::vector<PathEntry> m_Entries;
+	size_t m_RemovedCount = 0;
+
+	void Add(const wchar_t* pRelativePath, size_t length);
+	void Compact(void);
+
+	/* Relative path of the file if it's in the folder, or of the folder itself when it's the folder */
+	bool GetRelativePath(const std::wstring& path, std::wstring& relative) const;
+
+	/* Calls the function with the index of every file that is the path or in the folder the path is */
+	template <typename Function>
+	void ForEachUnder(const std::wstring& relative, Function function);
+
+	/* Higher score, then shorter path, then added first */
+	bool IsBetter(const FileMatch& a, const FileMatch& b) const;
+
+	/// <summary>
+	/// Scores the paths [first, last) against the folded query
+	/// </summary>
+	/// <param name="best"> Heap of the best matches so far, the worst one on top </param>
+	void ScoreRange(const std::wstring& query, uint64_t queryMask, size_t first, size_t last, size_t maxResults, std::vector<FileMatch>& best) const;
+
+	/// <returns> The score of the path, or false if it doesn't have every character of the query in order </returns>
+	bool ScorePath(const PathEntry& entry, const std::wstring& query, std::vector<uint32_t>& positions, int& score) const;
+
+public:
+	/// <summary>
+	/// Forgets the files of the folder that was open, the files added
+	/// after this have to be in the new folder
+	/// </summary>
+	void Open(const std::wstring& folder);
+	void Close(void);
+
+	/* Files outside the folder are ignored */
+	void AddFile(const std::wstring& path);
+
+	/* Removes the file, or every file in the folder */
+	void RemovePath(const std::wstring& path);
+
+	/* Moves the file, or every file in the folder, to the new path */
+	void RenamePath(const std::wstring& path, const std::wstring& newPath);
+
+	size_t GetFileCount(void) const { return m_Entries.size() - m_RemovedCount; }
+	size_t GetTableSize(void) const { return m_Paths.length() * sizeof(wchar_t) + m_Entries.size() * sizeof(PathEntry); }
+
+	std::wstring GetRelativePath(uint32_t file) const;
+	std::wstring GetAbsolutePath(uint32_t file) const;
+
+	/// <summary>
+	/// Finds the files that best match the query, the first files of the
+	/// folder when it is empty
+	/// </summary>
+	/// <param name="matches"> Receives the matches, the best first </param>
+	void Find(const std::wstring& query, size_t maxResults, std::vector<FileMatch>& matches) const;
+};
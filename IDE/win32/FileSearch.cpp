@@ -0,0 +1,549 @@
+#include "FileSearch.h"
+#include "SourceTab.h"
+#include "TrigramIndex.h"
+#include "Utf8Decoder.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <iterator>
+
+// Bytes at the start of a file that are checked for a null character, the way binary files are told apart
+#define BINARY_CHECK_LENGTH 8000
+
+static inline bool IsLineBreak(wchar_t ch)
+{
+	return ch == L'\r' || ch == L'\n';
+}
+
+static std::wstring FoldPath(std::wstring path)
+{
+	if (!path.empty())
+	{
+		CharLowerBuff(&path[0], static_cast<DWORD>(path.length()));
+	}
+
+	return path;
+}
+
+std::unique_ptr<FileSearchDocument> FileSearchDocument::FromTab(SourceTab* pSourceTab)
+{
+	// A tab without a file has no path to report
+	if (pSourceTab == nullptr || pSourceTab->GetPath() == nullptr || !pSourceTab->HasUnsavedChanges())
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<FileSearchDocument> pDocument(new FileSearchDocument);
+	pDocument->path = pSourceTab->GetPath();
+
+	if (pSourceTab->IsHibernated())
+	{
+		pDocument->pSnapshot.reset(new TabSnapshot(*pSourceTab->GetSnapshot()));
+	}
+
+	// Copying a document doesn't copy the text it was loaded with, only what was typed since
+	else
+	{
+		pDocument->pDocument.reset(new PieceTable(pSourceTab->GetSourceEdit()->GetDocument()));
+	}
+
+	return pDocument;
+}
+
+std::wstring FileSearchDocument::GetText(void) const
+{
+	if (pDocument != nullptr)
+	{
+		std::wstring text(pDocument->GetLength(), L'\0');
+
+		if (!text.empty())
+		{
+			text.resize(pDocument->CopyTextRange(0, text.length(), &text[0]));
+		}
+
+		return text;
+	}
+
+	std::wstring text;
+
+	// Searched as an empty file if it can't be decompressed, the tab shows the error when it's opened
+	if (pSnapshot != nullptr)
+	{
+		pSnapshot->GetText(text);
+	}
+
+	return text;
+}
+
+bool FileSearch::IsSearched(const WIN32_FIND_DATA& find_data)
+{
+	if (find_data.cFileName[0] == L'.')
+	{
+		return false;
+	}
+
+	// Links to folders could lead back up the tree
+	return !(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !(find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT);
+}
+
+bool FileSearch::ReadSourceFile(const std::wstring& path, std::vector<char>& buffer)
+{
+	HANDLE hFile = CreateFile(path.c_str(),
+		                      GENERIC_READ,
+		                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		                      nullptr,
+		                      OPEN_EXISTING,
+		                      FILE_FLAG_SEQUENTIAL_SCAN,
+		                      nullptr);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER liSize;
+	bool hasSucceeded = GetFileSizeEx(hFile, &liSize) && liSize.QuadPart <= FILE_SEARCH_MAX_FILE_SIZE;
+
+	if (hasSucceeded)
+	{
+		buffer.resize(static_cast<size_t>(liSize.QuadPart));
+
+		size_t position = 0;
+		DWORD dwRead = 0;
+
+		while (position < buffer.size() &&
+			   ReadFile(hFile, buffer.data() + position, static_cast<DWORD>(buffer.size() - position), &dwRead, nullptr) &&
+			   dwRead > 0)
+		{
+			position += dwRead;
+		}
+
+		// The file could have been cut short while it was read
+		buffer.resize(position);
+
+		const size_t checked = std::min<size_t>(buffer.size(), BINARY_CHECK_LENGTH);
+		hasSucceeded = std::find(buffer.begin(), buffer.begin() + checked, '\0') == buffer.begin() + checked;
+	}
+
+	CloseHandle(hFile);
+
+	return hasSucceeded;
+}
+
+FileSearch::FileSearch(HWND hWndNotify)
+	: m_hWndNotify(hWndNotify),
+	  m_RunningWorkerCount(0),
+	  m_IsCancelled(false),
+	  m_FileCount(0),
+	  m_MatchingFileCount(0),
+	  m_MatchCount(0)
+{
+}
+
+FileSearch::~FileSearch(void)
+{
+	Cancel();
+}
+
+bool FileSearch::Start(const std::wstring& folder,
+	                   const FileSearchQuery& query,
+	                   std::vector<std::unique_ptr<FileSearchDocument>> documents,
+	                   const TrigramIndex* pIndex,
+	                   std::wstring& error)
+{
+	Cancel();
+
+	if (query.isRegex)
+	{
+		if (!m_Regex.Compile(query.pattern, query.options))
+		{
+			error = m_Regex.GetError();
+			return false;
+		}
+
+		m_pSearcher.reset();
+	}
+
+	else
+	{
+		m_pSearcher.reset(new TextSearcher(query.pattern, query.options));
+	}
+
+	m_IsRegex = query.isRegex;
+	m_Documents = std::move(documents);
+	m_DocumentPaths.clear();
+
+	for (const std::unique_ptr<FileSearchDocument>& pDocument : m_Documents)
+	{
+		m_DocumentPaths.insert(FoldPath(pDocument->path));
+	}
+
+	// The index needs text that every match has, a regular expression may only have its prefix
+	const std::wstring& required = query.isRegex ? m_Regex.GetPrefix() : query.pattern;
+	m_IsIndexed = pIndex != nullptr && pIndex->FindCandidates(required, m_Files);
+
+	if (m_IsIndexed)
+	{
+		m_Directories.clear();
+	}
+
+	else
+	{
+		m_Directories.assign(1, folder);
+		m_Files.clear();
+	}
+
+	m_NextDocument = 0;
+	m_BusyCount = 0;
+
+	m_IsCancelled = false;
+	m_FileCount = 0;
+	m_MatchingFileCount = 0;
+	m_MatchCount = 0;
+
+	++m_SearchId;
+	m_IsRunning = true;
+	m_StartTime = GetTickCount64();
+
+	// Reading small files waits on the disk more than searching them keeps a processor busy
+	const size_t workerCount = std::max(std::thread::hardware_concurrency(), 1U);
+	m_RunningWorkerCount = workerCount;
+
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		m_Workers.emplace_back(&FileSearch::RunWorker, this);
+	}
+
+	return true;
+}
+
+void FileSearch::Cancel(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsCancelled = true;
+	}
+
+	m_WorkAvailable.notify_all();
+	JoinWorkers();
+
+	m_IsRunning = false;
+}
+
+void FileSearch::JoinWorkers(void)
+{
+	for (std::thread& worker : m_Workers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+
+	m_Workers.clear();
+}
+
+bool FileSearch::OnBatch(const FileSearchBatch* pBatch)
+{
+	if (!m_IsRunning || pBatch->searchId != m_SearchId)
+	{
+		return false;
+	}
+
+	if (pBatch->isLast)
+	{
+		// Every worker has posted what it found, so they're only returning at this point
+		JoinWorkers();
+		m_IsRunning = false;
+	}
+
+	return true;
+}
+
+bool FileSearch::TakeWork(WorkItem& item)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	while (!m_IsCancelled)
+	{
+		if (m_NextDocument < m_Documents.size())
+		{
+			item.pDocument = m_Documents[m_NextDocument++].get();
+			item.isDirectory = false;
+		}
+
+		// Listing directories first finds the files early, so every worker has some to search
+		else if (!m_Directories.empty())
+		{
+			item.path = std::move(m_Directories.back());
+			item.pDocument = nullptr;
+			item.isDirectory = true;
+			m_Directories.pop_back();
+		}
+
+		else if (!m_Files.empty())
+		{
+			item.path = std::move(m_Files.back());
+			item.pDocument = nullptr;
+			item.isDirectory = false;
+			m_Files.pop_back();
+		}
+
+		// Nobody can add anything anymore, the workers that wait are let go too
+		else if (m_BusyCount == 0)
+		{
+			m_WorkAvailable.notify_all();
+			return false;
+		}
+
+		else
+		{
+			m_WorkAvailable.wait(lock);
+			continue;
+		}
+
+		++m_BusyCount;
+		return true;
+	}
+
+	return false;
+}
+
+void FileSearch::FinishWork(std::vector<std::wstring>& directories, std::vector<std::wstring>& files)
+{
+	bool shouldNotify = !directories.empty() || !files.empty();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		std::move(directories.begin(), directories.end(), std::back_inserter(m_Directories));
+		std::move(files.begin(), files.end(), std::back_inserter(m_Files));
+
+		// The last busy worker is done, the others may be waiting for nothing
+		shouldNotify |= --m_BusyCount == 0;
+	}
+
+	if (shouldNotify)
+	{
+		m_WorkAvailable.notify_all();
+	}
+
+	directories.clear();
+	files.clear();
+}
+
+void FileSearch::ListDirectory(const std::wstring& directory,
+	                           std::vector<std::wstring>& directories,
+	                           std::vector<std::wstring>& files) const
+{
+	const std::wstring wildcard = directory + L"\\*";
+
+	// Without the short names and with bigger reads, listing is a lot faster
+	WIN32_FIND_DATA find_data;
+	HANDLE hFind = FindFirstFileEx(wildcard.c_str(),
+		                           FindExInfoBasic,
+		                           &find_data,
+		                           FindExSearchNameMatch,
+		                           nullptr,
+		                           FIND_FIRST_EX_LARGE_FETCH);
+
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	do {
+		if (!IsSearched(find_data))
+		{
+			continue;
+		}
+
+		std::wstring path = directory;
+		path += L'\\';
+		path += find_data.cFileName;
+
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			directories.push_back(std::move(path));
+		}
+
+		else
+		{
+			files.push_back(std::move(path));
+		}
+	} while (FindNextFile(hFind, &find_data));
+
+	FindClose(hFind);
+}
+
+/// <summary>
+/// Adds every line that has a match to the results, once. Lines end at
+/// "\r\n", "\n" or "\r", the last being what the edit control uses.
+/// </summary>
+void FileSearch::SearchText(const std::wstring& path, const wchar_t* pText, size_t length, std::vector<FileSearchResult>& results)
+{
+	size_t from = 0;
+	size_t line = 1;
+	size_t lineStart = 0;
+
+	// Line breaks before this have been counted
+	size_t counted = 0;
+	bool hasMatched = false;
+	RegexMatch match;
+
+	while (!m_IsCancelled)
+	{
+		size_t position = 0;
+		size_t matchEnd = 0;
+
+		if (m_IsRegex)
+		{
+			if (!m_Regex.FindForward(pText, length, from, match))
+			{
+				break;
+			}
+
+			position = match.GetPosition();
+			matchEnd = position + match.GetLength();
+		}
+
+		else
+		{
+			if (!m_pSearcher->FindForward(pText, length, from, position))
+			{
+				break;
+			}
+
+			matchEnd = position + m_pSearcher->GetPatternLength();
+		}
+
+		for (; counted < position; ++counted)
+		{
+			if (pText[counted] == L'\n' || (pText[counted] == L'\r' && (counted + 1 == length || pText[counted + 1] != L'\n')))
+			{
+				++line;
+				lineStart = counted + 1;
+			}
+		}
+
+		size_t lineEnd = position;
+
+		while (lineEnd < length && !IsLineBreak(pText[lineEnd]))
+		{
+			++lineEnd;
+		}
+
+		hasMatched = true;
+
+		if (m_MatchCount++ < FILE_SEARCH_MAX_RESULTS)
+		{
+			// Indentation is left out, the column still counts it
+			size_t textStart = lineStart;
+
+			while (textStart < lineEnd && iswspace(pText[textStart]))
+			{
+				++textStart;
+			}
+
+			FileSearchResult result;
+			result.path = path;
+			result.line = line;
+			result.column = position - lineStart + 1;
+			result.lineText.assign(pText + textStart, std::min<size_t>(lineEnd - textStart, FILE_SEARCH_MAX_LINE_LENGTH));
+
+			results.push_back(std::move(result));
+		}
+
+		// The rest of the line was reported already, a match of a regular expression can go past it
+		from = std::max(lineEnd, matchEnd);
+	}
+
+	if (hasMatched)
+	{
+		++m_MatchingFileCount;
+	}
+}
+
+void FileSearch::PostResults(std::vector<FileSearchResult>& results, bool isLast)
+{
+	FileSearchBatch* pBatch = new FileSearchBatch;
+	pBatch->searchId = m_SearchId;
+	pBatch->results = std::move(results);
+	pBatch->isLast = isLast;
+
+	results.clear();
+
+	// The window is gone, nobody would free it
+	if (!PostMessage(m_hWndNotify, WM_FILE_SEARCH_RESULTS, NULL, reinterpret_cast<LPARAM>(pBatch)))
+	{
+		delete pBatch;
+	}
+}
+
+void FileSearch::RunWorker(void)
+{
+	std::vector<std::wstring> directories;
+	std::vector<std::wstring> files;
+	std::vector<FileSearchResult> results;
+
+	// Reused from file to file, so that memory is only allocated for the biggest one
+	std::vector<char> buffer;
+	std::wstring text;
+	Utf8Decoder decoder;
+
+	ULONGLONG lastPostTime = GetTickCount64();
+	WorkItem item;
+
+	while (TakeWork(item))
+	{
+		if (item.isDirectory)
+		{
+			ListDirectory(item.path, directories, files);
+		}
+
+		else if (item.pDocument != nullptr)
+		{
+			const std::wstring documentText = item.pDocument->GetText();
+
+			SearchText(item.pDocument->path, documentText.c_str(), documentText.length(), results);
+			++m_FileCount;
+		}
+
+		// The files of the documents are left out, whether they were listed or came from the index
+		else if (m_DocumentPaths.find(FoldPath(item.path)) == m_DocumentPaths.end() && ReadSourceFile(item.path, buffer))
+		{
+			text.clear();
+			decoder.Reset();
+			decoder.Decode(buffer.data(), buffer.size(), text);
+			decoder.Finish(text);
+
+			SearchText(item.path, text.c_str(), text.length(), results);
+			++m_FileCount;
+		}
+
+		FinishWork(directories, files);
+
+		if (results.size() >= FILE_SEARCH_BATCH_SIZE ||
+			(!results.empty() && GetTickCount64() - lastPostTime >= FILE_SEARCH_BATCH_INTERVAL))
+		{
+			PostResults(results, false);
+			lastPostTime = GetTickCount64();
+		}
+	}
+
+	if (m_IsCancelled)
+	{
+		return;
+	}
+
+	if (!results.empty())
+	{
+		PostResults(results, false);
+	}
+
+	// Posted after what this worker found, and every other worker has posted all of theirs by now
+	if (--m_RunningWorkerCount == 0)
+	{
+		PostResults(results, true);
+	}
+}
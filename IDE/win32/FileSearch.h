@@ -0,0 +1,192 @@
+#pragma once
+
+#include "Window.h"
+#include "PieceTable.h"
+#include "TabSnapshot.h"
+#include "TextSearch.h"
+#include "Regex.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+class SourceTab;
+class TrigramIndex;
+
+// Posted to the window of a FileSearch, lParam: pointer to a FileSearchBatch that the window frees
+#define WM_FILE_SEARCH_RESULTS (WM_APP + 6)
+
+// Files bigger than this aren't searched, they are most likely not source code
+#define FILE_SEARCH_MAX_FILE_SIZE (64 * 1024 * 1024)
+
+// Matching lines that are reported, the rest are only counted
+#define FILE_SEARCH_MAX_RESULTS 10000
+
+// A worker posts what it found once it has this many lines, or after this many milliseconds
+#define FILE_SEARCH_BATCH_SIZE 256
+#define FILE_SEARCH_BATCH_INTERVAL 50
+
+// Characters of a matching line that are shown
+#define FILE_SEARCH_MAX_LINE_LENGTH 200
+
+/* What to look for, the same things the find dialog asks */
+struct FileSearchQuery {
+	std::wstring pattern;
+	SearchOptions options;
+	bool isRegex = false;
+};
+
+/* A line that has a match, the line and the column start at 1 */
+struct FileSearchResult {
+	std::wstring path;
+	size_t line = 0;
+	size_t column = 0;
+	std::wstring lineText;
+};
+
+/* Lines found by a worker since the last time it posted */
+struct FileSearchBatch {
+	// The results of a search that was cancelled are dropped
+	unsigned int searchId = 0;
+	std::vector<FileSearchResult> results;
+
+	// Posted by the last worker to finish, after all the other batches of the search
+	bool isLast = false;
+};
+
+/// <summary>
+/// The text of an open tab, copied on the UI thread. It's searched
+/// instead of the file, which doesn't have the changes that weren't saved.
+/// </summary>
+struct FileSearchDocument {
+	std::wstring path;
+
+	// The document of a live tab, or the snapshot of a hibernated one
+	std::unique_ptr<PieceTable> pDocument;
+	std::unique_ptr<TabSnapshot> pSnapshot;
+
+	/* nullptr if the tab has no unsaved changes, its file is searched then */
+	static std::unique_ptr<FileSearchDocument> FromTab(SourceTab* pSourceTab);
+
+	std::wstring GetText(void) const;
+};
+
+/// <summary>
+/// Finds a pattern in every file of a folder on a pool of worker threads.
+/// The workers share a queue of directories to list and files to search,
+/// so the tree is walked and searched at the same time, and a directory
+/// with many files is spread over all of them. What they find is posted
+/// back to the window as WM_FILE_SEARCH_RESULTS while they keep going.
+/// Hidden files and folders are skipped like the explorer does, and so
+/// are binary files.
+/// </summary>
+class FileSearch
+{
+private:
+	/* Something a worker has to do */
+	struct WorkItem {
+		std::wstring path;
+		const FileSearchDocument* pDocument = nullptr;
+		bool isDirectory = false;
+	};
+
+	HWND m_hWndNotify = nullptr;
+
+	unsigned int m_SearchId = 0;
+	bool m_IsRunning = false;
+	ULONGLONG m_StartTime = 0;
+
+	// Prepared once, the workers only read them
+	std::unique_ptr<TextSearcher> m_pSearcher;
+	Regex m_Regex;
+	bool m_IsRegex = false;
+
+	// Only the files the index said could match are searched
+	bool m_IsIndexed = false;
+
+	std::vector<std::unique_ptr<FileSearchDocument>> m_Documents;
+
+	// Lower case paths of the documents, their files aren't read
+	std::unordered_set<std::wstring> m_DocumentPaths;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::vector<std::wstring> m_Directories;
+	std::vector<std::wstring> m_Files;
+	size_t m_NextDocument = 0;
+
+	// Workers that are doing something, which could add more to the queue
+	size_t m_BusyCount = 0;
+
+	std::vector<std::thread> m_Workers;
+	std::atomic<size_t> m_RunningWorkerCount;
+	std::atomic<bool> m_IsCancelled;
+
+	std::atomic<size_t> m_FileCount;
+	std::atomic<size_t> m_MatchingFileCount;
+	std::atomic<size_t> m_MatchCount;
+
+	void RunWorker(void);
+	void JoinWorkers(void);
+
+	/* Waits until there's something to do, false once there's nothing left */
+	bool TakeWork(WorkItem& item);
+	void FinishWork(std::vector<std::wstring>& directories, std::vector<std::wstring>& files);
+
+	void ListDirectory(const std::wstring& directory, std::vector<std::wstring>& directories, std::vector<std::wstring>& files) const;
+	void SearchText(const std::wstring& path, const wchar_t* pText, size_t length, std::vector<FileSearchResult>& results);
+	void PostResults(std::vector<FileSearchResult>& results, bool isLast);
+
+public:
+	explicit FileSearch(HWND hWndNotify);
+
+	/* Cancels the search that is running */
+	~FileSearch(void);
+
+	FileSearch(const FileSearch&) = delete;
+	FileSearch& operator=(const FileSearch&) = delete;
+
+	bool IsRunning(void) const { return m_IsRunning; }
+
+	/// <summary>
+	/// Cancels the search that is running and starts searching the folder
+	/// and the documents on up to one thread per processor
+	/// </summary>
+	/// <param name="pIndex"> The index of the folder, can be nullptr. The
+	/// folder isn't walked if it can tell which files could match. </param>
+	/// <returns> False if the pattern isn't valid, the error says why </returns>
+	bool Start(const std::wstring& folder,
+		       const FileSearchQuery& query,
+		       std::vector<std::unique_ptr<FileSearchDocument>> documents,
+		       const TrigramIndex* pIndex,
+		       std::wstring& error);
+
+	/* Stops the workers and waits for them, what they have posted is dropped */
+	void Cancel(void);
+
+	/// <summary>
+	/// Called for every WM_FILE_SEARCH_RESULTS, the window frees the batch
+	/// </summary>
+	/// <returns> Whether the batch belongs to the search that is running </returns>
+	bool OnBatch(const FileSearchBatch* pBatch);
+
+	size_t GetFileCount(void) const { return m_FileCount; }
+	size_t GetMatchingFileCount(void) const { return m_MatchingFileCount; }
+	size_t GetMatchCount(void) const { return m_MatchCount; }
+	ULONGLONG GetElapsedTime(void) const { return GetTickCount64() - m_StartTime; }
+	bool IsIndexed(void) const { return m_IsIndexed; }
+
+	/* Whether a file or folder that was found is searched, hidden ones and links to folders aren't */
+	static bool IsSearched(const WIN32_FIND_DATA& find_data);
+
+	/// <summary>
+	/// Reads a whole file into the buffer, which is reused from file to file
+	/// </summary>
+	/// <returns> False if it can't be read, is too big or looks binary </returns>
+	static bool ReadSourceFile(const std::wstring& path, std::vector<char>& buffer);
+};
@@ -1,19 +1,126 @@
 #include "FindReplace.h"
 #include "Utility.h"
+#include "SourceEdit.h"
+#include "TextSearch.h"
+#include "Regex.h"
 
 #include <Richedit.h>
 #include <commdlg.h>
 
-bool FR::Find(const wchar_t* lpszTarget,
-	          HWND hEditControl,
-	          DWORD dwFlags)
+// The flags a compiled pattern depends on
+#define REGEX_FLAGS (FR_MATCHCASE | FR_WHOLEWORD)
+
+static bool g_IsRegexMode = false;
+
+// The last pattern that was compiled, so that Find Next doesn't compile it again
+static Regex g_Regex;
+static std::wstring g_RegexPattern;
+static DWORD g_dwRegexFlags = 0;
+static bool g_IsRegexCached = false;
+
+// The text of the document searched last, Find Next and Replace only copy it again once it has been edited
+static std::wstring g_Text;
+static size_t g_TextVersion = 0;
+
+static SearchOptions GetSearchOptions(DWORD dwFlags)
 {
-	CHARRANGE cr;
-	SendMessage(hEditControl, EM_EXGETSEL, NULL, (LPARAM)&cr);
+	SearchOptions options;
+	options.matchCase = (dwFlags & FR_MATCHCASE) != 0;
+	options.wholeWord = (dwFlags & FR_WHOLEWORD) != 0;
 
-	if (cr.cpMin == cr.cpMax) 
-		cr.cpMin = cr.cpMax = 0;
-		
+	return options;
+}
+
+/// <summary>
+/// Compiles the pattern, unless it's the one that was compiled last
+/// </summary>
+/// <returns> Null if the pattern isn't valid </returns>
+static const Regex* GetRegex(const wchar_t* lpszPattern, DWORD dwFlags)
+{
+	dwFlags &= REGEX_FLAGS;
+
+	if (!g_IsRegexCached || g_dwRegexFlags != dwFlags || g_RegexPattern != lpszPattern)
+	{
+		g_RegexPattern = lpszPattern;
+		g_dwRegexFlags = dwFlags;
+		g_IsRegexCached = true;
+
+		g_Regex.Compile(g_RegexPattern, GetSearchOptions(dwFlags));
+	}
+
+	return g_Regex.IsCompiled() ? &g_Regex : nullptr;
+}
+
+/// <summary>
+/// The whole text of the document. Versions are never given to two
+/// different texts, so the copy made for the last search is reused as long
+/// as the document has the same version.
+/// </summary>
+static const std::wstring& GetDocumentText(const PieceTable& document)
+{
+	if (g_TextVersion != document.GetVersion())
+	{
+		g_Text = document.GetText();
+		g_TextVersion = document.GetVersion();
+	}
+
+	return g_Text;
+}
+
+void FR::SetRegexMode(bool isRegexMode)
+{
+	g_IsRegexMode = isRegexMode;
+}
+
+bool FR::IsRegexMode(void)
+{
+	return g_IsRegexMode;
+}
+
+std::wstring FR::GetPatternError(const wchar_t* lpszFind, DWORD dwFlags)
+{
+	if (!g_IsRegexMode || GetRegex(lpszFind, dwFlags) != nullptr)
+	{
+		return std::wstring();
+	}
+
+	return g_Regex.GetError();
+}
+
+/* Selects the next or the previous match of the pattern in the document */
+static bool FindRegex(const wchar_t* lpszPattern,
+	                  SourceEdit* pSourceEdit,
+	                  DWORD dwFlags,
+	                  const CHARRANGE& cr)
+{
+	const Regex* pRegex = GetRegex(lpszPattern, dwFlags);
+
+	if (pRegex == nullptr)
+	{
+		return false;
+	}
+
+	const std::wstring& text = GetDocumentText(pSourceEdit->GetDocument());
+	RegexMatch match;
+
+	const bool found = (dwFlags & FR_DOWN)
+		? pRegex->FindForward(text.c_str(), text.length(), static_cast<size_t>(cr.cpMax), match)
+		: pRegex->FindBackward(text.c_str(), text.length(), static_cast<size_t>(cr.cpMin), match);
+
+	if (found)
+	{
+		SendMessage(pSourceEdit->GetHandle(), EM_SETSEL, match.GetPosition(), match.GetPosition() + match.GetLength());
+	}
+
+	return found;
+}
+
+/* The control searches the part of a large file that is on screen */
+static bool FindInControl(const wchar_t* lpszTarget,
+	                      HWND hEditControl,
+	                      DWORD dwFlags,
+	                      const CHARRANGE& cr)
+{
 	FINDTEXT ft;
 	ft.lpstrText = lpszTarget;
 
@@ -41,10 +148,148 @@ bool FR::Find(const wchar_t* lpszTarget,
 	return false;
 }
 
-bool FR::Replace(const wchar_t* lpszNewText,
-	             HWND hEditControl,
+/// <summary>
+/// Searches the document itself instead of asking the control to. Down
+/// looks for the first match after the selection, up for the last one
+/// before it, and without a selection both start from the top. The matches
+/// are those of the incremental search, so pressing Find Next again only
+/// looks them up.
+/// </summary>
+bool FR::Find(const wchar_t* lpszTarget,
+	          SourceEdit* pSourceEdit,
+	          DWORD dwFlags)
+{
+	HWND hEditControl = pSourceEdit->GetHandle();
+
+	CHARRANGE cr;
+	SendMessage(hEditControl, EM_EXGETSEL, NULL, (LPARAM)&cr);
+
+	if (cr.cpMin == cr.cpMax) 
+		cr.cpMin = cr.cpMax = 0;
+
+	// The document holds the part of a large file that is on screen too
+	if (g_IsRegexMode)
+	{
+		return FindRegex(lpszTarget, pSourceEdit, dwFlags, cr);
+	}
+
+	if (pSourceEdit->IsLargeFileView())
+	{
+		return FindInControl(lpszTarget, hEditControl, dwFlags, cr);
+	}
+
+	// Typing the same text again reuses the matches, they're kept up to date with the edits
+	IncrementalSearch& search = pSourceEdit->GetIncrementalSearch();
+	search.SetPattern(lpszTarget, GetSearchOptions(dwFlags));
+
+	const size_t index = (dwFlags & FR_DOWN)
+		? search.FindNext(static_cast<size_t>(cr.cpMax))
+		: search.FindPrevious(static_cast<size_t>(cr.cpMin));
+
+	if (index == search.GetMatchCount())
+	{
+		return false;
+	}
+
+	const size_t position = search.GetMatches()[index];
+	SendMessage(hEditControl, EM_SETSEL, position, position + search.GetPatternLength());
+
+	pSourceEdit->HighlightViewport();
+
+	return true;
+}
+
+/// <summary>
+/// Selects the first match at or after the start of the selection, so the
+/// selection stays where it is while the typed text still matches there.
+/// Goes around to the top of the document when there is none below.
+/// </summary>
+bool FR::FindAsYouType(const wchar_t* lpszFind,
+	                   SourceEdit* pSourceEdit,
+	                   DWORD dwFlags)
+{
+	IncrementalSearch& search = pSourceEdit->GetIncrementalSearch();
+
+	// Regular expressions are found with Find Next only, the large file view only has the lines on screen
+	if (g_IsRegexMode || pSourceEdit->IsLargeFileView() || *lpszFind == L'\0')
+	{
+		EndIncrementalSearch(pSourceEdit);
+		return false;
+	}
+
+	search.SetPattern(lpszFind, GetSearchOptions(dwFlags));
+
+	HWND hEditControl = pSourceEdit->GetHandle();
+
+	CHARRANGE cr;
+	SendMessage(hEditControl, EM_EXGETSEL, NULL, (LPARAM)&cr);
+
+	size_t index = search.FindNext(static_cast<size_t>(cr.cpMin));
+
+	if (index == search.GetMatchCount())
+	{
+		index = search.FindNext(0);
+	}
+
+	if (index < search.GetMatchCount())
+	{
+		const size_t position = search.GetMatches()[index];
+		SendMessage(hEditControl, EM_SETSEL, position, position + search.GetPatternLength());
+	}
+
+	pSourceEdit->HighlightViewport();
+
+	return index < search.GetMatchCount();
+}
+
+void FR::EndIncrementalSearch(SourceEdit* pSourceEdit)
+{
+	pSourceEdit->GetIncrementalSearch().Clear();
+	pSourceEdit->HighlightViewport();
+
+	// The copy can be as big as the document, so it isn't kept once the search ends
+	std::wstring().swap(g_Text);
+	g_TextVersion = 0;
+}
+
+std::wstring FR::GetMatchStatus(SourceEdit* pSourceEdit)
+{
+	const IncrementalSearch& search = pSourceEdit->GetIncrementalSearch();
+	const size_t count = search.GetMatchCount();
+
+	if (!search.IsActive())
+	{
+		return std::wstring();
+	}
+
+	if (count == 0)
+	{
+		return L"No matches";
+	}
+
+	CHARRANGE cr;
+	SendMessage(pSourceEdit->GetHandle(), EM_EXGETSEL, NULL, (LPARAM)&cr);
+
+	const size_t index = search.FindExact(static_cast<size_t>(cr.cpMin), static_cast<size_t>(cr.cpMax));
+
+	if (index == count)
+	{
+		return std::to_wstring(count) + (count == 1 ? L" match" : L" matches");
+	}
+
+	return std::to_wstring(index + 1) + L" of " + std::to_wstring(count);
+}
+
+/// <summary>
+/// Replaces the selection. With regular expressions the selection has to
+/// be a match of the pattern, so that the groups can go in the replacement.
+/// </summary>
+bool FR::Replace(const wchar_t* lpszFind,
+	             const wchar_t* lpszNewText,
+	             SourceEdit* pSourceEdit,
 	             DWORD dwFlags)
 {
+	HWND hEditControl = pSourceEdit->GetHandle();
 	DWORD dwStart = 0, dwEnd = 0;
 
 	SendMessage(hEditControl,
@@ -52,37 +297,82 @@ bool FR::Replace(const wchar_t* lpszNewText,
 		        reinterpret_cast<WPARAM>(&dwStart),
 		        reinterpret_cast<LPARAM>(&dwEnd));
 
-	if (dwStart != dwEnd)
+	if (dwStart == dwEnd)
 	{
-		SendMessage(hEditControl,
-			        EM_REPLACESEL,
-			        TRUE,
-			        reinterpret_cast<LPARAM>(lpszNewText));
+		return false;
+	}
 
-		Utility::UpdateUndoMenuButton(hEditControl);
-		
-		return true;
+	std::wstring replacement = lpszNewText;
+
+	if (g_IsRegexMode)
+	{
+		const Regex* pRegex = GetRegex(lpszFind, dwFlags);
+		const std::wstring& text = GetDocumentText(pSourceEdit->GetDocument());
+		RegexMatch match;
+
+		if (pRegex == nullptr || !pRegex->MatchRange(text.c_str(), text.length(), dwStart, dwEnd, match))
+		{
+			return false;
+		}
+
+		replacement.clear();
+		pRegex->AppendReplacement(lpszNewText, text.c_str(), match, replacement);
 	}
 
-	return false;
+	SendMessage(hEditControl,
+		        EM_REPLACESEL,
+		        TRUE,
+		        reinterpret_cast<LPARAM>(replacement.c_str()));
+		
+	return true;
 }
 
-bool FR::ReplaceAll(const wchar_t* lpszFind,
-	                const wchar_t* lpszReplace,
-	                HWND hEditControl,
-	                DWORD dwFlags)
+/// <summary>
+/// Finds every match in the document at once and replaces the range they
+/// span with a single edit, which is undone in one step. The direction
+/// doesn't matter, the whole text is searched.
+/// </summary>
+/// <returns> Number of matches that were replaced </returns>
+size_t FR::ReplaceAll(const wchar_t* lpszFind,
+	                  const wchar_t* lpszReplace,
+	                  SourceEdit* pSourceEdit,
+	                  DWORD dwFlags)
 {
-	bool was_anything_replaced = false;
+	// Read only, the document only holds the part of the file on screen
+	if (pSourceEdit->IsLargeFileView())
+	{
+		return 0;
+	}
 
-	SendMessage(hEditControl, EM_SETSEL, 0, 0);
+	ReplaceAllResult result;
+	const std::wstring& text = GetDocumentText(pSourceEdit->GetDocument());
 
-	while (FR::Find(lpszFind, hEditControl, dwFlags))
+	if (g_IsRegexMode)
 	{
-		FR::Replace(lpszReplace, hEditControl, dwFlags);
-		was_anything_replaced = true;
+		const Regex* pRegex = GetRegex(lpszFind, dwFlags);
+
+		if (pRegex == nullptr || !pRegex->ReplaceAll(text, lpszReplace, result))
+		{
+			return 0;
+		}
+	}
+
+	else if (!TextSearch::ReplaceAll(text, lpszFind, lpszReplace, GetSearchOptions(dwFlags), result))
+	{
+		return 0;
 	}
 
-	SendMessage(hEditControl, EM_SETSEL, 0, 0);
+	pSourceEdit->BeginUndoGroup();
+	pSourceEdit->SuspendRedraw();
 
-	return was_anything_replaced;
-}
\ No newline at end of file
+	pSourceEdit->ReplaceRange(static_cast<LONG>(result.position),
+		                      static_cast<LONG>(result.removedLength),
+		                      result.inserted.c_str());
+
+	pSourceEdit->ResumeRedraw();
+	pSourceEdit->EndUndoGroup();
+
+	SendMessage(pSourceEdit->GetHandle(), EM_SETSEL, 0, 0);
+
+	return result.matchCount;
+}
@@ -4,18 +4,45 @@
 
 #include <Windows.h>
 
+#include <string>
+
+class SourceEdit;
+
 namespace FR
 {
 	bool Find(const wchar_t* lpszFind,
-		      HWND hEditControl,
+		      SourceEdit* pSourceEdit,
 		      DWORD dwFlags);
 
-	bool Replace(const wchar_t* lpszReplace,
-		         HWND hEditControl,
+	bool Replace(const wchar_t* lpszFind,
+		         const wchar_t* lpszReplace,
+		         SourceEdit* pSourceEdit,
 		         DWORD dwFlags);
 
-	bool ReplaceAll(const wchar_t* lpszFind,
-		            const wchar_t* lpszReplace,
-		            HWND hEditControl,
-		            DWORD dwFlags);
+	size_t ReplaceAll(const wchar_t* lpszFind,
+		              const wchar_t* lpszReplace,
+		              SourceEdit* pSourceEdit,
+		              DWORD dwFlags);
+
+	/// <summary>
+	/// Called whenever the text in the find dialog changes. Highlights
+	/// every match on screen and selects the closest one, an empty text
+	/// ends the search.
+	/// </summary>
+	bool FindAsYouType(const wchar_t* lpszFind,
+		               SourceEdit* pSourceEdit,
+		               DWORD dwFlags);
+
+	/* Removes the highlights of the matches, once the find dialog closes */
+	void EndIncrementalSearch(SourceEdit* pSourceEdit);
+
+	/* "n of m" when the selection is a match, for the status bar */
+	std::wstring GetMatchStatus(SourceEdit* pSourceEdit);
+
+	/* Whether the text to find is a regular expression */
+	void SetRegexMode(bool isRegexMode);
+	bool IsRegexMode(void);
+
+	/* Why the text to find can't be searched for, empty if it can */
+	std::wstring GetPatternError(const wchar_t* lpszFind, DWORD dwFlags);
 }
\ No newline at end of file
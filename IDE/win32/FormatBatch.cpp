@@ -0,0 +1,49 @@
+#include "FormatBatch.h"
+
+FormatBatch::FormatBatch(uint32_t baseColor)
+	: m_BaseColor(baseColor)
+{
+}
+
+void FormatBatch::Append(std::vector<ColorRun>& runs, const ColorRun& run)
+{
+	if (!runs.empty())
+	{
+		ColorRun& last = runs.back();
+
+		if (last.color == run.color && last.position + last.length == run.position)
+		{
+			last.length += run.length;
+			return;
+		}
+	}
+
+	runs.push_back(run);
+}
+
+void FormatBatch::Add(const ColorRun& run)
+{
+	if (run.length == 0)
+	{
+		return;
+	}
+
+	++m_AddedCount;
+
+	Append(run.color == m_BaseColor ? m_BaseRuns : m_ColorRuns, run);
+}
+
+void FormatBatch::Add(const ColorRun* pRuns, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Add(pRuns[i]);
+	}
+}
+
+void FormatBatch::Clear(void)
+{
+	m_BaseRuns.clear();
+	m_ColorRuns.clear();
+	m_AddedCount = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "SyntaxHighlighter.h"
+
+#include <vector>
+
+/// <summary>
+/// Collects the color runs of a highlight pass so that they're applied to
+/// the control together. Runs in the base color go to a layer of their own
+/// that is applied first, and the colored runs are applied over it. A run
+/// that starts where the previous run of its layer ends, with the same
+/// color, is merged into it, so the bases of a block of consecutive lines
+/// take one format instead of one per line.
+/// Runs have to be added in the order they appear in the text.
+/// </summary>
+class FormatBatch
+{
+private:
+	uint32_t m_BaseColor = 0;
+
+	std::vector<ColorRun> m_BaseRuns;
+	std::vector<ColorRun> m_ColorRuns;
+
+	// Runs added before merging, for the statistics
+	size_t m_AddedCount = 0;
+
+	static void Append(std::vector<ColorRun>& runs, const ColorRun& run);
+
+public:
+	explicit FormatBatch(uint32_t baseColor);
+
+	void Add(const ColorRun& run);
+	void Add(const ColorRun* pRuns, size_t count);
+
+	void Clear(void);
+
+	bool IsEmpty(void) const { return m_BaseRuns.empty() && m_ColorRuns.empty(); }
+
+	/* Have to be applied in this order */
+	const std::vector<ColorRun>& GetBaseRuns(void) const { return m_BaseRuns; }
+	const std::vector<ColorRun>& GetColorRuns(void) const { return m_ColorRuns; }
+
+	size_t GetAddedCount(void) const { return m_AddedCount; }
+	size_t GetRunCount(void) const { return m_BaseRuns.size() + m_ColorRuns.size(); }
+};
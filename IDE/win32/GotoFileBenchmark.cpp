@@ -0,0 +1,279 @@
+#include "GotoFileBenchmark.h"
+#include "Benchmark.h"
+#include "FileFinder.h"
+#include "TextSearch.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A query is answered at least this many times and for at least this long
+#define GOTO_FILE_BENCHMARK_MIN_PASSES 5
+#define GOTO_FILE_BENCHMARK_MIN_DURATION_MS 500
+
+// The generated paths are under this folder, which doesn't have to exist
+#define GOTO_FILE_BENCHMARK_ROOT L"C:\\benchmark"
+
+/* One character, a common pair, words of file names, a path across folders, and nothing */
+static const wchar_t* g_Queries[] = {
+	L"a", L"sw", L"main", L"appwin", L"srcedit", L"wrkarea.cpp", L"w32 tokenlexer", L"zzqx"
+};
+
+static const wchar_t* g_Folders[] = {
+	L"src", L"include", L"win32", L"lib", L"test", L"tests", L"docs", L"core", L"net", L"io", L"ui", L"platform",
+	L"third_party", L"tools", L"build", L"common", L"internal", L"detail", L"impl", L"v2", L"x86", L"arm64"
+};
+
+static const wchar_t* g_Words[] = {
+	L"App", L"Window", L"Source", L"Edit", L"Tab", L"Work", L"Area", L"Find", L"Replace", L"Token", L"Lexer",
+	L"Parser", L"Index", L"File", L"Search", L"Buffer", L"Piece", L"Table", L"Status", L"Bar", L"Output",
+	L"Save", L"Job", L"Utility", L"Logger", L"Main", L"Config", L"Socket", L"Stream", L"Thread", L"Pool"
+};
+
+static const wchar_t* g_Extensions[] = {
+	L".cpp", L".h", L".c", L".hpp", L".py", L".js", L".json", L".txt", L".md"
+};
+
+template <typename T, size_t N>
+static const T& Pick(std::mt19937& random, const T (&items)[N])
+{
+	return items[random() % N];
+}
+
+/* Folders a few levels deep, and file names of a few words in camelCase */
+static void GeneratePaths(std::vector<std::wstring>& paths)
+{
+	std::mt19937 random(0x5345);
+
+	for (size_t i = 0; i < GOTO_FILE_BENCHMARK_PATH_COUNT; ++i)
+	{
+		std::wstring path = GOTO_FILE_BENCHMARK_ROOT;
+		const size_t depth = 1 + random() % 7;
+
+		for (size_t level = 0; level < depth; ++level)
+		{
+			path.push_back(L'\\');
+			path += Pick(random, g_Folders);
+
+			if (random() % 4 == 0)
+			{
+				path += std::to_wstring(random() % 100);
+			}
+		}
+
+		path.push_back(L'\\');
+
+		const size_t words = 1 + random() % 3;
+
+		for (size_t word = 0; word < words; ++word)
+		{
+			path += Pick(random, g_Words);
+		}
+
+		path += Pick(random, g_Extensions);
+		paths.push_back(std::move(path));
+	}
+}
+
+/* Every file the explorer would show, it leaves out the names that start with a dot */
+static void ListFiles(const std::wstring& folder, std::vector<std::wstring>& paths)
+{
+	std::vector<std::wstring> directories(1, folder);
+
+	while (!directories.empty())
+	{
+		const std::wstring directory = std::move(directories.back());
+		directories.pop_back();
+
+		const std::wstring wildcard = directory + L"\\*";
+
+		WIN32_FIND_DATA find_data;
+		HANDLE hFind = FindFirstFileEx(wildcard.c_str(), FindExInfoBasic, &find_data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+
+		if (hFind == INVALID_HANDLE_VALUE)
+		{
+			continue;
+		}
+
+		do {
+			if (find_data.cFileName[0] != L'.')
+			{
+				std::wstring path = directory + L"\\" + find_data.cFileName;
+
+				if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				{
+					directories.push_back(std::move(path));
+				}
+
+				else
+				{
+					paths.push_back(std::move(path));
+				}
+			}
+		} while (FindNextFile(hFind, &find_data));
+
+		FindClose(hFind);
+	}
+}
+
+/* Checks the paths one by one for the characters of the query in order, the way a plain loop would */
+static size_t CountPlainMatches(const std::vector<std::wstring>& paths, size_t rootLength, const std::wstring& query)
+{
+	std::wstring folded;
+
+	for (wchar_t ch : query)
+	{
+		if (ch != L' ')
+		{
+			folded.push_back(TextSearch::FoldChar(ch));
+		}
+	}
+
+	size_t matchCount = 0;
+
+	for (const std::wstring& path : paths)
+	{
+		size_t matched = 0;
+
+		for (size_t i = rootLength; i < path.length() && matched < folded.length(); ++i)
+		{
+			if (TextSearch::FoldChar(path[i]) == folded[matched])
+			{
+				++matched;
+			}
+		}
+
+		if (matched == folded.length())
+		{
+			++matchCount;
+		}
+	}
+
+	return matchCount;
+}
+
+/* Times a query until it has run long enough, in milliseconds per query */
+template <typename Function>
+static double MeasureQuery(Function query)
+{
+	size_t passCount = 0;
+
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	Benchmark::Clock::duration elapsed;
+
+	do
+	{
+		query();
+
+		++passCount;
+		elapsed = Benchmark::Clock::now() - start;
+	} while (passCount < GOTO_FILE_BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(GOTO_FILE_BENCHMARK_MIN_DURATION_MS));
+
+	return Benchmark::GetMilliseconds(elapsed) / passCount;
+}
+
+/* The path as JSON, backslashes escaped and anything past ASCII left out */
+static std::string ToJsonString(const std::wstring& text)
+{
+	std::string json;
+
+	for (wchar_t ch : text)
+	{
+		if (ch == L'\\' || ch == L'"')
+		{
+			json.push_back('\\');
+		}
+
+		json.push_back(ch < 128 ? static_cast<char>(ch) : '?');
+	}
+
+	return json;
+}
+
+bool GotoFileBenchmark::Run(const wchar_t* lpszFolder, const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	std::wstring folder = lpszFolder != nullptr ? lpszFolder : GOTO_FILE_BENCHMARK_ROOT;
+
+	while (folder.length() > 1 && folder.back() == L'\\')
+	{
+		folder.pop_back();
+	}
+
+	std::vector<std::wstring> paths;
+
+	if (lpszFolder != nullptr)
+	{
+		ListFiles(folder, paths);
+	}
+
+	else
+	{
+		GeneratePaths(paths);
+	}
+
+	FileFinder finder;
+
+	// Only the table, the explorer fills it in the same walk that fills the tree
+	const Benchmark::Clock::time_point buildStart = Benchmark::Clock::now();
+	finder.Open(folder);
+
+	for (const std::wstring& path : paths)
+	{
+		finder.AddFile(path);
+	}
+
+	const double buildMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - buildStart);
+	const unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1U);
+
+	fprintf(pOutput, "{\"files\":%llu,\"generated\":%s,\"table_bytes\":%llu,\"build_ms\":%.1f,\"threads\":%u,\"budget_ms\":%.1f}\n",
+		    static_cast<unsigned long long>(finder.GetFileCount()), lpszFolder == nullptr ? "true" : "false",
+		    static_cast<unsigned long long>(finder.GetTableSize()), buildMilliseconds, threadCount, GOTO_FILE_BENCHMARK_BUDGET_MS);
+	fflush(pOutput);
+
+	const size_t rootLength = folder.length() + 1;
+
+	for (const wchar_t* lpszQuery : g_Queries)
+	{
+		std::vector<FileMatch> matches;
+		size_t allCount = 0;
+		size_t plainCount = 0;
+
+		const double rankedMilliseconds = MeasureQuery([&]() {
+			finder.Find(lpszQuery, FILE_FINDER_MAX_RESULTS, matches);
+		});
+
+		// Every match rather than the best ones, to count them
+		std::vector<FileMatch> all;
+		finder.Find(lpszQuery, finder.GetFileCount(), all);
+		allCount = all.size();
+
+		const double plainMilliseconds = MeasureQuery([&]() {
+			plainCount = CountPlainMatches(paths, rootLength, lpszQuery);
+		});
+
+		const std::string best = matches.empty() ? std::string() : ToJsonString(finder.GetRelativePath(matches.front().file));
+
+		fprintf(pOutput, "{\"query\":\"%s\",\"matching_files\":%llu,\"plain_matching_files\":%llu,\"results\":%llu,\"best\":\"%s\","
+			             "\"ranked_ms\":%.2f,\"plain_ms\":%.2f,\"within_budget\":%s}\n",
+			    ToJsonString(lpszQuery).c_str(), static_cast<unsigned long long>(allCount), static_cast<unsigned long long>(plainCount),
+			    static_cast<unsigned long long>(matches.size()), best.c_str(), rankedMilliseconds, plainMilliseconds,
+			    rankedMilliseconds <= GOTO_FILE_BENCHMARK_BUDGET_MS ? "true" : "false");
+		fflush(pOutput);
+	}
+
+	return fclose(pOutput) == 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-goto-file [project folder]
+#define GOTO_FILE_BENCHMARK_ARGUMENT L"--benchmark-goto-file"
+
+// Written to the current directory, one line of JSON for the files and one per query
+#define GOTO_FILE_BENCHMARK_OUTPUT_FILE L"goto-file-benchmark.jsonl"
+
+// Paths generated when no folder is given
+#define GOTO_FILE_BENCHMARK_PATH_COUNT 500000
+
+// A query has to be answered within a frame to keep up with typing
+#define GOTO_FILE_BENCHMARK_BUDGET_MS 16.0
+
+/// <summary>
+/// Measures Go to File on the files of a project folder, or on generated
+/// paths when there's none: how long the table takes to fill, how big it
+/// is, and how long each query takes to rank the files on every core.
+/// Each query is also answered the plain way, every path checked one by
+/// one on a single thread without ranking them, and the number of files
+/// that matched is written next to the results of both so that they can
+/// be compared.
+/// </summary>
+namespace GotoFileBenchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszFolder, const wchar_t* lpszOutputPath);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#define FNV1A_32_OFFSET_BASIS 2166136261U
+#define FNV1A_32_PRIME 16777619U
+
+#define FNV1A_64_OFFSET_BASIS 14695981039346656037ULL
+#define FNV1A_64_PRIME 1099511628211ULL
+
+/// <summary>
+/// FNV-1a, the hash of color file texts and paths, journal names and
+/// checksums, keywords and the saved trigram index. Each element is mixed
+/// in as a whole (a wchar_t is one step, not two bytes), and the hash
+/// passed in is continued, so data can be hashed a part at a time.
+/// </summary>
+namespace Hash
+{
+	template <typename T>
+	inline uint32_t Fnv1a32(const T* pData, size_t count, uint32_t hash = FNV1A_32_OFFSET_BASIS)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			hash ^= static_cast<uint32_t>(static_cast<typename std::make_unsigned<T>::type>(pData[i]));
+			hash *= FNV1A_32_PRIME;
+		}
+
+		return hash;
+	}
+
+	template <typename T>
+	inline uint64_t Fnv1a64(const T* pData, size_t count, uint64_t hash = FNV1A_64_OFFSET_BASIS)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			hash ^= static_cast<uint64_t>(static_cast<typename std::make_unsigned<T>::type>(pData[i]));
+			hash *= FNV1A_64_PRIME;
+		}
+
+		return hash;
+	}
+}
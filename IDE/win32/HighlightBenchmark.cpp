@@ -0,0 +1,866 @@
+#include "HighlightBenchmark.h"
+#include "Benchmark.h"
+#include "HighlightWorker.h"
+#include "FormatBatch.h"
+#include "KeywordTable.h"
+#include "Utf8Decoder.h"
+#include "Utility.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Characters of each generated corpus
+#define BENCHMARK_CORPUS_SIZE (4 * 1024 * 1024)
+
+// A corpus is colored at least this many times and for at least this long
+#define BENCHMARK_MIN_PASSES 3
+#define BENCHMARK_MIN_DURATION_MS 1000
+
+// Lines of the file that is typed into, and keystrokes of each kind of edit
+#define BENCHMARK_KEYSTROKE_LINES 50000
+#define BENCHMARK_KEYSTROKES 20000
+
+// Lines around the edit that are on screen and colored after every keystroke
+#define BENCHMARK_VIEWPORT_LINES 60
+
+#define PATH_SEPARATOR L"\\"
+
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+static std::atomic<size_t> g_AllocationCount(0);
+
+/* The array and nothrow forms end up here too */
+void* operator new(size_t size)
+{
+	g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* pMemory = malloc(size > 0 ? size : 1);
+
+	if (pMemory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return pMemory;
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+#endif
+
+/* What looking up the words of a corpus cost one way of finding keywords */
+struct LookupResult {
+	const char* lpszLookup = nullptr;
+	size_t hitCount = 0;
+	double nanosecondsPerLookup = 0;
+
+	// Negative if allocations aren't counted
+	double allocationsPerLookup = -1;
+};
+
+/* The words of the keyword files and the rest of C++, looked up the same way */
+static const wchar_t* g_Keywords[] = {
+	L"static", L"ushort", L"ulong", L"void", L"int", L"float", L"char", L"double", L"short", L"long", L"signed", L"unsigned",
+	L"if", L"while", L"for", L"do", L"return", L"#include", L"#define", L"#pragma", L"#ifdef", L"#ifndef", L"#endif",
+	L"const", L"constexpr", L"class", L"struct", L"union", L"enum", L"template", L"typename", L"typedef", L"namespace",
+	L"using", L"public", L"private", L"protected", L"virtual", L"override", L"final", L"friend", L"inline", L"extern",
+	L"switch", L"case", L"default", L"break", L"continue", L"goto", L"else", L"new", L"delete", L"this", L"nullptr",
+	L"true", L"false", L"sizeof", L"alignof", L"decltype", L"auto", L"bool", L"wchar_t", L"size_t", L"try", L"catch",
+	L"throw", L"noexcept", L"operator", L"static_cast", L"reinterpret_cast", L"const_cast", L"dynamic_cast", L"volatile",
+	L"mutable", L"explicit", L"register", L"thread_local", L"static_assert"
+};
+
+/* What re-highlighting after one kind of keystroke cost */
+struct KeystrokeResult {
+	const char* lpszEdit = nullptr;
+	size_t lineCount = 0;
+
+	double averageMicroseconds = 0;
+	double p99Microseconds = 0;
+	double maxMicroseconds = 0;
+
+	double averageRelexedLines = 0;
+	size_t maxRelexedLines = 0;
+};
+
+/* Generated text of a language, the size of the text is its size in UTF-8 as well */
+struct GeneratedCorpus {
+	const wchar_t* lpszName;
+	const wchar_t* lpszExtension;
+	void (*pGenerate)(std::mt19937& random, std::wstring& text);
+};
+
+static std::wstring GetIdentifier(std::mt19937& random, size_t maxLength)
+{
+	static const wchar_t* lpszLetters = L"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+
+	std::wstring identifier;
+	const size_t length = 1 + random() % maxLength;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		identifier.push_back(lpszLetters[random() % 53]);
+	}
+
+	return identifier;
+}
+
+/* Declarations, doc comments, macros and literals, the way a big library header looks */
+static void GenerateHeader(std::mt19937& random, std::wstring& text)
+{
+	static const wchar_t* lpszTypes[] = { L"int", L"unsigned long", L"double", L"char", L"void", L"std::wstring", L"size_t" };
+
+	while (text.length() < BENCHMARK_CORPUS_SIZE)
+	{
+		const std::wstring name = GetIdentifier(random, 12);
+		const wchar_t* lpszType = lpszTypes[random() % 7];
+		const unsigned int number = random() % 100000;
+
+		switch (random() % 8)
+		{
+		case 0:
+			text += L"/// <summary>\n/// Returns the " + name + L" of the object, or 0 if it has none\n/// </summary>\n";
+			break;
+
+		case 1:
+			text += L"#define " + name + L"_SIZE (" + std::to_wstring(number) + L" * sizeof(" + lpszType + L"))\n";
+			break;
+
+		case 2:
+			text += L"template <typename T, size_t N = " + std::to_wstring(number % 64) + L">\nclass " + name + L" : public Base<T>\n{\npublic:\n";
+			break;
+
+		case 3:
+			text += L"\tstatic const " + std::wstring(lpszType) + L" k" + name + L" = 0x" + std::to_wstring(number) + L"UL;\n";
+			break;
+
+		case 4:
+			text += L"\tvirtual " + std::wstring(lpszType) + L" Get" + name + L"(const char* lpszName, int index) const = 0; // " + name + L"\n";
+			break;
+
+		case 5:
+			text += L"\tif (m_" + name + L" != nullptr && m_Count >= " + std::to_wstring(number) + L") return \"" + name + L"\\n\";\n";
+			break;
+
+		case 6:
+			text += L"/*\n * " + name + L" keeps its state between calls, 'c' and 1.5e-3 don't count\n */\n";
+			break;
+
+		default:
+			text += L"};\n\n";
+			break;
+		}
+	}
+}
+
+/* A few very long lines without a single space */
+static void GenerateMinifiedScript(std::mt19937& random, std::wstring& text)
+{
+	size_t lineStart = 0;
+
+	while (text.length() < BENCHMARK_CORPUS_SIZE)
+	{
+		const std::wstring a = GetIdentifier(random, 2);
+		const std::wstring b = GetIdentifier(random, 3);
+
+		switch (random() % 5)
+		{
+		case 0:
+			text += L"var " + a + L"=function(" + b + L",e){return " + b + L"+\"" + a + L"\"+e*" + std::to_wstring(random() % 1000) + L".5};";
+			break;
+
+		case 1:
+			text += L"if(" + a + L"&&" + b + L".length>" + std::to_wstring(random() % 100) + L"){" + a + L"=[" + b + L",'x',null]}else{throw new Error(\"" + b + L"\")}";
+			break;
+
+		case 2:
+			text += L"for(let i=0;i<" + a + L".length;i++)" + b + L"[i]=" + a + L"[i]/2;";
+			break;
+
+		case 3:
+			text += a + L".prototype." + b + L"=function(){return this." + a + L"!==undefined?this." + a + L":0x1f};";
+			break;
+
+		default:
+			text += L"/*!" + b + L"*/const " + a + L"=async()=>await " + b + L"();";
+			break;
+		}
+
+		if (text.length() - lineStart > 256 * 1024)
+		{
+			text.push_back(L'\n');
+			lineStart = text.length();
+		}
+	}
+}
+
+/* One array on a single line, the way an API response is saved */
+static void GenerateSingleLineJson(std::mt19937& random, std::wstring& text)
+{
+	text += L"[";
+
+	for (unsigned int id = 0; text.length() < BENCHMARK_CORPUS_SIZE; ++id)
+	{
+		const std::wstring name = GetIdentifier(random, 10);
+
+		text += L"{\"id\":" + std::to_wstring(id) + L",\"name\":\"" + name + L" \\\"" + name + L"\\\"\",\"score\":" +
+			    std::to_wstring(random() % 10000) + L".25e-2,\"tags\":[\"a\",\"" + name + L"\"],\"active\":" +
+			    (random() % 2 ? L"true" : L"false") + L",\"parent\":null},";
+	}
+
+	text += L"{}]";
+}
+
+/* Comment delimiters everywhere, and comments and literals that go on for many lines */
+static void GenerateNestedComments(std::mt19937& random, std::wstring& text)
+{
+	while (text.length() < BENCHMARK_CORPUS_SIZE)
+	{
+		const std::wstring name = GetIdentifier(random, 6);
+
+		switch (random() % 6)
+		{
+		case 0:
+			text += L"/* /* /* " + name + L" /* ** / * /";
+			text.append(random() % 40, L'*');
+			text += L"\n";
+			break;
+
+		case 1:
+			text += L"a/b*c/*" + name + L"*/d//e/*f\\\ncontinued // comment */ still \\\ncomment\n";
+			break;
+
+		case 2:
+			text += L"x = \"/* not a comment */ \\\n" + name + L" /* still a string\";\n";
+			break;
+
+		case 3:
+			text.append(1 + random() % 80, L'/');
+			text.append(1 + random() % 80, L'*');
+			text += L"\n";
+			break;
+
+		case 4:
+			text += L"*/ " + name + L" */ */ '*/' \"*/\" #" + name + L"\n";
+			break;
+
+		default:
+			text += L"/*/*/*/*/" + name + L"/*/*/*/\n";
+			break;
+		}
+	}
+}
+
+static const GeneratedCorpus g_Corpora[] = {
+	{ L"generated/large-header.h",      L".h",    GenerateHeader },
+	{ L"generated/minified.js",         L".js",   GenerateMinifiedScript },
+	{ L"generated/single-line.json",    L".json", GenerateSingleLineJson },
+	{ L"generated/nested-comments.cpp", L".cpp",  GenerateNestedComments }
+};
+
+static size_t GetAllocationCount(void)
+{
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+	return g_AllocationCount.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+/// <summary>
+/// Colors the whole text the way HighlightWorker::Run does, chunk by chunk
+/// </summary>
+/// <param name="pLineTimes"> Receives the time each line took in nanoseconds, can be null </param>
+/// <returns> Number of runs </returns>
+static size_t ColorText(const std::wstring& text, const std::vector<size_t>& lineStarts, const Language& language,
+	                    TokenColorFunction pColorFunction, uint32_t defaultColor, std::vector<long long>* pLineTimes)
+{
+	std::vector<Token> tokens;
+	HighlightChunk* pChunk = nullptr;
+	LexerState state = LexerState::NORMAL;
+	size_t runCount = 0;
+
+	for (size_t line = 0; line < lineStarts.size(); ++line)
+	{
+		const size_t lineStart = lineStarts[line];
+		const bool hasLineBreak = line + 1 < lineStarts.size();
+		const size_t lineEnd = hasLineBreak ? lineStarts[line + 1] - 1 : text.length();
+
+		if (pChunk == nullptr)
+		{
+			pChunk = new HighlightChunk();
+		}
+
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+
+		state = SyntaxHighlighter::AppendColorRuns(text.c_str() + lineStart, lineEnd - lineStart, hasLineBreak, lineStart, state,
+			                                       language, pColorFunction, defaultColor, tokens, pChunk->runs);
+
+		pChunk->lines.push_back(line);
+		pChunk->runEnds.push_back(pChunk->runs.size());
+
+		if (pLineTimes != nullptr)
+		{
+			pLineTimes->push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Benchmark::Clock::now() - start).count());
+		}
+
+		// The window would take the chunk here
+		if (pChunk->lines.size() == HIGHLIGHT_CHUNK_LINES)
+		{
+			runCount += pChunk->runs.size();
+			SAFE_DELETE_PTR(pChunk);
+		}
+	}
+
+	if (pChunk != nullptr)
+	{
+		runCount += pChunk->runs.size();
+		SAFE_DELETE_PTR(pChunk);
+	}
+
+	return runCount;
+}
+
+BenchmarkResult HighlightBenchmark::Measure(const std::wstring& corpus, const Language& language, const std::wstring& text, size_t byteCount,
+	                                        TokenColorFunction pColorFunction, uint32_t defaultColor)
+{
+	BenchmarkResult result;
+	result.corpus = corpus;
+	result.lpszLanguage = language.lpszName;
+	result.byteCount = byteCount;
+
+	std::vector<size_t> lineStarts(1, 0);
+
+	for (size_t i = 0; i < text.length(); ++i)
+	{
+		if (text[i] == L'\r')
+		{
+			lineStarts.push_back(i + 1);
+		}
+	}
+
+	result.lineCount = lineStarts.size();
+
+	// Also warms up the caches and loads the pages of the text
+	std::vector<long long> lineTimes;
+	lineTimes.reserve(lineStarts.size());
+
+	result.runCount = ColorText(text, lineStarts, language, pColorFunction, defaultColor, &lineTimes);
+
+	std::sort(lineTimes.begin(), lineTimes.end());
+	result.p99LineMicroseconds = lineTimes[std::min(lineTimes.size() - 1, lineTimes.size() * 99 / 100)] / 1000.0;
+	result.maxLineMicroseconds = lineTimes.back() / 1000.0;
+
+	const size_t allocationsBefore = GetAllocationCount();
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	Benchmark::Clock::duration elapsed;
+
+	do
+	{
+		ColorText(text, lineStarts, language, pColorFunction, defaultColor, nullptr);
+
+		++result.passCount;
+		elapsed = Benchmark::Clock::now() - start;
+	} while (result.passCount < BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(BENCHMARK_MIN_DURATION_MS));
+
+	const double megabytes = result.byteCount * static_cast<double>(result.passCount) / BYTES_PER_MEGABYTE;
+	const double seconds = std::chrono::duration<double>(elapsed).count();
+
+	result.megabytesPerSecond = megabytes / seconds;
+
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+	result.allocationsPerMegabyte = (GetAllocationCount() - allocationsBefore) / megabytes;
+#endif
+
+	return result;
+}
+
+/* Colors the lines on screen around the line that aren't painted, the way SourceEdit::HighlightViewport does */
+static void ColorViewport(SyntaxHighlighter& highlighter, size_t line, std::vector<ColorRun>& runs, FormatBatch& batch)
+{
+	const size_t first = line > BENCHMARK_VIEWPORT_LINES / 2 ? line - BENCHMARK_VIEWPORT_LINES / 2 : 0;
+	const size_t end = std::min(first + BENCHMARK_VIEWPORT_LINES, highlighter.GetLineCount());
+
+	runs.clear();
+	batch.Clear();
+
+	for (size_t i = first; i < end; ++i)
+	{
+		if (!highlighter.IsLinePainted(i))
+		{
+			highlighter.GetLineColorRuns(i, runs);
+			highlighter.MarkPainted(i);
+		}
+	}
+
+	batch.Add(runs.data(), runs.size());
+}
+
+/// <summary>
+/// Times what a keystroke costs the highlighting: the edit goes through the
+/// document to the line index and the highlighter, which lexes the lines
+/// again until their states converge, and then the lines on screen that
+/// have to be painted again are colored into a batch. The screen around
+/// the edit is colored before the timer starts, the way it would be.
+/// </summary>
+/// <param name="getPosition"> Returns where the next keystroke goes </param>
+/// <param name="type"> Makes the edit at that position </param>
+template <typename PositionFunction, typename EditFunction>
+static KeystrokeResult MeasureKeystrokes(const char* lpszEdit, PieceTable& document, const LineIndex& index, SyntaxHighlighter& highlighter,
+	                                     PositionFunction getPosition, EditFunction type)
+{
+	KeystrokeResult result;
+	result.lpszEdit = lpszEdit;
+	result.lineCount = index.GetLineCount();
+
+	std::vector<ColorRun> runs;
+	FormatBatch batch(highlighter.GetDefaultColor());
+	std::vector<long long> times;
+	size_t relexedLineCount = 0;
+
+	times.reserve(BENCHMARK_KEYSTROKES);
+
+	for (size_t i = 0; i < BENCHMARK_KEYSTROKES; ++i)
+	{
+		const size_t position = getPosition(i);
+		ColorViewport(highlighter, index.GetLineFromOffset(position), runs, batch);
+
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+
+		type(i, position);
+		ColorViewport(highlighter, index.GetLineFromOffset(position), runs, batch);
+
+		times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Benchmark::Clock::now() - start).count());
+
+		relexedLineCount += highlighter.GetLastRelexedLineCount();
+		result.maxRelexedLines = std::max(result.maxRelexedLines, highlighter.GetLastRelexedLineCount());
+	}
+
+	long long total = 0;
+
+	for (const long long time : times)
+	{
+		total += time;
+	}
+
+	std::sort(times.begin(), times.end());
+
+	result.averageMicroseconds = total / 1000.0 / times.size();
+	result.p99Microseconds = times[times.size() * 99 / 100] / 1000.0;
+	result.maxMicroseconds = times.back() / 1000.0;
+	result.averageRelexedLines = relexedLineCount / static_cast<double>(times.size());
+
+	return result;
+}
+
+/// <summary>
+/// Types into a large header: letters in the middle of random lines, which
+/// only touch their own line, and a comment opened at the start of a line
+/// and closed again, which changes how every line up to the next end of a
+/// comment starts
+/// </summary>
+static std::vector<KeystrokeResult> MeasureTyping(TokenColorFunction pColorFunction, uint32_t defaultColor)
+{
+	std::mt19937 random(0x4844);
+	std::wstring text;
+
+	GenerateHeader(random, text);
+
+	size_t end = 0;
+
+	for (size_t line = 0; line < BENCHMARK_KEYSTROKE_LINES && end != std::wstring::npos; ++line)
+	{
+		end = text.find(L'\n', end + (line > 0 ? 1 : 0));
+	}
+
+	if (end != std::wstring::npos)
+	{
+		text.resize(end);
+	}
+
+	Utility::NormalizeLineBreaks(text);
+
+	const Language* pLanguage = LanguageRegistry::GetLanguageOfFile(L".h");
+
+	PieceTable document;
+	LineIndex index;
+	SyntaxHighlighter highlighter(document, index, pLanguage);
+
+	document.AddListener(&index);
+	document.AddListener(&highlighter);
+	highlighter.SetColorFunction(pColorFunction, defaultColor);
+	document.Load(std::move(text));
+
+	std::vector<KeystrokeResult> results;
+
+	results.push_back(MeasureKeystrokes("type", document, index, highlighter, [&](size_t) {
+		const size_t line = random() % index.GetLineCount();
+		return index.GetOffsetFromLine(line) + random() % (index.GetLineLength(line) + 1);
+	}, [&](size_t i, size_t position) {
+		document.Insert(position, L"abcdefgh" + i % 8, 1);
+	}));
+
+	// Every other keystroke takes back the one before it
+	size_t commentStart = 0;
+
+	results.push_back(MeasureKeystrokes("toggle_comment", document, index, highlighter, [&](size_t i) {
+		if (i % 2 == 0)
+		{
+			commentStart = index.GetOffsetFromLine(random() % index.GetLineCount());
+		}
+
+		return commentStart;
+	}, [&](size_t i, size_t position) {
+		if (i % 2 == 0)
+		{
+			document.Insert(position, L"/*", 2);
+		}
+
+		else
+		{
+			document.Erase(position, 2);
+		}
+	}));
+
+	document.RemoveListener(&highlighter);
+	document.RemoveListener(&index);
+
+	return results;
+}
+
+/// <summary>
+/// Looks up every word of the text over and over, until it has run long
+/// enough, and counts the words that were found on the last pass
+/// </summary>
+template <typename Function>
+static LookupResult MeasureLookup(const char* lpszLookup, const std::wstring& text, const std::vector<Token>& words, Function find)
+{
+	LookupResult result;
+	result.lpszLookup = lpszLookup;
+
+	size_t passCount = 0;
+	size_t lookupCount = 0;
+
+	const size_t allocationsBefore = GetAllocationCount();
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	Benchmark::Clock::duration elapsed;
+
+	do
+	{
+		result.hitCount = 0;
+
+		for (const Token& word : words)
+		{
+			uint32_t value = 0;
+
+			if (find(text.c_str() + word.start, word.length, value))
+			{
+				++result.hitCount;
+			}
+		}
+
+		lookupCount += words.size();
+		++passCount;
+		elapsed = Benchmark::Clock::now() - start;
+	} while (passCount < BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(BENCHMARK_MIN_DURATION_MS));
+
+	result.nanosecondsPerLookup = std::chrono::duration<double, std::nano>(elapsed).count() / lookupCount;
+
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+	result.allocationsPerLookup = (GetAllocationCount() - allocationsBefore) / static_cast<double>(lookupCount);
+#endif
+
+	return result;
+}
+
+/// <summary>
+/// Looks up the words of the large header, the identifiers and directives
+/// the color function is given, in a KeywordTable and in the map the
+/// keywords used to be kept in. The map is searched the way it was, with
+/// a string built for the key and looked up twice for a keyword.
+/// </summary>
+static std::vector<LookupResult> MeasureKeywordLookups(size_t& keywordCount, size_t& wordCount)
+{
+	std::mt19937 random(0x4844);
+	std::wstring text;
+
+	GenerateHeader(random, text);
+	Utility::NormalizeLineBreaks(text);
+
+	// Words are kept as tokens whose start is relative to the text instead of their line
+	const Language* pLanguage = LanguageRegistry::GetLanguageOfFile(L".h");
+	std::vector<Token> tokens;
+	std::vector<Token> words;
+	LexerState state = LexerState::NORMAL;
+	size_t lineStart = 0;
+
+	while (lineStart <= text.length())
+	{
+		size_t lineEnd = text.find(L'\r', lineStart);
+
+		if (lineEnd == std::wstring::npos)
+		{
+			lineEnd = text.length();
+		}
+
+		tokens.clear();
+		state = Lexer::LexLine(text.c_str() + lineStart, lineEnd - lineStart, state, pLanguage->rules, &tokens);
+
+		for (Token token : tokens)
+		{
+			if (token.type == TokenType::IDENTIFIER || token.type == TokenType::DIRECTIVE)
+			{
+				token.start += static_cast<uint32_t>(lineStart);
+				words.push_back(token);
+			}
+		}
+
+		lineStart = lineEnd + 1;
+	}
+
+	std::vector<std::pair<std::wstring, uint32_t>> keywords;
+	std::unordered_map<std::wstring, uint32_t> map;
+
+	for (size_t i = 0; i < sizeof(g_Keywords) / sizeof(g_Keywords[0]); ++i)
+	{
+		keywords.emplace_back(g_Keywords[i], static_cast<uint32_t>(i + 1));
+		map[g_Keywords[i]] = static_cast<uint32_t>(i + 1);
+	}
+
+	KeywordTable table;
+	table.Build(keywords);
+
+	keywordCount = keywords.size();
+	wordCount = words.size();
+
+	std::vector<LookupResult> results;
+
+	results.push_back(MeasureLookup("keyword_table", text, words, [&](const wchar_t* pWord, size_t length, uint32_t& value) {
+		return table.Find(pWord, length, value);
+	}));
+
+	results.push_back(MeasureLookup("unordered_map", text, words, [&](const wchar_t* pWord, size_t length, uint32_t& value) {
+		const std::wstring key(pWord, length);
+
+		if (map.find(key) != map.end())
+		{
+			value = map[key];
+			return true;
+		}
+
+		return false;
+	}));
+
+	return results;
+}
+
+/* JSON strings are written as ASCII, anything else is escaped */
+static void WriteJsonString(FILE* pFile, const wchar_t* lpszText)
+{
+	fputc('"', pFile);
+
+	for (; *lpszText != L'\0'; ++lpszText)
+	{
+		const wchar_t ch = *lpszText;
+
+		if (ch == L'"' || ch == L'\\')
+		{
+			fputc('\\', pFile);
+			fputc(static_cast<char>(ch), pFile);
+		}
+
+		else if (ch >= 0x20 && ch < 0x7F)
+		{
+			fputc(static_cast<char>(ch), pFile);
+		}
+
+		else
+		{
+			fprintf(pFile, "\\u%04X", static_cast<unsigned int>(ch) & 0xFFFF);
+		}
+	}
+
+	fputc('"', pFile);
+}
+
+static void WriteResult(FILE* pFile, const BenchmarkResult& result)
+{
+	fputs("{\"corpus\":", pFile);
+	WriteJsonString(pFile, result.corpus.c_str());
+	fputs(",\"language\":", pFile);
+	WriteJsonString(pFile, result.lpszLanguage);
+
+	fprintf(pFile, ",\"bytes\":%llu,\"lines\":%llu,\"runs\":%llu,\"passes\":%llu,\"mb_per_s\":%.2f,",
+		    static_cast<unsigned long long>(result.byteCount), static_cast<unsigned long long>(result.lineCount),
+		    static_cast<unsigned long long>(result.runCount), static_cast<unsigned long long>(result.passCount),
+		    result.megabytesPerSecond);
+
+	if (result.allocationsPerMegabyte >= 0)
+	{
+		fprintf(pFile, "\"allocs_per_mb\":%.2f,", result.allocationsPerMegabyte);
+	}
+
+	else
+	{
+		fputs("\"allocs_per_mb\":null,", pFile);
+	}
+
+	fprintf(pFile, "\"p99_line_us\":%.3f,\"max_line_us\":%.3f}\n", result.p99LineMicroseconds, result.maxLineMicroseconds);
+	fflush(pFile);
+}
+
+static void WriteKeystrokeResult(FILE* pFile, const KeystrokeResult& result)
+{
+	fprintf(pFile, "{\"corpus\":\"generated/keystrokes.h\",\"edit\":\"%s\",\"lines\":%llu,\"keystrokes\":%u,\"avg_us\":%.3f,"
+		           "\"p99_us\":%.3f,\"max_us\":%.3f,\"avg_relexed_lines\":%.2f,\"max_relexed_lines\":%llu}\n",
+		    result.lpszEdit, static_cast<unsigned long long>(result.lineCount), static_cast<unsigned int>(BENCHMARK_KEYSTROKES),
+		    result.averageMicroseconds, result.p99Microseconds, result.maxMicroseconds, result.averageRelexedLines,
+		    static_cast<unsigned long long>(result.maxRelexedLines));
+	fflush(pFile);
+}
+
+static void WriteLookupResult(FILE* pFile, const LookupResult& result, size_t keywordCount, size_t wordCount)
+{
+	fprintf(pFile, "{\"corpus\":\"generated/large-header.h\",\"lookup\":\"%s\",\"keywords\":%llu,\"words\":%llu,\"hits\":%llu,"
+		           "\"ns_per_lookup\":%.2f,",
+		    result.lpszLookup, static_cast<unsigned long long>(keywordCount), static_cast<unsigned long long>(wordCount),
+		    static_cast<unsigned long long>(result.hitCount), result.nanosecondsPerLookup);
+
+	if (result.allocationsPerLookup >= 0)
+	{
+		fprintf(pFile, "\"allocs_per_lookup\":%.3f}\n", result.allocationsPerLookup);
+	}
+
+	else
+	{
+		fputs("\"allocs_per_lookup\":null}\n", pFile);
+	}
+
+	fflush(pFile);
+}
+
+static FILE* OpenFile(const std::wstring& path, const wchar_t* lpszMode)
+{
+	FILE* pFile = nullptr;
+	_wfopen_s(&pFile, path.c_str(), lpszMode);
+
+	return pFile;
+}
+
+static bool ReadFileBytes(const std::wstring& path, std::string& bytes)
+{
+	FILE* pFile = OpenFile(path, L"rb");
+
+	if (pFile == nullptr)
+	{
+		return false;
+	}
+
+	char buffer[65536];
+	size_t length;
+
+	while ((length = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+	{
+		bytes.append(buffer, length);
+	}
+
+	fclose(pFile);
+
+	return true;
+}
+
+/* Files right in the folder, sorted so that runs can be compared line by line */
+static std::vector<std::wstring> GetCorpusFiles(const std::wstring& directory)
+{
+	std::vector<std::wstring> names;
+
+	WIN32_FIND_DATA find_data;
+	const HANDLE hFind = FindFirstFile((directory + PATH_SEPARATOR L"*").c_str(), &find_data);
+
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			{
+				names.push_back(find_data.cFileName);
+			}
+		} while (FindNextFile(hFind, &find_data));
+
+		FindClose(hFind);
+	}
+
+	std::sort(names.begin(), names.end());
+
+	return names;
+}
+
+bool HighlightBenchmark::Run(const wchar_t* lpszCorpusDirectory, const wchar_t* lpszOutputPath, TokenColorFunction pColorFunction, uint32_t defaultColor)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	for (const GeneratedCorpus& corpus : g_Corpora)
+	{
+		// The same text every time, so that the results of two builds can be compared
+		std::mt19937 random(0x4844);
+		std::wstring text;
+
+		corpus.pGenerate(random, text);
+
+		const size_t byteCount = text.length();
+		Utility::NormalizeLineBreaks(text);
+
+		const Language* pLanguage = LanguageRegistry::GetLanguageOfFile(corpus.lpszExtension);
+
+		WriteResult(pOutput, Measure(corpus.lpszName, *pLanguage, text, byteCount, pColorFunction, defaultColor));
+	}
+
+	for (const KeystrokeResult& result : MeasureTyping(pColorFunction, defaultColor))
+	{
+		WriteKeystrokeResult(pOutput, result);
+	}
+
+	size_t keywordCount = 0;
+	size_t wordCount = 0;
+
+	for (const LookupResult& result : MeasureKeywordLookups(keywordCount, wordCount))
+	{
+		WriteLookupResult(pOutput, result, keywordCount, wordCount);
+	}
+
+	if (lpszCorpusDirectory != nullptr)
+	{
+		const std::wstring directory = lpszCorpusDirectory;
+
+		for (const std::wstring& name : GetCorpusFiles(directory))
+		{
+			const Language* pLanguage = LanguageRegistry::GetLanguageOfFile(name.c_str());
+			std::string bytes;
+
+			if (pLanguage == LanguageRegistry::GetPlainText() || !ReadFileBytes(directory + PATH_SEPARATOR + name, bytes) || bytes.empty())
+			{
+				continue;
+			}
+
+			std::wstring text = Utf8Decoder::DecodeAll(bytes.data(), bytes.size());
+			Utility::NormalizeLineBreaks(text);
+
+			WriteResult(pOutput, Measure(name, *pLanguage, text, bytes.size(), pColorFunction, defaultColor));
+		}
+	}
+
+	return fclose(pOutput) == 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "SyntaxHighlighter.h"
+
+#include <string>
+
+// Define BENCHMARK_COUNT_ALLOCATIONS to replace the global operator new with one that counts,
+// only the Benchmark configuration does so that the allocator of the IDE is left alone
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-highlighting [corpus folder]
+#define BENCHMARK_ARGUMENT L"--benchmark-highlighting"
+
+// Written to the current directory, one line of JSON per corpus, per kind of keystroke and per keyword lookup
+#define BENCHMARK_OUTPUT_FILE L"highlight-benchmark.jsonl"
+
+/* What coloring one corpus cost */
+struct BenchmarkResult {
+	std::wstring corpus;
+	const wchar_t* lpszLanguage = nullptr;
+
+	// Size of the file, in UTF-8
+	size_t byteCount = 0;
+	size_t lineCount = 0;
+	size_t runCount = 0;
+
+	// Times the whole corpus was colored for the throughput
+	size_t passCount = 0;
+
+	double megabytesPerSecond = 0;
+
+	// Negative if allocations aren't counted
+	double allocationsPerMegabyte = -1;
+
+	double p99LineMicroseconds = 0;
+	double maxLineMicroseconds = 0;
+};
+
+/// <summary>
+/// Measures the coloring path without a window: the lexer, the keyword
+/// lookups and the color runs, driven the same way the background pass
+/// drives them, so that a change to any of them shows up as a number.
+/// Every corpus is colored over and over for the throughput, and once more
+/// timing each line on its own for the latencies. The corpora are generated
+/// (a large C++ header, minified JavaScript, JSON on a single line and
+/// pathological comments), and files of any known language can be added
+/// from a folder. Typing is measured on a 50k line header as well, as
+/// the time it takes from a keystroke to the colors of the screen around
+/// it, for letters typed into a line and for comments opened and closed.
+/// Last, the words of the large header are looked up in a KeywordTable
+/// and in the unordered_map the keyword colors used to be kept in.
+/// </summary>
+namespace HighlightBenchmark
+{
+	/* The text has to have its line breaks normalized */
+	BenchmarkResult Measure(const std::wstring& corpus, const Language& language, const std::wstring& text, size_t byteCount,
+		                    TokenColorFunction pColorFunction, uint32_t defaultColor);
+
+	/// <summary>
+	/// Measures the generated corpora and the files in the folder, and
+	/// writes the results as JSON lines to the output file
+	/// </summary>
+	/// <param name="lpszCorpusDirectory"> Can be null, only the generated corpora are measured then </param>
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszCorpusDirectory, const wchar_t* lpszOutputPath, TokenColorFunction pColorFunction, uint32_t defaultColor);
+}
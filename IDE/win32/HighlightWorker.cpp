@@ -0,0 +1,224 @@
+#include "HighlightWorker.h"
+
+#include <algorithm>
+
+HighlightWorker::HighlightWorker(HWND hWndNotify, const PieceTable& document, const SyntaxHighlighter& highlighter)
+	: m_hWndNotify(hWndNotify),
+	  m_Document(document),
+	  m_IsLinePainted(highlighter.GetPaintedLines()),
+	  m_pLanguage(highlighter.GetLanguage()),
+	  m_pColorFunction(highlighter.GetColorFunction()),
+	  m_DefaultColor(highlighter.GetDefaultColor()),
+	  m_IsCancelled(false),
+	  m_HasFinished(false)
+{
+}
+
+HighlightWorker::~HighlightWorker(void)
+{
+	for (HighlightChunk* pChunk : m_Chunks)
+	{
+		delete pChunk;
+	}
+}
+
+void HighlightWorker::Start(void)
+{
+	std::thread(&HighlightWorker::Run, shared_from_this()).detach();
+}
+
+void HighlightWorker::Cancel(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsCancelled = true;
+	}
+
+	m_ChunkTaken.notify_all();
+}
+
+void HighlightWorker::Notify(void)
+{
+	// Cancel takes the lock, so the window is never told anything once it has cancelled the worker
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (!m_IsCancelled)
+	{
+		PostMessage(m_hWndNotify, WM_HIGHLIGHT_CHUNK, NULL, NULL);
+	}
+}
+
+bool HighlightWorker::PushChunk(HighlightChunk* pChunk)
+{
+	bool wasEmpty;
+
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		m_ChunkTaken.wait(lock, [this]() {
+			return m_IsCancelled || m_Chunks.size() < MAX_QUEUED_HIGHLIGHT_CHUNKS;
+		});
+
+		if (m_IsCancelled)
+		{
+			delete pChunk;
+			return false;
+		}
+
+		wasEmpty = m_Chunks.empty();
+		m_Chunks.push_back(pChunk);
+	}
+
+	// The window goes on taking chunks until the queue is empty, so it only needs waking up then
+	if (wasEmpty)
+	{
+		Notify();
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Lexes every line, since the state at the start of a line depends on
+/// all the lines before it, but only keeps the colors of the unpainted ones.
+/// The text is read a block at a time, so that a large document isn't
+/// copied as a whole and cancelling doesn't have to wait for a copy.
+/// </summary>
+void HighlightWorker::Run(void)
+{
+	std::vector<wchar_t> block(HIGHLIGHT_READ_BLOCK_SIZE);
+	size_t blockStart = 0;
+	size_t blockLength = 0;
+	size_t blockOffset = 0;
+
+	// The line being lexed, gathered from as many blocks as it spans
+	std::wstring text;
+
+	std::vector<Token> tokens;
+	HighlightChunk* pChunk = nullptr;
+
+	LexerState state = LexerState::NORMAL;
+	size_t lineStart = 0;
+
+	for (size_t line = 0; !m_IsCancelled; ++line)
+	{
+		bool hasLineBreak = false;
+		text.clear();
+
+		while (!hasLineBreak && !m_IsCancelled)
+		{
+			if (blockOffset == blockLength)
+			{
+				blockStart += blockLength;
+				blockLength = m_Document.CopyTextRange(blockStart, block.size(), block.data());
+				blockOffset = 0;
+
+				if (blockLength == 0)
+				{
+					break;
+				}
+			}
+
+			const wchar_t* pStart = block.data() + blockOffset;
+			const wchar_t* pEnd = block.data() + blockLength;
+			const wchar_t* pBreak = std::find(pStart, pEnd, L'\r');
+
+			text.append(pStart, pBreak);
+			blockOffset = static_cast<size_t>(pBreak - block.data());
+
+			if (pBreak != pEnd)
+			{
+				++blockOffset;
+				hasLineBreak = true;
+			}
+		}
+
+		if (m_IsCancelled)
+		{
+			break;
+		}
+
+		if (line < m_IsLinePainted.size() && m_IsLinePainted[line] == 0)
+		{
+			if (pChunk == nullptr)
+			{
+				pChunk = new HighlightChunk();
+				pChunk->version = m_Document.GetVersion();
+			}
+
+			state = SyntaxHighlighter::AppendColorRuns(text.c_str(), text.length(), hasLineBreak, lineStart, state,
+				                                       *m_pLanguage, m_pColorFunction, m_DefaultColor, tokens, pChunk->runs, &m_IsCancelled);
+
+			pChunk->lines.push_back(line);
+			pChunk->runEnds.push_back(pChunk->runs.size());
+
+			if (pChunk->lines.size() == HIGHLIGHT_CHUNK_LINES)
+			{
+				if (!PushChunk(pChunk))
+				{
+					return;
+				}
+
+				pChunk = nullptr;
+			}
+		}
+
+		else
+		{
+			state = Lexer::LexLine(text.c_str(), text.length(), state, m_pLanguage->rules, nullptr, &m_IsCancelled);
+		}
+
+		if (!hasLineBreak)
+		{
+			break;
+		}
+
+		lineStart += text.length() + 1;
+	}
+
+	// A chunk cut short by the cancellation is never pushed
+	if (m_IsCancelled)
+	{
+		delete pChunk;
+		return;
+	}
+
+	if (pChunk != nullptr && !PushChunk(pChunk))
+	{
+		return;
+	}
+
+	m_HasFinished = true;
+
+	// Lets the window know it can get rid of the worker
+	Notify();
+}
+
+HighlightChunk* HighlightWorker::TakeChunk(void)
+{
+	HighlightChunk* pChunk = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (!m_Chunks.empty())
+		{
+			pChunk = m_Chunks.front();
+			m_Chunks.pop_front();
+		}
+	}
+
+	if (pChunk != nullptr)
+	{
+		m_ChunkTaken.notify_one();
+	}
+
+	return pChunk;
+}
+
+bool HighlightWorker::IsDone(void)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	return m_HasFinished && m_Chunks.empty();
+}
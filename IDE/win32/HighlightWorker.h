@@ -0,0 +1,107 @@
+#pragma once
+
+#include "PieceTable.h"
+#include "SyntaxHighlighter.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Posted to the window of a HighlightWorker when a chunk is ready and none was waiting
+#define WM_HIGHLIGHT_CHUNK (WM_APP + 5)
+
+// Lines colored by each chunk
+#define HIGHLIGHT_CHUNK_LINES 256
+
+// The worker waits for the window once this many chunks are waiting to be applied
+#define MAX_QUEUED_HIGHLIGHT_CHUNKS 4
+
+// Characters copied out of the document at a time, the worker never holds the whole text
+#define HIGHLIGHT_READ_BLOCK_SIZE 65536
+
+/* Colors of a group of lines, computed by the worker */
+struct HighlightChunk {
+	// Version of the document the colors belong to
+	size_t version = 0;
+
+	std::vector<size_t> lines;
+
+	// The runs of lines[i] end at runs[runEnds[i]]
+	std::vector<size_t> runEnds;
+	std::vector<ColorRun> runs;
+
+	// Lines already applied, a chunk can be applied over more than one message
+	size_t appliedLines = 0;
+};
+
+/// <summary>
+/// Colors the lines of a document that aren't painted yet on a thread of
+/// its own, working from a copy of the document so that the text can keep
+/// changing. The colors are handed to the window in chunks, and the worker
+/// never gets more than a few chunks ahead of it. A worker whose document
+/// changed is of no use anymore and is cancelled. The thread holds on to
+/// the worker until it returns, so the window lets go of a cancelled worker
+/// right away instead of waiting for it.
+/// </summary>
+class HighlightWorker : public std::enable_shared_from_this<HighlightWorker>
+{
+private:
+	HWND m_hWndNotify = nullptr;
+
+	PieceTable m_Document;
+	std::vector<uint8_t> m_IsLinePainted;
+
+	const Language* m_pLanguage = nullptr;
+	TokenColorFunction m_pColorFunction = nullptr;
+	uint32_t m_DefaultColor = 0;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_ChunkTaken;
+	std::deque<HighlightChunk*> m_Chunks;
+
+	std::atomic<bool> m_IsCancelled;
+	std::atomic<bool> m_HasFinished;
+
+	void Run(void);
+
+	/* Waits for room in the queue, false if the worker was cancelled meanwhile */
+	bool PushChunk(HighlightChunk* pChunk);
+
+	/* Tells the window, unless the worker was cancelled and the window may be gone */
+	void Notify(void);
+
+public:
+	/* The document is copied, the copy shares the text it was loaded with */
+	HighlightWorker(HWND hWndNotify, const PieceTable& document, const SyntaxHighlighter& highlighter);
+
+	/* Frees the chunks that were never taken, on whichever thread lets go of the worker last */
+	~HighlightWorker(void);
+
+	HighlightWorker(const HighlightWorker&) = delete;
+	HighlightWorker& operator=(const HighlightWorker&) = delete;
+
+	/* The worker has to be owned by a shared_ptr */
+	void Start(void);
+
+	/// <summary>
+	/// Makes the thread stop as soon as it notices, within a few thousand
+	/// characters even in the middle of a long line. Doesn't wait for it,
+	/// and nothing is posted to the window afterwards.
+	/// </summary>
+	void Cancel(void);
+
+	size_t GetVersion(void) const { return m_Document.GetVersion(); }
+
+	/* Oldest chunk that hasn't been taken, nullptr if none is ready. The caller owns it */
+	HighlightChunk* TakeChunk(void);
+
+	/* Whether every chunk was computed and taken */
+	bool IsDone(void);
+};
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Nodes of a treap ordered by position only (an implicit treap), each
+/// node knowing how many nodes and how much length its subtree holds.
+/// Splitting and merging at a position take logarithmic time, which is
+/// what the piece table and the line index are built on. The nodes are
+/// indices into a vector, so copying the treap copies its trees as they
+/// are, and the nodes of freed subtrees are reused. The roots are kept
+/// by the owner.
+///
+/// Traits describes what a node holds:
+///   typedef ... Value;
+///   static size_t GetLength(const Value& value);
+///   static Value Cut(Value& value, size_t offset);
+/// Cut keeps the first 'offset' of the length in the value and returns
+/// the rest, it's only needed by SplitAtLength.
+/// </summary>
+template <typename Traits>
+class ImplicitTreap
+{
+public:
+	typedef typename Traits::Value Value;
+
+	static constexpr uint32_t NIL = UINT32_MAX;
+
+	struct Node {
+		Value value;
+		uint32_t left = NIL;
+		uint32_t right = NIL;
+		uint32_t priority = 0;
+
+		// Nodes and length of the node and of every node below it
+		uint32_t count = 1;
+		size_t sum = 0;
+	};
+
+private:
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_FreeNodes;
+	uint32_t m_Seed = 0x9E3779B9;
+
+	uint32_t NextPriority(void);
+
+public:
+	Node& operator[](uint32_t node) { return m_Nodes[node]; }
+	const Node& operator[](uint32_t node) const { return m_Nodes[node]; }
+
+	/* Nodes in use, in every tree */
+	size_t GetNodeCount(void) const { return m_Nodes.size() - m_FreeNodes.size(); }
+
+	uint32_t Count(uint32_t node) const { return node == NIL ? 0 : m_Nodes[node].count; }
+	size_t Sum(uint32_t node) const { return node == NIL ? 0 : m_Nodes[node].sum; }
+
+	/* Frees every node, the roots the owner kept mean nothing afterwards */
+	void Clear(void);
+
+	uint32_t CreateNode(const Value& value);
+	void FreeTree(uint32_t node);
+
+	/* Recomputes the count and sum of the node from its children */
+	void Update(uint32_t node);
+
+	/* Left tree gets the first 'count' nodes */
+	void SplitAtCount(uint32_t node, uint32_t count, uint32_t& left, uint32_t& right);
+
+	/* Left tree gets the first 'length', the value the position is in is cut in two */
+	void SplitAtLength(uint32_t node, size_t length, uint32_t& left, uint32_t& right);
+
+	uint32_t Merge(uint32_t left, uint32_t right);
+
+	/* Builds a tree out of the values, in order, in linear time */
+	uint32_t Build(const std::vector<Value>& values);
+};
+
+template <typename Traits>
+uint32_t ImplicitTreap<Traits>::NextPriority(void)
+{
+	// xorshift, the priorities only need to look random to keep the tree balanced
+	m_Seed ^= m_Seed << 13;
+	m_Seed ^= m_Seed >> 17;
+	m_Seed ^= m_Seed << 5;
+
+	return m_Seed;
+}
+
+template <typename Traits>
+void ImplicitTreap<Traits>::Clear(void)
+{
+	m_Nodes.clear();
+	m_FreeNodes.clear();
+}
+
+template <typename Traits>
+uint32_t ImplicitTreap<Traits>::CreateNode(const Value& value)
+{
+	Node node;
+	node.value = value;
+	node.priority = NextPriority();
+	node.sum = Traits::GetLength(value);
+
+	if (!m_FreeNodes.empty())
+	{
+		const uint32_t index = m_FreeNodes.back();
+		m_FreeNodes.pop_back();
+		m_Nodes[index] = node;
+		return index;
+	}
+
+	m_Nodes.push_back(node);
+
+	return static_cast<uint32_t>(m_Nodes.size() - 1);
+}
+
+template <typename Traits>
+void ImplicitTreap<Traits>::FreeTree(uint32_t node)
+{
+	std::vector<uint32_t> stack;
+
+	if (node != NIL)
+	{
+		stack.push_back(node);
+	}
+
+	while (!stack.empty())
+	{
+		const uint32_t current = stack.back();
+		stack.pop_back();
+
+		if (m_Nodes[current].left != NIL)
+			stack.push_back(m_Nodes[current].left);
+
+		if (m_Nodes[current].right != NIL)
+			stack.push_back(m_Nodes[current].right);
+
+		m_FreeNodes.push_back(current);
+	}
+}
+
+template <typename Traits>
+void ImplicitTreap<Traits>::Update(uint32_t node)
+{
+	Node& n = m_Nodes[node];
+	n.count = 1 + Count(n.left) + Count(n.right);
+	n.sum = Traits::GetLength(n.value) + Sum(n.left) + Sum(n.right);
+}
+
+template <typename Traits>
+void ImplicitTreap<Traits>::SplitAtCount(uint32_t node, uint32_t count, uint32_t& left, uint32_t& right)
+{
+	if (node == NIL)
+	{
+		left = right = NIL;
+		return;
+	}
+
+	if (Count(m_Nodes[node].left) < count)
+	{
+		uint32_t rest;
+		SplitAtCount(m_Nodes[node].right, count - Count(m_Nodes[node].left) - 1, rest, right);
+		m_Nodes[node].right = rest;
+		left = node;
+	}
+
+	else
+	{
+		uint32_t rest;
+		SplitAtCount(m_Nodes[node].left, count, left, rest);
+		m_Nodes[node].left = rest;
+		right = node;
+	}
+
+	Update(node);
+}
+
+template <typename Traits>
+void ImplicitTreap<Traits>::SplitAtLength(uint32_t node, size_t length, uint32_t& left, uint32_t& right)
+{
+	if (node == NIL)
+	{
+		left = right = NIL;
+		return;
+	}
+
+	const size_t leftLength = Sum(m_Nodes[node].left);
+	const size_t valueLength = Traits::GetLength(m_Nodes[node].value);
+
+	if (length <= leftLength)
+	{
+		uint32_t rest;
+		SplitAtLength(m_Nodes[node].left, length, left, rest);
+		m_Nodes[node].left = rest;
+		right = node;
+	}
+
+	else if (length >= leftLength + valueLength)
+	{
+		uint32_t rest;
+		SplitAtLength(m_Nodes[node].right, length - leftLength - valueLength, rest, right);
+		m_Nodes[node].right = rest;
+		left = node;
+	}
+
+	// The position is inside the value, its second half goes first in the right tree
+	else
+	{
+		const Value second = Traits::Cut(m_Nodes[node].value, length - leftLength);
+
+		// Can grow m_Nodes, so no reference to a node is held across it
+		const uint32_t secondNode = CreateNode(second);
+
+		right = Merge(secondNode, m_Nodes[node].right);
+		m_Nodes[node].right = NIL;
+		left = node;
+	}
+
+	Update(node);
+}
+
+template <typename Traits>
+uint32_t ImplicitTreap<Traits>::Merge(uint32_t left, uint32_t right)
+{
+	if (left == NIL) return right;
+	if (right == NIL) return left;
+
+	if (m_Nodes[left].priority > m_Nodes[right].priority)
+	{
+		m_Nodes[left].right = Merge(m_Nodes[left].right, right);
+		Update(left);
+		return left;
+	}
+
+	m_Nodes[right].left = Merge(left, m_Nodes[right].left);
+	Update(right);
+	return right;
+}
+
+template <typename Traits>
+uint32_t ImplicitTreap<Traits>::Build(const std::vector<Value>& values)
+{
+	// Cartesian tree construction: the stack holds the right spine of the tree
+	std::vector<uint32_t> spine;
+
+	for (const Value& value : values)
+	{
+		const uint32_t node = CreateNode(value);
+		uint32_t last = NIL;
+
+		while (!spine.empty() && m_Nodes[spine.back()].priority < m_Nodes[node].priority)
+		{
+			last = spine.back();
+			spine.pop_back();
+			Update(last);
+		}
+
+		m_Nodes[node].left = last;
+
+		if (!spine.empty())
+		{
+			m_Nodes[spine.back()].right = node;
+		}
+
+		spine.push_back(node);
+	}
+
+	while (spine.size() > 1)
+	{
+		Update(spine.back());
+		spine.pop_back();
+	}
+
+	if (spine.empty())
+	{
+		return NIL;
+	}
+
+	Update(spine.front());
+
+	return spine.front();
+}
@@ -0,0 +1,319 @@
+#include "IncrementalSearch.h"
+
+#include <algorithm>
+
+IncrementalSearch::IncrementalSearch(const PieceTable& document)
+	: m_Document(document)
+{
+}
+
+void IncrementalSearch::Scan(size_t start, size_t end, std::vector<size_t>& occurrences) const
+{
+	if (start >= end)
+	{
+		return;
+	}
+
+	const std::wstring text = m_Document.GetTextRange(start, end - start);
+
+	size_t from = 0;
+	size_t position = 0;
+
+	while (m_pSearcher->FindForward(text.c_str(), text.length(), from, position))
+	{
+		occurrences.push_back(start + position);
+		from = position + 1;
+	}
+}
+
+void IncrementalSearch::Refine(const std::vector<size_t>& occurrences, size_t prefixLength, const std::wstring& pattern)
+{
+	const size_t documentLength = m_Document.GetLength();
+	std::vector<wchar_t> suffix(pattern.length() - prefixLength);
+
+	for (size_t position : occurrences)
+	{
+		// They're sorted, the ones after don't fit either
+		if (position + pattern.length() > documentLength)
+		{
+			break;
+		}
+
+		m_Document.CopyTextRange(position + prefixLength, suffix.size(), suffix.data());
+
+		size_t i = 0;
+
+		while (i < suffix.size() && (m_Options.matchCase ? suffix[i] == pattern[prefixLength + i]
+			                         : TextSearch::FoldChar(suffix[i]) == TextSearch::FoldChar(pattern[prefixLength + i])))
+		{
+			++i;
+		}
+
+		if (i == suffix.size())
+		{
+			m_Occurrences.push_back(position);
+		}
+	}
+}
+
+bool IncrementalSearch::IsWholeWordAt(size_t position) const
+{
+	const size_t end = position + m_Pattern.length();
+
+	return (position == 0 || !TextSearch::IsWordChar(m_Document.GetCharAt(position - 1))) &&
+		   (end >= m_Document.GetLength() || !TextSearch::IsWordChar(m_Document.GetCharAt(end)));
+}
+
+void IncrementalSearch::FindWholeWords(void)
+{
+	m_WholeWords.clear();
+
+	if (!m_Options.wholeWord)
+	{
+		return;
+	}
+
+	for (size_t position : m_Occurrences)
+	{
+		if (IsWholeWordAt(position))
+		{
+			m_WholeWords.push_back(position);
+		}
+	}
+}
+
+/// <summary>
+/// Typing a character refines the matches of the text before it, erasing
+/// one goes back to the matches that were found for the shorter text.
+/// Whole word matching only filters the occurrences, so switching it on
+/// or off doesn't scan the document either.
+/// </summary>
+void IncrementalSearch::SetPattern(const std::wstring& pattern, const SearchOptions& options)
+{
+	if (pattern.empty())
+	{
+		Clear();
+		return;
+	}
+
+	const bool canReuse = IsActive() && options.matchCase == m_Options.matchCase;
+
+	if (canReuse && pattern == m_Pattern)
+	{
+		if (options.wholeWord != m_Options.wholeWord)
+		{
+			m_Options = options;
+			FindWholeWords();
+			++m_Version;
+		}
+
+		return;
+	}
+
+	const size_t prefixLength = m_Pattern.length();
+	const bool isTypedOn = canReuse && pattern.length() > prefixLength && pattern.compare(0, prefixLength, m_Pattern) == 0;
+
+	SearchOptions scanOptions;
+	scanOptions.matchCase = options.matchCase;
+
+	m_pSearcher.reset(new TextSearcher(pattern, scanOptions));
+
+	if (isTypedOn)
+	{
+		const bool isDense = m_Occurrences.size() * INCREMENTAL_SEARCH_RESCAN_DENSITY > m_Document.GetLength();
+
+		CachedMatches cached;
+		cached.pattern = std::move(m_Pattern);
+		cached.occurrences = std::move(m_Occurrences);
+		m_History.push_back(std::move(cached));
+
+		m_Occurrences.clear();
+
+		if (isDense)
+		{
+			Scan(0, m_Document.GetLength(), m_Occurrences);
+		}
+
+		else
+		{
+			Refine(m_History.back().occurrences, prefixLength, pattern);
+		}
+	}
+
+	else
+	{
+		// Only a shorter text typed before can still be in the history
+		while (!m_History.empty() && (!canReuse || m_History.back().pattern.length() > pattern.length()))
+		{
+			m_History.pop_back();
+		}
+
+		if (!m_History.empty() && m_History.back().pattern == pattern)
+		{
+			m_Occurrences = std::move(m_History.back().occurrences);
+			m_History.pop_back();
+		}
+
+		else
+		{
+			m_History.clear();
+			m_Occurrences.clear();
+			Scan(0, m_Document.GetLength(), m_Occurrences);
+		}
+	}
+
+	m_Pattern = pattern;
+	m_Options = options;
+
+	FindWholeWords();
+	++m_Version;
+}
+
+void IncrementalSearch::Clear(void)
+{
+	if (!IsActive())
+	{
+		return;
+	}
+
+	m_Pattern.clear();
+	m_pSearcher.reset();
+	m_Occurrences.clear();
+	m_WholeWords.clear();
+	m_History.clear();
+
+	++m_Version;
+}
+
+size_t IncrementalSearch::FindNext(size_t position) const
+{
+	const std::vector<size_t>& matches = GetMatches();
+
+	return std::lower_bound(matches.begin(), matches.end(), position) - matches.begin();
+}
+
+size_t IncrementalSearch::FindPrevious(size_t position) const
+{
+	const std::vector<size_t>& matches = GetMatches();
+
+	if (position < m_Pattern.length())
+	{
+		return matches.size();
+	}
+
+	const size_t index = std::upper_bound(matches.begin(), matches.end(), position - m_Pattern.length()) - matches.begin();
+
+	return index == 0 ? matches.size() : index - 1;
+}
+
+size_t IncrementalSearch::FindExact(size_t start, size_t end) const
+{
+	const std::vector<size_t>& matches = GetMatches();
+	const size_t index = FindNext(start);
+
+	if (index == matches.size() || matches[index] != start || end - start != m_Pattern.length())
+	{
+		return matches.size();
+	}
+
+	return index;
+}
+
+/// <summary>
+/// Drops the matches the edit cut through, moves the ones after it, and
+/// scans the text around it for the matches it made. Whole words can also
+/// start or stop being whole words when the text next to them changes.
+/// </summary>
+void IncrementalSearch::OnDocumentEdit(const TextEdit& edit)
+{
+	const size_t removed = edit.removed.length();
+	const size_t inserted = edit.inserted.length();
+
+	// Text typed right after a highlighted match takes its format
+	if (m_PaintedStart < m_PaintedEnd && edit.position <= m_PaintedEnd)
+	{
+		if (edit.position + removed < m_PaintedStart)
+		{
+			m_PaintedStart = m_PaintedStart + inserted - removed;
+			m_PaintedEnd = m_PaintedEnd + inserted - removed;
+		}
+
+		else
+		{
+			m_PaintedStart = std::min(m_PaintedStart, edit.position);
+			m_PaintedEnd = std::max(m_PaintedEnd, edit.position + removed) + inserted - removed;
+		}
+	}
+
+	if (!IsActive())
+	{
+		return;
+	}
+
+	// Refer to the text before the edit
+	m_History.clear();
+
+	const size_t length = m_Pattern.length();
+	const size_t first = edit.position >= length - 1 ? edit.position - (length - 1) : 0;
+
+	auto begin = std::lower_bound(m_Occurrences.begin(), m_Occurrences.end(), first);
+	auto end = std::lower_bound(begin, m_Occurrences.end(), edit.position + removed);
+	size_t index = m_Occurrences.erase(begin, end) - m_Occurrences.begin();
+
+	for (size_t i = index; i < m_Occurrences.size(); ++i)
+	{
+		m_Occurrences[i] = m_Occurrences[i] + inserted - removed;
+	}
+
+	std::vector<size_t> found;
+	Scan(first, std::min(m_Document.GetLength(), edit.position + inserted + length - 1), found);
+	m_Occurrences.insert(m_Occurrences.begin() + index, found.begin(), found.end());
+
+	if (m_Options.wholeWord)
+	{
+		const size_t wordFirst = edit.position >= length ? edit.position - length : 0;
+
+		begin = std::lower_bound(m_WholeWords.begin(), m_WholeWords.end(), wordFirst);
+		end = std::upper_bound(begin, m_WholeWords.end(), edit.position + removed);
+		index = m_WholeWords.erase(begin, end) - m_WholeWords.begin();
+
+		for (size_t i = index; i < m_WholeWords.size(); ++i)
+		{
+			m_WholeWords[i] = m_WholeWords[i] + inserted - removed;
+		}
+
+		found.clear();
+
+		for (auto it = std::lower_bound(m_Occurrences.begin(), m_Occurrences.end(), wordFirst);
+			 it != m_Occurrences.end() && *it <= edit.position + inserted; ++it)
+		{
+			if (IsWholeWordAt(*it))
+			{
+				found.push_back(*it);
+			}
+		}
+
+		m_WholeWords.insert(m_WholeWords.begin() + index, found.begin(), found.end());
+	}
+
+	++m_Version;
+}
+
+void IncrementalSearch::OnDocumentLoad(const PieceTable&)
+{
+	// The control lost its formats along with its text
+	m_PaintedStart = 0;
+	m_PaintedEnd = 0;
+
+	if (!IsActive())
+	{
+		return;
+	}
+
+	m_History.clear();
+	m_Occurrences.clear();
+	Scan(0, m_Document.GetLength(), m_Occurrences);
+
+	FindWholeWords();
+	++m_Version;
+}
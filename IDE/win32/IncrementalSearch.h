@@ -0,0 +1,97 @@
+#pragma once
+
+#include "PieceTable.h"
+#include "TextSearch.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Refining looks up every match in the document, past one match every this many characters a new scan is cheaper
+#define INCREMENTAL_SEARCH_RESCAN_DENSITY 10
+
+/// <summary>
+/// Keeps every match of the text being typed in the find dialog, so that
+/// they can be counted and highlighted while the user types. A character
+/// added to the end of the text only checks the matches that were found
+/// for the text before it, and erasing it brings back the matches that
+/// were found for the shorter text, so the document is only scanned when
+/// the text changes in any other way. The matches follow the edits of the
+/// document, only the text around an edit is scanned again.
+/// Overlapping matches are all kept, "aa" is found twice in "aaa".
+/// </summary>
+class IncrementalSearch : public DocumentListener
+{
+private:
+	/* The matches of a shorter text typed before */
+	struct CachedMatches {
+		std::wstring pattern;
+		std::vector<size_t> occurrences;
+	};
+
+	const PieceTable& m_Document;
+
+	std::wstring m_Pattern;
+	SearchOptions m_Options;
+
+	// Looks for the pattern without whole word matching, for the scans around edits
+	std::unique_ptr<TextSearcher> m_pSearcher;
+
+	// Start of every place the pattern is at, sorted, whether it's a whole word or not
+	std::vector<size_t> m_Occurrences;
+
+	// The occurrences that are whole words, when the options ask for them
+	std::vector<size_t> m_WholeWords;
+
+	std::vector<CachedMatches> m_History;
+
+	// Changes whenever the matches do
+	size_t m_Version = 0;
+
+	// Characters that were highlighted in the control, moved along with the edits
+	size_t m_PaintedStart = 0;
+	size_t m_PaintedEnd = 0;
+
+	/* Adds the occurrences in [start, end) of the document, in order */
+	void Scan(size_t start, size_t end, std::vector<size_t>& occurrences) const;
+
+	/* Keeps the occurrences of the first 'prefixLength' characters that are followed by the rest of the pattern */
+	void Refine(const std::vector<size_t>& occurrences, size_t prefixLength, const std::wstring& pattern);
+
+	void FindWholeWords(void);
+	bool IsWholeWordAt(size_t position) const;
+
+public:
+	explicit IncrementalSearch(const PieceTable& document);
+
+	IncrementalSearch(const IncrementalSearch&) = delete;
+	IncrementalSearch& operator=(const IncrementalSearch&) = delete;
+
+	/* Finds the matches of the pattern, an empty one ends the search */
+	void SetPattern(const std::wstring& pattern, const SearchOptions& options);
+	void Clear(void);
+
+	bool IsActive(void) const { return !m_Pattern.empty(); }
+	size_t GetPatternLength(void) const { return m_Pattern.length(); }
+	size_t GetVersion(void) const { return m_Version; }
+
+	/* Start of every match, sorted */
+	const std::vector<size_t>& GetMatches(void) const { return m_Options.wholeWord ? m_WholeWords : m_Occurrences; }
+	size_t GetMatchCount(void) const { return GetMatches().size(); }
+
+	/* Index of the first match that starts at or after the position, GetMatchCount() if there is none */
+	size_t FindNext(size_t position) const;
+
+	/* Index of the last match that ends at or before the position, GetMatchCount() if there is none */
+	size_t FindPrevious(size_t position) const;
+
+	/* Index of the match that is exactly the range, GetMatchCount() if it isn't one */
+	size_t FindExact(size_t start, size_t end) const;
+
+	/* Highlighted characters, empty if none are */
+	void GetPaintedRange(size_t& start, size_t& end) const { start = m_PaintedStart; end = m_PaintedEnd; }
+	void SetPaintedRange(size_t start, size_t end) { m_PaintedStart = start; m_PaintedEnd = end; }
+
+	void OnDocumentEdit(const TextEdit& edit) override;
+	void OnDocumentLoad(const PieceTable& document) override;
+};
@@ -0,0 +1,211 @@
+#include "IndexBenchmark.h"
+#include "Benchmark.h"
+#include "TrigramIndex.h"
+#include "FileSearch.h"
+#include "TextSearch.h"
+#include "Utf8Decoder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// A pattern is searched for at least this many times and for at least this long
+#define INDEX_BENCHMARK_MIN_PASSES 3
+#define INDEX_BENCHMARK_MIN_DURATION_MS 500
+
+/* Common in source code, rare, and not there at all */
+static const wchar_t* g_Patterns[] = {
+	L"include", L"return", L"TODO", L"CreateFile", L"std::vector<", L"m_hWndSelf", L"0x5345", L"xyzzy_not_found"
+};
+
+/* Every file Find in Files would search when it walks the folder */
+static void ListFiles(const std::wstring& folder, std::vector<std::wstring>& files)
+{
+	std::vector<std::wstring> directories(1, folder);
+
+	while (!directories.empty())
+	{
+		const std::wstring directory = std::move(directories.back());
+		directories.pop_back();
+
+		const std::wstring wildcard = directory + L"\\*";
+
+		WIN32_FIND_DATA find_data;
+		HANDLE hFind = FindFirstFileEx(wildcard.c_str(), FindExInfoBasic, &find_data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+
+		if (hFind == INVALID_HANDLE_VALUE)
+		{
+			continue;
+		}
+
+		do {
+			if (FileSearch::IsSearched(find_data))
+			{
+				std::wstring path = directory + L"\\" + find_data.cFileName;
+
+				if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				{
+					directories.push_back(std::move(path));
+				}
+
+				else
+				{
+					files.push_back(std::move(path));
+				}
+			}
+		} while (FindNextFile(hFind, &find_data));
+
+		FindClose(hFind);
+	}
+}
+
+/* Reads and searches the files one by one, like a single worker of Find in Files */
+static size_t CountMatchingFiles(const std::vector<std::wstring>& files, const TextSearcher& searcher)
+{
+	std::vector<char> buffer;
+	std::wstring text;
+	Utf8Decoder decoder;
+	size_t matchingCount = 0;
+
+	for (const std::wstring& path : files)
+	{
+		if (!FileSearch::ReadSourceFile(path, buffer))
+		{
+			continue;
+		}
+
+		text.clear();
+		decoder.Reset();
+		decoder.Decode(buffer.data(), buffer.size(), text);
+		decoder.Finish(text);
+
+		size_t position = 0;
+
+		if (searcher.FindForward(text.c_str(), text.length(), 0, position))
+		{
+			++matchingCount;
+		}
+	}
+
+	return matchingCount;
+}
+
+static unsigned long long GetFileSize(const wchar_t* lpszPath)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+
+	if (!GetFileAttributesEx(lpszPath, GetFileExInfoStandard, &data))
+	{
+		return 0;
+	}
+
+	return (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
+
+/* Times a search until it has run long enough, in milliseconds per search */
+template <typename Function>
+static double MeasureSearch(Function search, size_t& matchingCount)
+{
+	size_t passCount = 0;
+
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	Benchmark::Clock::duration elapsed;
+
+	do
+	{
+		matchingCount = search();
+
+		++passCount;
+		elapsed = Benchmark::Clock::now() - start;
+	} while (passCount < INDEX_BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(INDEX_BENCHMARK_MIN_DURATION_MS));
+
+	return Benchmark::GetMilliseconds(elapsed) / passCount;
+}
+
+bool IndexBenchmark::Run(const wchar_t* lpszFolder, const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	std::wstring folder = lpszFolder != nullptr ? lpszFolder : L".";
+
+	while (folder.length() > 1 && folder.back() == L'\\')
+	{
+		folder.pop_back();
+	}
+
+	TrigramIndex index;
+
+	const Benchmark::Clock::time_point buildStart = Benchmark::Clock::now();
+	index.Build(folder);
+	const double buildMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - buildStart);
+
+	const Benchmark::Clock::time_point saveStart = Benchmark::Clock::now();
+	const bool isSaved = index.Save(INDEX_BENCHMARK_INDEX_FILE);
+	const double saveMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - saveStart);
+
+	const unsigned long long indexBytes = GetFileSize(INDEX_BENCHMARK_INDEX_FILE);
+
+	TrigramIndex loaded;
+
+	const Benchmark::Clock::time_point loadStart = Benchmark::Clock::now();
+	const bool isLoaded = isSaved && loaded.Load(folder, INDEX_BENCHMARK_INDEX_FILE);
+	const double loadMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - loadStart);
+
+	DeleteFile(INDEX_BENCHMARK_INDEX_FILE);
+
+	const unsigned long long sourceBytes = index.GetIndexedBytes();
+	const double seconds = buildMilliseconds / 1000.0;
+
+	fprintf(pOutput, "{\"files\":%llu,\"source_bytes\":%llu,\"trigrams\":%llu,\"build_ms\":%.1f,\"build_mb_per_s\":%.2f,"
+		             "\"build_files_per_s\":%.0f,\"index_bytes\":%llu,\"size_ratio\":%.4f,\"save_ms\":%.1f,\"load_ms\":%.1f,\"loaded\":%s}\n",
+		    static_cast<unsigned long long>(index.GetFileCount()), sourceBytes,
+		    static_cast<unsigned long long>(index.GetTrigramCount()), buildMilliseconds,
+		    sourceBytes / BYTES_PER_MEGABYTE / seconds, index.GetFileCount() / seconds, indexBytes,
+		    sourceBytes != 0 ? static_cast<double>(indexBytes) / sourceBytes : 0.0, saveMilliseconds, loadMilliseconds,
+		    isLoaded ? "true" : "false");
+	fflush(pOutput);
+
+	for (const wchar_t* lpszPattern : g_Patterns)
+	{
+		const TextSearcher searcher(lpszPattern, SearchOptions());
+
+		size_t candidateCount = 0;
+		size_t indexedCount = 0;
+		size_t scannedCount = 0;
+
+		// Finding the files is part of both, the walk for the scan and the lists for the index
+		const double indexedMilliseconds = MeasureSearch([&]() {
+			std::vector<std::wstring> candidates;
+			index.FindCandidates(lpszPattern, candidates);
+
+			candidateCount = candidates.size();
+			return CountMatchingFiles(candidates, searcher);
+		}, indexedCount);
+
+		const double scannedMilliseconds = MeasureSearch([&]() {
+			std::vector<std::wstring> files;
+			ListFiles(folder, files);
+
+			return CountMatchingFiles(files, searcher);
+		}, scannedCount);
+
+		std::string pattern(wcstombs(nullptr, lpszPattern, 0), '\0');
+		wcstombs(&pattern[0], lpszPattern, pattern.length());
+
+		fprintf(pOutput, "{\"pattern\":\"%s\",\"candidates\":%llu,\"matching_files\":%llu,\"scan_matching_files\":%llu,"
+			             "\"index_ms\":%.2f,\"scan_ms\":%.2f,\"speedup\":%.1f}\n",
+			    pattern.c_str(), static_cast<unsigned long long>(candidateCount), static_cast<unsigned long long>(indexedCount),
+			    static_cast<unsigned long long>(scannedCount), indexedMilliseconds, scannedMilliseconds,
+			    indexedMilliseconds > 0 ? scannedMilliseconds / indexedMilliseconds : 0.0);
+		fflush(pOutput);
+	}
+
+	return fclose(pOutput) == 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-index <project folder>
+#define INDEX_BENCHMARK_ARGUMENT L"--benchmark-index"
+
+// Written to the current directory, one line of JSON for the index and one per pattern
+#define INDEX_BENCHMARK_OUTPUT_FILE L"index-benchmark.jsonl"
+
+// The index is saved here to be measured, and deleted afterwards
+#define INDEX_BENCHMARK_INDEX_FILE L"index-benchmark.idx"
+
+/// <summary>
+/// Measures the trigram index of a project folder: how fast it is built,
+/// how big it is on disk next to the text it indexes, how long it takes
+/// to save and load, and how long Find in Files takes with it compared
+/// to reading every file. Both searches run on one thread and report the
+/// files that matched, which have to be the same.
+/// </summary>
+namespace IndexBenchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszFolder, const wchar_t* lpszOutputPath);
+}
@@ -0,0 +1,235 @@
+#include "JournalBenchmark.h"
+#include "Benchmark.h"
+#include "EditJournal.h"
+#include "PieceTable.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+
+// Keystrokes typed at the same place before the caret moves somewhere else
+#define JOURNAL_BENCHMARK_BURST_LENGTH 100
+
+// Long enough for the journal to write the last records, and a checkpoint before them
+#define JOURNAL_BENCHMARK_FLUSH_WAIT_MS (JOURNAL_FLUSH_INTERVAL_MS * 8)
+
+// The writer kills itself with this, any other exit code means it failed
+#define JOURNAL_BENCHMARK_KILLED_EXIT_CODE 0x4A42
+
+static const wchar_t* g_Lines[] = {
+	L"#include \"EditJournal.h\"",
+	L"void EditJournal::OnDocumentEdit(const TextEdit& edit)",
+	L"{",
+	L"\tstd::lock_guard<std::mutex> lock(m_pFile->mutex);",
+	L"\tAppendNumber<uint32_t>(bytes, static_cast<uint32_t>(edit.position));",
+	L"}",
+	L"/* Only the length of the removed text is needed to replay the edit */",
+	L""
+};
+
+static void GenerateDocument(PieceTable& document)
+{
+	std::mt19937 random(0x4A42);
+	std::wstring text;
+
+	text.reserve(JOURNAL_BENCHMARK_DOCUMENT_SIZE + 128);
+
+	while (text.length() < JOURNAL_BENCHMARK_DOCUMENT_SIZE)
+	{
+		text += g_Lines[random() % (sizeof(g_Lines) / sizeof(g_Lines[0]))];
+		text.push_back(L'\r');
+	}
+
+	text.resize(JOURNAL_BENCHMARK_DOCUMENT_SIZE);
+	document.Load(std::move(text));
+}
+
+/// <summary>
+/// Typing in bursts at random places, with a backspace now and then. The
+/// writer and the recovery make the same keystrokes from the same seed.
+/// </summary>
+class Typist
+{
+private:
+	std::mt19937 m_Random;
+	size_t m_Caret = 0;
+	size_t m_Count = 0;
+
+public:
+	Typist(void)
+		: m_Random(0x4A42) {}
+
+	/* Makes the next keystroke on the document, the edit is returned for the journal */
+	TextEdit Type(PieceTable& document)
+	{
+		if (m_Count++ % JOURNAL_BENCHMARK_BURST_LENGTH == 0)
+		{
+			m_Caret = m_Random() % (document.GetLength() + 1);
+		}
+
+		TextEdit edit;
+
+		if (m_Caret > 0 && m_Random() % 8 == 0)
+		{
+			--m_Caret;
+			edit.position = m_Caret;
+			edit.removed.assign(1, document.GetCharAt(m_Caret));
+		}
+
+		else
+		{
+			edit.position = m_Caret++;
+			edit.inserted.assign(1, L"abcdefgh\r"[m_Random() % 9]);
+		}
+
+		document.Replace(edit.position, edit.removed.length(), edit.inserted.data(), edit.inserted.length());
+
+		return edit;
+	}
+};
+
+static std::wstring GetSourcePath(void)
+{
+	wchar_t lpszPath[MAX_PATH];
+	const DWORD dwLength = GetFullPathName(JOURNAL_BENCHMARK_FILE, MAX_PATH, lpszPath, nullptr);
+
+	return dwLength > 0 && dwLength < MAX_PATH ? lpszPath : JOURNAL_BENCHMARK_FILE;
+}
+
+/* Starts the writer and waits until it has been killed */
+static bool RunWriterProcess(const wchar_t* lpszOutputPath)
+{
+	wchar_t lpszExecutable[MAX_PATH];
+
+	if (GetModuleFileName(NULL, lpszExecutable, MAX_PATH) == 0)
+	{
+		return false;
+	}
+
+	std::wstring commandLine = std::wstring(L"\"") + lpszExecutable + L"\" " + JOURNAL_BENCHMARK_WRITER_ARGUMENT + L" \"" + lpszOutputPath + L"\"";
+
+	STARTUPINFO si = { sizeof(si) };
+	PROCESS_INFORMATION pi;
+
+	if (!CreateProcess(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi))
+	{
+		return false;
+	}
+
+	WaitForSingleObject(pi.hProcess, INFINITE);
+
+	DWORD dwExitCode = 0;
+	const bool hasBeenKilled = GetExitCodeProcess(pi.hProcess, &dwExitCode) && dwExitCode == JOURNAL_BENCHMARK_KILLED_EXIT_CODE;
+
+	CloseHandle(pi.hThread);
+	CloseHandle(pi.hProcess);
+
+	return hasBeenKilled;
+}
+
+bool JournalBenchmark::RunWriter(const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath, L"w");
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	PieceTable document;
+	GenerateDocument(document);
+
+	EditJournal journal(document);
+	journal.SetFilePath(GetSourcePath());
+	journal.Begin();
+
+	// The journal isn't a listener of the document, it's given each edit on its own so that only its part is timed
+	Typist typist;
+	Benchmark::Clock::duration total = Benchmark::Clock::duration::zero();
+	Benchmark::Clock::duration slowest = Benchmark::Clock::duration::zero();
+
+	for (size_t i = 0; i < JOURNAL_BENCHMARK_KEYSTROKES; ++i)
+	{
+		const TextEdit edit = typist.Type(document);
+
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+		journal.OnDocumentEdit(edit);
+		const Benchmark::Clock::duration elapsed = Benchmark::Clock::now() - start;
+
+		total += elapsed;
+		slowest = std::max(slowest, elapsed);
+	}
+
+	Sleep(JOURNAL_BENCHMARK_FLUSH_WAIT_MS);
+
+	const double averageMicroseconds = Benchmark::GetMicroseconds(total) / JOURNAL_BENCHMARK_KEYSTROKES;
+
+	fprintf(pOutput, "{\"operation\":\"keystroke\",\"keystrokes\":%llu,\"characters\":%llu,\"avg_us\":%.3f,\"max_us\":%.3f,"
+		             "\"target_us\":%.1f,\"within_target\":%s}\n",
+		    static_cast<unsigned long long>(JOURNAL_BENCHMARK_KEYSTROKES), static_cast<unsigned long long>(document.GetLength()),
+		    averageMicroseconds, Benchmark::GetMicroseconds(slowest), JOURNAL_BENCHMARK_KEYSTROKE_TARGET_US,
+		    averageMicroseconds < JOURNAL_BENCHMARK_KEYSTROKE_TARGET_US ? "true" : "false");
+
+	if (fclose(pOutput) != 0)
+	{
+		return false;
+	}
+
+	// Killed the way a crash would be, the journal is neither flushed nor closed nor deleted
+	TerminateProcess(GetCurrentProcess(), JOURNAL_BENCHMARK_KILLED_EXIT_CODE);
+
+	return true;
+}
+
+bool JournalBenchmark::Run(const wchar_t* lpszOutputPath)
+{
+	const std::wstring sourcePath = GetSourcePath();
+
+	// Left behind by a run that was stopped halfway
+	EditJournal::DiscardFile(sourcePath);
+
+	if (!RunWriterProcess(lpszOutputPath))
+	{
+		EditJournal::DiscardFile(sourcePath);
+		return false;
+	}
+
+	// After the line the writer wrote
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath, L"a");
+
+	if (pOutput == nullptr)
+	{
+		EditJournal::DiscardFile(sourcePath);
+		return false;
+	}
+
+	PieceTable expected;
+	GenerateDocument(expected);
+
+	Typist typist;
+
+	for (size_t i = 0; i < JOURNAL_BENCHMARK_KEYSTROKES; ++i)
+	{
+		typist.Type(expected);
+	}
+
+	RecoveredFile recovered;
+
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	const bool hasRecovered = EditJournal::RecoverFile(sourcePath, recovered);
+	const double recoveryMilliseconds = Benchmark::GetMicroseconds(Benchmark::Clock::now() - start) / 1000.0;
+
+	EditJournal::DiscardFile(sourcePath);
+
+	fprintf(pOutput, "{\"operation\":\"recover\",\"recovered\":%s,\"characters\":%llu,\"matches\":%s,\"recover_ms\":%.1f,"
+		             "\"target_ms\":%.1f,\"within_target\":%s}\n",
+		    hasRecovered ? "true" : "false", static_cast<unsigned long long>(recovered.text.length()),
+		    hasRecovered && recovered.path == sourcePath && recovered.text == expected.GetText() ? "true" : "false",
+		    recoveryMilliseconds, JOURNAL_BENCHMARK_RECOVERY_TARGET_MS,
+		    hasRecovered && recoveryMilliseconds < JOURNAL_BENCHMARK_RECOVERY_TARGET_MS ? "true" : "false");
+
+	return fclose(pOutput) == 0;
+}
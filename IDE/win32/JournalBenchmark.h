@@ -0,0 +1,45 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-journal
+#define JOURNAL_BENCHMARK_ARGUMENT L"--benchmark-journal"
+
+// The benchmark starts itself again with this to type into the document, that process is killed once it's done
+#define JOURNAL_BENCHMARK_WRITER_ARGUMENT L"--benchmark-journal-writer"
+
+// Written to the current directory, one line of JSON for the typing and one for the recovery
+#define JOURNAL_BENCHMARK_OUTPUT_FILE L"journal-benchmark.jsonl"
+
+// The document is journaled as if it was this file of the current directory, which is never written
+#define JOURNAL_BENCHMARK_FILE L"journal-benchmark.cpp"
+
+// Characters of the generated document
+#define JOURNAL_BENCHMARK_DOCUMENT_SIZE (10 * 1024 * 1024)
+
+// Keystrokes typed into the document, enough for the journal to start over from a new checkpoint once
+#define JOURNAL_BENCHMARK_KEYSTROKES 500000
+
+// The most journaling may add to a keystroke, and the longest a recovery may take
+#define JOURNAL_BENCHMARK_KEYSTROKE_TARGET_US 5.0
+#define JOURNAL_BENCHMARK_RECOVERY_TARGET_MS 1000.0
+
+/// <summary>
+/// Measures EditJournal the way it's used: a generated document of ten
+/// million characters is typed into by a second instance of the program,
+/// which times what the journal adds to every keystroke, waits for the
+/// records to reach the disk and is then killed, leaving its journal
+/// behind the way a crash would. The journal is then replayed and timed,
+/// and the text it gives back is compared with the same keystrokes typed
+/// into the document again. Each line of the output says whether its
+/// timing is within the target.
+/// </summary>
+namespace JournalBenchmark
+{
+	/// <returns> False if the writer failed or the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszOutputPath);
+
+	/// <summary>
+	/// Types into the journaled document and kills the process
+	/// </summary>
+	/// <returns> False if the output couldn't be written, it doesn't return otherwise </returns>
+	bool RunWriter(const wchar_t* lpszOutputPath);
+}
@@ -0,0 +1,284 @@
+#include "KeywordTable.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cwchar>
+#include <cstring>
+
+// Seeds tried for a bucket before starting over with another first hash
+#define MAX_SEED_ATTEMPTS 100000
+
+/* FNV-1a of the characters followed by a finalizer, so that every seed gives an unrelated hash */
+uint32_t KeywordTable::Hash(const wchar_t* pWord, size_t length, uint32_t seed)
+{
+	uint32_t hash = ::Hash::Fnv1a32(pWord, length, FNV1A_32_OFFSET_BASIS ^ seed);
+
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/// <summary>
+/// Hash and displace: the keywords are split into buckets by the first
+/// hash, then starting from the fullest bucket, each one looks for a seed
+/// that sends all of its keywords to slots that are still free
+/// </summary>
+/// <returns> False if a bucket found no seed, the caller then tries another first hash </returns>
+bool KeywordTable::TryPlaceKeywords(const std::vector<std::pair<std::wstring, uint32_t>>& keywords)
+{
+	const size_t count = keywords.size();
+
+	std::vector<std::vector<size_t>> buckets(count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const std::wstring& keyword = keywords[i].first;
+		buckets[Hash(keyword.c_str(), keyword.length(), m_Header.bucketSeed) % count].push_back(i);
+	}
+
+	std::vector<size_t> order(count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) {
+		return buckets[a].size() > buckets[b].size();
+	});
+
+	// Keyword that ended up in each slot
+	std::vector<size_t> placed(count, SIZE_MAX);
+	std::vector<size_t> slots;
+
+	m_Seeds.assign(count, 0);
+
+	for (size_t bucket : order)
+	{
+		const std::vector<size_t>& members = buckets[bucket];
+
+		if (members.empty())
+		{
+			break;
+		}
+
+		uint32_t seed = 1;
+
+		for (; seed <= MAX_SEED_ATTEMPTS; ++seed)
+		{
+			slots.clear();
+
+			for (size_t member : members)
+			{
+				const std::wstring& keyword = keywords[member].first;
+				const size_t slot = Hash(keyword.c_str(), keyword.length(), seed) % count;
+
+				if (placed[slot] != SIZE_MAX || std::find(slots.begin(), slots.end(), slot) != slots.end())
+				{
+					break;
+				}
+
+				slots.push_back(slot);
+			}
+
+			if (slots.size() == members.size())
+			{
+				break;
+			}
+		}
+
+		if (seed > MAX_SEED_ATTEMPTS)
+		{
+			return false;
+		}
+
+		m_Seeds[bucket] = seed;
+
+		for (size_t i = 0; i < members.size(); ++i)
+		{
+			placed[slots[i]] = members[i];
+		}
+	}
+
+	m_Entries.resize(count);
+	m_Text.clear();
+
+	for (size_t slot = 0; slot < count; ++slot)
+	{
+		const std::pair<std::wstring, uint32_t>& keyword = keywords[placed[slot]];
+
+		m_Entries[slot].offset = static_cast<uint32_t>(m_Text.length());
+		m_Entries[slot].length = static_cast<uint32_t>(keyword.first.length());
+		m_Entries[slot].value = keyword.second;
+
+		m_Text.append(keyword.first);
+	}
+
+	return true;
+}
+
+void KeywordTable::Build(const std::vector<std::pair<std::wstring, uint32_t>>& keywords)
+{
+	std::vector<std::pair<std::wstring, uint32_t>> unique;
+	std::unordered_map<std::wstring, size_t> indices;
+
+	for (const std::pair<std::wstring, uint32_t>& keyword : keywords)
+	{
+		if (keyword.first.empty())
+		{
+			continue;
+		}
+
+		auto found = indices.find(keyword.first);
+
+		if (found != indices.end())
+		{
+			unique[found->second].second = keyword.second;
+			continue;
+		}
+
+		indices[keyword.first] = unique.size();
+		unique.push_back(keyword);
+	}
+
+	Clear();
+
+	if (unique.empty())
+	{
+		return;
+	}
+
+	m_Header.count = static_cast<uint32_t>(unique.size());
+	m_Header.minLength = UINT32_MAX;
+
+	for (const std::pair<std::wstring, uint32_t>& keyword : unique)
+	{
+		const size_t length = keyword.first.length();
+		const wchar_t first = keyword.first[0];
+
+		m_Header.minLength = std::min(m_Header.minLength, static_cast<uint32_t>(length));
+		m_Header.maxLength = std::max(m_Header.maxLength, static_cast<uint32_t>(length));
+		m_Header.lengthMask |= 1ULL << std::min<size_t>(length, 63);
+
+		if (first < 128)
+		{
+			m_Header.firstCharMask[first >> 6] |= 1ULL << (first & 63);
+		}
+
+		else
+		{
+			m_Header.hasNonAsciiFirstChar = 1;
+		}
+	}
+
+	for (m_Header.bucketSeed = 0; !TryPlaceKeywords(unique); ++m_Header.bucketSeed);
+
+	m_Header.textLength = static_cast<uint32_t>(m_Text.length());
+
+	m_pSeeds = m_Seeds.data();
+	m_pEntries = m_Entries.data();
+	m_pText = m_Text.c_str();
+}
+
+void KeywordTable::Serialize(std::vector<char>& data) const
+{
+	const auto append = [&data](const void* pData, size_t size) {
+		data.insert(data.end(), static_cast<const char*>(pData), static_cast<const char*>(pData) + size);
+	};
+
+	append(&m_Header, sizeof(m_Header));
+	append(m_pSeeds, m_Header.count * sizeof(uint32_t));
+	append(m_pEntries, m_Header.count * sizeof(Entry));
+	append(m_pText, m_Header.textLength * sizeof(wchar_t));
+}
+
+bool KeywordTable::Attach(const char* pData, size_t size)
+{
+	Clear();
+
+	Header header;
+
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+
+	memcpy(&header, pData, sizeof(header));
+
+	const size_t seedsSize = header.count * sizeof(uint32_t);
+	const size_t entriesSize = header.count * sizeof(Entry);
+	const size_t textSize = header.textLength * sizeof(wchar_t);
+
+	if (size != sizeof(header) + seedsSize + entriesSize + textSize || header.minLength > header.maxLength)
+	{
+		return false;
+	}
+
+	const Entry* pEntries = reinterpret_cast<const Entry*>(pData + sizeof(header) + seedsSize);
+
+	// A damaged table must not send a lookup out of bounds
+	for (uint32_t i = 0; i < header.count; ++i)
+	{
+		if (pEntries[i].offset > header.textLength || pEntries[i].length > header.textLength - pEntries[i].offset)
+		{
+			return false;
+		}
+	}
+
+	m_Header = header;
+	m_pSeeds = reinterpret_cast<const uint32_t*>(pData + sizeof(header));
+	m_pEntries = pEntries;
+	m_pText = reinterpret_cast<const wchar_t*>(pData + sizeof(header) + seedsSize + entriesSize);
+
+	return true;
+}
+
+void KeywordTable::Clear(void)
+{
+	m_Header = Header();
+	m_pSeeds = nullptr;
+	m_pEntries = nullptr;
+	m_pText = nullptr;
+
+	m_Seeds.clear();
+	m_Entries.clear();
+	m_Text.clear();
+}
+
+bool KeywordTable::Find(const wchar_t* pWord, size_t length, uint32_t& value) const
+{
+	if (length < m_Header.minLength || length > m_Header.maxLength || m_Header.count == 0)
+	{
+		return false;
+	}
+
+	if ((m_Header.lengthMask & (1ULL << std::min<size_t>(length, 63))) == 0)
+	{
+		return false;
+	}
+
+	const wchar_t first = pWord[0];
+
+	if (first < 128 ? (m_Header.firstCharMask[first >> 6] & (1ULL << (first & 63))) == 0 : m_Header.hasNonAsciiFirstChar == 0)
+	{
+		return false;
+	}
+
+	const uint32_t count = m_Header.count;
+	const uint32_t seed = m_pSeeds[Hash(pWord, length, m_Header.bucketSeed) % count];
+	const Entry& entry = m_pEntries[Hash(pWord, length, seed) % count];
+
+	if (entry.length != length || wmemcmp(m_pText + entry.offset, pWord, length) != 0)
+	{
+		return false;
+	}
+
+	value = entry.value;
+
+	return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary>
+/// Read only set of keywords, each with a value, looked up with a minimal
+/// perfect hash: every keyword gets a slot of its own, so a lookup hashes
+/// the word twice and compares it against a single keyword at most. Most
+/// words are turned away before that by the length and first character
+/// filters. Lookups take the word as a pointer and a length, so a token
+/// can be looked up in place without copying it.
+/// The table is flat, so it can be written out as is and used straight
+/// from a memory mapped file later on.
+/// </summary>
+class KeywordTable
+{
+private:
+	/* Laid out the same in memory and in a serialized table */
+	struct Header {
+		uint32_t count = 0;
+		uint32_t bucketSeed = 0;
+		uint32_t minLength = 0;
+		uint32_t maxLength = 0;
+
+		// Bit n is set if a keyword is n characters long (lengths past 63 share bit 63)
+		uint64_t lengthMask = 0;
+
+		// Bit c is set if a keyword starts with the ASCII character c
+		uint64_t firstCharMask[2] = { 0, 0 };
+		uint32_t hasNonAsciiFirstChar = 0;
+
+		// Characters of all the keywords put together
+		uint32_t textLength = 0;
+	};
+
+	struct Entry {
+		uint32_t offset;
+		uint32_t length;
+		uint32_t value;
+	};
+
+	Header m_Header;
+
+	// Either point into the vectors below or into memory the table was attached to
+	const uint32_t* m_pSeeds = nullptr;
+	const Entry* m_pEntries = nullptr;
+	const wchar_t* m_pText = nullptr;
+
+	// Seed of the second hash for each bucket of the first one
+	std::vector<uint32_t> m_Seeds;
+
+	// Indexed by the final hash, holds every keyword exactly once
+	std::vector<Entry> m_Entries;
+	std::wstring m_Text;
+
+	static uint32_t Hash(const wchar_t* pWord, size_t length, uint32_t seed);
+	bool TryPlaceKeywords(const std::vector<std::pair<std::wstring, uint32_t>>& keywords);
+
+public:
+	KeywordTable(void) = default;
+
+	// The pointers would point into the other table
+	KeywordTable(const KeywordTable&) = delete;
+	KeywordTable& operator=(const KeywordTable&) = delete;
+
+	/// <summary>
+	/// Builds the table from scratch, a keyword that appears more than
+	/// once keeps its last value
+	/// </summary>
+	void Build(const std::vector<std::pair<std::wstring, uint32_t>>& keywords);
+
+	/* Appends the table to 'data' in the format Attach takes */
+	void Serialize(std::vector<char>& data) const;
+
+	/// <summary>
+	/// Uses a serialized table without copying it, the memory has to stay
+	/// valid and unchanged for as long as the table is used. 'pData' has to
+	/// be aligned to 8 bytes.
+	/// </summary>
+	/// <returns> False if the data isn't a valid table, which leaves the table empty </returns>
+	bool Attach(const char* pData, size_t size);
+
+	void Clear(void);
+
+	/// <returns> Whether the word is a keyword, its value is then written to 'value' </returns>
+	bool Find(const wchar_t* pWord, size_t length, uint32_t& value) const;
+
+	size_t GetCount(void) const { return m_Header.count; }
+	size_t GetMaxLength(void) const { return m_Header.maxLength; }
+};
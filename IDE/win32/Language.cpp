@@ -0,0 +1,168 @@
+#include "Language.h"
+#include "Utility.h"
+
+#include <cwctype>
+
+/* What the registry knows about a language before loading it */
+struct LanguageDefinition {
+	const wchar_t* lpszName;
+
+	// Lower case and separated by semicolons, e.g. ".c;.h"
+	const wchar_t* lpszExtensions;
+
+	// Keyword colors, found next to the executable. nullptr if there are none
+	const wchar_t* lpszKeywordFile;
+
+	LexerRules (*pGetRules)(void);
+};
+
+static LexerRules GetCRules(void)
+{
+	LexerRules rules;
+	rules.lpszLineComment = L"//";
+	rules.lpszBlockCommentStart = L"/*";
+	rules.lpszBlockCommentEnd = L"*/";
+	rules.hasDoubleQuotedStrings = true;
+	rules.hasCharacters = true;
+	rules.hasNumbers = true;
+	rules.hasDirectives = true;
+	rules.doLineCommentsContinue = true;
+
+	return rules;
+}
+
+static LexerRules GetJavaScriptRules(void)
+{
+	LexerRules rules;
+	rules.lpszLineComment = L"//";
+	rules.lpszBlockCommentStart = L"/*";
+	rules.lpszBlockCommentEnd = L"*/";
+	rules.hasDoubleQuotedStrings = true;
+	rules.hasSingleQuotedStrings = true;
+	rules.hasNumbers = true;
+
+	return rules;
+}
+
+static LexerRules GetPythonRules(void)
+{
+	LexerRules rules;
+	rules.lpszLineComment = L"#";
+	rules.hasDoubleQuotedStrings = true;
+	rules.hasSingleQuotedStrings = true;
+	rules.hasNumbers = true;
+
+	return rules;
+}
+
+static LexerRules GetJsonRules(void)
+{
+	LexerRules rules;
+	rules.hasDoubleQuotedStrings = true;
+	rules.hasNumbers = true;
+
+	return rules;
+}
+
+/* Quotes and digits are everywhere in prose, only the HTML comments are told apart */
+static LexerRules GetMarkdownRules(void)
+{
+	LexerRules rules;
+	rules.lpszBlockCommentStart = L"<!--";
+	rules.lpszBlockCommentEnd = L"-->";
+
+	return rules;
+}
+
+static LexerRules GetPlainTextRules(void)
+{
+	return LexerRules();
+}
+
+static const LanguageDefinition g_Definitions[] = {
+	{ L"C/C++",      L".c;.h;.cpp;.hpp;.cc;.hh;.cxx;.hxx;.inl", L"keywords.color",   GetCRules },
+	{ L"JavaScript", L".js;.mjs;.cjs",                          L"javascript.color", GetJavaScriptRules },
+	{ L"Python",     L".py;.pyw",                               L"python.color",     GetPythonRules },
+	{ L"JSON",       L".json",                                  L"json.color",       GetJsonRules },
+	{ L"Markdown",   L".md;.markdown",                          nullptr,             GetMarkdownRules }
+};
+
+#define LANGUAGE_COUNT (sizeof(g_Definitions) / sizeof(g_Definitions[0]))
+
+// Loaded the first time a file needs them, and kept until the program exits
+static Language* g_pLanguages[LANGUAGE_COUNT] = {};
+static Language* g_pPlainText = nullptr;
+
+static bool HasExtension(const wchar_t* lpszExtensions, const std::wstring& extension)
+{
+	const size_t length = extension.length();
+
+	for (const wchar_t* pStart = lpszExtensions; *pStart != L'\0';)
+	{
+		const wchar_t* pEnd = wcschr(pStart, L';');
+
+		if (pEnd == nullptr)
+		{
+			pEnd = pStart + lstrlen(pStart);
+		}
+
+		if (static_cast<size_t>(pEnd - pStart) == length && extension.compare(0, length, pStart, length) == 0)
+		{
+			return true;
+		}
+
+		pStart = *pEnd == L';' ? pEnd + 1 : pEnd;
+	}
+
+	return false;
+}
+
+const Language* LanguageRegistry::GetLanguageOfFile(const wchar_t* lpszFileName)
+{
+	std::wstring extension = Utility::GetFileExtension(lpszFileName);
+
+	for (wchar_t& ch : extension)
+	{
+		ch = towlower(ch);
+	}
+
+	for (size_t i = 0; i < LANGUAGE_COUNT && !extension.empty(); ++i)
+	{
+		const LanguageDefinition& definition = g_Definitions[i];
+
+		if (!HasExtension(definition.lpszExtensions, extension))
+		{
+			continue;
+		}
+
+		if (g_pLanguages[i] == nullptr)
+		{
+			Language* pLanguage = new Language;
+			pLanguage->lpszName = definition.lpszName;
+			pLanguage->rules = definition.pGetRules();
+
+			if (definition.lpszKeywordFile != nullptr)
+			{
+				pLanguage->keywords.ParseFile(definition.lpszKeywordFile);
+			}
+
+			g_pLanguages[i] = pLanguage;
+		}
+
+		return g_pLanguages[i];
+	}
+
+	return GetPlainText();
+}
+
+const Language* LanguageRegistry::GetPlainText(void)
+{
+	if (g_pPlainText == nullptr)
+	{
+		g_pPlainText = new Language;
+		g_pPlainText->lpszName = L"Plain Text";
+		g_pPlainText->rules = GetPlainTextRules();
+	}
+
+	return g_pPlainText;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Lexer.h"
+#include "ColorFormatParser.h"
+
+#include <string>
+
+/// <summary>
+/// Everything needed to highlight the files of a language. A language is
+/// loaded once and never changes afterwards, so every tab showing a file
+/// of that language shares it, background passes included.
+/// </summary>
+struct Language {
+	const wchar_t* lpszName = nullptr;
+
+	LexerRules rules;
+
+	// Empty if the language has no keyword file
+	ColorFormatParser keywords;
+};
+
+namespace LanguageRegistry
+{
+	/// <summary>
+	/// Finds the language of a file by its extension, loading it if it's
+	/// the first file of that language. Only the UI thread may call it.
+	/// </summary>
+	/// <param name="lpszFileName"> Path or name of the file </param>
+	/// <returns> The language, plain text if the extension isn't known. Never null </returns>
+	const Language* GetLanguageOfFile(const wchar_t* lpszFileName);
+
+	/* Text that has no highlighting at all */
+	const Language* GetPlainText(void);
+}
@@ -0,0 +1,252 @@
+#include "LargeFileBenchmark.h"
+#include "Benchmark.h"
+#include "LargeFileView.h"
+
+#include <Windows.h>
+#include <Psapi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#define MEGABYTE (1024ULL * 1024)
+
+// Bytes written to a generated file at a time
+#define LARGE_FILE_BENCHMARK_WRITE_SIZE (1024 * 1024)
+
+// How often the view is asked whether the thread has counted every line
+#define LARGE_FILE_BENCHMARK_POLL_MS 10
+
+/* A file to generate, the lines of a log or a single line without any break */
+struct FileCase {
+	const char* lpszName;
+	unsigned long long size;
+	bool hasLineBreaks;
+};
+
+static const FileCase g_FileCases[] = {
+	{ "log",         128 * MEGABYTE,  true },
+	{ "log",         512 * MEGABYTE,  true },
+	{ "log",         2048 * MEGABYTE, true },
+	{ "log",         4096 * MEGABYTE, true },
+	{ "single_line", 512 * MEGABYTE,  false }
+};
+
+/* What viewing one file cost */
+struct FileResult {
+	double openMilliseconds = 0;
+	Benchmark::OperationResult jump;
+	Benchmark::OperationResult scroll;
+	double countMilliseconds = 0;
+	unsigned long long lastLine = 0;
+	unsigned long long expectedLastLine = 0;
+	size_t estimatedJumpCount = 0;
+	double maxEstimateErrorPercent = 0;
+	size_t workingSetBytes = 0;
+};
+
+static PROCESS_MEMORY_COUNTERS GetMemoryCounters(void)
+{
+	PROCESS_MEMORY_COUNTERS pmc = {};
+	pmc.cb = sizeof(pmc);
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+
+	return pmc;
+}
+
+/// <summary>
+/// Writes the file a block at a time, so that generating it doesn't take
+/// more memory than viewing it
+/// </summary>
+/// <param name="lastLine"> Receives the (zero based) number of the line of the last byte </param>
+static bool GenerateFile(const FileCase& fileCase, unsigned long long& lastLine)
+{
+	FILE* pFile = nullptr;
+
+	if (_wfopen_s(&pFile, LARGE_FILE_BENCHMARK_FILE, L"wb") != 0 || pFile == nullptr)
+	{
+		return false;
+	}
+
+	std::mt19937 random(0x4C46);
+	std::string block;
+	unsigned long long written = 0;
+	unsigned long long lineBreaks = 0;
+	bool succeeded = true;
+
+	while (succeeded && written < fileCase.size)
+	{
+		block.clear();
+
+		while (block.size() < LARGE_FILE_BENCHMARK_WRITE_SIZE)
+		{
+			if (fileCase.hasLineBreaks)
+			{
+				block += "2026-10-18 12:00:00.000 INFO Handled request ";
+				block += std::to_string(random());
+				block.append(random() % 120, 'x');
+				block.push_back('\n');
+			}
+
+			else
+			{
+				block.append(LARGE_FILE_BENCHMARK_WRITE_SIZE, 'x');
+			}
+		}
+
+		const size_t length = static_cast<size_t>(std::min<unsigned long long>(block.size(), fileCase.size - written));
+
+		lineBreaks += std::count(block.begin(), block.begin() + length, '\n');
+		succeeded = fwrite(block.data(), 1, length, pFile) == length;
+		written += length;
+
+		// The line break at the end of the file belongs to the last line
+		if (written == fileCase.size && length > 0 && block[length - 1] == '\n')
+		{
+			--lineBreaks;
+		}
+	}
+
+	lastLine = lineBreaks;
+
+	return fclose(pFile) == 0 && succeeded;
+}
+
+static bool MeasureFile(LargeFileView& view, FileResult& result)
+{
+	size_t workingSet = GetMemoryCounters().WorkingSetSize;
+
+	const auto sampleWorkingSet = [&]() {
+		workingSet = std::max(workingSet, GetMemoryCounters().WorkingSetSize);
+	};
+
+	const Benchmark::Clock::time_point openStart = Benchmark::Clock::now();
+
+	if (!view.Open(LARGE_FILE_BENCHMARK_FILE, nullptr))
+	{
+		return false;
+	}
+
+	view.GetLines(LARGE_FILE_BENCHMARK_VISIBLE_LINES);
+	result.openMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - openStart);
+	sampleWorkingSet();
+
+	// The jumps start right after opening, while the thread is still counting
+	std::mt19937 random(0x4C46);
+	std::vector<double> positions(LARGE_FILE_BENCHMARK_JUMPS);
+	std::vector<std::pair<double, unsigned long long>> estimates;
+
+	for (double& position : positions)
+	{
+		position = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+	}
+
+	result.jump = Benchmark::MeasureOperation(positions.size(), [&](size_t i) {
+		view.ScrollToPosition(positions[i]);
+		view.GetLines(LARGE_FILE_BENCHMARK_VISIBLE_LINES);
+	}, [&](size_t i) {
+		sampleWorkingSet();
+
+		if (view.IsTopLineEstimated())
+		{
+			estimates.push_back(std::make_pair(positions[i], view.GetTopLine()));
+		}
+	});
+
+	// A screen at a time, down from the middle of the file
+	view.ScrollToPosition(0.5);
+
+	result.scroll = Benchmark::MeasureOperation(LARGE_FILE_BENCHMARK_JUMPS, [&](size_t) {
+		view.ScrollLines(LARGE_FILE_BENCHMARK_VISIBLE_LINES);
+		view.GetLines(LARGE_FILE_BENCHMARK_VISIBLE_LINES);
+	}, [&](size_t) {
+		sampleWorkingSet();
+	});
+
+	// The number of the last line is only exact once every line before it has been counted
+	view.ScrollToPosition(1.0);
+
+	while (view.IsTopLineEstimated())
+	{
+		Sleep(LARGE_FILE_BENCHMARK_POLL_MS);
+		view.UpdateTopLine();
+		sampleWorkingSet();
+	}
+
+	result.countMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - openStart);
+	result.lastLine = view.GetTopLine();
+
+	// Every line has been counted, so the same jumps now give the real numbers
+	result.estimatedJumpCount = estimates.size();
+
+	for (const auto& estimate : estimates)
+	{
+		view.ScrollToPosition(estimate.first);
+
+		const double line = static_cast<double>(view.GetTopLine());
+		const double error = std::abs(static_cast<double>(estimate.second) - line) * 100.0 / std::max(line, 1.0);
+
+		result.maxEstimateErrorPercent = std::max(result.maxEstimateErrorPercent, error);
+	}
+
+	result.workingSetBytes = workingSet;
+	view.Close();
+
+	return true;
+}
+
+bool LargeFileBenchmark::Run(const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	LargeFileView view;
+	size_t minWorkingSet = SIZE_MAX;
+	size_t maxWorkingSet = 0;
+
+	for (const FileCase& fileCase : g_FileCases)
+	{
+		FileResult result;
+
+		const bool hasSucceeded = GenerateFile(fileCase, result.expectedLastLine) && MeasureFile(view, result);
+
+		DeleteFile(LARGE_FILE_BENCHMARK_FILE);
+
+		if (!hasSucceeded)
+		{
+			fprintf(pOutput, "{\"file\":\"%s\",\"bytes\":%llu,\"error\":\"the file couldn't be generated or opened\"}\n", fileCase.lpszName, fileCase.size);
+			fflush(pOutput);
+			continue;
+		}
+
+		// A single line decodes as much as the view ever does, it's only compared with the other logs
+		if (fileCase.hasLineBreaks)
+		{
+			minWorkingSet = std::min(minWorkingSet, result.workingSetBytes);
+			maxWorkingSet = std::max(maxWorkingSet, result.workingSetBytes);
+		}
+
+		fprintf(pOutput, "{\"file\":\"%s\",\"bytes\":%llu,\"open_ms\":%.3f,", fileCase.lpszName, fileCase.size, result.openMilliseconds);
+		Benchmark::WriteResult(pOutput, "jump_", result.jump);
+		fprintf(pOutput, ",");
+		Benchmark::WriteResult(pOutput, "scroll_", result.scroll);
+		fprintf(pOutput, ",\"count_ms\":%.1f,\"last_line\":%llu,\"lines_match\":%s,\"estimated_jumps\":%llu,\"max_estimate_error_pct\":%.2f,\"working_set_mb\":%.1f}\n",
+			    result.countMilliseconds, result.lastLine, result.lastLine == result.expectedLastLine ? "true" : "false",
+			    static_cast<unsigned long long>(result.estimatedJumpCount), result.maxEstimateErrorPercent, result.workingSetBytes / BYTES_PER_MEGABYTE);
+		fflush(pOutput);
+	}
+
+	// Flat means the biggest log took about as much memory as the smallest one
+	fprintf(pOutput, "{\"peak_working_set_mb\":%.1f,\"log_working_set_spread_mb\":%.1f}\n",
+		    GetMemoryCounters().PeakWorkingSetSize / BYTES_PER_MEGABYTE,
+		    maxWorkingSet >= minWorkingSet ? (maxWorkingSet - minWorkingSet) / BYTES_PER_MEGABYTE : 0.0);
+
+	return fclose(pOutput) == 0;
+}
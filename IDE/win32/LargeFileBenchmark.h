@@ -0,0 +1,32 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-large-file
+#define LARGE_FILE_BENCHMARK_ARGUMENT L"--benchmark-large-file"
+
+// Written to the current directory, one line of JSON per file and one for the whole run
+#define LARGE_FILE_BENCHMARK_OUTPUT_FILE L"large-file-benchmark.jsonl"
+
+// The files are generated here one at a time, and deleted afterwards
+#define LARGE_FILE_BENCHMARK_FILE L"large-file-benchmark.tmp"
+
+// Jumps to random places of each file, the way dragging the scroll bar does
+#define LARGE_FILE_BENCHMARK_JUMPS 200
+
+// Lines decoded for every jump and scroll, about a screen
+#define LARGE_FILE_BENCHMARK_VISIBLE_LINES 60
+
+/// <summary>
+/// Measures LargeFileView on generated log files that get bigger and
+/// bigger, up to a few gigabytes, and on one that is a single line. Each
+/// file is opened, jumped around in and scrolled through a screen at a
+/// time, then the view waits for the thread to count every line and
+/// checks the number of the last line. The line numbers estimated before
+/// the count got there are compared with the real ones. The working set
+/// is sampled after every call, its peak has to stay the same however big
+/// the log is, and the peak of the whole process is written at the end.
+/// </summary>
+namespace LargeFileBenchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszOutputPath);
+}
@@ -0,0 +1,378 @@
+#include "LargeFileView.h"
+#include "Utf8Decoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define SCAN_CHUNK_SIZE 65536
+#define LINE_COUNT_BLOCK_SIZE (1024 * 1024)
+
+// Bytes before a position whose line breaks are counted to estimate its line number
+#define LINE_SAMPLE_SIZE (256 * 1024)
+
+// A single line longer than this is cut, the control can't display it anyway
+#define MAX_DECODED_BYTES (4 * 1024 * 1024)
+
+// Looking for the end of a line gives up after this many bytes, and the
+// line is moved through in pieces of this size instead
+#define MAX_LINE_SCAN_BYTES MAX_DECODED_BYTES
+
+static unsigned long long CountLineBreaks(MappedFile& file, unsigned long long offset, unsigned long long length)
+{
+	unsigned long long count = 0;
+	const unsigned long long end = std::min(offset + length, file.GetSize());
+
+	while (offset < end)
+	{
+		const size_t chunk = static_cast<size_t>(std::min<unsigned long long>(SCAN_CHUNK_SIZE, end - offset));
+		const char* pData = file.GetView(offset, chunk);
+
+		if (pData == nullptr)
+		{
+			break;
+		}
+
+		count += std::count(pData, pData + chunk, '\n');
+		offset += chunk;
+	}
+
+	return count;
+}
+
+LargeFileView::LargeFileView(void)
+	: m_CountedBlocks(0), m_IsClosing(false)
+{
+}
+
+LargeFileView::~LargeFileView(void)
+{
+	Close();
+}
+
+bool LargeFileView::Open(const wchar_t* lpszPath, HWND hWndNotify)
+{
+	Close();
+
+	m_TopOffset = 0;
+	m_TopLine = 0;
+	m_IsTopLineEstimated = false;
+
+	if (!m_File.Open(lpszPath))
+	{
+		return false;
+	}
+
+	m_LinesBeforeBlock.assign(static_cast<size_t>(m_File.GetSize() / LINE_COUNT_BLOCK_SIZE) + 1, 0);
+	m_CountedBlocks = 0;
+	m_IsClosing = false;
+	m_CountThread = std::thread(&LargeFileView::CountLines, this, std::wstring(lpszPath), hWndNotify);
+
+	return true;
+}
+
+void LargeFileView::Close(void)
+{
+	// It stops after the block it's counting
+	m_IsClosing = true;
+
+	if (m_CountThread.joinable())
+	{
+		m_CountThread.join();
+	}
+
+	m_File.Close();
+	m_LinesBeforeBlock.clear();
+}
+
+/// <summary>
+/// Counts the line breaks of every block but the last one, from the start
+/// of the file. The file is mapped again, the view of the other mapping
+/// moves with the view of the file.
+/// </summary>
+void LargeFileView::CountLines(std::wstring path, HWND hWndNotify)
+{
+	MappedFile file;
+
+	if (!file.Open(path.c_str()))
+	{
+		return;
+	}
+
+	for (size_t block = 0; block + 1 < m_LinesBeforeBlock.size(); ++block)
+	{
+		if (m_IsClosing)
+		{
+			return;
+		}
+
+		m_LinesBeforeBlock[block + 1] = m_LinesBeforeBlock[block] +
+			CountLineBreaks(file, static_cast<unsigned long long>(block) * LINE_COUNT_BLOCK_SIZE, LINE_COUNT_BLOCK_SIZE);
+
+		m_CountedBlocks.store(block + 1, std::memory_order_release);
+	}
+
+	if (hWndNotify != nullptr)
+	{
+		PostMessage(hWndNotify, WM_LINE_COUNT_READY, NULL, NULL);
+	}
+}
+
+/* Whether the byte at the offset is the first of a line, and not part of a line too long to scan */
+bool LargeFileView::IsLineStart(unsigned long long offset)
+{
+	if (offset == 0)
+	{
+		return true;
+	}
+
+	const char* pData = m_File.GetView(offset - 1, 1);
+
+	return pData != nullptr && *pData == '\n';
+}
+
+/// <summary>
+/// Scans backwards for the line break that comes before the offset, for
+/// at most MAX_LINE_SCAN_BYTES
+/// </summary>
+/// <returns> Offset of the first byte of the line that contains 'offset',
+/// or of where the scan gave up </returns>
+unsigned long long LargeFileView::FindLineStart(unsigned long long offset)
+{
+	const unsigned long long limit = offset > MAX_LINE_SCAN_BYTES ? offset - MAX_LINE_SCAN_BYTES : 0;
+
+	while (offset > limit)
+	{
+		const unsigned long long start = std::max<unsigned long long>(offset > SCAN_CHUNK_SIZE ? offset - SCAN_CHUNK_SIZE : 0, limit);
+		const size_t length = static_cast<size_t>(offset - start);
+		const char* pData = m_File.GetView(start, length);
+
+		if (pData == nullptr)
+		{
+			return limit;
+		}
+
+		for (size_t i = length; i > 0; --i)
+		{
+			if (pData[i - 1] == '\n')
+			{
+				return start + i;
+			}
+		}
+
+		offset = start;
+	}
+
+	return limit;
+}
+
+/// <returns> Offset of the first byte after the next line break, of where the scan gave up
+/// after MAX_LINE_SCAN_BYTES, or the file size if there is none </returns>
+unsigned long long LargeFileView::FindNextLineStart(unsigned long long offset)
+{
+	const unsigned long long size = m_File.GetSize();
+	const unsigned long long limit = std::min(size, offset + MAX_LINE_SCAN_BYTES);
+
+	while (offset < limit)
+	{
+		const size_t length = static_cast<size_t>(std::min<unsigned long long>(SCAN_CHUNK_SIZE, limit - offset));
+		const char* pData = m_File.GetView(offset, length);
+
+		if (pData == nullptr)
+		{
+			return size;
+		}
+
+		const void* pFound = memchr(pData, '\n', length);
+
+		if (pFound != nullptr)
+		{
+			return offset + (static_cast<const char*>(pFound) - pData) + 1;
+		}
+
+		offset += length;
+	}
+
+	return limit;
+}
+
+/// <summary>
+/// Line number of a byte of the file. It's exact once the thread has counted
+/// the blocks before it, until then it's estimated from how many line breaks
+/// there are in the bytes right before it, or in the blocks counted so far
+/// if there are more of them. Either way only a bounded number of bytes is read.
+/// </summary>
+unsigned long long LargeFileView::CountLinesBefore(unsigned long long offset, bool& isEstimated)
+{
+	const size_t block = static_cast<size_t>(offset / LINE_COUNT_BLOCK_SIZE);
+	const size_t counted = m_CountedBlocks.load(std::memory_order_acquire);
+
+	if (block <= counted)
+	{
+		const unsigned long long block_start = static_cast<unsigned long long>(block) * LINE_COUNT_BLOCK_SIZE;
+
+		isEstimated = false;
+		return m_LinesBeforeBlock[block] + CountLineBreaks(m_File, block_start, offset - block_start);
+	}
+
+	const unsigned long long counted_bytes = static_cast<unsigned long long>(counted) * LINE_COUNT_BLOCK_SIZE;
+	double lines_per_byte = 0.0;
+
+	if (counted_bytes >= LINE_SAMPLE_SIZE)
+	{
+		lines_per_byte = static_cast<double>(m_LinesBeforeBlock[counted]) / counted_bytes;
+	}
+
+	else
+	{
+		// The offset is past the first block, so there's always a whole sample before it
+		lines_per_byte = static_cast<double>(CountLineBreaks(m_File, offset - LINE_SAMPLE_SIZE, LINE_SAMPLE_SIZE)) / LINE_SAMPLE_SIZE;
+	}
+
+	isEstimated = true;
+	return m_LinesBeforeBlock[counted] + static_cast<unsigned long long>((offset - counted_bytes) * lines_per_byte);
+}
+
+bool LargeFileView::UpdateTopLine(void)
+{
+	if (!m_IsTopLineEstimated || !m_File.IsOpen())
+	{
+		return false;
+	}
+
+	const unsigned long long line = CountLinesBefore(m_TopOffset, m_IsTopLineEstimated);
+	const bool changed = line != m_TopLine;
+
+	m_TopLine = line;
+
+	return changed;
+}
+
+double LargeFileView::GetPosition(void) const
+{
+	if (m_File.GetSize() == 0)
+	{
+		return 0.0;
+	}
+
+	return static_cast<double>(m_TopOffset) / m_File.GetSize();
+}
+
+bool LargeFileView::ScrollLines(long long lines)
+{
+	bool moved = false;
+
+	for (; lines > 0; --lines)
+	{
+		const unsigned long long next = FindNextLineStart(m_TopOffset);
+
+		// Don't scroll past the start of the last line
+		if (next >= m_File.GetSize())
+		{
+			break;
+		}
+
+		// A line too long to scan is moved through in pieces, all of them on the same line
+		if (IsLineStart(next))
+		{
+			++m_TopLine;
+		}
+
+		m_TopOffset = next;
+		moved = true;
+	}
+
+	for (; lines < 0 && m_TopOffset > 0; ++lines)
+	{
+		const bool wasLineStart = IsLineStart(m_TopOffset);
+
+		m_TopOffset = FindLineStart(m_TopOffset - 1);
+
+		// An estimate can be lower than the lines that are left above the view
+		if (wasLineStart && m_TopLine > 0)
+		{
+			--m_TopLine;
+		}
+
+		moved = true;
+	}
+
+	if (m_TopOffset == 0)
+	{
+		m_TopLine = 0;
+		m_IsTopLineEstimated = false;
+	}
+
+	return moved;
+}
+
+void LargeFileView::ScrollToPosition(double position)
+{
+	const unsigned long long size = m_File.GetSize();
+
+	if (size == 0)
+	{
+		return;
+	}
+
+	position = std::min(std::max(position, 0.0), 1.0);
+
+	const unsigned long long offset = std::min(static_cast<unsigned long long>(position * size), size - 1);
+
+	m_TopOffset = FindLineStart(offset);
+	m_TopLine = CountLinesBefore(m_TopOffset, m_IsTopLineEstimated);
+}
+
+void LargeFileView::ScrollToEnd(size_t visibleLines)
+{
+	const unsigned long long size = m_File.GetSize();
+
+	if (size == 0)
+	{
+		return;
+	}
+
+	ScrollToPosition(1.0);
+	ScrollLines(-static_cast<long long>(visibleLines > 0 ? visibleLines - 1 : 0));
+}
+
+std::wstring LargeFileView::GetLines(size_t lineCount)
+{
+	const unsigned long long limit = std::min<unsigned long long>(m_File.GetSize(), m_TopOffset + MAX_DECODED_BYTES);
+	unsigned long long end = m_TopOffset;
+
+	for (size_t i = 0; i < lineCount && end < limit; ++i)
+	{
+		end = FindNextLineStart(end);
+	}
+
+	end = std::min(end, limit);
+
+	if (end <= m_TopOffset)
+	{
+		return std::wstring();
+	}
+
+	const size_t length = static_cast<size_t>(end - m_TopOffset);
+	const char* pData = m_File.GetView(m_TopOffset, length);
+
+	if (pData == nullptr)
+	{
+		return std::wstring();
+	}
+
+	// The byte order mark is skipped too when the view is at the start of the file
+	std::wstring text = Utf8Decoder::DecodeAll(pData, length);
+
+	// The line break of the last line would show up as an extra empty line
+	if (!text.empty() && text.back() == L'\n')
+	{
+		text.pop_back();
+	}
+
+	if (!text.empty() && text.back() == L'\r')
+	{
+		text.pop_back();
+	}
+
+	return text;
+}
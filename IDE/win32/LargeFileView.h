@@ -0,0 +1,90 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Files at least this big are opened read only through a LargeFileView
+#define LARGE_FILE_THRESHOLD (64ULL * 1024 * 1024)
+
+// Posted to the window passed to Open once every line break of the file has been counted
+#define WM_LINE_COUNT_READY (WM_APP + 7)
+
+/// <summary>
+/// Read only view of a memory mapped file that only ever decodes the
+/// lines that are on screen. Opening is constant time and memory use
+/// doesn't depend on the size of the file, since the view is moved by
+/// scanning the mapped bytes for line breaks around the current position.
+/// The line breaks of the whole file are counted by a background thread,
+/// until it gets to the view the number of its first line is estimated.
+/// </summary>
+class LargeFileView
+{
+private:
+	MappedFile m_File;
+
+	// Byte offset and (zero based) number of the first line of the view
+	unsigned long long m_TopOffset = 0;
+	unsigned long long m_TopLine = 0;
+
+	// Set while the lines before the view haven't been counted yet
+	bool m_IsTopLineEstimated = false;
+
+	// Number of line breaks before each block of the file. Sized when the file
+	// is opened, the thread fills in the entries up to m_CountedBlocks in order
+	std::vector<unsigned long long> m_LinesBeforeBlock;
+	std::atomic<size_t> m_CountedBlocks;
+	std::atomic<bool> m_IsClosing;
+	std::thread m_CountThread;
+
+	void CountLines(std::wstring path, HWND hWndNotify);
+
+	bool IsLineStart(unsigned long long offset);
+	unsigned long long FindLineStart(unsigned long long offset);
+	unsigned long long FindNextLineStart(unsigned long long offset);
+	unsigned long long CountLinesBefore(unsigned long long offset, bool& isEstimated);
+
+public:
+	LargeFileView(void);
+	~LargeFileView(void);
+
+	LargeFileView(const LargeFileView&) = delete;
+	LargeFileView& operator=(const LargeFileView&) = delete;
+
+	/* Starts counting the lines of the file, the window (if any) is told when they have all been counted */
+	bool Open(const wchar_t* lpszPath, HWND hWndNotify);
+	void Close(void);
+
+	bool IsOpen(void) const { return m_File.IsOpen(); }
+	unsigned long long GetFileSize(void) const { return m_File.GetSize(); }
+	unsigned long long GetTopLine(void) const { return m_TopLine; }
+	bool IsTopLineEstimated(void) const { return m_IsTopLineEstimated; }
+
+	/// <summary>
+	/// Replaces the estimated number of the first line of the view with the
+	/// real one, if the lines before it have been counted since
+	/// </summary>
+	/// <returns> Whether the number changed </returns>
+	bool UpdateTopLine(void);
+
+	/* Position of the view in the file, from 0.0 (start) to 1.0 (end) */
+	double GetPosition(void) const;
+
+	/// <summary>
+	/// Moves the view a number of lines up (negative) or down (positive)
+	/// </summary>
+	/// <returns> Whether the view moved at all </returns>
+	bool ScrollLines(long long lines);
+
+	/* Moves the view to the line that contains the byte at 'position' of the file */
+	void ScrollToPosition(double position);
+
+	/* Moves the view so that its last line is the last line of the file */
+	void ScrollToEnd(size_t visibleLines);
+
+	/* Decodes the first 'lineCount' lines of the view */
+	std::wstring GetLines(size_t lineCount);
+};
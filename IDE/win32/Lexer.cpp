@@ -0,0 +1,286 @@
+#include "Lexer.h"
+
+#include <cwchar>
+
+static inline bool IsIdentifierStart(wchar_t ch)
+{
+	// Anything outside of ASCII is taken as a letter
+	return (ch >= L'a' && ch <= L'z') || (ch >= L'A' && ch <= L'Z') || ch == L'_' || ch >= 0x80;
+}
+
+static inline bool IsDigit(wchar_t ch)
+{
+	return ch >= L'0' && ch <= L'9';
+}
+
+static inline bool IsIdentifierChar(wchar_t ch)
+{
+	return IsIdentifierStart(ch) || IsDigit(ch);
+}
+
+/// <summary>
+/// Looks at the cancellation flag every LEXER_CANCEL_CHECK_INTERVAL
+/// characters, the loops that skip over literals and comments ask it too
+/// since a single one of them can take up a whole line
+/// </summary>
+class CancelCheck
+{
+private:
+	const std::atomic<bool>* m_pIsCancelled;
+	size_t m_NextCheck = LEXER_CANCEL_CHECK_INTERVAL;
+
+public:
+	explicit CancelCheck(const std::atomic<bool>* pIsCancelled) : m_pIsCancelled(pIsCancelled) {}
+
+	bool IsCancelled(size_t i)
+	{
+		if (m_pIsCancelled == nullptr || i < m_NextCheck)
+		{
+			return false;
+		}
+
+		m_NextCheck = i + LEXER_CANCEL_CHECK_INTERVAL;
+
+		return m_pIsCancelled->load(std::memory_order_relaxed);
+	}
+};
+
+static inline void AddToken(std::vector<Token>* pTokens, size_t start, size_t end, TokenType type)
+{
+	if (pTokens != nullptr && end > start)
+	{
+		Token token;
+		token.start = static_cast<uint32_t>(start);
+		token.length = static_cast<uint32_t>(end - start);
+		token.type = type;
+
+		pTokens->push_back(token);
+	}
+}
+
+/// <summary>
+/// Skips to the end of a string or character literal
+/// </summary>
+/// <param name="i"> Index after the opening quote, receives the index after the closing one </param>
+/// <returns> Whether the literal goes on in the next line </returns>
+static bool SkipLiteral(const wchar_t* pLine, size_t length, size_t& i, wchar_t quote, CancelCheck& cancelCheck)
+{
+	while (i < length)
+	{
+		if (cancelCheck.IsCancelled(i))
+		{
+			i = length;
+			break;
+		}
+
+		const wchar_t ch = pLine[i++];
+
+		if (ch == L'\\')
+		{
+			if (i == length)
+			{
+				return true;
+			}
+
+			++i;
+		}
+
+		else if (ch == quote)
+		{
+			return false;
+		}
+	}
+
+	// An unterminated literal ends with its line
+	return false;
+}
+
+/* Whether the text at index 'i' starts with 'lpszText', which may be null */
+static bool IsAt(const wchar_t* pLine, size_t length, size_t i, const wchar_t* lpszText)
+{
+	if (lpszText == nullptr || *lpszText == L'\0')
+	{
+		return false;
+	}
+
+	for (; *lpszText != L'\0'; ++lpszText, ++i)
+	{
+		if (i == length || pLine[i] != *lpszText)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// <returns> Whether the comment was closed, 'i' is then the index after the closing delimiter </returns>
+static bool SkipBlockComment(const wchar_t* pLine, size_t length, size_t& i, const wchar_t* lpszEnd, CancelCheck& cancelCheck)
+{
+	const size_t endLength = wcslen(lpszEnd);
+
+	for (; i + endLength <= length; ++i)
+	{
+		if (cancelCheck.IsCancelled(i))
+		{
+			break;
+		}
+
+		if (IsAt(pLine, length, i, lpszEnd))
+		{
+			i += endLength;
+			return true;
+		}
+	}
+
+	i = length;
+
+	return false;
+}
+
+static size_t SkipNumber(const wchar_t* pLine, size_t length, size_t i)
+{
+	while (i < length)
+	{
+		const wchar_t ch = pLine[i];
+
+		if (IsIdentifierChar(ch) || ch == L'.' || ch == L'\'')
+		{
+			++i;
+		}
+
+		// Sign of an exponent, e.g. 1e-5 or 0x1p+3
+		else if ((ch == L'+' || ch == L'-') &&
+			     (pLine[i - 1] == L'e' || pLine[i - 1] == L'E' || pLine[i - 1] == L'p' || pLine[i - 1] == L'P'))
+		{
+			++i;
+		}
+
+		else
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+/* Token of a literal in single quotes */
+static inline TokenType GetSingleQuotedType(const LexerRules& rules)
+{
+	return rules.hasCharacters ? TokenType::CHARACTER : TokenType::STRING;
+}
+
+LexerState Lexer::LexLine(const wchar_t* pLine, size_t length, LexerState state, const LexerRules& rules, std::vector<Token>* pTokens,
+	                      const std::atomic<bool>* pIsCancelled)
+{
+	CancelCheck cancelCheck(pIsCancelled);
+	size_t i = 0;
+
+	// Finish whatever the previous line left open first
+	switch (state)
+	{
+	case LexerState::BLOCK_COMMENT:
+		if (rules.lpszBlockCommentEnd == nullptr || !SkipBlockComment(pLine, length, i, rules.lpszBlockCommentEnd, cancelCheck))
+		{
+			AddToken(pTokens, 0, length, TokenType::COMMENT);
+			return rules.lpszBlockCommentEnd != nullptr ? LexerState::BLOCK_COMMENT : LexerState::NORMAL;
+		}
+
+		AddToken(pTokens, 0, i, TokenType::COMMENT);
+		break;
+
+	case LexerState::LINE_COMMENT:
+		AddToken(pTokens, 0, length, TokenType::COMMENT);
+		return rules.doLineCommentsContinue && length > 0 && pLine[length - 1] == L'\\' ? LexerState::LINE_COMMENT : LexerState::NORMAL;
+
+	case LexerState::STRING:
+	case LexerState::CHARACTER:
+	{
+		const bool isString = state == LexerState::STRING;
+		const TokenType type = isString ? TokenType::STRING : GetSingleQuotedType(rules);
+
+		if (SkipLiteral(pLine, length, i, isString ? L'"' : L'\'', cancelCheck))
+		{
+			AddToken(pTokens, 0, length, type);
+			return state;
+		}
+
+		AddToken(pTokens, 0, i, type);
+	}
+		break;
+
+	default:
+		break;
+	}
+
+	while (i < length && !cancelCheck.IsCancelled(i))
+	{
+		const wchar_t ch = pLine[i];
+		const size_t start = i;
+
+		if (IsIdentifierStart(ch))
+		{
+			while (++i < length && IsIdentifierChar(pLine[i]));
+
+			AddToken(pTokens, start, i, TokenType::IDENTIFIER);
+		}
+
+		else if (rules.hasNumbers && (IsDigit(ch) || (ch == L'.' && i + 1 < length && IsDigit(pLine[i + 1]))))
+		{
+			i = SkipNumber(pLine, length, i + 1);
+
+			AddToken(pTokens, start, i, TokenType::NUMBER);
+		}
+
+		else if ((ch == L'"' && rules.hasDoubleQuotedStrings) ||
+			     (ch == L'\'' && (rules.hasCharacters || rules.hasSingleQuotedStrings)))
+		{
+			++i;
+
+			const bool isString = ch == L'"';
+			const TokenType type = isString ? TokenType::STRING : GetSingleQuotedType(rules);
+
+			if (SkipLiteral(pLine, length, i, ch, cancelCheck))
+			{
+				AddToken(pTokens, start, length, type);
+				return isString ? LexerState::STRING : LexerState::CHARACTER;
+			}
+
+			AddToken(pTokens, start, i, type);
+		}
+
+		else if (IsAt(pLine, length, i, rules.lpszLineComment))
+		{
+			AddToken(pTokens, start, length, TokenType::COMMENT);
+			return rules.doLineCommentsContinue && pLine[length - 1] == L'\\' ? LexerState::LINE_COMMENT : LexerState::NORMAL;
+		}
+
+		else if (IsAt(pLine, length, i, rules.lpszBlockCommentStart))
+		{
+			i += wcslen(rules.lpszBlockCommentStart);
+
+			if (!SkipBlockComment(pLine, length, i, rules.lpszBlockCommentEnd, cancelCheck))
+			{
+				AddToken(pTokens, start, length, TokenType::COMMENT);
+				return LexerState::BLOCK_COMMENT;
+			}
+
+			AddToken(pTokens, start, i, TokenType::COMMENT);
+		}
+
+		else if (rules.hasDirectives && ch == L'#' && i + 1 < length && IsIdentifierStart(pLine[i + 1]))
+		{
+			while (++i < length && IsIdentifierChar(pLine[i]));
+
+			AddToken(pTokens, start, i, TokenType::DIRECTIVE);
+		}
+
+		else
+		{
+			++i;
+		}
+	}
+
+	return LexerState::NORMAL;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A cancelled lex notices within about this many characters, even in the middle of a long line
+#define LEXER_CANCEL_CHECK_INTERVAL 4096
+
+/* What is still open at the end of a line, so the next one has to start inside of it */
+enum class LexerState : uint8_t {
+	NORMAL,
+	BLOCK_COMMENT,
+	LINE_COMMENT, // A '//' comment whose line ends with a backslash
+	STRING,       // A string literal whose line ends with a backslash
+	CHARACTER     // Any literal in single quotes, a character or a string depending on the language
+};
+
+enum class TokenType : uint8_t {
+	IDENTIFIER,
+	DIRECTIVE, // '#' followed by a word, e.g. #include
+	NUMBER,
+	STRING,
+	CHARACTER,
+	COMMENT,
+	MARKER     // TODO, FIXME... inside a comment, found by the highlighter rather than the lexer
+};
+
+/* What a language's text is made of, anything a language doesn't have is left out */
+struct LexerRules {
+	// Starts a comment that runs to the end of the line, e.g. "//"
+	const wchar_t* lpszLineComment = nullptr;
+
+	// e.g. "/*" and "*/"
+	const wchar_t* lpszBlockCommentStart = nullptr;
+	const wchar_t* lpszBlockCommentEnd = nullptr;
+
+	bool hasDoubleQuotedStrings = false;
+
+	// Single quotes enclose a character in C and a string in Python
+	bool hasCharacters = false;
+	bool hasSingleQuotedStrings = false;
+
+	bool hasNumbers = false;
+	bool hasDirectives = false;
+
+	// A line comment ending with a backslash goes on in the next line
+	bool doLineCommentsContinue = false;
+};
+
+/* Punctuation and white space between the tokens are not reported */
+struct Token {
+	uint32_t start = 0;
+	uint32_t length = 0;
+	TokenType type = TokenType::IDENTIFIER;
+};
+
+/// <summary>
+/// Splits source code into tokens, a line at a time, following the rules
+/// of its language. Everything a line needs to know about the lines before
+/// it is the state they ended in, so the lines can be lexed again
+/// independently after an edit.
+/// </summary>
+namespace Lexer
+{
+	/// <summary>
+	/// Lexes a line, without its line break
+	/// </summary>
+	/// <param name="state"> State at the start of the line, from lexing the line before with the same rules </param>
+	/// <param name="pTokens"> Receives the tokens of the line, can be null when only the state is needed </param>
+	/// <param name="pIsCancelled"> Stops lexing once it's set, the tokens and the state are of no use then. Can be null </param>
+	/// <returns> State at the start of the next line </returns>
+	LexerState LexLine(const wchar_t* pLine, size_t length, LexerState state, const LexerRules& rules, std::vector<Token>* pTokens,
+		               const std::atomic<bool>* pIsCancelled = nullptr);
+}
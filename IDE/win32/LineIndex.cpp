@@ -0,0 +1,164 @@
+#include "LineIndex.h"
+
+#include <algorithm>
+
+#define READ_BLOCK_SIZE 65536
+
+LineIndex::LineIndex(void)
+{
+	m_Root = m_Tree.CreateNode(0);
+}
+
+void LineIndex::OnDocumentLoad(const PieceTable& document)
+{
+	m_Tree.Clear();
+
+	std::vector<size_t> lengths;
+	std::vector<wchar_t> buffer(READ_BLOCK_SIZE);
+
+	const size_t length = document.GetLength();
+	size_t line_length = 0;
+
+	for (size_t position = 0; position < length; position += READ_BLOCK_SIZE)
+	{
+		const size_t copied = document.CopyTextRange(position, READ_BLOCK_SIZE, buffer.data());
+
+		for (size_t i = 0; i < copied; ++i)
+		{
+			++line_length;
+
+			if (buffer[i] == L'\r')
+			{
+				lengths.push_back(line_length);
+				line_length = 0;
+			}
+		}
+	}
+
+	lengths.push_back(line_length);
+
+	m_Root = m_Tree.Build(lengths);
+}
+
+void LineIndex::OnDocumentEdit(const TextEdit& edit)
+{
+	const size_t first_line = GetLineFromOffset(edit.position);
+	const size_t line_count = std::count(edit.removed.begin(), edit.removed.end(), L'\r') + 1;
+
+	// Take out the lines the removed text was spread over...
+	uint32_t before, affected, after;
+	m_Tree.SplitAtCount(m_Root, static_cast<uint32_t>(first_line), before, affected);
+	m_Tree.SplitAtCount(affected, static_cast<uint32_t>(line_count), affected, after);
+
+	const size_t line_start = m_Tree.Sum(before);
+	const size_t old_length = m_Tree.Sum(affected);
+	m_Tree.FreeTree(affected);
+
+	// ...and put back the lines they turned into
+	std::vector<size_t> lengths;
+	size_t line_length = edit.position - line_start;
+
+	for (wchar_t ch : edit.inserted)
+	{
+		++line_length;
+
+		if (ch == L'\r')
+		{
+			lengths.push_back(line_length);
+			line_length = 0;
+		}
+	}
+
+	// Whatever followed the removed text on the last affected line
+	line_length += old_length - (edit.position - line_start) - edit.removed.length();
+	lengths.push_back(line_length);
+
+	m_Root = m_Tree.Merge(m_Tree.Merge(before, m_Tree.Build(lengths)), after);
+}
+
+size_t LineIndex::GetLineCount(void) const
+{
+	return m_Tree.Count(m_Root);
+}
+
+size_t LineIndex::GetLineFromOffset(size_t offset) const
+{
+	if (offset >= m_Tree.Sum(m_Root))
+	{
+		return GetLineCount() - 1;
+	}
+
+	size_t line = 0;
+	uint32_t node = m_Root;
+
+	while (node != NIL)
+	{
+		const Tree::Node& n = m_Tree[node];
+		const size_t left_sum = m_Tree.Sum(n.left);
+
+		if (offset < left_sum)
+		{
+			node = n.left;
+		}
+
+		else if (offset < left_sum + n.value)
+		{
+			return line + m_Tree.Count(n.left);
+		}
+
+		else
+		{
+			offset -= left_sum + n.value;
+			line += m_Tree.Count(n.left) + 1;
+			node = n.right;
+		}
+	}
+
+	return GetLineCount() - 1;
+}
+
+size_t LineIndex::GetOffsetFromLine(size_t line) const
+{
+	if (line >= GetLineCount())
+	{
+		return m_Tree.Sum(m_Root);
+	}
+
+	size_t offset = 0;
+	uint32_t node = m_Root;
+
+	while (node != NIL)
+	{
+		const Tree::Node& n = m_Tree[node];
+		const size_t left_count = m_Tree.Count(n.left);
+
+		if (line < left_count)
+		{
+			node = n.left;
+		}
+
+		else if (line == left_count)
+		{
+			return offset + m_Tree.Sum(n.left);
+		}
+
+		else
+		{
+			offset += m_Tree.Sum(n.left) + n.value;
+			line -= left_count + 1;
+			node = n.right;
+		}
+	}
+
+	return offset;
+}
+
+size_t LineIndex::GetLineLength(size_t line) const
+{
+	if (line >= GetLineCount())
+	{
+		return 0;
+	}
+
+	return GetOffsetFromLine(line + 1) - GetOffsetFromLine(line);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PieceTable.h"
+#include "ImplicitTreap.h"
+
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// Keeps the length of every line of a document in a balanced tree (a treap
+/// ordered by line number) whose nodes also store the total length and line
+/// count of their subtree. Both conversions walk from the root to a single
+/// node, so they take logarithmic time no matter how big the file is.
+/// Each line's length includes its terminating '\r', except for the last line.
+/// </summary>
+class LineIndex : public DocumentListener
+{
+private:
+	/* A node holds the length of one line */
+	struct LineTraits {
+		typedef size_t Value;
+
+		static size_t GetLength(size_t length) { return length; }
+	};
+
+	typedef ImplicitTreap<LineTraits> Tree;
+
+	static constexpr uint32_t NIL = Tree::NIL;
+
+	Tree m_Tree;
+	uint32_t m_Root = NIL;
+
+public:
+	LineIndex(void);
+
+	void OnDocumentEdit(const TextEdit& edit) override;
+	void OnDocumentLoad(const PieceTable& document) override;
+
+	// Lines are zero based
+
+	size_t GetLineCount(void) const;
+	size_t GetLineFromOffset(size_t offset) const;
+	size_t GetOffsetFromLine(size_t line) const;
+	size_t GetLineLength(size_t line) const;
+};
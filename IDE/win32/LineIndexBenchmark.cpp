@@ -0,0 +1,295 @@
+#include "LineIndexBenchmark.h"
+#include "Benchmark.h"
+#include "LineIndex.h"
+#include "PieceTable.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Where every line starts, in a sorted array. Queries are binary searches,
+/// but an edit has to move every line start after it.
+/// </summary>
+class LineStartTable
+{
+private:
+	std::vector<size_t> m_Starts;
+
+public:
+	void Build(const std::wstring& text)
+	{
+		m_Starts.assign(1, 0);
+
+		for (size_t i = 0; i < text.length(); ++i)
+		{
+			if (text[i] == L'\r')
+			{
+				m_Starts.push_back(i + 1);
+			}
+		}
+	}
+
+	size_t GetLineFromOffset(size_t offset) const
+	{
+		return static_cast<size_t>(std::upper_bound(m_Starts.begin(), m_Starts.end(), offset) - m_Starts.begin()) - 1;
+	}
+
+	size_t GetOffsetFromLine(size_t line) const
+	{
+		return m_Starts[std::min(line, m_Starts.size() - 1)];
+	}
+
+	size_t GetLineCount(void) const { return m_Starts.size(); }
+
+	void OnDocumentEdit(const TextEdit& edit)
+	{
+		const size_t firstLine = GetLineFromOffset(edit.position);
+		const size_t removedCount = std::count(edit.removed.begin(), edit.removed.end(), L'\r');
+
+		m_Starts.erase(m_Starts.begin() + firstLine + 1, m_Starts.begin() + firstLine + 1 + removedCount);
+
+		const size_t end = edit.position + edit.removed.length();
+
+		for (size_t line = firstLine + 1; line < m_Starts.size(); ++line)
+		{
+			m_Starts[line] = m_Starts[line] - end + edit.position + edit.inserted.length();
+		}
+
+		std::vector<size_t> inserted;
+
+		for (size_t i = 0; i < edit.inserted.length(); ++i)
+		{
+			if (edit.inserted[i] == L'\r')
+			{
+				inserted.push_back(edit.position + i + 1);
+			}
+		}
+
+		m_Starts.insert(m_Starts.begin() + firstLine + 1, inserted.begin(), inserted.end());
+	}
+};
+
+/* Lines of random lengths, as long as lines of code usually are */
+static void GenerateDocument(std::wstring& text)
+{
+	std::mt19937 random(0x4C49);
+
+	for (size_t line = 0; line + 1 < LINE_INDEX_BENCHMARK_LINES; ++line)
+	{
+		text.append(random() % 80, L'x');
+		text.push_back(L'\r');
+	}
+
+	text.append(random() % 80, L'x');
+}
+
+/* Typing a character at a random place */
+static TextEdit MakeTypingEdit(const PieceTable& document, const LineIndex&, std::mt19937& random)
+{
+	TextEdit edit;
+	edit.position = random() % (document.GetLength() + 1);
+	edit.inserted = L"x";
+
+	return edit;
+}
+
+/* Enter at a random place */
+static TextEdit MakeLineBreakEdit(const PieceTable& document, const LineIndex&, std::mt19937& random)
+{
+	TextEdit edit;
+	edit.position = random() % (document.GetLength() + 1);
+	edit.inserted = L"\r";
+
+	return edit;
+}
+
+/* Backspace at the start of a random line */
+static TextEdit MakeJoinEdit(const PieceTable&, const LineIndex& index, std::mt19937& random)
+{
+	TextEdit edit;
+	edit.position = index.GetOffsetFromLine(1 + random() % (index.GetLineCount() - 1)) - 1;
+	edit.removed = L"\r";
+
+	return edit;
+}
+
+typedef TextEdit (*EditFunction)(const PieceTable& document, const LineIndex& index, std::mt19937& random);
+
+struct EditCase {
+	const char* lpszName;
+	EditFunction pMakeEdit;
+};
+
+static const EditCase g_EditCases[] = {
+	{ "type",       MakeTypingEdit },
+	{ "break_line", MakeLineBreakEdit },
+	{ "join_lines", MakeJoinEdit }
+};
+
+#define EDIT_CASE_COUNT (sizeof(g_EditCases) / sizeof(g_EditCases[0]))
+
+/// <summary>
+/// Makes the edits on the document one after the other, and times how
+/// long the index takes to follow each of them, and the table if there's one
+/// </summary>
+static void MeasureEdits(PieceTable& document, LineIndex& index, LineStartTable* pTable, size_t count, EditFunction pMakeEdit,
+	                     std::mt19937& random, Benchmark::OperationResult& indexResult, Benchmark::OperationResult& tableResult)
+{
+	Benchmark::Clock::duration indexTotal = Benchmark::Clock::duration::zero();
+	Benchmark::Clock::duration indexSlowest = Benchmark::Clock::duration::zero();
+	Benchmark::Clock::duration tableTotal = Benchmark::Clock::duration::zero();
+	Benchmark::Clock::duration tableSlowest = Benchmark::Clock::duration::zero();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const TextEdit edit = pMakeEdit(document, index, random);
+		document.Replace(edit.position, edit.removed.length(), edit.inserted.data(), edit.inserted.length());
+
+		const Benchmark::Clock::time_point indexStart = Benchmark::Clock::now();
+		index.OnDocumentEdit(edit);
+		const Benchmark::Clock::duration indexElapsed = Benchmark::Clock::now() - indexStart;
+
+		indexTotal += indexElapsed;
+		indexSlowest = std::max(indexSlowest, indexElapsed);
+
+		if (pTable != nullptr)
+		{
+			const Benchmark::Clock::time_point tableStart = Benchmark::Clock::now();
+			pTable->OnDocumentEdit(edit);
+			const Benchmark::Clock::duration tableElapsed = Benchmark::Clock::now() - tableStart;
+
+			tableTotal += tableElapsed;
+			tableSlowest = std::max(tableSlowest, tableElapsed);
+		}
+	}
+
+	indexResult.averageMicroseconds = Benchmark::GetMicroseconds(indexTotal) / count;
+	indexResult.maxMicroseconds = Benchmark::GetMicroseconds(indexSlowest);
+	tableResult.averageMicroseconds = Benchmark::GetMicroseconds(tableTotal) / count;
+	tableResult.maxMicroseconds = Benchmark::GetMicroseconds(tableSlowest);
+}
+
+static void WriteResult(FILE* pFile, const char* lpszOperation, const Benchmark::OperationResult& indexResult, const Benchmark::OperationResult& tableResult,
+	                    size_t indexSum, size_t tableSum)
+{
+	fprintf(pFile, "{\"operation\":\"%s\",", lpszOperation);
+	Benchmark::WriteResult(pFile, "index_", indexResult);
+	fprintf(pFile, ",");
+	Benchmark::WriteResult(pFile, "table_", tableResult);
+	fprintf(pFile, ",\"index_sum\":%llu,\"table_sum\":%llu}\n", static_cast<unsigned long long>(indexSum), static_cast<unsigned long long>(tableSum));
+	fflush(pFile);
+}
+
+bool LineIndexBenchmark::Run(const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	std::wstring text;
+	GenerateDocument(text);
+
+	LineStartTable table;
+
+	const Benchmark::Clock::time_point tableStart = Benchmark::Clock::now();
+	table.Build(text);
+	const double tableMilliseconds = Benchmark::GetMicroseconds(Benchmark::Clock::now() - tableStart) / 1000.0;
+
+	PieceTable document;
+	LineIndex index;
+
+	document.AddListener(&index);
+
+	const Benchmark::Clock::time_point indexStart = Benchmark::Clock::now();
+	document.Load(std::move(text));
+	const double indexMilliseconds = Benchmark::GetMicroseconds(Benchmark::Clock::now() - indexStart) / 1000.0;
+
+	// The edits below are given to the index and the table one at a time, so that each is timed on its own
+	document.RemoveListener(&index);
+
+	fprintf(pOutput, "{\"lines\":%llu,\"characters\":%llu,\"index_build_ms\":%.1f,\"table_build_ms\":%.1f}\n",
+		    static_cast<unsigned long long>(index.GetLineCount()), static_cast<unsigned long long>(document.GetLength()),
+		    indexMilliseconds, tableMilliseconds);
+	fflush(pOutput);
+
+	// The index and the table are asked the same things in the same order
+	std::mt19937 indexRandom(0x4C49);
+	std::mt19937 tableRandom(0x4C49);
+	size_t indexSum = 0;
+	size_t tableSum = 0;
+
+	const size_t length = document.GetLength();
+	const size_t lineCount = index.GetLineCount();
+
+	{
+		const Benchmark::OperationResult indexResult = Benchmark::MeasureOperation(LINE_INDEX_BENCHMARK_OPERATIONS, [&](size_t) {
+			indexSum += index.GetLineFromOffset(indexRandom() % length);
+		});
+
+		const Benchmark::OperationResult tableResult = Benchmark::MeasureOperation(LINE_INDEX_BENCHMARK_OPERATIONS, [&](size_t) {
+			tableSum += table.GetLineFromOffset(tableRandom() % length);
+		});
+
+		WriteResult(pOutput, "line_from_offset", indexResult, tableResult, indexSum, tableSum);
+	}
+
+	{
+		const Benchmark::OperationResult indexResult = Benchmark::MeasureOperation(LINE_INDEX_BENCHMARK_OPERATIONS, [&](size_t) {
+			indexSum += index.GetOffsetFromLine(indexRandom() % lineCount);
+		});
+
+		const Benchmark::OperationResult tableResult = Benchmark::MeasureOperation(LINE_INDEX_BENCHMARK_OPERATIONS, [&](size_t) {
+			tableSum += table.GetOffsetFromLine(tableRandom() % lineCount);
+		});
+
+		WriteResult(pOutput, "offset_from_line", indexResult, tableResult, indexSum, tableSum);
+	}
+
+	// The line of the caret, then where that line starts for the column
+	{
+		const Benchmark::OperationResult indexResult = Benchmark::MeasureOperation(LINE_INDEX_BENCHMARK_OPERATIONS, [&](size_t) {
+			const size_t offset = indexRandom() % length;
+			indexSum += offset - index.GetOffsetFromLine(index.GetLineFromOffset(offset));
+		});
+
+		const Benchmark::OperationResult tableResult = Benchmark::MeasureOperation(LINE_INDEX_BENCHMARK_OPERATIONS, [&](size_t) {
+			const size_t offset = tableRandom() % length;
+			tableSum += offset - table.GetOffsetFromLine(table.GetLineFromOffset(offset));
+		});
+
+		WriteResult(pOutput, "status_bar", indexResult, tableResult, indexSum, tableSum);
+	}
+
+	Benchmark::OperationResult tableResults[EDIT_CASE_COUNT];
+	size_t indexLineCounts[EDIT_CASE_COUNT];
+	size_t tableLineCounts[EDIT_CASE_COUNT];
+
+	// The table is only given the first few edits, before the index gets any edit of its own
+	for (size_t i = 0; i < EDIT_CASE_COUNT; ++i)
+	{
+		Benchmark::OperationResult indexResult;
+		MeasureEdits(document, index, &table, LINE_INDEX_BENCHMARK_TABLE_EDITS, g_EditCases[i].pMakeEdit, indexRandom, indexResult, tableResults[i]);
+
+		indexLineCounts[i] = index.GetLineCount();
+		tableLineCounts[i] = table.GetLineCount();
+	}
+
+	for (size_t i = 0; i < EDIT_CASE_COUNT; ++i)
+	{
+		Benchmark::OperationResult indexResult;
+		Benchmark::OperationResult tableResult;
+		MeasureEdits(document, index, nullptr, LINE_INDEX_BENCHMARK_OPERATIONS, g_EditCases[i].pMakeEdit, indexRandom, indexResult, tableResult);
+
+		WriteResult(pOutput, g_EditCases[i].lpszName, indexResult, tableResults[i], indexLineCounts[i], tableLineCounts[i]);
+	}
+
+	return fclose(pOutput) == 0;
+}
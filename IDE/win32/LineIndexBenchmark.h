@@ -0,0 +1,33 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-line-index
+#define LINE_INDEX_BENCHMARK_ARGUMENT L"--benchmark-line-index"
+
+// Written to the current directory, one line of JSON for the document and one per operation
+#define LINE_INDEX_BENCHMARK_OUTPUT_FILE L"line-index-benchmark.jsonl"
+
+// Lines of the generated document
+#define LINE_INDEX_BENCHMARK_LINES 1000000
+
+// Queries and edits of each operation on the index
+#define LINE_INDEX_BENCHMARK_OPERATIONS 200000
+
+// Edits of each operation on the plain table of line starts, every one of them moves most of the table
+#define LINE_INDEX_BENCHMARK_TABLE_EDITS 2000
+
+/// <summary>
+/// Measures LineIndex on a generated file of a million lines: how long it
+/// takes to build, converting offsets to lines and back, the pair of
+/// conversions the status bar makes on every caret move, and typing,
+/// breaking and joining lines at random places. Each operation is also
+/// done on a sorted table of line starts, binary searched for queries and
+/// shifted after every edit the way a plain array has to be, and both
+/// report the average and the worst time of a call. The answers to the
+/// queries are summed up, and after the edits the line counts are written
+/// instead, the index and the table have to agree on both.
+/// </summary>
+namespace LineIndexBenchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszOutputPath);
+}
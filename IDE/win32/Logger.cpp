@@ -6,6 +6,7 @@
 #include <stdarg.h>
 #include <chrono>
 #include <ctime>
+#include <mutex>
 
 #define WIN32_LEAN_AND_MEAN
 
@@ -14,6 +15,9 @@
 static FILE* pOutputFile = nullptr;
 static const wchar_t* g_lpszFilePath = nullptr;
 
+// Files are loaded and saved on other threads too
+static std::mutex g_WriteMutex;
+
 static void OpenOutputFile(void)
 {
 	_wfopen_s(&pOutputFile, g_lpszFilePath, L"a");
@@ -47,6 +51,8 @@ void Logger::Write(const wchar_t* lpszFormat, ...)
 {
 #ifdef LOGGER_ACTIVE
 
+	std::lock_guard<std::mutex> lock(g_WriteMutex);
+
 	OpenOutputFile();
 
 	if (pOutputFile)
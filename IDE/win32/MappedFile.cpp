@@ -0,0 +1,139 @@
+#include "MappedFile.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+MappedFile::MappedFile(void)
+{
+	SYSTEM_INFO sInfo;
+	GetSystemInfo(&sInfo);
+
+	// Views have to start at a multiple of the allocation granularity, not just the page size
+	m_Granularity = sInfo.dwAllocationGranularity;
+}
+
+MappedFile::~MappedFile(void)
+{
+	Close();
+}
+
+bool MappedFile::Open(const wchar_t* lpszPath)
+{
+	Close();
+
+	m_hFile = CreateFile(lpszPath,
+		                 GENERIC_READ,
+		                 FILE_SHARE_READ | FILE_SHARE_WRITE,
+		                 nullptr,
+		                 OPEN_EXISTING,
+		                 FILE_ATTRIBUTE_NORMAL,
+		                 nullptr);
+
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		Logger::Write(L"Failed to open %ls for mapping (error %u)", lpszPath, GetLastError());
+		return false;
+	}
+
+	LARGE_INTEGER liSize;
+
+	if (!GetFileSizeEx(m_hFile, &liSize))
+	{
+		Close();
+		return false;
+	}
+
+	m_Size = static_cast<unsigned long long>(liSize.QuadPart);
+
+	// Empty files can't be mapped, there's nothing to read anyway
+	if (m_Size > 0)
+	{
+		m_hMapping = CreateFileMapping(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (m_hMapping == nullptr)
+		{
+			Logger::Write(L"Failed to create a file mapping of %ls (error %u)", lpszPath, GetLastError());
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MappedFile::Unmap(void)
+{
+	if (m_pView != nullptr)
+	{
+		UnmapViewOfFile(m_pView);
+	}
+
+	m_pView = nullptr;
+	m_ViewOffset = 0;
+	m_ViewSize = 0;
+}
+
+void MappedFile::Close(void)
+{
+	Unmap();
+
+	if (m_hMapping != nullptr)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+
+	m_Size = 0;
+}
+
+bool MappedFile::IsOpen(void) const
+{
+	return m_hFile != INVALID_HANDLE_VALUE;
+}
+
+const char* MappedFile::GetView(unsigned long long offset, size_t length)
+{
+	if (!IsOpen() || offset >= m_Size)
+	{
+		return nullptr;
+	}
+
+	length = static_cast<size_t>(std::min<unsigned long long>(length, m_Size - offset));
+
+	if (m_pView != nullptr && offset >= m_ViewOffset && offset + length <= m_ViewOffset + m_ViewSize)
+	{
+		return m_pView + (offset - m_ViewOffset);
+	}
+
+	Unmap();
+
+	const unsigned long long start = offset - offset % m_Granularity;
+	const size_t size = static_cast<size_t>(std::min<unsigned long long>(
+		std::max<unsigned long long>(MAPPED_VIEW_SIZE, offset - start + length),
+		m_Size - start
+	));
+
+	void* pView = MapViewOfFile(m_hMapping,
+		                        FILE_MAP_READ,
+		                        static_cast<DWORD>(start >> 32),
+		                        static_cast<DWORD>(start & 0xFFFFFFFF),
+		                        size);
+
+	if (pView == nullptr)
+	{
+		Logger::Write(L"Failed to map a view of a file (error %u)", GetLastError());
+		return nullptr;
+	}
+
+	m_pView = static_cast<const char*>(pView);
+	m_ViewOffset = start;
+	m_ViewSize = size;
+
+	return m_pView + (offset - start);
+}
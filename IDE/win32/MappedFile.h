@@ -0,0 +1,52 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <cstddef>
+
+// Bytes mapped at once, files bigger than this are viewed through a sliding window
+#define MAPPED_VIEW_SIZE (16 * 1024 * 1024)
+
+/// <summary>
+/// Read only memory mapping of a file. Only a window of the file is mapped
+/// at any time so even files bigger than the address space can be read,
+/// and the pages are loaded by the system only when they are touched.
+/// The IDE only runs on Windows, so this is a file mapping object viewed
+/// with MapViewOfFile, there's no mmap version of it.
+/// </summary>
+class MappedFile
+{
+private:
+	HANDLE m_hFile = INVALID_HANDLE_VALUE;
+	HANDLE m_hMapping = nullptr;
+
+	unsigned long long m_Size = 0;
+	size_t m_Granularity = 0;
+
+	const char* m_pView = nullptr;
+	unsigned long long m_ViewOffset = 0;
+	size_t m_ViewSize = 0;
+
+	void Unmap(void);
+
+public:
+	MappedFile(void);
+	~MappedFile(void);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const wchar_t* lpszPath);
+	void Close(void);
+
+	bool IsOpen(void) const;
+	unsigned long long GetSize(void) const { return m_Size; }
+
+	/// <summary>
+	/// Maps the part of the file that starts at 'offset' if it isn't mapped already
+	/// </summary>
+	/// <returns> Pointer to the byte at 'offset' that stays valid for 'length' bytes
+	/// (or up to the end of the file) until the next call, nullptr on failure </returns>
+	const char* GetView(unsigned long long offset, size_t length);
+};
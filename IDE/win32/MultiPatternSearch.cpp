@@ -0,0 +1,371 @@
+#include "MultiPatternSearch.h"
+
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SEARCH_USE_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// A state of the trie that has no child for a column yet
+#define NO_STATE 0xFFFFFFFFu
+
+// Characters of the BMP, the ones past it can only start a pattern if a pattern has them
+#define BMP_SIZE 0x10000
+
+uint16_t MultiPatternSearcher::GetColumn(wchar_t ch) const
+{
+	if (ch < 128)
+	{
+		return m_AsciiColumns[ch];
+	}
+
+	if (!m_Options.matchCase)
+	{
+		ch = TextSearch::FoldChar(ch);
+
+		if (ch < 128)
+		{
+			return m_AsciiColumns[ch];
+		}
+	}
+
+	const auto it = std::lower_bound(m_OtherColumns.begin(), m_OtherColumns.end(), std::make_pair(ch, static_cast<uint16_t>(0)));
+
+	return it != m_OtherColumns.end() && it->first == ch ? it->second : 0;
+}
+
+uint16_t MultiPatternSearcher::AddColumn(wchar_t ch)
+{
+	const uint16_t column = GetColumn(ch);
+
+	if (column != 0)
+	{
+		return column;
+	}
+
+	const uint16_t added = static_cast<uint16_t>(m_ColumnCount++);
+
+	if (ch < 128)
+	{
+		m_AsciiColumns[ch] = added;
+	}
+
+	else
+	{
+		const auto pair = std::make_pair(ch, added);
+		m_OtherColumns.insert(std::lower_bound(m_OtherColumns.begin(), m_OtherColumns.end(), pair), pair);
+	}
+
+	return added;
+}
+
+/// <summary>
+/// Builds the trie of the patterns, then fills in the transitions it's
+/// missing by following the failure links in breadth first order, so that
+/// the text never has to go back along a failure link while it's scanned.
+/// </summary>
+MultiPatternSearcher::MultiPatternSearcher(const std::vector<std::wstring>& patterns, const SearchOptions& options)
+	: m_Options(options)
+{
+	std::vector<std::wstring> folded(patterns);
+
+	for (std::wstring& pattern : folded)
+	{
+		for (wchar_t& ch : pattern)
+		{
+			if (!m_Options.matchCase)
+			{
+				ch = TextSearch::FoldChar(ch);
+			}
+
+			AddColumn(ch);
+		}
+	}
+
+	// Upper case letters go to the column of their lower case
+	if (!m_Options.matchCase)
+	{
+		for (wchar_t ch = 0; ch < 128; ++ch)
+		{
+			const wchar_t foldedChar = TextSearch::FoldChar(ch);
+
+			if (foldedChar != ch)
+			{
+				m_AsciiColumns[ch] = GetColumn(foldedChar);
+			}
+		}
+	}
+
+	const size_t columnCount = m_ColumnCount;
+
+	std::vector<uint32_t> next(columnCount, NO_STATE);
+	std::vector<std::vector<uint32_t>> outputs(1);
+
+	m_PatternLengths.resize(folded.size(), 0);
+
+	for (size_t index = 0; index < folded.size(); ++index)
+	{
+		const std::wstring& pattern = folded[index];
+
+		// The offsets of the rows have to fit next to the flag, a pattern that doesn't is never found
+		if (pattern.empty() || (outputs.size() + pattern.length()) * columnCount >= MULTI_PATTERN_OUTPUT_FLAG)
+		{
+			continue;
+		}
+
+		uint32_t state = 0;
+
+		for (wchar_t ch : pattern)
+		{
+			uint32_t& child = next[state * columnCount + GetColumn(ch)];
+
+			if (child == NO_STATE)
+			{
+				child = static_cast<uint32_t>(outputs.size());
+				outputs.emplace_back();
+				next.resize(next.size() + columnCount, NO_STATE);
+			}
+
+			state = next[state * columnCount + GetColumn(ch)];
+		}
+
+		outputs[state].push_back(static_cast<uint32_t>(index));
+		m_PatternLengths[index] = static_cast<uint32_t>(pattern.length());
+	}
+
+	const size_t stateCount = outputs.size();
+
+	std::vector<uint32_t> fail(stateCount, 0);
+	std::vector<uint32_t> order;
+	order.reserve(stateCount);
+
+	// A character that starts no pattern stays in the root
+	for (size_t column = 0; column < columnCount; ++column)
+	{
+		if (next[column] == NO_STATE)
+		{
+			next[column] = 0;
+		}
+
+		else
+		{
+			order.push_back(next[column]);
+		}
+	}
+
+	// The state a failure link leads to is shallower, so its transitions are complete by then
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const uint32_t state = order[i];
+		const uint32_t* pFailRow = &next[fail[state] * columnCount];
+
+		for (size_t column = 0; column < columnCount; ++column)
+		{
+			uint32_t& child = next[state * columnCount + column];
+
+			if (child == NO_STATE)
+			{
+				child = pFailRow[column];
+			}
+
+			else
+			{
+				fail[child] = pFailRow[column];
+				order.push_back(child);
+			}
+		}
+
+		const std::vector<uint32_t>& inherited = outputs[fail[state]];
+		outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+	}
+
+	m_OutputStart.reserve(stateCount + 1);
+
+	for (const std::vector<uint32_t>& output : outputs)
+	{
+		m_OutputStart.push_back(static_cast<uint32_t>(m_Outputs.size()));
+		m_Outputs.insert(m_Outputs.end(), output.begin(), output.end());
+	}
+
+	m_OutputStart.push_back(static_cast<uint32_t>(m_Outputs.size()));
+
+	m_Transitions.resize(next.size());
+
+	for (size_t i = 0; i < next.size(); ++i)
+	{
+		m_Transitions[i] = static_cast<uint32_t>(next[i] * columnCount) | (outputs[next[i]].empty() ? 0 : MULTI_PATTERN_OUTPUT_FLAG);
+	}
+
+	FindStartChars();
+}
+
+/// <summary>
+/// Without matching case any character that folds to the first character
+/// of a pattern starts it, so every character is tried
+/// </summary>
+void MultiPatternSearcher::FindStartChars(void)
+{
+	m_StartCharCount = 0;
+
+	// False once there are too many of them to compare against
+	const auto addStartChar = [this](wchar_t ch) {
+		if (m_Transitions[GetColumn(ch)] == 0)
+		{
+			return true;
+		}
+
+		if (m_StartCharCount == MAX_START_CHARS)
+		{
+			m_StartCharCount = 0;
+			return false;
+		}
+
+		m_StartChars[m_StartCharCount++] = ch;
+		return true;
+	};
+
+	for (uint32_t ch = 0; ch < BMP_SIZE; ++ch)
+	{
+		if (!addStartChar(static_cast<wchar_t>(ch)))
+		{
+			return;
+		}
+	}
+
+	for (const auto& column : m_OtherColumns)
+	{
+		if (static_cast<uint32_t>(column.first) >= BMP_SIZE && !addStartChar(column.first))
+		{
+			return;
+		}
+	}
+}
+
+#ifdef SEARCH_USE_SIMD
+static inline unsigned long GetLowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline __m128i SetChars(wchar_t ch)
+{
+	return sizeof(wchar_t) == 2 ? _mm_set1_epi16(static_cast<short>(ch)) : _mm_set1_epi32(static_cast<int>(ch));
+}
+
+static inline __m128i CompareChars(__m128i a, __m128i b)
+{
+	return sizeof(wchar_t) == 2 ? _mm_cmpeq_epi16(a, b) : _mm_cmpeq_epi32(a, b);
+}
+
+/* The characters that can start a pattern, each one repeated across a vector */
+struct StartCharVectors {
+	__m128i chars[MAX_START_CHARS];
+	size_t count = 0;
+};
+
+/// <summary>
+/// Skips the blocks of the text that have none of the characters
+/// </summary>
+/// <returns> Position of the first one, or where there's less than a block left </returns>
+static size_t SkipBlocks(const StartCharVectors& startChars, const wchar_t* pText, size_t start, size_t length)
+{
+	const size_t width = sizeof(__m128i) / sizeof(wchar_t);
+
+	for (; length - start >= width; start += width)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pText + start));
+		__m128i matches = CompareChars(block, startChars.chars[0]);
+
+		for (size_t i = 1; i < startChars.count; ++i)
+		{
+			matches = _mm_or_si128(matches, CompareChars(block, startChars.chars[i]));
+		}
+
+		const uint32_t mask = _mm_movemask_epi8(matches);
+
+		if (mask != 0)
+		{
+			return start + GetLowestBit(mask) / sizeof(wchar_t);
+		}
+	}
+
+	return start;
+}
+#endif
+
+void MultiPatternSearcher::ReportMatches(const wchar_t* pText, size_t length, size_t end, uint32_t row, std::vector<PatternMatch>& matches) const
+{
+	const size_t state = (row & ~MULTI_PATTERN_OUTPUT_FLAG) / m_ColumnCount;
+
+	for (uint32_t i = m_OutputStart[state]; i < m_OutputStart[state + 1]; ++i)
+	{
+		PatternMatch match;
+		match.pattern = m_Outputs[i];
+		match.position = end - m_PatternLengths[match.pattern];
+
+		if (m_Options.wholeWord && ((match.position > 0 && TextSearch::IsWordChar(pText[match.position - 1])) ||
+			                        (end < length && TextSearch::IsWordChar(pText[end]))))
+		{
+			continue;
+		}
+
+		matches.push_back(match);
+	}
+}
+
+void MultiPatternSearcher::FindAll(const wchar_t* pText, size_t length, std::vector<PatternMatch>& matches) const
+{
+	const uint32_t* pTransitions = m_Transitions.data();
+	uint32_t row = 0;
+
+#ifdef SEARCH_USE_SIMD
+	StartCharVectors startChars;
+	startChars.count = m_StartCharCount;
+
+	for (size_t i = 0; i < m_StartCharCount; ++i)
+	{
+		startChars.chars[i] = SetChars(m_StartChars[i]);
+	}
+#endif
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (row == 0)
+		{
+#ifdef SEARCH_USE_SIMD
+			if (startChars.count != 0)
+			{
+				i = SkipBlocks(startChars, pText, i, length);
+			}
+#endif
+
+			while (i < length && pTransitions[GetColumn(pText[i])] == 0)
+			{
+				++i;
+			}
+
+			if (i == length)
+			{
+				break;
+			}
+		}
+
+		row = pTransitions[(row & ~MULTI_PATTERN_OUTPUT_FLAG) + GetColumn(pText[i])];
+
+		if (row & MULTI_PATTERN_OUTPUT_FLAG)
+		{
+			ReportMatches(pText, length, i + 1, row, matches);
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "TextSearch.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Set in a transition whose target state ends at least one pattern
+#define MULTI_PATTERN_OUTPUT_FLAG 0x80000000u
+
+// Up to this many characters that start a pattern are looked for with vector compares
+#define MAX_START_CHARS 4
+
+/* An occurrence of one of the patterns of a MultiPatternSearcher */
+struct PatternMatch {
+	size_t position = 0;
+
+	// Index of the pattern in the list the searcher was built from
+	uint32_t pattern = 0;
+};
+
+/// <summary>
+/// Finds every occurrence of many patterns in a single pass over the text,
+/// with an Aho-Corasick automaton turned into a table of transitions.
+/// Only the characters the patterns use get a column of their own, every
+/// other character shares column 0, so a row is as short as the number of
+/// distinct characters in the patterns and the table stays small enough to
+/// be cached. A transition holds the offset of the row it leads to rather
+/// than the number of the state, and its top bit tells whether that state
+/// ends a pattern, so going from one character to the next is a single
+/// load and a match is only looked up when the bit is set.
+/// Outside of any pattern, the text is skipped a block at a time up to
+/// the next character that can start one, when there are few of those.
+/// Without matching case the patterns are folded once, and the text is
+/// folded a character at a time the same way TextSearcher folds it.
+/// Overlapping occurrences are all found, "aa" is found twice in "aaa",
+/// and a pattern that is the end of another is found along with it.
+/// </summary>
+class MultiPatternSearcher
+{
+private:
+	SearchOptions m_Options;
+
+	std::vector<uint32_t> m_PatternLengths;
+
+	// Column of each ASCII character, and of the other characters the patterns use, sorted
+	uint16_t m_AsciiColumns[128] = {};
+	std::vector<std::pair<wchar_t, uint16_t>> m_OtherColumns;
+	size_t m_ColumnCount = 1;
+
+	// One row per state, each transition is the offset of the next row, flagged if it ends a pattern
+	std::vector<uint32_t> m_Transitions;
+
+	// Patterns that end in each state, including those that end in the states its suffixes lead to
+	std::vector<uint32_t> m_OutputStart;
+	std::vector<uint32_t> m_Outputs;
+
+	// Every character that leads out of the root, none if there are too many to compare against
+	wchar_t m_StartChars[MAX_START_CHARS] = {};
+	size_t m_StartCharCount = 0;
+
+	uint16_t GetColumn(wchar_t ch) const;
+	uint16_t AddColumn(wchar_t ch);
+	void FindStartChars(void);
+
+	/* Adds the patterns that end right before 'end', the longest first */
+	void ReportMatches(const wchar_t* pText, size_t length, size_t end, uint32_t row, std::vector<PatternMatch>& matches) const;
+
+public:
+	/// <summary>
+	/// Empty patterns are never found, and neither are the ones that would
+	/// make the table too big to address. They keep their index, so the
+	/// indices of the others still match the list.
+	/// </summary>
+	MultiPatternSearcher(const std::vector<std::wstring>& patterns, const SearchOptions& options);
+
+	/// <summary>
+	/// Finds every occurrence of every pattern in the text
+	/// </summary>
+	/// <param name="matches"> Receives the occurrences, in order of where they end </param>
+	void FindAll(const wchar_t* pText, size_t length, std::vector<PatternMatch>& matches) const;
+
+	size_t GetPatternCount(void) const { return m_PatternLengths.size(); }
+	size_t GetPatternLength(uint32_t pattern) const { return m_PatternLengths[pattern]; }
+
+	size_t GetStateCount(void) const { return m_Transitions.size() / m_ColumnCount; }
+	size_t GetTableSize(void) const { return m_Transitions.size() * sizeof(uint32_t); }
+};
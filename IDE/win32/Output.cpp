@@ -6,6 +6,10 @@
 #include <Richedit.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <vector>
+
+// Characters the output can hold
+#define OUTPUT_MAX_LENGTH (64 * 1024 * 1024)
 
 Output::Output(HWND hParentWindow)
 {
@@ -22,6 +26,9 @@ Output::Output(HWND hParentWindow)
 		GetModuleHandle(NULL),
 		nullptr
 	);
+
+	// Appended text counts against the limit, which is only 32K characters by default
+	SendMessage(m_hWndSelf, EM_EXLIMITTEXT, NULL, OUTPUT_MAX_LENGTH);
 }
 
 void Output::Clear(void)
@@ -29,27 +36,50 @@ void Output::Clear(void)
 	SetWindowText(m_hWndSelf, L"");
 }
 
+/* Adds the text at the end without copying out what's already there */
 static void AppendText(HWND hWnd, const wchar_t* text)
 {
-	int iOutLength = GetWindowTextLength(hWnd) + lstrlen(text) + 1;
+	const int iLength = GetWindowTextLength(hWnd);
 
-	wchar_t* buffer = (wchar_t*)GlobalAlloc(GPTR, iOutLength * sizeof(wchar_t));
+	// The control is read only for the user, not for the output written to it
+	SendMessage(hWnd, EM_SETREADONLY, FALSE, NULL);
+	SendMessage(hWnd, EM_SETSEL, iLength, iLength);
+	SendMessage(hWnd, EM_REPLACESEL, FALSE, reinterpret_cast<LPARAM>(text));
+	SendMessage(hWnd, EM_SETREADONLY, TRUE, NULL);
+}
 
-	if (buffer)
+static void AppendFormat(HWND hWnd, const wchar_t* lpszFormat, va_list arglist)
+{
+	// Counting the characters uses up a copy of the arguments, the originals are for printing
+	va_list counted;
+	va_copy(counted, arglist);
+	const int iLength = _vscwprintf(lpszFormat, counted);
+	va_end(counted);
+
+	if (iLength > 0)
 	{
-		GetWindowText(hWnd, buffer, iOutLength);
-		wcscat_s(buffer, iOutLength, text);
-		SetWindowText(hWnd, buffer);
-		
-		GlobalFree(buffer);
+		std::vector<wchar_t> buffer(static_cast<size_t>(iLength) + 1);
+
+		StringCchVPrintf(
+			buffer.data(),
+			buffer.size(),
+			lpszFormat,
+			arglist
+		);
+
+		AppendText(hWnd, buffer.data());
 	}
 }
 
-// wrong lol
 void Output::WriteLine(const wchar_t* lpszFormat, ...)
 {
-	Write(lpszFormat);
+	va_list arglist;
+	va_start(arglist, lpszFormat);
+
+	AppendFormat(m_hWndSelf, lpszFormat, arglist);
 	AppendText(m_hWndSelf, L"\r\n");
+
+	va_end(arglist);
 }
 
 void Output::Write(const wchar_t* lpszFormat, ...)
@@ -57,19 +87,7 @@ void Output::Write(const wchar_t* lpszFormat, ...)
 	va_list arglist;
 	va_start(arglist, lpszFormat);
 
-	size_t size = lstrlen(lpszFormat) * 10 + 1;
-	wchar_t* buffer = new wchar_t[size];
-	
-	StringCbVPrintf(
-		buffer,
-		size * sizeof(wchar_t),
-		lpszFormat,
-		arglist
-	);
-	
-	AppendText(m_hWndSelf, buffer);
-
-	delete[] buffer;
+	AppendFormat(m_hWndSelf, lpszFormat, arglist);
 
 	va_end(arglist);
 }
\ No newline at end of file
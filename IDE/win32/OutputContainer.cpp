@@ -209,6 +209,15 @@ LRESULT OutputContainer::OnDrawItem(HWND hWnd, LPARAM lParam)
 	return 0;
 }
 
+void OutputContainer::ShowOutput(void)
+{
+	if (m_pErrorList && m_pOutput)
+	{
+		m_pErrorList->Hide();
+		m_pOutput->Show();
+	}
+}
+
 LRESULT OutputContainer::OnCommand(HWND hWnd, WPARAM wParam)
 {
 	if (m_pErrorList && m_pOutput)
@@ -221,8 +230,7 @@ LRESULT OutputContainer::OnCommand(HWND hWnd, WPARAM wParam)
 			break;
 
 		case IDC_OUTPUT_BUTTON:
-			m_pErrorList->Hide();
-			m_pOutput->Show();
+			ShowOutput();
 			break;
 		}
 	}
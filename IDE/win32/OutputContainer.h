@@ -41,5 +41,8 @@ public:
 	LRESULT WindowProcedure(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
 	inline Output* GetOutput(void) { return m_pOutput; }
+
+	/* Switches to the output, the way its button does */
+	void ShowOutput(void);
 };
 
@@ -0,0 +1,290 @@
+#include "PieceTable.h"
+
+#include <algorithm>
+#include <atomic>
+
+/* Shared by all documents, so that two different texts never get the same version */
+static size_t NextVersion(void)
+{
+	static std::atomic<size_t> lastVersion(0);
+
+	return ++lastVersion;
+}
+
+PieceTable::PieceTable(void)
+	: m_pOriginal(std::make_shared<const std::wstring>()),
+	  m_Version(NextVersion())
+{
+}
+
+PieceTable::PieceTable(const PieceTable& other)
+	: m_pOriginal(other.m_pOriginal),
+	  m_Added(other.m_Added),
+	  m_Tree(other.m_Tree),
+	  m_Root(other.m_Root),
+	  m_Length(other.m_Length),
+	  m_Version(other.m_Version)
+{
+}
+
+PieceTable& PieceTable::operator=(const PieceTable& other)
+{
+	if (this != &other)
+	{
+		m_pOriginal = other.m_pOriginal;
+		m_Added = other.m_Added;
+		m_Tree = other.m_Tree;
+		m_Root = other.m_Root;
+		m_Length = other.m_Length;
+		m_Version = other.m_Version;
+	}
+
+	return *this;
+}
+
+void PieceTable::Load(std::wstring text)
+{
+	m_Length = text.length();
+	m_Version = NextVersion();
+	m_pOriginal = std::make_shared<const std::wstring>(std::move(text));
+	m_Added.clear();
+	m_Tree.Clear();
+	m_Root = NIL;
+
+	if (m_Length > 0)
+	{
+		m_Root = m_Tree.CreateNode({ PieceSource::ORIGINAL, 0, m_Length });
+	}
+
+	for (DocumentListener* pListener : m_Listeners)
+	{
+		pListener->OnDocumentLoad(*this);
+	}
+}
+
+const wchar_t* PieceTable::GetPieceText(const Piece& piece) const
+{
+	if (piece.source == PieceSource::ORIGINAL)
+	{
+		return m_pOriginal->data() + piece.start;
+	}
+
+	return m_Added.data() + piece.start;
+}
+
+uint32_t PieceTable::FindNode(size_t position, size_t& offset, std::vector<uint32_t>* pPath) const
+{
+	if (position >= m_Length)
+	{
+		return NIL;
+	}
+
+	uint32_t node = m_Root;
+
+	while (true)
+	{
+		const Tree::Node& current = m_Tree[node];
+		const size_t leftLength = m_Tree.Sum(current.left);
+
+		if (position < leftLength)
+		{
+			if (pPath != nullptr)
+			{
+				pPath->push_back(node);
+			}
+
+			node = current.left;
+		}
+
+		else if (position < leftLength + current.value.length)
+		{
+			offset = position - leftLength;
+			return node;
+		}
+
+		else
+		{
+			position -= leftLength + current.value.length;
+			node = current.right;
+		}
+	}
+}
+
+void PieceTable::ApplyReplace(size_t position, size_t length, const wchar_t* lpszText, size_t textLength)
+{
+	uint32_t before;
+	uint32_t rest;
+	uint32_t removed;
+	uint32_t after;
+
+	m_Tree.SplitAtLength(m_Root, position, before, rest);
+	m_Tree.SplitAtLength(rest, length, removed, after);
+	m_Tree.FreeTree(removed);
+
+	if (textLength > 0)
+	{
+		// Typing continues where the previous insertion ended most of the time,
+		// so grow that piece instead of adding a new one for every character
+		uint32_t last = before;
+
+		while (last != NIL && m_Tree[last].right != NIL)
+		{
+			last = m_Tree[last].right;
+		}
+
+		if (last != NIL &&
+			m_Tree[last].value.source == PieceSource::ADDED &&
+			m_Tree[last].value.start + m_Tree[last].value.length == m_Added.length())
+		{
+			// Every node on the right edge has the piece in its subtree
+			for (uint32_t node = before; node != NIL; node = m_Tree[node].right)
+			{
+				m_Tree[node].sum += textLength;
+			}
+
+			m_Tree[last].value.length += textLength;
+		}
+
+		else
+		{
+			before = m_Tree.Merge(before, m_Tree.CreateNode({ PieceSource::ADDED, m_Added.length(), textLength }));
+		}
+
+		m_Added.append(lpszText, textLength);
+	}
+
+	m_Root = m_Tree.Merge(before, after);
+	m_Length = m_Length - length + textLength;
+	m_Version = NextVersion();
+}
+
+void PieceTable::Replace(size_t position, size_t length, const wchar_t* lpszText, size_t textLength)
+{
+	position = std::min(position, m_Length);
+	length = std::min(length, m_Length - position);
+
+	if (length == 0 && textLength == 0)
+	{
+		return;
+	}
+
+	TextEdit edit;
+	edit.position = position;
+	edit.removed = GetTextRange(position, length);
+	edit.inserted.assign(lpszText, textLength);
+
+	ApplyReplace(position, length, lpszText, textLength);
+
+	for (DocumentListener* pListener : m_Listeners)
+	{
+		pListener->OnDocumentEdit(edit);
+	}
+}
+
+void PieceTable::Insert(size_t position, const wchar_t* lpszText, size_t length)
+{
+	Replace(position, 0, lpszText, length);
+}
+
+void PieceTable::Erase(size_t position, size_t length)
+{
+	Replace(position, length, nullptr, 0);
+}
+
+wchar_t PieceTable::GetCharAt(size_t position) const
+{
+	size_t offset = 0;
+	const uint32_t node = FindNode(position, offset, nullptr);
+
+	if (node == NIL)
+	{
+		return L'\0';
+	}
+
+	return GetPieceText(m_Tree[node].value)[offset];
+}
+
+size_t PieceTable::CopyTextRange(size_t position, size_t length, wchar_t* buffer) const
+{
+	if (position >= m_Length)
+	{
+		return 0;
+	}
+
+	length = std::min(length, m_Length - position);
+
+	// The pieces after the current one are its right subtree, then the nodes left on the path
+	std::vector<uint32_t> path;
+	size_t offset = 0;
+	uint32_t node = FindNode(position, offset, &path);
+	size_t copied = 0;
+
+	while (node != NIL && copied < length)
+	{
+		const Piece& piece = m_Tree[node].value;
+		const size_t count = std::min(piece.length - offset, length - copied);
+
+		std::copy_n(GetPieceText(piece) + offset, count, buffer + copied);
+
+		copied += count;
+		offset = 0;
+
+		if (m_Tree[node].right != NIL)
+		{
+			node = m_Tree[node].right;
+
+			while (m_Tree[node].left != NIL)
+			{
+				path.push_back(node);
+				node = m_Tree[node].left;
+			}
+		}
+
+		else if (!path.empty())
+		{
+			node = path.back();
+			path.pop_back();
+		}
+
+		else
+		{
+			node = NIL;
+		}
+	}
+
+	return copied;
+}
+
+std::wstring PieceTable::GetTextRange(size_t position, size_t length) const
+{
+	std::wstring text;
+
+	if (position < m_Length)
+	{
+		text.resize(std::min(length, m_Length - position));
+		CopyTextRange(position, text.length(), &text[0]);
+	}
+
+	return text;
+}
+
+std::wstring PieceTable::GetText(void) const
+{
+	return GetTextRange(0, m_Length);
+}
+
+void PieceTable::AddListener(DocumentListener* pListener)
+{
+	if (std::find(m_Listeners.begin(), m_Listeners.end(), pListener) == m_Listeners.end())
+	{
+		m_Listeners.push_back(pListener);
+	}
+}
+
+void PieceTable::RemoveListener(DocumentListener* pListener)
+{
+	m_Listeners.erase(
+		std::remove(m_Listeners.begin(), m_Listeners.end(), pListener),
+		m_Listeners.end()
+	);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ImplicitTreap.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+class PieceTable;
+
+/* A single replacement: 'removed' was taken out at 'position' and 'inserted' was put in its place */
+struct TextEdit {
+	size_t position = 0;
+	std::wstring removed;
+	std::wstring inserted;
+};
+
+/// <summary>
+/// Implemented by anything that has to follow the edits of a document
+/// (line index, undo history, highlighter...)
+/// </summary>
+class DocumentListener
+{
+public:
+	virtual ~DocumentListener(void) = default;
+
+	/* Called after the edit has been applied to the document */
+	virtual void OnDocumentEdit(const TextEdit& edit) = 0;
+
+	/* Called after the whole text has been replaced by PieceTable::Load */
+	virtual void OnDocumentLoad(const PieceTable& document) {}
+};
+
+/// <summary>
+/// Owns the text of a source file. The text that was loaded is never modified,
+/// everything typed afterwards is appended to a second buffer and the document
+/// is described by a sequence of pieces pointing into those two buffers.
+/// The pieces are the nodes of a treap ordered by their place in the text,
+/// each node knowing the length of its subtree, so finding a position and
+/// replacing text take logarithmic time however many pieces there are.
+/// Line breaks are stored as a single '\r' so that offsets match the
+/// character positions of the rich edit control.
+/// </summary>
+class PieceTable
+{
+private:
+	enum class PieceSource { ORIGINAL, ADDED };
+
+	struct Piece {
+		PieceSource source = PieceSource::ORIGINAL;
+		size_t start = 0;
+		size_t length = 0;
+	};
+
+	/* A node holds one piece, cutting it keeps its start in the node */
+	struct PieceTraits {
+		typedef Piece Value;
+
+		static size_t GetLength(const Piece& piece) { return piece.length; }
+
+		static Piece Cut(Piece& piece, size_t offset)
+		{
+			Piece second = piece;
+			second.start += offset;
+			second.length -= offset;
+			piece.length = offset;
+
+			return second;
+		}
+	};
+
+	typedef ImplicitTreap<PieceTraits> Tree;
+
+	static constexpr uint32_t NIL = Tree::NIL;
+
+	// Shared so that copies of the document (e.g. for saving) don't copy the loaded text
+	std::shared_ptr<const std::wstring> m_pOriginal;
+	std::wstring m_Added;
+
+	// Copying the tree copies the nodes as they are, nodes of removed pieces are reused
+	Tree m_Tree;
+	uint32_t m_Root = NIL;
+	size_t m_Length = 0;
+
+	// Changes with every edit, copies keep the version of the document they were made from
+	size_t m_Version = 0;
+
+	std::vector<DocumentListener*> m_Listeners;
+
+	const wchar_t* GetPieceText(const Piece& piece) const;
+
+	/// <summary>
+	/// Finds the piece that contains the position
+	/// </summary>
+	/// <param name="offset"> Receives the position within the piece </param>
+	/// <param name="pPath"> Receives the nodes that come after it in the text on the way down, can be null </param>
+	/// <returns> The node of the piece, or NIL if position is the end of the document </returns>
+	uint32_t FindNode(size_t position, size_t& offset, std::vector<uint32_t>* pPath) const;
+
+	void ApplyReplace(size_t position, size_t length, const wchar_t* lpszText, size_t textLength);
+
+public:
+	PieceTable(void);
+
+	/* Copies only the text, listeners stay with the original document */
+	PieceTable(const PieceTable& other);
+	PieceTable& operator=(const PieceTable& other);
+
+	void Load(std::wstring text);
+
+	void Insert(size_t position, const wchar_t* lpszText, size_t length);
+	void Erase(size_t position, size_t length);
+
+	/// <summary>
+	/// Replaces 'length' characters at 'position' with the text passed.
+	/// Every other modification goes through here so listeners see all edits.
+	/// </summary>
+	void Replace(size_t position, size_t length, const wchar_t* lpszText, size_t textLength);
+
+	size_t GetLength(void) const { return m_Length; }
+	size_t GetPieceCount(void) const { return m_Tree.GetNodeCount(); }
+	size_t GetVersion(void) const { return m_Version; }
+
+	wchar_t GetCharAt(size_t position) const;
+	std::wstring GetText(void) const;
+	std::wstring GetTextRange(size_t position, size_t length) const;
+
+	/* Copies min(length, GetLength() - position) characters to the buffer, no terminator is added */
+	size_t CopyTextRange(size_t position, size_t length, wchar_t* buffer) const;
+
+	void AddListener(DocumentListener* pListener);
+	void RemoveListener(DocumentListener* pListener);
+};
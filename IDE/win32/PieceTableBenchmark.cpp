@@ -0,0 +1,141 @@
+#include "PieceTableBenchmark.h"
+#include "Benchmark.h"
+#include "PieceTable.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Characters copied at a time when the whole document is read, the same as a save
+#define PIECE_TABLE_BENCHMARK_BLOCK_SIZE 65536
+
+// Characters read at a time at random places, about a screen of text
+#define PIECE_TABLE_BENCHMARK_READ_SIZE 4096
+
+// Copies of the document are slow enough to be timed one by one
+#define PIECE_TABLE_BENCHMARK_COPIES 10
+
+static const wchar_t* g_Lines[] = {
+	L"#include \"PieceTable.h\"",
+	L"static size_t GetSubtreeLength(size_t node) const;",
+	L"\tfor (size_t i = 0; i < m_Nodes.size(); ++i)",
+	L"\t{",
+	L"\t\tconst Node& current = m_Nodes[i];",
+	L"\t\tif (current.piece.length == 0 && current.left != SIZE_MAX) return false; // never happens",
+	L"\t}",
+	L"/* The pieces after the current one are its right subtree, then the nodes left on the path */",
+	L"",
+	L"\tLogger::Write(L\"Failed to open %ls for mapping\", lpszPath);"
+};
+
+/* Lines of source code with a random number here and there so that no two blocks are the same */
+static void GenerateDocument(std::wstring& text)
+{
+	std::mt19937 random(0x5054);
+
+	text.reserve(PIECE_TABLE_BENCHMARK_DOCUMENT_SIZE + 128);
+
+	while (text.length() < PIECE_TABLE_BENCHMARK_DOCUMENT_SIZE)
+	{
+		text += g_Lines[random() % (sizeof(g_Lines) / sizeof(g_Lines[0]))];
+
+		if (random() % 4 == 0)
+		{
+			text += L" // " + std::to_wstring(random());
+		}
+
+		text.push_back(L'\r');
+	}
+
+	text.resize(PIECE_TABLE_BENCHMARK_DOCUMENT_SIZE);
+}
+
+static void WriteResult(FILE* pFile, const char* lpszOperation, size_t count, const PieceTable& document, const Benchmark::OperationResult& result)
+{
+	fprintf(pFile, "{\"operation\":\"%s\",\"count\":%llu,\"pieces\":%llu,\"length\":%llu,",
+		    lpszOperation, static_cast<unsigned long long>(count), static_cast<unsigned long long>(document.GetPieceCount()),
+		    static_cast<unsigned long long>(document.GetLength()));
+	Benchmark::WriteResult(pFile, "", result);
+	fprintf(pFile, "}\n");
+	fflush(pFile);
+}
+
+bool PieceTableBenchmark::Run(const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	PieceTable document;
+
+	{
+		std::wstring text;
+		GenerateDocument(text);
+
+		const Benchmark::Clock::time_point loadStart = Benchmark::Clock::now();
+		document.Load(std::move(text));
+
+		fprintf(pOutput, "{\"characters\":%llu,\"load_ms\":%.1f}\n",
+			    static_cast<unsigned long long>(document.GetLength()), Benchmark::GetMicroseconds(Benchmark::Clock::now() - loadStart) / 1000.0);
+		fflush(pOutput);
+	}
+
+	// The same edits every time, so that the results of two builds can be compared
+	std::mt19937 random(0x5054);
+	const wchar_t* lpszInserted = L"abcdefgh";
+
+	WriteResult(pOutput, "insert", PIECE_TABLE_BENCHMARK_OPERATIONS, document, Benchmark::MeasureOperation(PIECE_TABLE_BENCHMARK_OPERATIONS, [&](size_t) {
+		document.Insert(random() % (document.GetLength() + 1), lpszInserted, 1 + random() % 8);
+	}));
+
+	WriteResult(pOutput, "erase", PIECE_TABLE_BENCHMARK_OPERATIONS, document, Benchmark::MeasureOperation(PIECE_TABLE_BENCHMARK_OPERATIONS, [&](size_t) {
+		document.Erase(random() % document.GetLength(), 1 + random() % 16);
+	}));
+
+	// One character after the other at the same place, what the edit does most of the time
+	const size_t typingStart = random() % document.GetLength();
+
+	WriteResult(pOutput, "type", PIECE_TABLE_BENCHMARK_OPERATIONS, document, Benchmark::MeasureOperation(PIECE_TABLE_BENCHMARK_OPERATIONS, [&](size_t i) {
+		document.Insert(typingStart + i, lpszInserted + i % 8, 1);
+	}));
+
+	// Summed up so that the reads can't be optimized away
+	size_t checksum = 0;
+
+	WriteResult(pOutput, "read_char", PIECE_TABLE_BENCHMARK_OPERATIONS, document, Benchmark::MeasureOperation(PIECE_TABLE_BENCHMARK_OPERATIONS, [&](size_t) {
+		checksum += document.GetCharAt(random() % document.GetLength());
+	}));
+
+	std::vector<wchar_t> block(PIECE_TABLE_BENCHMARK_BLOCK_SIZE);
+
+	WriteResult(pOutput, "read_block", PIECE_TABLE_BENCHMARK_OPERATIONS, document, Benchmark::MeasureOperation(PIECE_TABLE_BENCHMARK_OPERATIONS, [&](size_t) {
+		checksum += document.CopyTextRange(random() % document.GetLength(), PIECE_TABLE_BENCHMARK_READ_SIZE, block.data());
+	}));
+
+	WriteResult(pOutput, "copy", PIECE_TABLE_BENCHMARK_COPIES, document, Benchmark::MeasureOperation(PIECE_TABLE_BENCHMARK_COPIES, [&](size_t) {
+		const PieceTable copy(document);
+		checksum += copy.GetLength();
+	}));
+
+	const Benchmark::Clock::time_point readStart = Benchmark::Clock::now();
+
+	for (size_t position = 0; position < document.GetLength(); position += PIECE_TABLE_BENCHMARK_BLOCK_SIZE)
+	{
+		checksum += document.CopyTextRange(position, PIECE_TABLE_BENCHMARK_BLOCK_SIZE, block.data());
+	}
+
+	const double readSeconds = Benchmark::GetMicroseconds(Benchmark::Clock::now() - readStart) / 1000000.0;
+
+	fprintf(pOutput, "{\"operation\":\"read_all\",\"pieces\":%llu,\"length\":%llu,\"mb_per_s\":%.1f,\"checksum\":%llu}\n",
+		    static_cast<unsigned long long>(document.GetPieceCount()), static_cast<unsigned long long>(document.GetLength()),
+		    document.GetLength() * sizeof(wchar_t) / BYTES_PER_MEGABYTE / readSeconds, static_cast<unsigned long long>(checksum));
+
+	return fclose(pOutput) == 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-piece-table
+#define PIECE_TABLE_BENCHMARK_ARGUMENT L"--benchmark-piece-table"
+
+// Written to the current directory, one line of JSON for the document and one per operation
+#define PIECE_TABLE_BENCHMARK_OUTPUT_FILE L"piece-table-benchmark.jsonl"
+
+// Characters of the generated document, as many bytes as a 100 MB file of ASCII source
+#define PIECE_TABLE_BENCHMARK_DOCUMENT_SIZE (100 * 1024 * 1024)
+
+// Edits and reads of each operation
+#define PIECE_TABLE_BENCHMARK_OPERATIONS 200000
+
+/// <summary>
+/// Measures the document of an edit on a generated 100 MB source file:
+/// inserting and erasing at random places, typing at one place, reading
+/// single characters and blocks at random places, copying the document
+/// the way a save does, and reading it all out. Every edit also splits a
+/// piece, so the later operations run on a document of hundreds of
+/// thousands of pieces. Each operation reports the average and the worst
+/// time of a single call, the worst is what a keystroke would feel.
+/// </summary>
+namespace PieceTableBenchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszOutputPath);
+}
@@ -0,0 +1,1902 @@
+#include "Regex.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <map>
+#include <unordered_map>
+
+// Groups can't be nested deeper than this, the parser recurses for each one
+#define MAX_NESTING_DEPTH 256
+
+// Repetitions without an upper bound
+#define UNBOUNDED SIZE_MAX
+
+// Marks an entry of the thread stack that puts a group slot back
+#define RESTORE_SLOT UINT32_MAX
+
+// Characters the DFA tells apart, the 16 bits of a UTF-16 unit
+#define DFA_CHAR_COUNT 0x10000
+
+// Consuming instructions that match different characters, past this the
+// character classes would take too long to work out and the DFA isn't used
+#define DFA_MAX_MATCHERS 62
+
+// A DFA that grows past these gives up, and the Pike VM does the search
+#define DFA_MAX_STATES 4096
+#define DFA_MAX_TRANSITIONS (4 * 1024 * 1024)
+
+// Transitions that haven't been worked out yet, and the ones that gave up
+#define DFA_UNKNOWN -1
+#define DFA_GAVE_UP -2
+
+// Flags of a DFA state, next to the kind of the character before it
+#define DFA_KIND_MASK 3
+#define DFA_INJECT 4      // A thread starts at the position, with the lowest priority
+#define DFA_ANCHORED 8    // Only at the first position
+#define DFA_NOT_EMPTY 16  // Matches that end where they start don't count
+
+enum : uint32_t {
+	ASSERT_LINE_START,
+	ASSERT_LINE_END,
+	ASSERT_WORD_BOUNDARY,
+	ASSERT_NOT_WORD_BOUNDARY,
+
+	// Whole word matching puts these around the pattern
+	ASSERT_NO_WORD_BEFORE,
+	ASSERT_NO_WORD_AFTER
+};
+
+enum : uint32_t {
+	PREDICATE_DIGIT = 1,
+	PREDICATE_NOT_DIGIT = 2,
+	PREDICATE_WORD = 4,
+	PREDICATE_NOT_WORD = 8,
+	PREDICATE_SPACE = 16,
+	PREDICATE_NOT_SPACE = 32,
+	PREDICATE_LINE_BREAK = 64
+};
+
+// What the assertions need to know about the characters on either side of a position
+enum : uint32_t {
+	KIND_OTHER,
+	KIND_WORD,
+
+	// A line break, or the start or end of the text
+	KIND_LINE
+};
+
+/* A node of the parsed pattern, the nodes refer to each other by index */
+struct RegexNode {
+	enum class Type { EMPTY, CHAR, ANY, CLASS, ASSERT, CONCAT, ALTERNATE, GROUP, REPEAT };
+
+	Type type = Type::EMPTY;
+	wchar_t ch = 0;
+
+	// The assertion, or the index of a capturing group
+	uint32_t value = 0;
+
+	size_t min = 0;
+	size_t max = 0;
+	bool isGreedy = true;
+
+	std::vector<std::pair<wchar_t, wchar_t>> ranges;
+	uint32_t predicates = 0;
+	bool isNegated = false;
+
+	std::vector<size_t> children;
+};
+
+/* A set of threads of the program, the way the Pike VM would have them at some position */
+struct RegexDfaState {
+	// By priority, what they are waiting for hasn't been followed yet
+	std::vector<uint32_t> pcs;
+	uint32_t flags = 0;
+
+	// Nothing left that could match
+	bool isDead = false;
+
+	// Nothing but the thread that starts at every position, the prefix can be skipped to
+	bool isIdle = false;
+
+	// For every character class the next state shifted left, with whether a match ended before the character
+	std::vector<int32_t> next;
+
+	// Whether a match ends at the end of the range, by the kind of character after it
+	int8_t finals[3] = { DFA_UNKNOWN, DFA_UNKNOWN, DFA_UNKNOWN };
+};
+
+/// <summary>
+/// The states of the DFA are worked out while the text is read, only the
+/// ones the text leads to are ever built
+/// </summary>
+struct RegexDfa {
+	std::vector<RegexDfaState> states;
+
+	// The flags followed by the program counters of each state
+	std::map<std::vector<uint32_t>, int32_t> ids;
+
+	// Runs backward through the reversed program and finds the longest match instead of the first
+	bool isReversed = false;
+	bool hasGivenUp = false;
+
+	std::vector<uint32_t> key;
+	std::vector<uint32_t> pcs;
+	std::vector<uint32_t> stack;
+
+	// Program counters are visited when they hold the current generation
+	std::vector<uint32_t> visited;
+	uint32_t generation = 0;
+};
+
+/* What the machine needs while it runs, kept between runs so nothing is allocated per match */
+struct RegexMachine {
+	/* Sparse set of program counters, in the order they were added, with the groups of each thread */
+	struct ThreadList {
+		std::vector<uint32_t> sparse;
+		std::vector<uint32_t> dense;
+		size_t count = 0;
+
+		std::vector<size_t> slots;
+
+		bool Contains(uint32_t pc) const
+		{
+			const uint32_t index = sparse[pc];
+			return index < count && dense[index] == pc;
+		}
+
+		void Insert(uint32_t pc)
+		{
+			sparse[pc] = static_cast<uint32_t>(count);
+			dense[count++] = pc;
+		}
+	};
+
+	struct StackEntry {
+		uint32_t pc;
+		uint32_t slot;
+		size_t value;
+	};
+
+	ThreadList lists[2];
+	std::vector<size_t> scratch;
+	std::vector<StackEntry> stack;
+
+	// Forward and reverse
+	RegexDfa dfas[2];
+
+	RegexMachine(size_t programSize, size_t slotCount)
+	{
+		dfas[1].isReversed = true;
+
+		for (ThreadList& list : lists)
+		{
+			list.sparse.resize(programSize);
+			list.dense.resize(programSize);
+			list.slots.resize(programSize * slotCount);
+		}
+
+		scratch.resize(slotCount);
+	}
+};
+
+/// <summary>
+/// Recursive descent over the pattern, into a tree of RegexNode
+/// </summary>
+class RegexParser
+{
+private:
+	const std::wstring& m_Pattern;
+	std::vector<RegexNode>& m_Nodes;
+
+	size_t m_Position = 0;
+	size_t m_Depth = 0;
+	size_t m_GroupCount = 1;
+
+	std::wstring m_Error;
+
+	bool Fail(const wchar_t* lpszError)
+	{
+		m_Error = lpszError;
+		m_Error.append(L" (at character ");
+		m_Error.append(std::to_wstring(std::min(m_Position, m_Pattern.length()) + 1));
+		m_Error.push_back(L')');
+
+		return false;
+	}
+
+	size_t AddNode(RegexNode node)
+	{
+		m_Nodes.push_back(std::move(node));
+		return m_Nodes.size() - 1;
+	}
+
+	bool IsAtEnd(void) const { return m_Position >= m_Pattern.length(); }
+
+	bool ParseAlternation(size_t& index);
+	bool ParseConcatenation(size_t& index);
+	bool ParseRepetition(size_t& index);
+	bool ParseAtom(size_t& index);
+	bool ParseClass(size_t& index);
+	bool ParseEscape(wchar_t& ch, uint32_t& predicates);
+	bool ParseHex(size_t digitCount, wchar_t& ch);
+	bool ParseCount(size_t& position, size_t& min, size_t& max) const;
+
+public:
+	RegexParser(const std::wstring& pattern, std::vector<RegexNode>& nodes)
+		: m_Pattern(pattern), m_Nodes(nodes) {}
+
+	bool Parse(size_t& root)
+	{
+		if (!ParseAlternation(root))
+		{
+			return false;
+		}
+
+		// The only thing that stops an alternation early
+		if (!IsAtEnd())
+		{
+			return Fail(L"Unmatched )");
+		}
+
+		return true;
+	}
+
+	size_t GetGroupCount(void) const { return m_GroupCount; }
+	const std::wstring& GetError(void) const { return m_Error; }
+};
+
+bool RegexParser::ParseAlternation(size_t& index)
+{
+	RegexNode node;
+	node.type = RegexNode::Type::ALTERNATE;
+
+	for (;;)
+	{
+		size_t child;
+
+		if (!ParseConcatenation(child))
+		{
+			return false;
+		}
+
+		node.children.push_back(child);
+
+		if (IsAtEnd() || m_Pattern[m_Position] != L'|')
+		{
+			break;
+		}
+
+		++m_Position;
+	}
+
+	index = node.children.size() == 1 ? node.children[0] : AddNode(std::move(node));
+
+	return true;
+}
+
+bool RegexParser::ParseConcatenation(size_t& index)
+{
+	RegexNode node;
+	node.type = RegexNode::Type::CONCAT;
+
+	while (!IsAtEnd() && m_Pattern[m_Position] != L'|' && m_Pattern[m_Position] != L')')
+	{
+		size_t child;
+
+		if (!ParseRepetition(child))
+		{
+			return false;
+		}
+
+		node.children.push_back(child);
+	}
+
+	if (node.children.empty())
+	{
+		index = AddNode(RegexNode());
+	}
+
+	else
+	{
+		index = node.children.size() == 1 ? node.children[0] : AddNode(std::move(node));
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Reads {n}, {n,} or {n,m} at 'position'
+/// </summary>
+/// <returns> False if it isn't one, the brace is an ordinary character then </returns>
+bool RegexParser::ParseCount(size_t& position, size_t& min, size_t& max) const
+{
+	const size_t length = m_Pattern.length();
+	size_t i = position + 1;
+
+	const auto parseNumber = [&](size_t& value) {
+		const size_t start = i;
+		value = 0;
+
+		for (; i < length && m_Pattern[i] >= L'0' && m_Pattern[i] <= L'9'; ++i)
+		{
+			// Anything past the limit is an error later, it only has to stay past it
+			value = std::min<size_t>(value * 10 + (m_Pattern[i] - L'0'), REGEX_MAX_REPEAT + 1);
+		}
+
+		return i > start;
+	};
+
+	if (!parseNumber(min))
+	{
+		return false;
+	}
+
+	max = min;
+
+	if (i < length && m_Pattern[i] == L',')
+	{
+		++i;
+
+		if (!parseNumber(max))
+		{
+			max = UNBOUNDED;
+		}
+	}
+
+	if (i >= length || m_Pattern[i] != L'}')
+	{
+		return false;
+	}
+
+	position = i + 1;
+
+	return true;
+}
+
+bool RegexParser::ParseRepetition(size_t& index)
+{
+	if (!ParseAtom(index))
+	{
+		return false;
+	}
+
+	bool isRepeated = false;
+
+	while (!IsAtEnd())
+	{
+		size_t min, max;
+		size_t next = m_Position + 1;
+
+		switch (m_Pattern[m_Position])
+		{
+		case L'*': min = 0; max = UNBOUNDED; break;
+		case L'+': min = 1; max = UNBOUNDED; break;
+		case L'?': min = 0; max = 1; break;
+
+		case L'{':
+			next = m_Position;
+
+			if (!ParseCount(next, min, max))
+			{
+				return true;
+			}
+
+			break;
+
+		default:
+			return true;
+		}
+
+		// Things like a** and ^* are mistakes
+		if (isRepeated || m_Nodes[index].type == RegexNode::Type::ASSERT)
+		{
+			return Fail(L"Nothing to repeat");
+		}
+
+		if ((max != UNBOUNDED && max > REGEX_MAX_REPEAT) || min > REGEX_MAX_REPEAT)
+		{
+			return Fail(L"Repetition count is too large");
+		}
+
+		if (min > max)
+		{
+			return Fail(L"Repetition counts are out of order");
+		}
+
+		m_Position = next;
+
+		RegexNode node;
+		node.type = RegexNode::Type::REPEAT;
+		node.min = min;
+		node.max = max;
+		node.children.push_back(index);
+
+		if (!IsAtEnd() && m_Pattern[m_Position] == L'?')
+		{
+			node.isGreedy = false;
+			++m_Position;
+		}
+
+		index = AddNode(std::move(node));
+		isRepeated = true;
+	}
+
+	return true;
+}
+
+bool RegexParser::ParseAtom(size_t& index)
+{
+	RegexNode node;
+	const wchar_t ch = m_Pattern[m_Position++];
+
+	switch (ch)
+	{
+	case L'(':
+	{
+		bool isCapturing = true;
+
+		if (m_Pattern.compare(m_Position, 2, L"?:") == 0)
+		{
+			isCapturing = false;
+			m_Position += 2;
+		}
+
+		else if (!IsAtEnd() && m_Pattern[m_Position] == L'?')
+		{
+			return Fail(L"Only (?: groups are supported");
+		}
+
+		if (++m_Depth > MAX_NESTING_DEPTH)
+		{
+			return Fail(L"Groups are nested too deeply");
+		}
+
+		const uint32_t group = isCapturing ? static_cast<uint32_t>(m_GroupCount++) : 0;
+		size_t child;
+
+		if (!ParseAlternation(child))
+		{
+			return false;
+		}
+
+		--m_Depth;
+
+		if (IsAtEnd())
+		{
+			return Fail(L"Missing )");
+		}
+
+		++m_Position;
+
+		if (!isCapturing)
+		{
+			index = child;
+			return true;
+		}
+
+		node.type = RegexNode::Type::GROUP;
+		node.value = group;
+		node.children.push_back(child);
+		break;
+	}
+
+	case L'[':
+		return ParseClass(index);
+
+	case L'.':
+		node.type = RegexNode::Type::ANY;
+		break;
+
+	case L'^':
+	case L'$':
+		node.type = RegexNode::Type::ASSERT;
+		node.value = ch == L'^' ? ASSERT_LINE_START : ASSERT_LINE_END;
+		break;
+
+	case L'*':
+	case L'+':
+	case L'?':
+		--m_Position;
+		return Fail(L"Nothing to repeat");
+
+	case L'\\':
+		if (!IsAtEnd() && (m_Pattern[m_Position] == L'b' || m_Pattern[m_Position] == L'B'))
+		{
+			node.type = RegexNode::Type::ASSERT;
+			node.value = m_Pattern[m_Position++] == L'b' ? ASSERT_WORD_BOUNDARY : ASSERT_NOT_WORD_BOUNDARY;
+			break;
+		}
+
+		if (!ParseEscape(node.ch, node.predicates))
+		{
+			return false;
+		}
+
+		node.type = node.predicates != 0 ? RegexNode::Type::CLASS : RegexNode::Type::CHAR;
+		break;
+
+	default:
+	{
+		size_t next = m_Position - 1, min, max;
+
+		if (ch == L'{' && ParseCount(next, min, max))
+		{
+			--m_Position;
+			return Fail(L"Nothing to repeat");
+		}
+
+		node.type = RegexNode::Type::CHAR;
+		node.ch = ch;
+		break;
+	}
+	}
+
+	index = AddNode(std::move(node));
+
+	return true;
+}
+
+bool RegexParser::ParseClass(size_t& index)
+{
+	RegexNode node;
+	node.type = RegexNode::Type::CLASS;
+
+	if (!IsAtEnd() && m_Pattern[m_Position] == L'^')
+	{
+		node.isNegated = true;
+		++m_Position;
+	}
+
+	// A ']' right at the start is a character of the class
+	bool isFirst = true;
+
+	const auto parseChar = [this](wchar_t& ch, uint32_t& predicates) {
+		predicates = 0;
+
+		if (m_Pattern[m_Position] != L'\\')
+		{
+			ch = m_Pattern[m_Position++];
+			return true;
+		}
+
+		++m_Position;
+
+		return ParseEscape(ch, predicates);
+	};
+
+	for (;;)
+	{
+		if (IsAtEnd())
+		{
+			return Fail(L"Missing ]");
+		}
+
+		if (m_Pattern[m_Position] == L']' && !isFirst)
+		{
+			++m_Position;
+			break;
+		}
+
+		isFirst = false;
+
+		wchar_t low, high;
+		uint32_t predicates;
+
+		if (!parseChar(low, predicates))
+		{
+			return false;
+		}
+
+		if (predicates != 0)
+		{
+			node.predicates |= predicates;
+			continue;
+		}
+
+		high = low;
+
+		if (m_Position + 1 < m_Pattern.length() && m_Pattern[m_Position] == L'-' && m_Pattern[m_Position + 1] != L']')
+		{
+			++m_Position;
+
+			if (!parseChar(high, predicates))
+			{
+				return false;
+			}
+
+			if (predicates != 0 || high < low)
+			{
+				return Fail(L"Invalid range");
+			}
+		}
+
+		node.ranges.push_back(std::make_pair(low, high));
+	}
+
+	index = AddNode(std::move(node));
+
+	return true;
+}
+
+bool RegexParser::ParseHex(size_t digitCount, wchar_t& ch)
+{
+	unsigned int value = 0;
+
+	for (size_t i = 0; i < digitCount; ++i, ++m_Position)
+	{
+		if (IsAtEnd() || !iswxdigit(m_Pattern[m_Position]))
+		{
+			return Fail(L"Invalid hexadecimal escape");
+		}
+
+		const wchar_t digit = m_Pattern[m_Position];
+		value = value * 16 + (digit <= L'9' ? digit - L'0' : (digit | 0x20) - L'a' + 10);
+	}
+
+	ch = static_cast<wchar_t>(value);
+
+	return true;
+}
+
+/* After a backslash, sets either the character or the predicates */
+bool RegexParser::ParseEscape(wchar_t& ch, uint32_t& predicates)
+{
+	if (IsAtEnd())
+	{
+		return Fail(L"The pattern ends with a backslash");
+	}
+
+	const wchar_t escaped = m_Pattern[m_Position++];
+
+	ch = 0;
+	predicates = 0;
+
+	switch (escaped)
+	{
+	case L'd': predicates = PREDICATE_DIGIT; return true;
+	case L'D': predicates = PREDICATE_NOT_DIGIT; return true;
+	case L'w': predicates = PREDICATE_WORD; return true;
+	case L'W': predicates = PREDICATE_NOT_WORD; return true;
+	case L's': predicates = PREDICATE_SPACE; return true;
+	case L'S': predicates = PREDICATE_NOT_SPACE; return true;
+
+	// The document breaks lines with '\r', the pattern shouldn't have to know
+	case L'n': predicates = PREDICATE_LINE_BREAK; return true;
+
+	case L'r': ch = L'\r'; return true;
+	case L't': ch = L'\t'; return true;
+	case L'f': ch = L'\f'; return true;
+	case L'v': ch = L'\v'; return true;
+	case L'0': ch = L'\0'; return true;
+	case L'x': return ParseHex(2, ch);
+	case L'u': return ParseHex(4, ch);
+	}
+
+	if (iswalnum(escaped))
+	{
+		// Points at the backslash
+		m_Position -= 2;
+
+		return Fail(escaped >= L'1' && escaped <= L'9' ? L"Backreferences aren't supported" : L"Unknown escape");
+	}
+
+	ch = escaped;
+
+	return true;
+}
+
+/// <summary>
+/// Appends the text every match of the node starts with
+/// </summary>
+/// <returns> Whether the node is only that text, so that what follows it can be appended too </returns>
+static bool CollectPrefix(const std::vector<RegexNode>& nodes, size_t index, std::wstring& prefix)
+{
+	const RegexNode& node = nodes[index];
+
+	switch (node.type)
+	{
+	case RegexNode::Type::CHAR:
+		prefix.push_back(node.ch);
+		return true;
+
+	// Take up no characters
+	case RegexNode::Type::EMPTY:
+	case RegexNode::Type::ASSERT:
+		return true;
+
+	case RegexNode::Type::GROUP:
+		return CollectPrefix(nodes, node.children[0], prefix);
+
+	case RegexNode::Type::CONCAT:
+		for (size_t child : node.children)
+		{
+			if (!CollectPrefix(nodes, child, prefix))
+			{
+				return false;
+			}
+		}
+
+		return true;
+
+	case RegexNode::Type::REPEAT:
+		if (node.min > 0)
+		{
+			CollectPrefix(nodes, node.children[0], prefix);
+		}
+
+		return false;
+
+	default:
+		return false;
+	}
+}
+
+static inline bool IsLineBreak(wchar_t ch)
+{
+	return ch == L'\r' || ch == L'\n';
+}
+
+static bool IsPredicateMatch(uint32_t predicates, wchar_t ch)
+{
+	const bool isDigit = ch >= L'0' && ch <= L'9';
+	const bool isWord = TextSearch::IsWordChar(ch);
+	const bool isSpace = iswspace(ch) || IsLineBreak(ch);
+
+	return ((predicates & PREDICATE_DIGIT) && isDigit) || ((predicates & PREDICATE_NOT_DIGIT) && !isDigit) ||
+		   ((predicates & PREDICATE_WORD) && isWord) || ((predicates & PREDICATE_NOT_WORD) && !isWord) ||
+		   ((predicates & PREDICATE_SPACE) && isSpace) || ((predicates & PREDICATE_NOT_SPACE) && !isSpace) ||
+		   ((predicates & PREDICATE_LINE_BREAK) && IsLineBreak(ch));
+}
+
+static inline uint32_t GetCharKind(wchar_t ch)
+{
+	return IsLineBreak(ch) ? KIND_LINE : (TextSearch::IsWordChar(ch) ? KIND_WORD : KIND_OTHER);
+}
+
+static inline uint32_t GetKindBefore(const wchar_t* pText, size_t position)
+{
+	return position > 0 ? GetCharKind(pText[position - 1]) : KIND_LINE;
+}
+
+static inline uint32_t GetKindAfter(const wchar_t* pText, size_t length, size_t position)
+{
+	return position < length ? GetCharKind(pText[position]) : KIND_LINE;
+}
+
+static bool IsAssertionTrue(uint32_t assertion, uint32_t before, uint32_t after)
+{
+	switch (assertion)
+	{
+	case ASSERT_LINE_START: return before == KIND_LINE;
+	case ASSERT_LINE_END: return after == KIND_LINE;
+	case ASSERT_WORD_BOUNDARY: return (before == KIND_WORD) != (after == KIND_WORD);
+	case ASSERT_NOT_WORD_BOUNDARY: return (before == KIND_WORD) == (after == KIND_WORD);
+	case ASSERT_NO_WORD_BEFORE: return before != KIND_WORD;
+	case ASSERT_NO_WORD_AFTER: return after != KIND_WORD;
+	}
+
+	return false;
+}
+
+/* What the assertion checks when the text is read from the end */
+static uint32_t ReverseAssertion(uint32_t assertion)
+{
+	switch (assertion)
+	{
+	case ASSERT_LINE_START: return ASSERT_LINE_END;
+	case ASSERT_LINE_END: return ASSERT_LINE_START;
+	case ASSERT_NO_WORD_BEFORE: return ASSERT_NO_WORD_AFTER;
+	case ASSERT_NO_WORD_AFTER: return ASSERT_NO_WORD_BEFORE;
+	}
+
+	return assertion;
+}
+
+Regex::Regex(void)
+	: m_PrefixSearcher(std::wstring(), SearchOptions())
+{
+}
+
+uint32_t Regex::AddInstruction(std::vector<Instruction>& program, OpCode op, wchar_t ch, uint32_t x, uint32_t y)
+{
+	Instruction instruction;
+	instruction.op = op;
+	instruction.ch = ch;
+	instruction.x = x;
+	instruction.y = y;
+
+	program.push_back(instruction);
+
+	return static_cast<uint32_t>(program.size() - 1);
+}
+
+void Regex::FinishClass(CharClass& charClass) const
+{
+	std::vector<std::pair<wchar_t, wchar_t>>& ranges = charClass.ranges;
+
+	// Ranges like A-Z become the characters they fold to
+	if (m_IsCaseIgnored)
+	{
+		std::vector<wchar_t> chars;
+
+		for (const std::pair<wchar_t, wchar_t>& range : ranges)
+		{
+			for (uint32_t ch = static_cast<uint32_t>(range.first); ch <= static_cast<uint32_t>(range.second); ++ch)
+			{
+				chars.push_back(TextSearch::FoldChar(static_cast<wchar_t>(ch)));
+			}
+		}
+
+		std::sort(chars.begin(), chars.end());
+		chars.erase(std::unique(chars.begin(), chars.end()), chars.end());
+
+		ranges.clear();
+
+		for (wchar_t ch : chars)
+		{
+			ranges.push_back(std::make_pair(ch, ch));
+		}
+	}
+
+	std::sort(ranges.begin(), ranges.end());
+
+	std::vector<std::pair<wchar_t, wchar_t>> merged;
+
+	for (const std::pair<wchar_t, wchar_t>& range : ranges)
+	{
+		if (!merged.empty() && static_cast<uint32_t>(range.first) <= static_cast<uint32_t>(merged.back().second) + 1)
+		{
+			merged.back().second = std::max(merged.back().second, range.second);
+		}
+
+		else
+		{
+			merged.push_back(range);
+		}
+	}
+
+	ranges.swap(merged);
+}
+
+/// <summary>
+/// Appends the instructions of the node to the program. The reversed
+/// program matches the same text read from the end, it has no groups
+/// since only the DFA runs it.
+/// </summary>
+bool Regex::Emit(const std::vector<RegexNode>& nodes, size_t index, std::vector<Instruction>& program, bool isReversed)
+{
+	if (program.size() > REGEX_MAX_PROGRAM_SIZE)
+	{
+		m_Error = L"The pattern is too large";
+		return false;
+	}
+
+	const RegexNode& node = nodes[index];
+
+	switch (node.type)
+	{
+	case RegexNode::Type::EMPTY:
+		break;
+
+	case RegexNode::Type::CHAR:
+		AddInstruction(program, OpCode::CHAR, m_IsCaseIgnored ? TextSearch::FoldChar(node.ch) : node.ch);
+		break;
+
+	case RegexNode::Type::ANY:
+		AddInstruction(program, OpCode::ANY);
+		break;
+
+	case RegexNode::Type::CLASS:
+	{
+		CharClass charClass;
+		charClass.ranges = node.ranges;
+		charClass.predicates = node.predicates;
+		charClass.isNegated = node.isNegated;
+
+		FinishClass(charClass);
+
+		// Both programs use the same classes, and [0-9] twice is one class
+		size_t found = 0;
+
+		while (found < m_Classes.size() && !(m_Classes[found].ranges == charClass.ranges &&
+			                                 m_Classes[found].predicates == charClass.predicates &&
+			                                 m_Classes[found].isNegated == charClass.isNegated))
+		{
+			++found;
+		}
+
+		if (found == m_Classes.size())
+		{
+			m_Classes.push_back(std::move(charClass));
+		}
+
+		AddInstruction(program, OpCode::CLASS, 0, static_cast<uint32_t>(found));
+		break;
+	}
+
+	case RegexNode::Type::ASSERT:
+		AddInstruction(program, OpCode::ASSERT, 0, isReversed ? ReverseAssertion(node.value) : node.value);
+		break;
+
+	case RegexNode::Type::CONCAT:
+		for (size_t i = 0; i < node.children.size(); ++i)
+		{
+			if (!Emit(nodes, node.children[isReversed ? node.children.size() - 1 - i : i], program, isReversed))
+			{
+				return false;
+			}
+		}
+
+		break;
+
+	case RegexNode::Type::GROUP:
+		if (isReversed)
+		{
+			return Emit(nodes, node.children[0], program, isReversed);
+		}
+
+		AddInstruction(program, OpCode::SAVE, 0, node.value * 2);
+
+		if (!Emit(nodes, node.children[0], program, isReversed))
+		{
+			return false;
+		}
+
+		AddInstruction(program, OpCode::SAVE, 0, node.value * 2 + 1);
+		break;
+
+	case RegexNode::Type::ALTERNATE:
+	{
+		// Every alternative but the last one jumps past the others when it's done
+		std::vector<uint32_t> jumps;
+
+		for (size_t i = 0; i < node.children.size(); ++i)
+		{
+			const bool isLast = i + 1 == node.children.size();
+			const uint32_t split = isLast ? 0 : AddInstruction(program, OpCode::SPLIT);
+
+			if (!Emit(nodes, node.children[i], program, isReversed))
+			{
+				return false;
+			}
+
+			if (!isLast)
+			{
+				jumps.push_back(AddInstruction(program, OpCode::JUMP));
+
+				program[split].x = split + 1;
+				program[split].y = static_cast<uint32_t>(program.size());
+			}
+		}
+
+		for (uint32_t jump : jumps)
+		{
+			program[jump].x = static_cast<uint32_t>(program.size());
+		}
+
+		break;
+	}
+
+	case RegexNode::Type::REPEAT:
+	{
+		const size_t child = node.children[0];
+
+		for (size_t i = 0; i < node.min; ++i)
+		{
+			if (!Emit(nodes, child, program, isReversed))
+			{
+				return false;
+			}
+		}
+
+		// Each split either goes through the body once more or leaves
+		std::vector<uint32_t> splits;
+
+		if (node.max == UNBOUNDED)
+		{
+			const uint32_t loop = AddInstruction(program, OpCode::SPLIT);
+			splits.push_back(loop);
+
+			if (!Emit(nodes, child, program, isReversed))
+			{
+				return false;
+			}
+
+			AddInstruction(program, OpCode::JUMP, 0, loop);
+		}
+
+		else
+		{
+			for (size_t i = node.min; i < node.max; ++i)
+			{
+				splits.push_back(AddInstruction(program, OpCode::SPLIT));
+
+				if (!Emit(nodes, child, program, isReversed))
+				{
+					return false;
+				}
+			}
+		}
+
+		const uint32_t exit = static_cast<uint32_t>(program.size());
+
+		for (uint32_t split : splits)
+		{
+			program[split].x = node.isGreedy ? split + 1 : exit;
+			program[split].y = node.isGreedy ? exit : split + 1;
+		}
+
+		break;
+	}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Splits the characters into the classes the DFA reads instead of them:
+/// two characters are in the same class when every consuming instruction
+/// matches both or neither, and the assertions see them the same way
+/// </summary>
+void Regex::BuildCharClasses(void)
+{
+	m_CharClasses.clear();
+	m_ClassChars.clear();
+
+	std::vector<const Instruction*> matchers;
+
+	for (const Instruction& instruction : m_Program)
+	{
+		if (instruction.op != OpCode::CHAR && instruction.op != OpCode::ANY && instruction.op != OpCode::CLASS)
+		{
+			continue;
+		}
+
+		const bool isKnown = std::any_of(matchers.begin(), matchers.end(), [&instruction](const Instruction* pMatcher) {
+			return pMatcher->op == instruction.op && pMatcher->ch == instruction.ch && pMatcher->x == instruction.x;
+		});
+
+		if (!isKnown)
+		{
+			matchers.push_back(&instruction);
+		}
+	}
+
+	if (matchers.size() > DFA_MAX_MATCHERS)
+	{
+		return;
+	}
+
+	std::unordered_map<uint64_t, uint16_t> ids;
+	m_CharClasses.resize(DFA_CHAR_COUNT);
+
+	for (uint32_t i = 0; i < DFA_CHAR_COUNT; ++i)
+	{
+		const wchar_t ch = static_cast<wchar_t>(i);
+		uint64_t signature = GetCharKind(ch);
+
+		for (size_t j = 0; j < matchers.size(); ++j)
+		{
+			if (IsCharMatch(*matchers[j], ch))
+			{
+				signature |= 4ull << j;
+			}
+		}
+
+		const auto found = ids.find(signature);
+
+		if (found != ids.end())
+		{
+			m_CharClasses[i] = found->second;
+		}
+
+		else
+		{
+			m_CharClasses[i] = static_cast<uint16_t>(m_ClassChars.size());
+			ids.emplace(signature, m_CharClasses[i]);
+			m_ClassChars.push_back(ch);
+		}
+	}
+}
+
+bool Regex::Compile(const std::wstring& pattern, const SearchOptions& options)
+{
+	m_Program.clear();
+	m_ReverseProgram.clear();
+	m_Classes.clear();
+	m_Prefix.clear();
+	m_Error.clear();
+
+	m_IsCompiled = false;
+	m_IsCaseIgnored = !options.matchCase;
+
+	std::vector<RegexNode> nodes;
+	RegexParser parser(pattern, nodes);
+	size_t root;
+
+	if (!parser.Parse(root))
+	{
+		m_Error = parser.GetError();
+		return false;
+	}
+
+	m_GroupCount = parser.GetGroupCount();
+
+	AddInstruction(m_Program, OpCode::SAVE, 0, 0);
+
+	if (options.wholeWord)
+	{
+		AddInstruction(m_Program, OpCode::ASSERT, 0, ASSERT_NO_WORD_BEFORE);
+		AddInstruction(m_ReverseProgram, OpCode::ASSERT, 0, ReverseAssertion(ASSERT_NO_WORD_AFTER));
+	}
+
+	if (!Emit(nodes, root, m_Program, false) || !Emit(nodes, root, m_ReverseProgram, true))
+	{
+		m_Program.clear();
+		m_ReverseProgram.clear();
+
+		return false;
+	}
+
+	if (options.wholeWord)
+	{
+		AddInstruction(m_Program, OpCode::ASSERT, 0, ASSERT_NO_WORD_AFTER);
+		AddInstruction(m_ReverseProgram, OpCode::ASSERT, 0, ReverseAssertion(ASSERT_NO_WORD_BEFORE));
+	}
+
+	AddInstruction(m_Program, OpCode::SAVE, 0, 1);
+	AddInstruction(m_Program, OpCode::MATCH);
+	AddInstruction(m_ReverseProgram, OpCode::MATCH);
+
+	if (m_Program.size() * m_GroupCount * 2 > REGEX_MAX_THREAD_SLOTS)
+	{
+		m_Error = L"The pattern is too large";
+		m_Program.clear();
+		m_ReverseProgram.clear();
+
+		return false;
+	}
+
+	CollectPrefix(nodes, root, m_Prefix);
+	BuildCharClasses();
+
+	SearchOptions prefixOptions;
+	prefixOptions.matchCase = options.matchCase;
+
+	m_PrefixSearcher = TextSearcher(m_Prefix, prefixOptions);
+	m_IsCompiled = true;
+
+	return true;
+}
+
+bool Regex::IsInClass(const CharClass& charClass, wchar_t ch) const
+{
+	const wchar_t key = m_IsCaseIgnored ? TextSearch::FoldChar(ch) : ch;
+
+	// The last range that starts at or before the character
+	auto found = std::upper_bound(charClass.ranges.begin(), charClass.ranges.end(), key, [](wchar_t value, const std::pair<wchar_t, wchar_t>& range) {
+		return value < range.first;
+	});
+
+	bool isInClass = found != charClass.ranges.begin() && key <= (found - 1)->second;
+
+	if (!isInClass && charClass.predicates != 0)
+	{
+		isInClass = IsPredicateMatch(charClass.predicates, ch);
+	}
+
+	return isInClass != charClass.isNegated;
+}
+
+bool Regex::IsCharMatch(const Instruction& instruction, wchar_t ch) const
+{
+	switch (instruction.op)
+	{
+	case OpCode::CHAR:
+		return instruction.ch == (m_IsCaseIgnored ? TextSearch::FoldChar(ch) : ch);
+
+	case OpCode::ANY:
+		return !IsLineBreak(ch);
+
+	case OpCode::CLASS:
+		return IsInClass(m_Classes[instruction.x], ch);
+
+	default:
+		return false;
+	}
+}
+
+/// <summary>
+/// Follows every instruction that doesn't take up a character from 'pc',
+/// in order of priority, and adds the threads that end up waiting for a
+/// character (or at the match) to the list with the groups in the scratch
+/// slots. A program counter that's already in the list was reached by a
+/// thread of a higher priority, so it isn't followed again.
+/// </summary>
+void Regex::AddThread(RegexMachine& machine, size_t list, uint32_t pc, const wchar_t* pText, size_t length, size_t position) const
+{
+	RegexMachine::ThreadList& threads = machine.lists[list];
+	std::vector<RegexMachine::StackEntry>& stack = machine.stack;
+	const size_t slotCount = m_GroupCount * 2;
+
+	const uint32_t before = GetKindBefore(pText, position);
+	const uint32_t after = GetKindAfter(pText, length, position);
+
+	stack.clear();
+	stack.push_back({ pc, 0, 0 });
+
+	while (!stack.empty())
+	{
+		const RegexMachine::StackEntry entry = stack.back();
+		stack.pop_back();
+
+		if (entry.pc == RESTORE_SLOT)
+		{
+			machine.scratch[entry.slot] = entry.value;
+			continue;
+		}
+
+		if (threads.Contains(entry.pc))
+		{
+			continue;
+		}
+
+		threads.Insert(entry.pc);
+
+		const Instruction& instruction = m_Program[entry.pc];
+
+		switch (instruction.op)
+		{
+		case OpCode::JUMP:
+			stack.push_back({ instruction.x, 0, 0 });
+			break;
+
+		// The first branch is on top, so it's followed first
+		case OpCode::SPLIT:
+			stack.push_back({ instruction.y, 0, 0 });
+			stack.push_back({ instruction.x, 0, 0 });
+			break;
+
+		// The old position is put back once everything after the save has been followed
+		case OpCode::SAVE:
+			stack.push_back({ RESTORE_SLOT, instruction.x, machine.scratch[instruction.x] });
+			machine.scratch[instruction.x] = position;
+			stack.push_back({ entry.pc + 1, 0, 0 });
+			break;
+
+		case OpCode::ASSERT:
+			if (IsAssertionTrue(instruction.x, before, after))
+			{
+				stack.push_back({ entry.pc + 1, 0, 0 });
+			}
+
+			break;
+
+		default:
+			std::copy(machine.scratch.begin(), machine.scratch.end(), threads.slots.begin() + entry.pc * slotCount);
+			break;
+		}
+	}
+}
+
+bool Regex::Run(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, uint32_t flags, RegexMatch& match) const
+{
+	const size_t slotCount = m_GroupCount * 2;
+
+	size_t current = 0;
+	bool isMatched = false;
+
+	machine.lists[current].count = 0;
+
+	for (size_t position = from; ; ++position)
+	{
+		RegexMachine::ThreadList& threads = machine.lists[current];
+
+		// A new thread starts at every position until there's a match, it has the lowest priority
+		if (!isMatched && (!(flags & RUN_AT_START) || position == from))
+		{
+			if (threads.count == 0 && !(flags & RUN_AT_START) && !m_Prefix.empty())
+			{
+				size_t next;
+
+				if (!m_PrefixSearcher.FindForward(pText, end, position, next))
+				{
+					break;
+				}
+
+				position = next;
+			}
+
+			std::fill(machine.scratch.begin(), machine.scratch.end(), REGEX_NO_GROUP);
+			AddThread(machine, current, 0, pText, length, position);
+		}
+
+		if (threads.count == 0)
+		{
+			break;
+		}
+
+		machine.lists[1 - current].count = 0;
+
+		for (size_t i = 0; i < threads.count; ++i)
+		{
+			const uint32_t pc = threads.dense[i];
+			const Instruction& instruction = m_Program[pc];
+			const size_t* pSlots = threads.slots.data() + pc * slotCount;
+
+			if (instruction.op == OpCode::MATCH)
+			{
+				if (((flags & RUN_TO_END) && position != end) || ((flags & RUN_NOT_EMPTY) && pSlots[0] == position))
+				{
+					continue;
+				}
+
+				match.groups.assign(pSlots, pSlots + slotCount);
+				isMatched = true;
+
+				// The threads after this one have a lower priority
+				break;
+			}
+
+			if (position < end && IsCharMatch(instruction, pText[position]))
+			{
+				std::copy(pSlots, pSlots + slotCount, machine.scratch.begin());
+				AddThread(machine, 1 - current, pc + 1, pText, length, position + 1);
+			}
+		}
+
+		current = 1 - current;
+
+		if (position >= end)
+		{
+			break;
+		}
+	}
+
+	return isMatched;
+}
+
+/// <returns> The state, or -1 if the DFA has grown too large </returns>
+int32_t Regex::AddDfaState(RegexDfa& dfa, uint32_t flags, const std::vector<uint32_t>& pcs) const
+{
+	dfa.key.assign(1, flags);
+	dfa.key.insert(dfa.key.end(), pcs.begin(), pcs.end());
+
+	const auto found = dfa.ids.find(dfa.key);
+
+	if (found != dfa.ids.end())
+	{
+		return found->second;
+	}
+
+	if (dfa.states.size() >= DFA_MAX_STATES || (dfa.states.size() + 1) * m_ClassChars.size() > DFA_MAX_TRANSITIONS)
+	{
+		dfa.hasGivenUp = true;
+		return -1;
+	}
+
+	RegexDfaState state;
+	state.pcs = pcs;
+	state.flags = flags;
+	state.isDead = pcs.empty() && !(flags & DFA_INJECT);
+	state.isIdle = pcs.empty() && (flags & DFA_INJECT) && !(flags & DFA_ANCHORED);
+	state.next.assign(m_ClassChars.size(), DFA_UNKNOWN);
+
+	dfa.states.push_back(std::move(state));
+	dfa.ids.emplace(dfa.key, static_cast<int32_t>(dfa.states.size() - 1));
+
+	return static_cast<int32_t>(dfa.states.size() - 1);
+}
+
+/// <summary>
+/// Does what a step of the Pike VM does, without the groups: follows the
+/// threads of the state (and the one that starts there) in order of
+/// priority and collects the ones that take 'ch'. Once a match is found
+/// the threads after it are dropped, unless the DFA looks for the longest
+/// match. At the end of the range there's no character to take.
+/// </summary>
+/// <returns> Whether a match ends at the position </returns>
+bool Regex::StepDfa(RegexDfa& dfa, int32_t state, uint32_t after, const wchar_t* pChar, std::vector<uint32_t>& next) const
+{
+	const std::vector<Instruction>& program = dfa.isReversed ? m_ReverseProgram : m_Program;
+	const RegexDfaState& current = dfa.states[state];
+	const uint32_t before = current.flags & DFA_KIND_MASK;
+
+	if (dfa.visited.size() < program.size())
+	{
+		dfa.visited.resize(program.size(), 0);
+	}
+
+	++dfa.generation;
+	next.clear();
+
+	bool isMatched = false;
+	const size_t threadCount = current.pcs.size() + ((current.flags & DFA_INJECT) ? 1 : 0);
+
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		// The thread that starts here comes last
+		const bool isStart = i == current.pcs.size();
+
+		dfa.stack.assign(1, isStart ? 0 : current.pcs[i]);
+
+		while (!dfa.stack.empty())
+		{
+			const uint32_t pc = dfa.stack.back();
+			dfa.stack.pop_back();
+
+			if (dfa.visited[pc] == dfa.generation)
+			{
+				continue;
+			}
+
+			dfa.visited[pc] = dfa.generation;
+
+			const Instruction& instruction = program[pc];
+
+			switch (instruction.op)
+			{
+			case OpCode::JUMP:
+				dfa.stack.push_back(instruction.x);
+				break;
+
+			case OpCode::SPLIT:
+				dfa.stack.push_back(instruction.y);
+				dfa.stack.push_back(instruction.x);
+				break;
+
+			case OpCode::SAVE:
+				dfa.stack.push_back(pc + 1);
+				break;
+
+			case OpCode::ASSERT:
+				if (IsAssertionTrue(instruction.x, before, after))
+				{
+					dfa.stack.push_back(pc + 1);
+				}
+
+				break;
+
+			case OpCode::MATCH:
+				if (isStart && (current.flags & DFA_NOT_EMPTY))
+				{
+					break;
+				}
+
+				isMatched = true;
+
+				if (!dfa.isReversed)
+				{
+					return true;
+				}
+
+				break;
+
+			default:
+				if (pChar != nullptr && IsCharMatch(instruction, *pChar))
+				{
+					next.push_back(pc + 1);
+				}
+
+				break;
+			}
+		}
+	}
+
+	return isMatched;
+}
+
+/// <returns> The next state shifted left with whether a match ended before the character, or DFA_GAVE_UP </returns>
+int32_t Regex::GetDfaTransition(RegexDfa& dfa, int32_t state, uint16_t charClass) const
+{
+	if (dfa.states[state].next[charClass] != DFA_UNKNOWN)
+	{
+		return dfa.states[state].next[charClass];
+	}
+
+	const wchar_t ch = m_ClassChars[charClass];
+	const uint32_t flags = dfa.states[state].flags;
+
+	const bool isMatched = StepDfa(dfa, state, GetCharKind(ch), &ch, dfa.pcs);
+
+	// After the first match no more threads start, the ones left can only make it longer
+	const bool isInjected = (flags & DFA_INJECT) && !(flags & DFA_ANCHORED) && !isMatched;
+	const int32_t next = AddDfaState(dfa, GetCharKind(ch) | (flags & DFA_NOT_EMPTY) | (isInjected ? DFA_INJECT : 0), dfa.pcs);
+
+	if (next < 0)
+	{
+		return DFA_GAVE_UP;
+	}
+
+	dfa.states[state].next[charClass] = (next << 1) | (isMatched ? 1 : 0);
+
+	return dfa.states[state].next[charClass];
+}
+
+bool Regex::IsDfaFinalMatch(RegexDfa& dfa, int32_t state, uint32_t after) const
+{
+	if (dfa.states[state].finals[after] == DFA_UNKNOWN)
+	{
+		dfa.states[state].finals[after] = StepDfa(dfa, state, after, nullptr, dfa.pcs) ? 1 : 0;
+	}
+
+	return dfa.states[state].finals[after] == 1;
+}
+
+/// <summary>
+/// Reads the text from 'from' with the DFA, and finds where the match the
+/// Pike VM would report ends
+/// </summary>
+Regex::ScanResult Regex::ScanForward(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, uint32_t flags, size_t& matchEnd) const
+{
+	RegexDfa& dfa = machine.dfas[0];
+
+	const uint32_t searchFlags = DFA_INJECT | ((flags & RUN_AT_START) ? DFA_ANCHORED : 0) | ((flags & RUN_NOT_EMPTY) ? DFA_NOT_EMPTY : 0);
+	int32_t state = AddDfaState(dfa, searchFlags | GetKindBefore(pText, from), std::vector<uint32_t>());
+
+	if (state < 0)
+	{
+		return ScanResult::GAVE_UP;
+	}
+
+	bool isFound = false;
+
+	for (size_t position = from; ; ++position)
+	{
+		// Nothing is under way, so nothing can match before the prefix
+		if (dfa.states[state].isIdle && !m_Prefix.empty())
+		{
+			size_t next;
+
+			if (!m_PrefixSearcher.FindForward(pText, end, position, next))
+			{
+				break;
+			}
+
+			if (next != position)
+			{
+				position = next;
+				state = AddDfaState(dfa, searchFlags | GetKindBefore(pText, position), std::vector<uint32_t>());
+
+				if (state < 0)
+				{
+					return ScanResult::GAVE_UP;
+				}
+			}
+		}
+
+		if (position == end)
+		{
+			if (IsDfaFinalMatch(dfa, state, GetKindAfter(pText, length, end)))
+			{
+				isFound = true;
+				matchEnd = end;
+			}
+
+			break;
+		}
+
+		if (static_cast<uint32_t>(pText[position]) >= DFA_CHAR_COUNT)
+		{
+			return ScanResult::GAVE_UP;
+		}
+
+		const uint16_t charClass = m_CharClasses[pText[position]];
+		int32_t transition = dfa.states[state].next[charClass];
+
+		if (transition < 0 && (transition = GetDfaTransition(dfa, state, charClass)) == DFA_GAVE_UP)
+		{
+			return ScanResult::GAVE_UP;
+		}
+
+		if (transition & 1)
+		{
+			isFound = true;
+			matchEnd = position;
+		}
+
+		state = transition >> 1;
+
+		if (dfa.states[state].isDead)
+		{
+			break;
+		}
+	}
+
+	return isFound ? ScanResult::MATCH : ScanResult::NO_MATCH;
+}
+
+/// <summary>
+/// Reads the text back from the end of a match with the reversed program,
+/// down to 'from', and finds where the longest match that ends there starts
+/// </summary>
+Regex::ScanResult Regex::ScanBackward(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, size_t& matchStart) const
+{
+	RegexDfa& dfa = machine.dfas[1];
+
+	// Read from the end, the character before a position is the one after it
+	int32_t state = AddDfaState(dfa, DFA_INJECT | DFA_ANCHORED | GetKindAfter(pText, length, end), std::vector<uint32_t>());
+
+	if (state < 0)
+	{
+		return ScanResult::GAVE_UP;
+	}
+
+	bool isFound = false;
+
+	for (size_t position = end; ; --position)
+	{
+		if (position == from)
+		{
+			if (IsDfaFinalMatch(dfa, state, GetKindBefore(pText, from)))
+			{
+				isFound = true;
+				matchStart = from;
+			}
+
+			break;
+		}
+
+		if (static_cast<uint32_t>(pText[position - 1]) >= DFA_CHAR_COUNT)
+		{
+			return ScanResult::GAVE_UP;
+		}
+
+		const uint16_t charClass = m_CharClasses[pText[position - 1]];
+		int32_t transition = dfa.states[state].next[charClass];
+
+		if (transition < 0 && (transition = GetDfaTransition(dfa, state, charClass)) == DFA_GAVE_UP)
+		{
+			return ScanResult::GAVE_UP;
+		}
+
+		if (transition & 1)
+		{
+			isFound = true;
+			matchStart = position;
+		}
+
+		state = transition >> 1;
+
+		if (dfa.states[state].isDead)
+		{
+			break;
+		}
+	}
+
+	return isFound ? ScanResult::MATCH : ScanResult::NO_MATCH;
+}
+
+/// <summary>
+/// Finds the match Run would, but lets the DFA read the text: forward to
+/// where the match ends, then back to where it starts (it's the longest of
+/// the ones ending there, a match further to the left would have been the
+/// first). Only the match itself goes through the Pike VM, for the groups.
+/// </summary>
+bool Regex::Search(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, uint32_t flags, RegexMatch& match) const
+{
+	if (!m_ClassChars.empty() && !machine.dfas[0].hasGivenUp && !machine.dfas[1].hasGivenUp)
+	{
+		size_t matchEnd = from;
+		size_t matchStart = from;
+
+		const ScanResult result = ScanForward(machine, pText, length, from, end, flags, matchEnd);
+
+		if (result == ScanResult::NO_MATCH)
+		{
+			return false;
+		}
+
+		if (result == ScanResult::MATCH &&
+			((flags & RUN_AT_START) || ScanBackward(machine, pText, length, from, matchEnd, matchStart) == ScanResult::MATCH))
+		{
+			return Run(machine, pText, length, matchStart, matchEnd, flags | RUN_AT_START | RUN_TO_END, match);
+		}
+	}
+
+	return Run(machine, pText, length, from, end, flags, match);
+}
+
+bool Regex::FindForward(const wchar_t* pText, size_t length, size_t from, RegexMatch& match) const
+{
+	if (!m_IsCompiled)
+	{
+		return false;
+	}
+
+	RegexMachine machine(m_Program.size(), m_GroupCount * 2);
+
+	return from <= length && Search(machine, pText, length, from, length, RUN_NOT_EMPTY, match);
+}
+
+bool Regex::FindBackward(const wchar_t* pText, size_t length, size_t end, RegexMatch& match) const
+{
+	if (!m_IsCompiled)
+	{
+		return false;
+	}
+
+	end = std::min(end, length);
+
+	RegexMachine machine(m_Program.size(), m_GroupCount * 2);
+	RegexMatch candidate;
+	bool isFound = false;
+
+	for (size_t from = 0; from <= end && Search(machine, pText, length, from, end, RUN_NOT_EMPTY, candidate); from = candidate.groups[1])
+	{
+		match = candidate;
+		isFound = true;
+	}
+
+	return isFound;
+}
+
+bool Regex::MatchRange(const wchar_t* pText, size_t length, size_t position, size_t end, RegexMatch& match) const
+{
+	if (!m_IsCompiled || position > end || end > length)
+	{
+		return false;
+	}
+
+	RegexMachine machine(m_Program.size(), m_GroupCount * 2);
+
+	return Run(machine, pText, length, position, end, RUN_AT_START | RUN_TO_END, match);
+}
+
+void Regex::AppendReplacement(const std::wstring& replacement, const wchar_t* pText, const RegexMatch& match, std::wstring& out) const
+{
+	const size_t length = replacement.length();
+
+	const auto isDigit = [&replacement](size_t index) {
+		return replacement[index] >= L'0' && replacement[index] <= L'9';
+	};
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		const wchar_t ch = replacement[i];
+
+		if (ch == L'\\' && i + 1 < length)
+		{
+			switch (replacement[i + 1])
+			{
+			case L'n': out.push_back(L'\r'); ++i; continue;
+			case L't': out.push_back(L'\t'); ++i; continue;
+			case L'\\': out.push_back(L'\\'); ++i; continue;
+			}
+		}
+
+		if (ch != L'$' || i + 1 == length)
+		{
+			out.push_back(ch);
+			continue;
+		}
+
+		const wchar_t next = replacement[i + 1];
+		size_t group = SIZE_MAX;
+		size_t last = i + 1;
+
+		if (next == L'$')
+		{
+			out.push_back(L'$');
+			++i;
+
+			continue;
+		}
+
+		if (next == L'&')
+		{
+			group = 0;
+		}
+
+		else if (isDigit(i + 1))
+		{
+			group = next - L'0';
+
+			// Two digits only if there are that many groups
+			if (i + 2 < length && isDigit(i + 2) && group * 10 + (replacement[i + 2] - L'0') < m_GroupCount)
+			{
+				group = group * 10 + (replacement[i + 2] - L'0');
+				last = i + 2;
+			}
+		}
+
+		else if (next == L'{')
+		{
+			const size_t close = replacement.find(L'}', i + 2);
+
+			if (close != std::wstring::npos && close > i + 2 && close - i <= 6)
+			{
+				group = 0;
+
+				for (size_t j = i + 2; j < close && group != SIZE_MAX; ++j)
+				{
+					group = isDigit(j) ? group * 10 + (replacement[j] - L'0') : SIZE_MAX;
+				}
+
+				last = close;
+			}
+		}
+
+		// Not a group of the pattern, so it's just text
+		if (group >= m_GroupCount)
+		{
+			out.push_back(ch);
+			continue;
+		}
+
+		const size_t start = match.groups[group * 2];
+		const size_t finish = match.groups[group * 2 + 1];
+
+		if (start != REGEX_NO_GROUP && finish != REGEX_NO_GROUP)
+		{
+			out.append(pText + start, finish - start);
+		}
+
+		i = last;
+	}
+}
+
+bool Regex::ReplaceAll(const std::wstring& text, const std::wstring& replacement, ReplaceAllResult& result) const
+{
+	if (!m_IsCompiled)
+	{
+		return false;
+	}
+
+	const wchar_t* pText = text.c_str();
+	const size_t length = text.length();
+
+	RegexMachine machine(m_Program.size(), m_GroupCount * 2);
+	RegexMatch match;
+
+	result.matchCount = 0;
+	result.inserted.clear();
+
+	size_t copied = 0;
+	size_t from = 0;
+	uint32_t flags = 0;
+
+	while (from <= length)
+	{
+		if (!Search(machine, pText, length, from, length, flags, match))
+		{
+			if (flags == 0)
+			{
+				break;
+			}
+
+			// Only the empty match starts there
+			flags = 0;
+			++from;
+
+			continue;
+		}
+
+		const size_t start = match.groups[0];
+		const size_t finish = match.groups[1];
+
+		if (result.matchCount++ == 0)
+		{
+			result.position = start;
+			copied = start;
+		}
+
+		result.inserted.append(text, copied, start - copied);
+		AppendReplacement(replacement, pText, match, result.inserted);
+
+		copied = finish;
+		from = finish;
+
+		// An empty match can't be found again at the same place, a longer one can
+		flags = finish == start ? RUN_AT_START | RUN_NOT_EMPTY : 0;
+	}
+
+	if (result.matchCount == 0)
+	{
+		return false;
+	}
+
+	result.removedLength = copied - result.position;
+
+	return true;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "TextSearch.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Counted repetitions, like a{1000}, can't repeat more than this
+#define REGEX_MAX_REPEAT 1000
+
+// Instructions a compiled pattern can take up
+#define REGEX_MAX_PROGRAM_SIZE 100000
+
+// Group positions the machine keeps for all its threads, per step
+#define REGEX_MAX_THREAD_SLOTS (4 * 1024 * 1024)
+
+// Start and end of a group that took no part in the match
+#define REGEX_NO_GROUP SIZE_MAX
+
+/* Where a match and its groups are */
+struct RegexMatch {
+	// Start and end of every group, group 0 is the whole match
+	std::vector<size_t> groups;
+
+	size_t GetPosition(void) const { return groups[0]; }
+	size_t GetLength(void) const { return groups[1] - groups[0]; }
+};
+
+struct RegexNode;
+struct RegexDfa;
+struct RegexMachine;
+
+/// <summary>
+/// Regular expressions compiled to a small program, a Thompson NFA.
+/// Every way the pattern could match is followed side by side, one
+/// character of the text at a time, so a search never goes back over the
+/// text and takes linear time whatever the pattern (nested repetitions
+/// like (a*)*b can't blow up the way they do with backtracking).
+/// The text is read by a DFA built from the program while it reads, which
+/// finds where the match ends and, reading back with the reversed program,
+/// where it starts. The program itself only runs as a Pike VM over the
+/// match to find its groups, or over all of the text when the DFA grows
+/// too large.
+/// Matches and groups are the ones a backtracking engine would report:
+/// the leftmost match, earlier alternatives and greedy repetitions first
+/// (except when a repetition of something that can match nothing goes
+/// around without taking up anything, which is cut short).
+/// When every match starts with the same text, the search skips ahead to
+/// it with a TextSearcher instead of reading everything.
+///
+/// Syntax: literals, ., [...] and [^...], \d \w \s (and \D \W \S), ^ and $
+/// at the start and end of lines, \b and \B, (...) groups and (?:...)
+/// groups that don't capture, |, and the quantifiers * + ? {n} {n,} and
+/// {n,m}, each followed by ? to make it lazy. \n matches a line break,
+/// \t \r \f \v \xHH and \uHHHH are characters. Backreferences aren't
+/// supported, since they can't be matched in linear time.
+/// </summary>
+class Regex
+{
+private:
+	enum class OpCode : uint8_t {
+		CHAR,   // Consumes 'ch'
+		ANY,    // Consumes anything but a line break
+		CLASS,  // Consumes a character of the class 'x'
+		ASSERT, // Continues if the assertion 'x' holds
+		SPLIT,  // Continues at 'x', and at 'y' with a lower priority
+		JUMP,   // Continues at 'x'
+		SAVE,   // Records the position in the group slot 'x'
+		MATCH
+	};
+
+	struct Instruction {
+		OpCode op = OpCode::MATCH;
+		wchar_t ch = 0;
+		uint32_t x = 0;
+		uint32_t y = 0;
+	};
+
+	struct CharClass {
+		// Sorted and merged, folded when case doesn't matter
+		std::vector<std::pair<wchar_t, wchar_t>> ranges;
+
+		// Sets of characters like \d and \w that are in the class too
+		uint32_t predicates = 0;
+		bool isNegated = false;
+	};
+
+	std::vector<Instruction> m_Program;
+	std::vector<Instruction> m_ReverseProgram;
+	std::vector<CharClass> m_Classes;
+
+	// The class of each character for the DFA, and a character of each class.
+	// Empty when the pattern tells too many characters apart for the DFA.
+	std::vector<uint16_t> m_CharClasses;
+	std::vector<wchar_t> m_ClassChars;
+
+	// Including group 0, the whole match
+	size_t m_GroupCount = 0;
+	bool m_IsCaseIgnored = false;
+	bool m_IsCompiled = false;
+
+	// Text every match starts with, can be empty
+	std::wstring m_Prefix;
+	TextSearcher m_PrefixSearcher;
+
+	std::wstring m_Error;
+
+	enum class ScanResult { NO_MATCH, MATCH, GAVE_UP };
+
+	bool Emit(const std::vector<RegexNode>& nodes, size_t index, std::vector<Instruction>& program, bool isReversed);
+	static uint32_t AddInstruction(std::vector<Instruction>& program, OpCode op, wchar_t ch = 0, uint32_t x = 0, uint32_t y = 0);
+	void FinishClass(CharClass& charClass) const;
+	void BuildCharClasses(void);
+
+	bool IsInClass(const CharClass& charClass, wchar_t ch) const;
+	bool IsCharMatch(const Instruction& instruction, wchar_t ch) const;
+
+	enum RunFlags : uint32_t {
+		RUN_AT_START = 1,  // The match starts at 'from'
+		RUN_TO_END = 2,    // The match ends at 'end'
+		RUN_NOT_EMPTY = 4
+	};
+
+	void AddThread(RegexMachine& machine, size_t list, uint32_t pc, const wchar_t* pText, size_t length, size_t position) const;
+
+	/// <summary>
+	/// Runs the program from 'from', matches can't go past 'end' but the
+	/// assertions see the whole text
+	/// </summary>
+	bool Run(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, uint32_t flags, RegexMatch& match) const;
+
+	int32_t AddDfaState(RegexDfa& dfa, uint32_t flags, const std::vector<uint32_t>& pcs) const;
+	bool StepDfa(RegexDfa& dfa, int32_t state, uint32_t after, const wchar_t* pChar, std::vector<uint32_t>& next) const;
+	int32_t GetDfaTransition(RegexDfa& dfa, int32_t state, uint16_t charClass) const;
+	bool IsDfaFinalMatch(RegexDfa& dfa, int32_t state, uint32_t after) const;
+
+	ScanResult ScanForward(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, uint32_t flags, size_t& matchEnd) const;
+	ScanResult ScanBackward(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, size_t& matchStart) const;
+
+	/* Same as Run, with the DFA doing the reading */
+	bool Search(RegexMachine& machine, const wchar_t* pText, size_t length, size_t from, size_t end, uint32_t flags, RegexMatch& match) const;
+
+public:
+	Regex(void);
+
+	/// <summary>
+	/// Compiles the pattern, replacing whatever was compiled before
+	/// </summary>
+	/// <returns> False if the pattern isn't valid, GetError says why </returns>
+	bool Compile(const std::wstring& pattern, const SearchOptions& options);
+
+	bool IsCompiled(void) const { return m_IsCompiled; }
+	const std::wstring& GetError(void) const { return m_Error; }
+	size_t GetGroupCount(void) const { return m_GroupCount; }
+
+	/* Text every match starts with, can be empty */
+	const std::wstring& GetPrefix(void) const { return m_Prefix; }
+
+	/// <summary>
+	/// Finds the first match that starts at or after 'from'. Empty matches
+	/// are skipped, there would be nothing to select.
+	/// </summary>
+	bool FindForward(const wchar_t* pText, size_t length, size_t from, RegexMatch& match) const;
+
+	/// <summary>
+	/// Finds the last match out of the ones that searching from the top to
+	/// 'end' would find one after another. Empty matches are skipped.
+	/// </summary>
+	bool FindBackward(const wchar_t* pText, size_t length, size_t end, RegexMatch& match) const;
+
+	/* Whether the text from 'position' to 'end' is a match as a whole, e.g. the selection */
+	bool MatchRange(const wchar_t* pText, size_t length, size_t position, size_t end, RegexMatch& match) const;
+
+	/// <summary>
+	/// Appends the replacement with $0 to $99 (or ${n}) and $& replaced by
+	/// the groups of the match, $$ by $. \n stands for a line break and \t
+	/// for a tab.
+	/// </summary>
+	void AppendReplacement(const std::wstring& replacement, const wchar_t* pText, const RegexMatch& match, std::wstring& out) const;
+
+	/// <summary>
+	/// Replaces every match, empty ones included, the same way
+	/// TextSearch::ReplaceAll does for text. After an empty match the next
+	/// one can start at the same place if it isn't empty.
+	/// </summary>
+	/// <returns> False if nothing matched </returns>
+	bool ReplaceAll(const std::wstring& text, const std::wstring& replacement, ReplaceAllResult& result) const;
+};
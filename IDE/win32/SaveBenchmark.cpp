@@ -0,0 +1,211 @@
+#include "SaveBenchmark.h"
+#include "Benchmark.h"
+#include "SaveScheduler.h"
+#include "PieceTable.h"
+
+#include <Windows.h>
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Characters of a generated buffer, somewhere between the two
+#define SAVE_BENCHMARK_MIN_SIZE (16 * 1024)
+#define SAVE_BENCHMARK_MAX_SIZE (256 * 1024)
+
+// Typed into every buffer at random places before it's saved
+#define SAVE_BENCHMARK_EDITS 20
+
+static const wchar_t* g_Lines[] = {
+	L"#include \"SaveScheduler.h\"",
+	L"bool SaveJob::Run(void)",
+	L"{",
+	L"\tconst size_t copied = pDocument->CopyTextRange(position, block.size(), block.data());",
+	L"\tif (!writer.Write(block.data(), copied))",
+	L"\t\treturn false;",
+	L"}",
+	L"/* Only one block of the text and its encoded bytes are in memory at any point */",
+	L""
+};
+
+static void GenerateBuffer(std::mt19937& random, PieceTable& document)
+{
+	const size_t size = SAVE_BENCHMARK_MIN_SIZE + random() % (SAVE_BENCHMARK_MAX_SIZE - SAVE_BENCHMARK_MIN_SIZE);
+	std::wstring text;
+
+	while (text.length() < size)
+	{
+		text += g_Lines[random() % (sizeof(g_Lines) / sizeof(g_Lines[0]))];
+		text.push_back(L'\r');
+	}
+
+	document.Load(std::move(text));
+
+	for (size_t i = 0; i < SAVE_BENCHMARK_EDITS; ++i)
+	{
+		document.Insert(random() % (document.GetLength() + 1), L"// edited\r", 10);
+	}
+}
+
+static std::wstring GetFilePath(size_t index)
+{
+	return std::wstring(SAVE_BENCHMARK_FOLDER) + L"\\file" + std::to_wstring(index) + L".cpp";
+}
+
+/* What SaveJob::FromTab does for a tab that isn't hibernated */
+static std::vector<std::unique_ptr<SaveJob>> CreateJobs(const std::vector<std::unique_ptr<PieceTable>>& documents)
+{
+	std::vector<std::unique_ptr<SaveJob>> jobs;
+
+	for (size_t i = 0; i < documents.size(); ++i)
+	{
+		std::unique_ptr<SaveJob> pJob(new SaveJob);
+		pJob->tabId = i + 1;
+		pJob->version = documents[i]->GetVersion();
+		pJob->path = GetFilePath(i);
+		pJob->pDocument.reset(new PieceTable(*documents[i]));
+
+		jobs.push_back(std::move(pJob));
+	}
+
+	return jobs;
+}
+
+static void WriteResult(FILE* pFile, const char* lpszMode, size_t workerCount, double snapshotMilliseconds, double firstMilliseconds,
+	                    double totalMilliseconds, size_t failedCount)
+{
+	fprintf(pFile, "{\"mode\":\"%s\",\"files\":%u,\"workers\":%u,\"snapshot_ms\":%.1f,\"first_saved_ms\":%.1f,\"total_ms\":%.1f,\"failed\":%u}\n",
+		    lpszMode, static_cast<unsigned int>(SAVE_BENCHMARK_BUFFERS), static_cast<unsigned int>(workerCount), snapshotMilliseconds,
+		    firstMilliseconds, totalMilliseconds, static_cast<unsigned int>(failedCount));
+	fflush(pFile);
+}
+
+/* Every file is written on this thread before the next one starts, what the window used to wait for */
+static void MeasureSequential(FILE* pOutput, const std::vector<std::unique_ptr<PieceTable>>& documents)
+{
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	std::vector<std::unique_ptr<SaveJob>> jobs = CreateJobs(documents);
+	const double snapshotMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - start);
+
+	double firstMilliseconds = 0;
+	size_t failedCount = 0;
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		if (!jobs[i]->Run())
+		{
+			++failedCount;
+		}
+
+		if (i == 0)
+		{
+			firstMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - start);
+		}
+	}
+
+	WriteResult(pOutput, "sequential", 1, snapshotMilliseconds, firstMilliseconds, Benchmark::GetMilliseconds(Benchmark::Clock::now() - start), failedCount);
+}
+
+/* The window is only there to receive WM_FILE_SAVED, the messages are handled before they're dispatched */
+static bool MeasureScheduler(FILE* pOutput, const std::vector<std::unique_ptr<PieceTable>>& documents)
+{
+	const HWND hWnd = CreateWindowEx(0, L"STATIC", nullptr, 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, GetModuleHandle(nullptr), nullptr);
+
+	if (hWnd == nullptr)
+	{
+		return false;
+	}
+
+	{
+		SaveScheduler scheduler(hWnd);
+
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+		std::vector<std::unique_ptr<SaveJob>> jobs = CreateJobs(documents);
+		const double snapshotMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - start);
+
+		scheduler.Start(std::move(jobs));
+
+		// The workers are joined once the last file is saved
+		const size_t workerCount = scheduler.GetWorkerCount();
+
+		double firstMilliseconds = 0;
+		MSG msg;
+
+		while (scheduler.IsRunning() && GetMessage(&msg, nullptr, 0, 0) > 0)
+		{
+			if (msg.message == WM_FILE_SAVED)
+			{
+				if (scheduler.GetFinishedCount() == 0)
+				{
+					firstMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - start);
+				}
+
+				scheduler.OnJobFinished(reinterpret_cast<SaveJob*>(msg.lParam));
+			}
+
+			else
+			{
+				DispatchMessage(&msg);
+			}
+		}
+
+		WriteResult(pOutput, "scheduler", workerCount, snapshotMilliseconds, firstMilliseconds,
+			        Benchmark::GetMilliseconds(Benchmark::Clock::now() - start), scheduler.GetFailedCount());
+	}
+
+	DestroyWindow(hWnd);
+
+	return true;
+}
+
+bool SaveBenchmark::Run(const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	if (!CreateDirectory(SAVE_BENCHMARK_FOLDER, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		fclose(pOutput);
+		return false;
+	}
+
+	std::mt19937 random(0x5341);
+	std::vector<std::unique_ptr<PieceTable>> documents;
+	size_t characterCount = 0;
+
+	for (size_t i = 0; i < SAVE_BENCHMARK_BUFFERS; ++i)
+	{
+		documents.emplace_back(new PieceTable);
+		GenerateBuffer(random, *documents.back());
+
+		characterCount += documents.back()->GetLength();
+	}
+
+	fprintf(pOutput, "{\"files\":%u,\"characters\":%llu}\n",
+		    static_cast<unsigned int>(SAVE_BENCHMARK_BUFFERS), static_cast<unsigned long long>(characterCount));
+	fflush(pOutput);
+
+	// The files are written once before either is timed, so that both replace files that exist the way a save does
+	for (const std::unique_ptr<SaveJob>& pJob : CreateJobs(documents))
+	{
+		pJob->Run();
+	}
+
+	MeasureSequential(pOutput, documents);
+	const bool hasSucceeded = MeasureScheduler(pOutput, documents);
+
+	for (size_t i = 0; i < SAVE_BENCHMARK_BUFFERS; ++i)
+	{
+		DeleteFile(GetFilePath(i).c_str());
+	}
+
+	RemoveDirectory(SAVE_BENCHMARK_FOLDER);
+
+	return fclose(pOutput) == 0 && hasSucceeded;
+}
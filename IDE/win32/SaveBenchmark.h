@@ -0,0 +1,28 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-save
+#define SAVE_BENCHMARK_ARGUMENT L"--benchmark-save"
+
+// Written to the current directory, one line of JSON per way of saving
+#define SAVE_BENCHMARK_OUTPUT_FILE L"save-benchmark.jsonl"
+
+// The files are saved in this folder of the current directory, which is deleted afterwards
+#define SAVE_BENCHMARK_FOLDER L"save-benchmark"
+
+// Dirty buffers saved at once, as many as a Save All of a big session
+#define SAVE_BENCHMARK_BUFFERS 500
+
+/// <summary>
+/// Measures Save All on generated buffers of source code, each of them
+/// loaded and then edited at a few places. It times copying the documents
+/// on the UI thread, which is all the window waits for, then writes the
+/// files one after the other on the calling thread the way Save All used
+/// to, and then through SaveScheduler, whose completions come back as
+/// messages to a window the way they come back to the explorer. The
+/// scheduler also reports when the first file landed.
+/// </summary>
+namespace SaveBenchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszOutputPath);
+}
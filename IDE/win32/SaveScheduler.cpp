@@ -0,0 +1,222 @@
+#include "SaveScheduler.h"
+#include "SourceTab.h"
+#include "TextFileWriter.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <mutex>
+#include <unordered_map>
+
+// Characters copied out of a document at a time when it's saved
+#define SAVE_BLOCK_SIZE 65536
+
+/* The newest version of a tab written to a file, the lock is held while the file is replaced */
+struct CommittedFile {
+	std::mutex mutex;
+	size_t version = 0;
+};
+
+static std::mutex g_CommittedFilesMutex;
+static std::unordered_map<std::wstring, std::unique_ptr<CommittedFile>> g_CommittedFiles;
+
+static CommittedFile& GetCommittedFile(const std::wstring& path)
+{
+	// Paths differing only in case are the same file
+	std::wstring folded(path);
+	std::transform(folded.begin(), folded.end(), folded.begin(), towlower);
+
+	std::lock_guard<std::mutex> lock(g_CommittedFilesMutex);
+	std::unique_ptr<CommittedFile>& pFile = g_CommittedFiles[folded];
+
+	if (pFile == nullptr)
+	{
+		pFile.reset(new CommittedFile);
+	}
+
+	return *pFile;
+}
+
+std::unique_ptr<SaveJob> SaveJob::FromTab(SourceTab* pSourceTab)
+{
+	if (pSourceTab == nullptr || !pSourceTab->HasUnsavedChanges())
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<SaveJob> pJob(new SaveJob);
+	pJob->tabId = pSourceTab->GetId();
+	pJob->version = pSourceTab->GetVersion();
+	pJob->path = pSourceTab->GetPath();
+	pJob->writeByteOrderMark = pSourceTab->HasByteOrderMark();
+
+	// A snapshot that couldn't be revived is still the text of the tab, the edit is empty
+	if (pSourceTab->IsHibernated())
+	{
+		pJob->pSnapshot.reset(new TabSnapshot(*pSourceTab->GetSnapshot()));
+	}
+
+	// Copying a document doesn't copy the text it was loaded with, only what was typed since
+	else
+	{
+		pJob->pDocument.reset(new PieceTable(pSourceTab->GetSourceEdit()->GetDocument()));
+	}
+
+	return pJob;
+}
+
+bool SaveJob::Run(void)
+{
+	TextFileWriter writer;
+	hasSucceeded = false;
+
+	if (!writer.Open(path.c_str(), writeByteOrderMark))
+	{
+		return false;
+	}
+
+	if (pDocument != nullptr)
+	{
+		// Only one block of the text and its encoded bytes are in memory at any point
+		std::vector<wchar_t> block(SAVE_BLOCK_SIZE);
+		size_t position = 0;
+
+		while (position < pDocument->GetLength())
+		{
+			const size_t copied = pDocument->CopyTextRange(position, block.size(), block.data());
+
+			if (!writer.Write(block.data(), copied))
+			{
+				return false;
+			}
+
+			position += copied;
+		}
+	}
+
+	// The text of a hibernated tab only exists compressed, so it's decompressed as a whole
+	else if (pSnapshot != nullptr)
+	{
+		std::wstring text;
+
+		if (!pSnapshot->GetText(text) || !writer.Write(text.data(), text.length()))
+		{
+			return false;
+		}
+	}
+
+	CommittedFile& committedFile = GetCommittedFile(path);
+	std::lock_guard<std::mutex> lock(committedFile.mutex);
+
+	// Ctrl+S can write a newer version of the tab while Save All is still writing this one,
+	// the file already holds newer text, so the temporary file is deleted by the writer
+	if (committedFile.version > version)
+	{
+		Logger::Write(L"Skipped saving an older version of %ls", path.c_str());
+		hasSucceeded = true;
+		return true;
+	}
+
+	hasSucceeded = writer.Commit();
+
+	if (hasSucceeded)
+	{
+		committedFile.version = version;
+	}
+
+	return hasSucceeded;
+}
+
+SaveScheduler::SaveScheduler(HWND hWndNotify)
+	: m_hWndNotify(hWndNotify),
+	  m_NextJob(0)
+{
+}
+
+SaveScheduler::~SaveScheduler(void)
+{
+	JoinWorkers();
+}
+
+bool SaveScheduler::Start(std::vector<std::unique_ptr<SaveJob>> jobs)
+{
+	// The jobs of the running batch are still referenced by posted messages
+	if (IsRunning())
+	{
+		return false;
+	}
+
+	JoinWorkers();
+
+	m_Jobs = std::move(jobs);
+	m_NextJob = 0;
+	m_FinishedCount = 0;
+	m_FailedCount = 0;
+	m_StartTime = GetTickCount64();
+
+	if (m_Jobs.empty())
+	{
+		return true;
+	}
+
+	// Saving is mostly waiting for the disk, but encoding big files can keep a processor busy
+	const size_t workerCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), m_Jobs.size());
+
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		m_Workers.emplace_back(&SaveScheduler::RunWorker, this);
+	}
+
+	return true;
+}
+
+void SaveScheduler::RunWorker(void)
+{
+	size_t index = 0;
+
+	while ((index = m_NextJob++) < m_Jobs.size())
+	{
+		SaveJob* pJob = m_Jobs[index].get();
+		pJob->Run();
+
+		PostMessage(m_hWndNotify, WM_FILE_SAVED, NULL, reinterpret_cast<LPARAM>(pJob));
+	}
+}
+
+void SaveScheduler::JoinWorkers(void)
+{
+	for (std::thread& worker : m_Workers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+
+	m_Workers.clear();
+}
+
+bool SaveScheduler::OnJobFinished(SaveJob* pJob)
+{
+	if (!pJob->hasSucceeded)
+	{
+		++m_FailedCount;
+	}
+
+	if (++m_FinishedCount < m_Jobs.size())
+	{
+		return false;
+	}
+
+	// Every worker has posted its last job, so they're only returning at this point
+	JoinWorkers();
+
+	Logger::Write(L"Saved %u files in %u ms, %u failed",
+		          static_cast<unsigned int>(m_Jobs.size() - m_FailedCount),
+		          static_cast<unsigned int>(GetTickCount64() - m_StartTime),
+		          static_cast<unsigned int>(m_FailedCount));
+
+	m_Jobs.clear();
+
+	return true;
+}
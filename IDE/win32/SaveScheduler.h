@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Window.h"
+#include "PieceTable.h"
+#include "TabSnapshot.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SourceTab;
+
+// Posted to the window of a SaveScheduler, lParam: pointer to the SaveJob that finished
+#define WM_FILE_SAVED (WM_APP + 4)
+
+/// <summary>
+/// Everything needed to save one tab, copied on the UI thread so that the
+/// file can be written on another thread while the tab keeps being edited.
+/// </summary>
+struct SaveJob {
+	// The tab may be closed and deleted before the file is written, so it's looked up again by id
+	size_t tabId = 0;
+	size_t version = 0;
+
+	std::wstring path;
+	bool writeByteOrderMark = false;
+
+	// The document of a live tab, or the snapshot of a hibernated one
+	std::unique_ptr<PieceTable> pDocument;
+	std::unique_ptr<TabSnapshot> pSnapshot;
+
+	bool hasSucceeded = false;
+
+	/* nullptr if the tab has no unsaved changes */
+	static std::unique_ptr<SaveJob> FromTab(SourceTab* pSourceTab);
+
+	/// <summary>
+	/// Encodes and writes the file, safe to call from any thread. Jobs for
+	/// the same file replace it one at a time, and a job whose version is
+	/// older than the one the file was last saved with leaves it alone.
+	/// </summary>
+	bool Run(void);
+};
+
+/// <summary>
+/// Writes a batch of files on a pool of worker threads. Each finished job
+/// is posted back to the window as WM_FILE_SAVED, which passes it on to
+/// OnJobFinished once it has dealt with the tab.
+/// </summary>
+class SaveScheduler
+{
+private:
+	HWND m_hWndNotify = nullptr;
+
+	std::vector<std::unique_ptr<SaveJob>> m_Jobs;
+	std::vector<std::thread> m_Workers;
+	std::atomic<size_t> m_NextJob;
+
+	size_t m_FinishedCount = 0;
+	size_t m_FailedCount = 0;
+	ULONGLONG m_StartTime = 0;
+
+	void RunWorker(void);
+	void JoinWorkers(void);
+
+public:
+	explicit SaveScheduler(HWND hWndNotify);
+
+	/* Waits for the files that are still being written */
+	~SaveScheduler(void);
+
+	SaveScheduler(const SaveScheduler&) = delete;
+	SaveScheduler& operator=(const SaveScheduler&) = delete;
+
+	bool IsRunning(void) const { return !m_Jobs.empty(); }
+
+	/// <summary>
+	/// Starts writing the files on up to one thread per processor
+	/// </summary>
+	/// <returns> false if the previous batch hasn't finished yet </returns>
+	bool Start(std::vector<std::unique_ptr<SaveJob>> jobs);
+
+	/// <summary>
+	/// Called for every WM_FILE_SAVED. The job is freed when it's the last
+	/// one of the batch.
+	/// </summary>
+	/// <returns> Whether every job of the batch has finished </returns>
+	bool OnJobFinished(SaveJob* pJob);
+
+	size_t GetJobCount(void) const { return m_Jobs.size(); }
+	size_t GetWorkerCount(void) const { return m_Workers.size(); }
+	size_t GetFinishedCount(void) const { return m_FinishedCount; }
+	size_t GetFailedCount(void) const { return m_FailedCount; }
+};
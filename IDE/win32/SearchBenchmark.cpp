@@ -0,0 +1,528 @@
+#include "SearchBenchmark.h"
+#include "Benchmark.h"
+#include "TextSearch.h"
+#include "MultiPatternSearch.h"
+#include "Regex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define SEARCH_BENCHMARK_HORSPOOL
+#endif
+
+// Characters of each generated corpus
+#define SEARCH_BENCHMARK_CORPUS_SIZE (16 * 1024 * 1024)
+
+// A pattern is searched for at least this many times and for at least this long
+#define SEARCH_BENCHMARK_MIN_PASSES 3
+#define SEARCH_BENCHMARK_MIN_DURATION_MS 500
+
+/* A pattern looked for in one of the corpora */
+struct SearchCase {
+	const char* lpszCorpus;
+	const wchar_t* lpszPattern;
+	bool matchCase;
+};
+
+/* Counts the non overlapping matches of the whole text */
+typedef size_t(*CountFunction)(const std::wstring& text, const std::wstring& pattern, bool matchCase);
+
+static const wchar_t* g_Words[] = {
+	L"the", L"of", L"and", L"search", L"window", L"buffer", L"Editor", L"find", L"a", L"text", L"with", L"pattern",
+	L"line", L"document", L"file", L"when", L"match", L"Replace", L"is", L"character"
+};
+
+/* Words and punctuation, with a line break every few sentences */
+static void GenerateProse(std::mt19937& random, std::wstring& text)
+{
+	while (text.length() < SEARCH_BENCHMARK_CORPUS_SIZE)
+	{
+		const size_t words = 4 + random() % 16;
+
+		for (size_t i = 0; i < words; ++i)
+		{
+			text += g_Words[random() % (sizeof(g_Words) / sizeof(g_Words[0]))];
+			text.push_back(i + 1 < words ? L' ' : L'.');
+		}
+
+		text.push_back(random() % 4 == 0 ? L'\r' : L' ');
+	}
+}
+
+/* Short lines of code, indented, full of the same few identifiers */
+static void GenerateSource(std::mt19937& random, std::wstring& text)
+{
+	static const wchar_t* lpszLines[] = {
+		L"\tif (pSourceEdit->IsLargeFileView())\r",
+		L"\t\treturn SendMessage(hEditControl, EM_SETSEL, 0, 0);\r",
+		L"\tconst size_t length = text.length();\r",
+		L"\tfor (size_t i = 0; i < length; ++i)\r",
+		L"\t{\r",
+		L"\t}\r",
+		L"\tLogger::Write(L\"Could not open %ls\", lpszPath);\r",
+		L"// Line breaks are stored as a single character\r"
+	};
+
+	while (text.length() < SEARCH_BENCHMARK_CORPUS_SIZE)
+	{
+		text += lpszLines[random() % (sizeof(lpszLines) / sizeof(lpszLines[0]))];
+	}
+}
+
+/* Every position passes the filter of a pattern made of the same character */
+static void GenerateRepeated(std::mt19937& random, std::wstring& text)
+{
+	text.assign(SEARCH_BENCHMARK_CORPUS_SIZE, L'a');
+
+	for (size_t i = 0; i < 16; ++i)
+	{
+		text[random() % text.length()] = L'b';
+	}
+}
+
+static const SearchCase g_Cases[] = {
+	{ "prose", L"window", true },
+	{ "prose", L"WINDOW", false },
+	{ "prose", L"the", true },
+	{ "prose", L"document file when match", true },
+	{ "prose", L"not in the text", false },
+	{ "source", L"IsLargeFileView", true },
+	{ "source", L"em_setsel", false },
+	{ "source", L"\tfor (size_t i = 0; i < length; ++i)\r\t{", true },
+	{ "repeated", L"aaaaaaaaaaaaaaab", true },
+	{ "repeated", L"baaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", true },
+	{ "repeated", L"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", false }
+};
+
+/* A regular expression, named since the pattern would have to be escaped for JSON */
+struct RegexCase {
+	const char* lpszCorpus;
+	const char* lpszName;
+	const wchar_t* lpszPattern;
+	bool matchCase;
+};
+
+static const RegexCase g_RegexCases[] = {
+	{ "prose", "literal", L"window", true },
+	{ "prose", "word_ending", L"\\b\\w+ow\\b", false },
+	{ "prose", "alternation", L"(search|find|match)\\w* (the|a)", true },
+	{ "source", "call", L"(\\w+)\\(([^)]*)\\)", true },
+	{ "source", "string", L"L\"[^\"]*\"", true },
+
+	// Each of these takes a backtracking engine exponential time once the run of a's is long
+	{ "repeated", "nested_star", L"(a*)*c", true },
+	{ "repeated", "same_alternatives", L"(a|a)*c", true },
+	{ "repeated", "nested_plus", L"(a+a+)+c", true },
+	{ "repeated", "counted", L"a{0,30}a{30}c", true }
+};
+
+/* Several patterns looked for in one of the corpora, all at once or one after the other */
+struct MultiPatternCase {
+	const char* lpszCorpus;
+	const char* lpszName;
+	void (*pGetPatterns)(std::vector<std::wstring>& patterns);
+	bool matchCase;
+};
+
+static void GetMarkers(std::vector<std::wstring>& patterns)
+{
+	patterns = { L"TODO", L"FIXME", L"HACK", L"XXX" };
+}
+
+static void GetKeywords(std::vector<std::wstring>& patterns)
+{
+	patterns = { L"if", L"for", L"while", L"return", L"const", L"size_t", L"int", L"void",
+		         L"char", L"else", L"switch", L"case", L"break", L"static", L"struct", L"class" };
+}
+
+static void GetWords(std::vector<std::wstring>& patterns)
+{
+	patterns.assign(std::begin(g_Words), std::end(g_Words));
+}
+
+/* Many words that are rarely in the text, like the identifiers of a big project */
+static void GetIdentifiers(std::vector<std::wstring>& patterns)
+{
+	std::mt19937 random(0x5345);
+
+	patterns.assign(std::begin(g_Words), std::end(g_Words));
+
+	while (patterns.size() < 256)
+	{
+		std::wstring identifier(4 + random() % 8, L'\0');
+
+		for (wchar_t& ch : identifier)
+		{
+			ch = static_cast<wchar_t>(L'a' + random() % 26);
+		}
+
+		patterns.push_back(std::move(identifier));
+	}
+}
+
+static const MultiPatternCase g_MultiPatternCases[] = {
+	{ "source", "markers", GetMarkers, true },
+	{ "source", "keywords", GetKeywords, true },
+	{ "prose", "words", GetWords, false },
+	{ "prose", "identifiers", GetIdentifiers, true }
+};
+
+/* Case folding for the standard searchers */
+static inline wchar_t FoldChar(wchar_t ch)
+{
+	return static_cast<wchar_t>(towlower(ch));
+}
+
+struct FoldedEqual {
+	bool operator()(wchar_t a, wchar_t b) const { return FoldChar(a) == FoldChar(b); }
+};
+
+struct FoldedHash {
+	size_t operator()(wchar_t ch) const { return std::hash<wchar_t>()(FoldChar(ch)); }
+};
+
+static size_t CountForward(const std::wstring& text, const std::wstring& pattern, bool matchCase)
+{
+	SearchOptions options;
+	options.matchCase = matchCase;
+
+	const TextSearcher searcher(pattern, options);
+
+	size_t count = 0;
+	size_t position = 0;
+	size_t match;
+
+	while (searcher.FindForward(text.c_str(), text.length(), position, match))
+	{
+		++count;
+		position = match + pattern.length();
+	}
+
+	return count;
+}
+
+static size_t CountBackward(const std::wstring& text, const std::wstring& pattern, bool matchCase)
+{
+	SearchOptions options;
+	options.matchCase = matchCase;
+
+	const TextSearcher searcher(pattern, options);
+
+	size_t count = 0;
+	size_t end = text.length();
+	size_t match;
+
+	while (searcher.FindBackward(text.c_str(), text.length(), end, match))
+	{
+		++count;
+		end = match;
+	}
+
+	return count;
+}
+
+/* Calls 'search' until the end of the text, it returns where the match starts or 'last' */
+template <class Iterator, class Search>
+static size_t CountMatches(Iterator first, Iterator last, size_t patternLength, Search search)
+{
+	size_t count = 0;
+
+	while (static_cast<size_t>(last - first) >= patternLength)
+	{
+		const Iterator match = search(first, last);
+
+		if (match == last)
+		{
+			break;
+		}
+
+		++count;
+		first = match + patternLength;
+	}
+
+	return count;
+}
+
+static size_t CountStdSearch(const std::wstring& text, const std::wstring& pattern, bool matchCase)
+{
+	return CountMatches(text.begin(), text.end(), pattern.length(), [&](std::wstring::const_iterator first, std::wstring::const_iterator last) {
+		return matchCase ? std::search(first, last, pattern.begin(), pattern.end())
+			             : std::search(first, last, pattern.begin(), pattern.end(), FoldedEqual());
+	});
+}
+
+static size_t CountStdSearchBackward(const std::wstring& text, const std::wstring& pattern, bool matchCase)
+{
+	return CountMatches(text.rbegin(), text.rend(), pattern.length(), [&](std::wstring::const_reverse_iterator first, std::wstring::const_reverse_iterator last) {
+		return matchCase ? std::search(first, last, pattern.rbegin(), pattern.rend())
+			             : std::search(first, last, pattern.rbegin(), pattern.rend(), FoldedEqual());
+	});
+}
+
+#ifdef SEARCH_BENCHMARK_HORSPOOL
+static size_t CountHorspool(const std::wstring& text, const std::wstring& pattern, bool matchCase)
+{
+	if (matchCase)
+	{
+		const std::boyer_moore_horspool_searcher<std::wstring::const_iterator> searcher(pattern.begin(), pattern.end());
+
+		return CountMatches(text.begin(), text.end(), pattern.length(), [&searcher](std::wstring::const_iterator first, std::wstring::const_iterator last) {
+			return searcher(first, last).first;
+		});
+	}
+
+	const std::boyer_moore_horspool_searcher<std::wstring::const_iterator, FoldedHash, FoldedEqual> searcher(pattern.begin(), pattern.end());
+
+	return CountMatches(text.begin(), text.end(), pattern.length(), [&searcher](std::wstring::const_iterator first, std::wstring::const_iterator last) {
+		return searcher(first, last).first;
+	});
+}
+
+static size_t CountHorspoolBackward(const std::wstring& text, const std::wstring& pattern, bool matchCase)
+{
+	if (matchCase)
+	{
+		const std::boyer_moore_horspool_searcher<std::wstring::const_reverse_iterator> searcher(pattern.rbegin(), pattern.rend());
+
+		return CountMatches(text.rbegin(), text.rend(), pattern.length(), [&searcher](std::wstring::const_reverse_iterator first, std::wstring::const_reverse_iterator last) {
+			return searcher(first, last).first;
+		});
+	}
+
+	const std::boyer_moore_horspool_searcher<std::wstring::const_reverse_iterator, FoldedHash, FoldedEqual> searcher(pattern.rbegin(), pattern.rend());
+
+	return CountMatches(text.rbegin(), text.rend(), pattern.length(), [&searcher](std::wstring::const_reverse_iterator first, std::wstring::const_reverse_iterator last) {
+		return searcher(first, last).first;
+	});
+}
+#endif
+
+static const struct {
+	const char* lpszName;
+	const char* lpszDirection;
+	CountFunction pCount;
+} g_Engines[] = {
+	{ "TextSearcher", "forward", CountForward },
+	{ "TextSearcher", "backward", CountBackward },
+	{ "std::search", "forward", CountStdSearch },
+	{ "std::search", "backward", CountStdSearchBackward },
+#ifdef SEARCH_BENCHMARK_HORSPOOL
+	{ "std::boyer_moore_horspool_searcher", "forward", CountHorspool },
+	{ "std::boyer_moore_horspool_searcher", "backward", CountHorspoolBackward },
+#endif
+};
+
+static void Measure(FILE* pOutput, const SearchCase& searchCase, const std::wstring& text)
+{
+	const std::wstring pattern = searchCase.lpszPattern;
+
+	for (const auto& engine : g_Engines)
+	{
+		size_t passCount = 0;
+		size_t matchCount = 0;
+
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+		Benchmark::Clock::duration elapsed;
+
+		do
+		{
+			matchCount = engine.pCount(text, pattern, searchCase.matchCase);
+
+			++passCount;
+			elapsed = Benchmark::Clock::now() - start;
+		} while (passCount < SEARCH_BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(SEARCH_BENCHMARK_MIN_DURATION_MS));
+
+		const double megabytes = text.length() * sizeof(wchar_t) * static_cast<double>(passCount) / BYTES_PER_MEGABYTE;
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+
+		fprintf(pOutput, "{\"corpus\":\"%s\",\"pattern_length\":%llu,\"match_case\":%s,\"engine\":\"%s\",\"direction\":\"%s\","
+			             "\"matches\":%llu,\"passes\":%llu,\"mb_per_s\":%.2f}\n",
+			    searchCase.lpszCorpus, static_cast<unsigned long long>(pattern.length()), searchCase.matchCase ? "true" : "false",
+			    engine.lpszName, engine.lpszDirection, static_cast<unsigned long long>(matchCount),
+			    static_cast<unsigned long long>(passCount), megabytes / seconds);
+		fflush(pOutput);
+	}
+}
+
+/* Replace All does the whole search with one machine, the way the editor runs it */
+static void MeasureRegex(FILE* pOutput, const RegexCase& regexCase, const std::wstring& text)
+{
+	SearchOptions options;
+	options.matchCase = regexCase.matchCase;
+
+	Regex regex;
+	regex.Compile(regexCase.lpszPattern, options);
+
+	size_t passCount = 0;
+	size_t matchCount = 0;
+
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	Benchmark::Clock::duration elapsed;
+
+	do
+	{
+		ReplaceAllResult result;
+		regex.ReplaceAll(text, L"$&", result);
+		matchCount = result.matchCount;
+
+		++passCount;
+		elapsed = Benchmark::Clock::now() - start;
+	} while (passCount < SEARCH_BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(SEARCH_BENCHMARK_MIN_DURATION_MS));
+
+	const double megabytes = text.length() * sizeof(wchar_t) * static_cast<double>(passCount) / BYTES_PER_MEGABYTE;
+	const double seconds = std::chrono::duration<double>(elapsed).count();
+
+	fprintf(pOutput, "{\"corpus\":\"%s\",\"regex\":\"%s\",\"match_case\":%s,\"engine\":\"Regex\",\"direction\":\"forward\","
+		             "\"matches\":%llu,\"passes\":%llu,\"mb_per_s\":%.2f}\n",
+		    regexCase.lpszCorpus, regexCase.lpszName, regexCase.matchCase ? "true" : "false",
+		    static_cast<unsigned long long>(matchCount), static_cast<unsigned long long>(passCount), megabytes / seconds);
+	fflush(pOutput);
+}
+
+/* Counts every occurrence of every pattern, overlapping ones too, the way the automaton finds them */
+static size_t CountSequential(const std::wstring& text, const std::vector<std::wstring>& patterns, const SearchOptions& options)
+{
+	size_t count = 0;
+
+	for (const std::wstring& pattern : patterns)
+	{
+		const TextSearcher searcher(pattern, options);
+
+		size_t position = 0;
+		size_t match;
+
+		while (searcher.FindForward(text.c_str(), text.length(), position, match))
+		{
+			++count;
+			position = match + 1;
+		}
+	}
+
+	return count;
+}
+
+/// <summary>
+/// The automaton against a TextSearcher per pattern, one after the other.
+/// Building the automaton is timed apart from the scans, the editor builds
+/// it once and scans with it many times.
+/// </summary>
+static void MeasureMultiPattern(FILE* pOutput, const MultiPatternCase& multiCase, const std::wstring& text)
+{
+	std::vector<std::wstring> patterns;
+	multiCase.pGetPatterns(patterns);
+
+	SearchOptions options;
+	options.matchCase = multiCase.matchCase;
+
+	const Benchmark::Clock::time_point buildStart = Benchmark::Clock::now();
+	const MultiPatternSearcher searcher(patterns, options);
+	const double buildMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - buildStart);
+
+	std::vector<PatternMatch> matches;
+
+	const std::function<size_t(void)> engines[] = {
+		[&]() {
+			matches.clear();
+			searcher.FindAll(text.c_str(), text.length(), matches);
+
+			return matches.size();
+		},
+		[&]() {
+			return CountSequential(text, patterns, options);
+		}
+	};
+
+	const char* lpszEngines[] = { "MultiPatternSearcher", "TextSearcher per pattern" };
+
+	for (size_t engine = 0; engine < 2; ++engine)
+	{
+		size_t passCount = 0;
+		size_t matchCount = 0;
+
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+		Benchmark::Clock::duration elapsed;
+
+		do
+		{
+			matchCount = engines[engine]();
+
+			++passCount;
+			elapsed = Benchmark::Clock::now() - start;
+		} while (passCount < SEARCH_BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(SEARCH_BENCHMARK_MIN_DURATION_MS));
+
+		const double megabytes = text.length() * sizeof(wchar_t) * static_cast<double>(passCount) / BYTES_PER_MEGABYTE;
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+
+		fprintf(pOutput, "{\"corpus\":\"%s\",\"pattern_set\":\"%s\",\"patterns\":%llu,\"match_case\":%s,\"engine\":\"%s\","
+			             "\"matches\":%llu,\"passes\":%llu,\"mb_per_s\":%.2f,\"states\":%llu,\"table_bytes\":%llu,\"build_ms\":%.3f}\n",
+			    multiCase.lpszCorpus, multiCase.lpszName, static_cast<unsigned long long>(patterns.size()),
+			    multiCase.matchCase ? "true" : "false", lpszEngines[engine], static_cast<unsigned long long>(matchCount),
+			    static_cast<unsigned long long>(passCount), megabytes / seconds, static_cast<unsigned long long>(searcher.GetStateCount()),
+			    static_cast<unsigned long long>(searcher.GetTableSize()), buildMilliseconds);
+		fflush(pOutput);
+	}
+}
+
+bool SearchBenchmark::Run(const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	static const struct {
+		const char* lpszName;
+		void (*pGenerate)(std::mt19937& random, std::wstring& text);
+	} corpora[] = {
+		{ "prose", GenerateProse },
+		{ "source", GenerateSource },
+		{ "repeated", GenerateRepeated }
+	};
+
+	for (const auto& corpus : corpora)
+	{
+		// The same text every time, so that the results of two builds can be compared
+		std::mt19937 random(0x5345);
+		std::wstring text;
+
+		corpus.pGenerate(random, text);
+
+		for (const SearchCase& searchCase : g_Cases)
+		{
+			if (strcmp(searchCase.lpszCorpus, corpus.lpszName) == 0)
+			{
+				Measure(pOutput, searchCase, text);
+			}
+		}
+
+		for (const RegexCase& regexCase : g_RegexCases)
+		{
+			if (strcmp(regexCase.lpszCorpus, corpus.lpszName) == 0)
+			{
+				MeasureRegex(pOutput, regexCase, text);
+			}
+		}
+
+		for (const MultiPatternCase& multiCase : g_MultiPatternCases)
+		{
+			if (strcmp(multiCase.lpszCorpus, corpus.lpszName) == 0)
+			{
+				MeasureMultiPattern(pOutput, multiCase, text);
+			}
+		}
+	}
+
+	return fclose(pOutput) == 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-search
+#define SEARCH_BENCHMARK_ARGUMENT L"--benchmark-search"
+
+// Written to the current directory, one line of JSON per pattern and engine
+#define SEARCH_BENCHMARK_OUTPUT_FILE L"search-benchmark.jsonl"
+
+/// <summary>
+/// Measures TextSearcher against the searchers of the standard library on
+/// generated text: prose, source code and a text made of a single
+/// repeated character, which is the worst case of the vector filter.
+/// Every engine counts the matches of the whole text, forward and
+/// backward, and the counts are written next to the throughput so that a
+/// wrong result can't pass for a fast one.
+/// std::boyer_moore_horspool_searcher is only measured when the project
+/// is built as C++17 or later.
+/// Regular expressions are measured through Replace All, including
+/// patterns that take backtracking engines exponential time.
+/// Sets of patterns are looked for with MultiPatternSearcher in one pass,
+/// and with a TextSearcher per pattern one after the other.
+/// </summary>
+namespace SearchBenchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszOutputPath);
+}
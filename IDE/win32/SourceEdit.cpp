@@ -3,11 +3,15 @@
 #include "ColorFormatParser.h"
 #include "Utility.h"
 #include "AppWindow.h"
+#include "Logger.h"
 #include "resource.h"
 
 #include <Richedit.h>
 #include <CommCtrl.h>
+#include <imm.h>
+#include <algorithm>
 #include <cctype>
+#include <chrono>
 
 #ifndef IsKeyPressed
 #define IsKeyPressed(x) (GetKeyState(x) & 0x8000)
@@ -16,12 +20,86 @@
 #define NUMBER_BUFSIZ 32
 #define BASE10 10
 
+#define LARGE_FILE_SCROLL_RANGE 10000
+
+// The background pass starts once no edit was made for this long
+#define HIGHLIGHT_TIMER_ID 0x484C
+#define HIGHLIGHT_IDLE_DELAY_MS 300
+
+// Time the background colors may hold up the UI thread in one go
+#define HIGHLIGHT_FRAME_BUDGET_MS 8
+
+// Lines of a chunk applied between two looks at the clock
+#define HIGHLIGHT_SLICE_LINES 64
+
+// Passes that send at least this many messages to the control are logged
+#define HIGHLIGHT_REPORT_MESSAGE_COUNT 1000
+
+// Characters of the document compared with the control at a time when they're synchronized
+#define SYNCHRONIZE_BLOCK_SIZE 4096
+
 static bool g_hasBeenParsed = false;
-static ColorFormatParser g_KeywordColorParser;
+static ColorFormatParser g_SpecialColorParser;
+
+static COLORREF g_crString = DEFAULT_TEXT_COLOR;
+static COLORREF g_crDigit = DEFAULT_TEXT_COLOR;
+static COLORREF g_crComment = DEFAULT_TEXT_COLOR;
+static COLORREF g_crMarker = DEFAULT_TEXT_COLOR;
+
+/* Called by the background pass as well, so it may only read the color tables */
+static uint32_t GetTokenColor(const Language& language, const wchar_t* pLine, const Token& token)
+{
+	switch (token.type)
+	{
+	case TokenType::IDENTIFIER:
+	case TokenType::DIRECTIVE:
+		return language.keywords.GetKeywordColor(pLine + token.start, token.length).cr;
+
+	case TokenType::NUMBER:
+		return g_crDigit;
+
+	case TokenType::STRING:
+	case TokenType::CHARACTER:
+		return g_crString;
+
+	case TokenType::COMMENT:
+		return g_crComment;
+
+	case TokenType::MARKER:
+		return g_crMarker;
+	}
+
+	return DEFAULT_TEXT_COLOR;
+}
+
+/// <summary>
+/// Parses the color file of the literals and comments if it's the first
+/// time the function is called and saves it globally
+/// </summary>
+TokenColorFunction SourceEdit::GetTokenColorFunction(void)
+{
+	if (!g_hasBeenParsed)
+	{
+		g_SpecialColorParser.ParseFile(L"special.color");
+
+		g_crString = g_SpecialColorParser.GetKeywordColor(L"string").cr;
+		g_crDigit = g_SpecialColorParser.GetKeywordColor(L"digit").cr;
+		g_crComment = g_SpecialColorParser.GetKeywordColor(L"comment").cr;
+
+		// Color files that predate markers leave them the color of the comment
+		const CRSTATUS marker = g_SpecialColorParser.GetKeywordColor(L"marker");
+		g_crMarker = marker.wasFound ? marker.cr : g_crComment;
+
+		g_hasBeenParsed = true;
+	}
+
+	return ::GetTokenColor;
+}
 
 void MarkSourceAsEdited(SourceEdit* pSourceEdit)
 {
-	if (pSourceEdit != nullptr)
+	// Large files are read only, they never need saving
+	if (pSourceEdit != nullptr && !pSourceEdit->IsLargeFileView())
 	{
 		if (!pSourceEdit->HasBeenEdited())
 		{
@@ -55,45 +133,6 @@ void MarkSourceAsEdited(SourceEdit* pSourceEdit)
 	}
 }
 
-static void OnCharColorWord(HWND hWnd)
-{
-	CHARRANGE cr;
-	SendMessage(hWnd, EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&cr));
-
-	DWORD dwLeft = SendMessage(hWnd, EM_FINDWORDBREAK, WB_MOVEWORDLEFT, cr.cpMin);
-	DWORD dwRight = SendMessage(hWnd, EM_FINDWORDBREAK, WB_MOVEWORDRIGHT, cr.cpMin);
-
-	wchar_t* lpsz = new wchar_t[dwRight - dwLeft + 1];
-	SendMessage(hWnd, EM_SETSEL, dwLeft, dwRight);
-	SendMessage(hWnd, EM_GETSELTEXT, NULL, (LPARAM)lpsz);
-
-	signed int offset = 0;
-
-	for (int i = min(lstrlen(lpsz) - 1, dwRight - dwLeft); i > 0 && (iswspace(lpsz[i]) || iswpunct(lpsz[i])); --i) {
-		--offset;
-		lpsz[i] = L'\0';
-	}
-
-	SendMessage(hWnd, EM_SETSEL, dwLeft, dwRight + offset);
-
-	CRSTATUS crStatus = g_KeywordColorParser.GetKeywordColor(lpsz);
-
-	CHARFORMAT cf;
-	cf.cbSize = sizeof(cf);
-	cf.dwMask = CFM_COLOR;
-	cf.dwEffects = 0;
-	cf.crTextColor = crStatus.wasFound ? crStatus.cr : 0x000000;
-
-	SendMessage(hWnd,
-		        EM_SETCHARFORMAT,
-		        SCF_WORD | SCF_SELECTION,
-		        reinterpret_cast<LPARAM>(&cf));
-
-	SendMessage(hWnd, EM_SETSEL, cr.cpMin, cr.cpMax);
-
-	delete[] lpsz;
-}
-
 static LRESULT OnChar(HWND hWnd, WPARAM wParam, LPARAM lParam, DWORD_PTR dwRefData)
 {
 	LRESULT result = DefSubclassProc(hWnd, WM_CHAR, wParam, lParam);
@@ -105,10 +144,6 @@ static LRESULT OnChar(HWND hWnd, WPARAM wParam, LPARAM lParam, DWORD_PTR dwRefDa
 		::MarkSourceAsEdited(pSourceEdit);
 	}
 
-	Utility::UpdateUndoMenuButton(hWnd);
-
-	OnCharColorWord(hWnd);
-
 	return result;
 }
 
@@ -173,7 +208,7 @@ static int CalculateLineNumberContainerVerticalOffset(HWND hWnd, int iLineHeight
 	return -offset % iLineHeight;
 }
 
-static void DrawLineNumbers(HDC hDC, HWND hWnd, const RECT* p_rcRect)
+static void DrawLineNumbers(HDC hDC, HWND hWnd, const RECT* p_rcRect, size_t first_line_number)
 {
 	double zoom_scale = ::GetZoomScale(hWnd);
 
@@ -197,7 +232,7 @@ static void DrawLineNumbers(HDC hDC, HWND hWnd, const RECT* p_rcRect)
 	for (int i = SendMessage(hWnd, EM_GETFIRSTVISIBLELINE, 0, 0); i < iLineCount; ++i)
 	{
 		wchar_t buf[NUMBER_BUFSIZ];
-		_itow_s(i + 1, buf, NUMBER_BUFSIZ, BASE10);
+		_ui64tow_s(first_line_number + i + 1, buf, NUMBER_BUFSIZ, BASE10);
 
 		RECT rc = { x, y, left_margin - iDistanceFromRightEdge + x, iLineHeight * (i + 1) };
 
@@ -219,7 +254,7 @@ static void DrawLineNumbers(HDC hDC, HWND hWnd, const RECT* p_rcRect)
 /// paints the numbers of the current lines on screen
 /// </summary>
 /// <param name="hWnd"> Handle to the edit control </param>
-static LRESULT OnPaint(HWND hWnd, WPARAM wParam, LPARAM lParam)
+static LRESULT OnPaint(HWND hWnd, WPARAM wParam, LPARAM lParam, SourceEdit* pSourceEdit)
 {
 	const int left_margin = ::GetLeftMargin(hWnd);
 
@@ -239,15 +274,17 @@ static LRESULT OnPaint(HWND hWnd, WPARAM wParam, LPARAM lParam)
 	HDC hDC = GetDC(hWnd);
 
 	DrawLineNumberingBackground(hDC, hWnd, &rcClient);
-	DrawLineNumbers(hDC, hWnd, &rcClient);
+	DrawLineNumbers(hDC, hWnd, &rcClient, pSourceEdit->GetFirstLineNumber());
 
 	ReleaseDC(hWnd, hDC);
 
 	return result;
 }
 
-static LRESULT OnKeyDown(HWND hWnd, WPARAM wParam, LPARAM lParam)
+static LRESULT OnKeyDown(HWND hWnd, WPARAM wParam, LPARAM lParam, DWORD_PTR dwRefData)
 {
+	SourceEdit* pSourceEdit = reinterpret_cast<SourceEdit*>(dwRefData);
+
 	/* Remove formatting keys */
 	if (IsKeyPressed(VK_CONTROL))
 	{
@@ -261,7 +298,14 @@ static LRESULT OnKeyDown(HWND hWnd, WPARAM wParam, LPARAM lParam)
 
 		case 'V': /* Remove format from pasted text */
 			SendMessage(hWnd, EM_PASTESPECIAL, CF_UNICODETEXT, NULL);
-			Utility::UpdateUndoMenuButton(hWnd);
+			return 0;
+
+		case 'Z':
+			pSourceEdit->Undo();
+			return 0;
+
+		case 'Y':
+			pSourceEdit->Redo();
 			return 0;
 
 		case 'C': {
@@ -305,6 +349,249 @@ static void ToggleCCDButtons(HWND hEditWindow, UINT uEnable)
 	EnableMenuItem(hMenu, ID_EDIT_DELETE, uEnable);
 }
 
+static bool IsTextChangingMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	switch (uMsg)
+	{
+	// The control inserts the text the IME composed without a WM_IME_CHAR for it
+	case WM_IME_COMPOSITION:
+		return (lParam & GCS_RESULTSTR) != 0;
+
+	case WM_CHAR:
+	case WM_IME_CHAR:
+	case WM_PASTE:
+	case WM_CUT:
+	case WM_CLEAR:
+	case EM_REPLACESEL:
+	case EM_PASTESPECIAL:
+		return true;
+
+	// Keys that the control handles by itself without sending one of the above
+	case WM_KEYDOWN:
+		return wParam == VK_DELETE || wParam == VK_BACK || wParam == VK_INSERT || wParam == 'X';
+	}
+
+	return false;
+}
+
+/* Messages after which other lines may be on screen */
+static bool CanScrollView(UINT uMsg)
+{
+	switch (uMsg)
+	{
+	case WM_VSCROLL:
+	case WM_MOUSEWHEEL:
+	case WM_KEYDOWN:
+	case WM_SIZE:
+	case EM_LINESCROLL:
+	case EM_SCROLLCARET:
+		return true;
+	}
+
+	return false;
+}
+
+static void OnLargeFileVerticalScroll(HWND hWnd, WPARAM wParam, SourceEdit* pSourceEdit)
+{
+	LargeFileView* pView = pSourceEdit->GetLargeFileView();
+	const int iPage = max(pSourceEdit->GetVisibleLineCount() - 1, 1);
+
+	switch (LOWORD(wParam))
+	{
+	case SB_LINEUP:   pSourceEdit->ScrollLargeFileView(-1); break;
+	case SB_LINEDOWN: pSourceEdit->ScrollLargeFileView(1); break;
+	case SB_PAGEUP:   pSourceEdit->ScrollLargeFileView(-iPage); break;
+	case SB_PAGEDOWN: pSourceEdit->ScrollLargeFileView(iPage); break;
+
+	case SB_TOP:
+		pView->ScrollToPosition(0.0);
+		pSourceEdit->RefreshLargeFileView();
+		break;
+
+	case SB_BOTTOM:
+		pView->ScrollToEnd(pSourceEdit->GetVisibleLineCount());
+		pSourceEdit->RefreshLargeFileView();
+		break;
+
+	case SB_THUMBTRACK:
+	case SB_THUMBPOSITION:
+	{
+		// The position in wParam is only 16 bits
+		SCROLLINFO sInfo = {};
+		sInfo.cbSize = sizeof(SCROLLINFO);
+		sInfo.fMask = SIF_TRACKPOS;
+		GetScrollInfo(hWnd, SB_VERT, &sInfo);
+
+		pView->ScrollToPosition(sInfo.nTrackPos / static_cast<double>(LARGE_FILE_SCROLL_RANGE));
+		pSourceEdit->RefreshLargeFileView();
+	}
+		break;
+	}
+}
+
+/// <summary>
+/// The control only holds the lines on screen when viewing a large file, so
+/// scrolling has to move the view of the file instead of the control
+/// </summary>
+/// <returns> Whether the message was handled </returns>
+static bool HandleLargeFileViewMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, SourceEdit* pSourceEdit, LRESULT* pResult)
+{
+	*pResult = 0;
+
+	switch (uMsg)
+	{
+	case WM_VSCROLL:
+		OnLargeFileVerticalScroll(hWnd, wParam, pSourceEdit);
+		return true;
+
+	case WM_MOUSEWHEEL:
+		if ((LOWORD(wParam) & MK_CONTROL) == MK_CONTROL)
+		{
+			// Zooming changes how many lines fit on screen
+			*pResult = DefSubclassProc(hWnd, uMsg, wParam, lParam);
+			pSourceEdit->HandleMouseWheel(wParam);
+			pSourceEdit->RefreshLargeFileView();
+		}
+
+		else
+		{
+			pSourceEdit->ScrollLargeFileView(-GET_WHEEL_DELTA_WPARAM(wParam) * 3 / WHEEL_DELTA);
+		}
+		return true;
+
+	case WM_SIZE:
+		*pResult = DefSubclassProc(hWnd, uMsg, wParam, lParam);
+		pSourceEdit->RefreshLargeFileView();
+		return true;
+
+	// The line numbers were estimated until now
+	case WM_LINE_COUNT_READY:
+		pSourceEdit->RefreshLargeFileView();
+		return true;
+
+	case WM_KEYDOWN:
+	{
+		const int iPage = max(pSourceEdit->GetVisibleLineCount() - 1, 1);
+
+		CHARRANGE cr;
+		SendMessage(hWnd, EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&cr));
+		const int iCaretLine = static_cast<int>(SendMessage(hWnd, EM_EXLINEFROMCHAR, NULL, cr.cpMax));
+
+		switch (wParam)
+		{
+		case VK_PRIOR:
+			pSourceEdit->ScrollLargeFileView(-iPage);
+			return true;
+
+		case VK_NEXT:
+			pSourceEdit->ScrollLargeFileView(iPage);
+			return true;
+
+		case VK_UP:
+			if (iCaretLine == 0 && pSourceEdit->GetLargeFileView()->GetPosition() > 0.0)
+			{
+				pSourceEdit->ScrollLargeFileView(-1);
+				return true;
+			}
+			break;
+
+		case VK_DOWN:
+			if (iCaretLine >= pSourceEdit->GetVisibleLineCount() - 2)
+			{
+				pSourceEdit->ScrollLargeFileView(1);
+				return true;
+			}
+			break;
+
+		case VK_HOME:
+		case VK_END:
+			if (IsKeyPressed(VK_CONTROL))
+			{
+				OnLargeFileVerticalScroll(hWnd, wParam == VK_HOME ? SB_TOP : SB_BOTTOM, pSourceEdit);
+				return true;
+			}
+			break;
+		}
+	}
+		break;
+	}
+
+	return false;
+}
+
+static LRESULT HandleSourceEditMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, DWORD_PTR dwRefData)
+{
+	SourceEdit* pSource = reinterpret_cast<SourceEdit*>(dwRefData);
+
+	if (pSource->IsLargeFileView())
+	{
+		LRESULT result;
+
+		if (HandleLargeFileViewMessage(hWnd, uMsg, wParam, lParam, pSource, &result))
+		{
+			return result;
+		}
+	}
+
+	switch (uMsg)
+	{
+	case WM_CHAR:
+		return OnChar(hWnd, wParam, lParam, dwRefData);
+
+	case WM_PAINT:
+		return OnPaint(hWnd, wParam, lParam, pSource);
+
+	case WM_KEYDOWN:
+		return OnKeyDown(hWnd, wParam, lParam, dwRefData);
+
+	// The control keeps no history of its own, the journal answers instead
+	case WM_UNDO:
+	case EM_UNDO:
+		return pSource->Undo();
+
+	case EM_REDO:
+		return pSource->Redo();
+
+	case EM_CANUNDO:
+		return pSource->CanUndo();
+
+	case EM_CANREDO:
+		return pSource->CanRedo();
+
+	case WM_MOUSEWHEEL:
+	{
+		LRESULT ret = DefSubclassProc(hWnd, uMsg, wParam, lParam);
+		pSource->HandleMouseWheel(wParam);
+		return ret;
+	}
+
+	case WM_TIMER:
+		if (wParam == HIGHLIGHT_TIMER_ID)
+		{
+			pSource->StartBackgroundHighlighting();
+			return 0;
+		}
+		break;
+
+	case WM_HIGHLIGHT_CHUNK:
+		pSource->OnHighlightChunk();
+		return 0;
+
+	case WM_HSCROLL:
+	{
+		RECT rcInvalid;
+		rcInvalid.left = 0;
+		rcInvalid.right = ::GetLeftMargin(hWnd) * 2;
+		rcInvalid.top = 0;
+		rcInvalid.bottom = pSource->GetRect().bottom;
+		InvalidateRect(hWnd, &rcInvalid, FALSE);
+	}
+		break;
+	}
+
+	return DefSubclassProc(hWnd, uMsg, wParam, lParam);
+}
+
 LRESULT CALLBACK SourceEditSubclassProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR, DWORD_PTR dwRefData)
 {
 	SourceEdit* pSource = reinterpret_cast<SourceEdit*>(dwRefData);
@@ -326,7 +613,7 @@ LRESULT CALLBACK SourceEditSubclassProcedure(HWND hWnd, UINT uMsg, WPARAM wParam
 	case EM_SETSEL:
 	case EM_EXSETSEL:
 		// TODO: refresh copy/cut/replace buttons
-		if (SelectionHasChanged(uMsg, lParam)) {
+		if (SelectionHasChanged(uMsg, lParam) && !pSource->IsHighlighting()) {
 			pSource->RefreshStatusBarText();
 			CHARRANGE cr;
 			SendMessage(hWnd, EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&cr));
@@ -338,55 +625,61 @@ LRESULT CALLBACK SourceEditSubclassProcedure(HWND hWnd, UINT uMsg, WPARAM wParam
 		break;
 	}
 
-	switch (uMsg)
+	if (IsTextChangingMessage(uMsg, wParam, lParam))
 	{
-	case WM_CHAR:
-		return OnChar(hWnd, wParam, lParam, dwRefData);
+		// A big paste would otherwise be drawn once plain and once more with its colors
+		const bool isPaste = uMsg == WM_PASTE || uMsg == EM_PASTESPECIAL;
 
-	case WM_PAINT:
-		return OnPaint(hWnd, wParam, lParam);
+		if (isPaste)
+		{
+			pSource->SuspendRedraw();
+		}
 
-	case WM_KEYDOWN:
-		return OnKeyDown(hWnd, wParam, lParam);
+		pSource->BeginTrackingEdit();
+		LRESULT result = HandleSourceEditMessage(hWnd, uMsg, wParam, lParam, dwRefData);
+		pSource->EndTrackingEdit(uMsg, wParam);
+		pSource->ApplyHighlighting();
 
-	case WM_MOUSEWHEEL:
-	{
-		LRESULT ret = DefSubclassProc(hWnd, uMsg, wParam, lParam);
-		pSource->HandleMouseWheel(wParam);
-		return ret;
+		if (isPaste)
+		{
+			pSource->ResumeRedraw();
+		}
+
+		return result;
 	}
 
-	case WM_HSCROLL:
+	const LRESULT result = HandleSourceEditMessage(hWnd, uMsg, wParam, lParam, dwRefData);
+
+	if (CanScrollView(uMsg))
 	{
-		RECT rcInvalid;
-		rcInvalid.left = 0;
-		rcInvalid.right = ::GetLeftMargin(hWnd) * 2;
-		rcInvalid.top = 0;
-		rcInvalid.bottom = pSource->GetRect().bottom;
-		InvalidateRect(hWnd, &rcInvalid, FALSE);
-	}
-		break;
+		pSource->HighlightViewport();
 	}
 
-	return DefSubclassProc(hWnd, uMsg, wParam, lParam);
+	return result;
 }
 
 /// <summary>
-/// Parses the color files if it's the first time the function is called
-/// and saves them globally, then initialize the edit window 
+/// Initializes the edit window. The text is plain until the language of
+/// the file is set.
 /// </summary>
 /// <param name="hParentWindow"> Handle to the parent window (WorkArea) </param>
 SourceEdit::SourceEdit(HWND hParentWindow)
-	: m_Zoomer(this)
+	: m_Zoomer(this),
+	  m_SyntaxHighlighter(m_Document, m_LineIndex, LanguageRegistry::GetPlainText()),
+	  m_EditJournal(m_Document),
+	  m_IncrementalSearch(m_Document),
+	  m_FormatBatch(DEFAULT_TEXT_COLOR)
 {
-	if (!g_hasBeenParsed)
-	{
-		g_KeywordColorParser.ParseFile(L"keywords.color");
-		g_hasBeenParsed = true;
-	}
+	m_SyntaxHighlighter.SetColorFunction(GetTokenColorFunction(), DEFAULT_TEXT_COLOR);
 
 	m_hWndParent = hParentWindow;
 
+	m_Document.AddListener(&m_LineIndex);
+	m_Document.AddListener(&m_SyntaxHighlighter);
+	m_Document.AddListener(&m_UndoJournal);
+	m_Document.AddListener(&m_EditJournal);
+	m_Document.AddListener(&m_IncrementalSearch);
+
 	m_pStatusBar = GetAssociatedObject<AppWindow>(GetAncestor(hParentWindow, GA_ROOT))->GetStatusBar();
 
 	m_Zoomer.AttachStatusBar(m_pStatusBar);
@@ -406,6 +699,12 @@ SourceEdit::SourceEdit(HWND hParentWindow)
 
 	SendMessage(m_hWndSelf, EM_AUTOURLDETECT, AURL_ENABLEURL, NULL);
 
+	// Dragging text around doesn't go through any message we can track
+	SendMessage(m_hWndSelf, EM_SETEVENTMASK, NULL, ENM_DRAGDROPDONE);
+
+	// Undo is handled by the journal, a second copy of the history would only waste memory
+	SendMessage(m_hWndSelf, EM_SETUNDOLIMIT, 0, NULL);
+
 	AdjustFontForDPI();
 	AdjustLeftMarginForDPI();
 
@@ -468,11 +767,15 @@ void SourceEdit::SetLineColumnStatusBar(void)
 	CHARRANGE cr;
 	SendMessage(m_hWndSelf, EM_EXGETSEL, NULL, (LPARAM)&cr);
 
-	LRESULT lLineIndex = SendMessage(m_hWndSelf, EM_EXLINEFROMCHAR, 0, cr.cpMax);
-	LRESULT lColumn = cr.cpMax - SendMessage(m_hWndSelf, EM_LINEINDEX, lLineIndex, NULL);
+	const size_t line = m_LineIndex.GetLineFromOffset(cr.cpMax);
+	const size_t column = cr.cpMax - m_LineIndex.GetOffsetFromLine(line);
 
-	WCHAR buf[32];
-	wsprintf(buf, L" Ln %d, Col %d", lLineIndex + 1, lColumn + 1);
+	// The lines before a large file's view may not have been counted yet
+	const bool isEstimated = m_pLargeFileView != nullptr && m_pLargeFileView->IsTopLineEstimated();
+
+	WCHAR buf[48];
+	swprintf_s(buf, isEstimated ? L" Ln ~%llu, Col %d" : L" Ln %llu, Col %d",
+		       static_cast<unsigned long long>(GetFirstLineNumber() + line + 1), static_cast<int>(column + 1));
 
 	m_pStatusBar->SetText(buf, 1);
 }
@@ -480,11 +783,13 @@ void SourceEdit::SetLineColumnStatusBar(void)
 void SourceEdit::MarkAsEdited(void)
 {
 	m_haveContentsBeenEdited = true;
+	m_EditJournal.Begin();
 }
 
 void SourceEdit::MarkAsUnedited(void)
 {
 	m_haveContentsBeenEdited = false;
+	m_EditJournal.Discard();
 }
 
 void SourceEdit::RefreshStatusBarText(void)
@@ -505,7 +810,7 @@ void SourceEdit::ScrollTo(int line)
 {
 	if (line >= 1)
 	{
-		int iLineCount = SendMessage(m_hWndSelf, EM_GETLINECOUNT, NULL, NULL);
+		const int iLineCount = GetLineCount();
 
 		if (line <= iLineCount)
 		{
@@ -516,7 +821,732 @@ void SourceEdit::ScrollTo(int line)
 	}
 }
 
-SourceEdit::~SourceEdit(void)
+static LONG GetTextLength(HWND hWnd)
+{
+	GETTEXTLENGTHEX gtl;
+	gtl.flags = GTL_NUMCHARS | GTL_PRECISE;
+	gtl.codepage = 1200; // UTF-16
+
+	return static_cast<LONG>(SendMessage(hWnd, EM_GETTEXTLENGTHEX, reinterpret_cast<WPARAM>(&gtl), NULL));
+}
+
+static std::wstring GetTextRange(HWND hWnd, LONG lStart, LONG lCount)
+{
+	std::wstring text;
+
+	if (lCount > 0)
+	{
+		text.resize(static_cast<size_t>(lCount) + 1);
+
+		TEXTRANGE tr;
+		tr.chrg.cpMin = lStart;
+		tr.chrg.cpMax = lStart + lCount;
+		tr.lpstrText = &text[0];
+
+		text.resize(SendMessage(hWnd, EM_GETTEXTRANGE, NULL, reinterpret_cast<LPARAM>(&tr)));
+	}
+
+	return text;
+}
+
+void SourceEdit::SetText(std::wstring text)
+{
+	Utility::NormalizeLineBreaks(text);
+
+	SetWindowText(m_hWndSelf, text.c_str());
+
+	m_Document.Load(std::move(text));
+
+	ApplyHighlighting();
+	StartBackgroundHighlighting();
+}
+
+void SourceEdit::SetPlaceholderText(const std::wstring& text)
+{
+	// WM_SETTEXT isn't tracked as an edit, so neither the undo history nor the journal sees it
+	SetWindowText(m_hWndSelf, text.c_str());
+}
+
+void SourceEdit::SetLanguage(const Language* pLanguage)
 {
+	if (pLanguage == m_SyntaxHighlighter.GetLanguage())
+	{
+		return;
+	}
+
+	// The background pass lexes with the rules of the old language
+	StopBackgroundHighlighting();
+
+	m_SyntaxHighlighter.SetLanguage(pLanguage);
+
+	ApplyHighlighting();
+	StartBackgroundHighlighting();
+}
+
+/* Characters at the start of the document that are the same as in the text */
+static size_t GetCommonPrefixLength(const PieceTable& document, const std::wstring& text)
+{
+	const size_t length = min(document.GetLength(), text.length());
+	wchar_t buffer[SYNCHRONIZE_BLOCK_SIZE];
+	size_t position = 0;
+
+	while (position < length)
+	{
+		const size_t copied = document.CopyTextRange(position, min(length - position, static_cast<size_t>(SYNCHRONIZE_BLOCK_SIZE)), buffer);
+		const size_t same = std::mismatch(buffer, buffer + copied, text.begin() + position).first - buffer;
+
+		position += same;
+
+		if (same < copied)
+		{
+			break;
+		}
+	}
+
+	return position;
+}
+
+/* Characters at the end of the document that are the same as in the text, at most 'maxLength' */
+static size_t GetCommonSuffixLength(const PieceTable& document, const std::wstring& text, size_t maxLength)
+{
+	wchar_t buffer[SYNCHRONIZE_BLOCK_SIZE];
+	size_t matched = 0;
+
+	while (matched < maxLength)
+	{
+		const size_t count = min(maxLength - matched, static_cast<size_t>(SYNCHRONIZE_BLOCK_SIZE));
+
+		document.CopyTextRange(document.GetLength() - matched - count, count, buffer);
+
+		// Compared backwards, from the end of the block
+		size_t same = 0;
+
+		while (same < count && buffer[count - same - 1] == text[text.length() - matched - same - 1])
+		{
+			++same;
+		}
+
+		matched += same;
+
+		if (same < count)
+		{
+			break;
+		}
+	}
+
+	return matched;
+}
+
+void SourceEdit::SynchronizeDocument(void)
+{
+	const std::wstring text = ::GetTextRange(m_hWndSelf, 0, ::GetTextLength(m_hWndSelf));
+
+	// Whatever the control did, it's applied as a single replacement of the
+	// characters between the part that stayed the same at both ends, so the
+	// undo history and the listeners only see what changed
+	const size_t documentLength = m_Document.GetLength();
+	const size_t prefix = GetCommonPrefixLength(m_Document, text);
+	const size_t suffix = GetCommonSuffixLength(m_Document, text, min(documentLength, text.length()) - prefix);
+
+	if (prefix + suffix == documentLength && documentLength == text.length())
+	{
+		return;
+	}
+
+	m_Document.Replace(prefix, documentLength - prefix - suffix, text.data() + prefix, text.length() - prefix - suffix);
+
+	ApplyHighlighting();
+}
+
+void SourceEdit::BeginTrackingEdit(void)
+{
+	if (m_iEditDepth++ == 0)
+	{
+		SendMessage(m_hWndSelf, EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&m_crBeforeEdit));
+		m_lLengthBeforeEdit = ::GetTextLength(m_hWndSelf);
+	}
+}
+
+void SourceEdit::EndTrackingEdit(UINT uMsg, WPARAM wParam)
+{
+	if (--m_iEditDepth > 0)
+	{
+		return;
+	}
+
+	CHARRANGE cr;
+	SendMessage(m_hWndSelf, EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&cr));
+
+	const LONG lLength = ::GetTextLength(m_hWndSelf);
+
+	if (lLength == m_lLengthBeforeEdit)
+	{
+		// Edits always leave a caret behind, a selection means nothing was typed over
+		if (cr.cpMin != cr.cpMax)
+		{
+			return;
+		}
+
+		// Same length with no selection before can only be a character typed in overwrite mode
+		const bool isPrintableChar = (uMsg == WM_CHAR || uMsg == WM_IME_CHAR) && wParam >= L' ';
+
+		if (m_crBeforeEdit.cpMin == m_crBeforeEdit.cpMax && !isPrintableChar)
+		{
+			return;
+		}
+	}
+
+	// Whatever was selected (or the character next to the caret) was removed
+	// and everything between the start of the edit and the caret was inserted
+	const LONG lStart = min(m_crBeforeEdit.cpMin, cr.cpMax);
+	const LONG lInserted = cr.cpMax - lStart;
+	const LONG lRemoved = m_lLengthBeforeEdit - lLength + lInserted;
+
+	if (lRemoved < 0 || static_cast<size_t>(lStart) + lRemoved > m_Document.GetLength())
+	{
+		SynchronizeDocument();
+		return;
+	}
+
+	const std::wstring inserted = ::GetTextRange(m_hWndSelf, lStart, lInserted);
+
+	m_Document.Replace(lStart, lRemoved, inserted.c_str(), inserted.length());
+
+	if (m_Document.GetLength() != static_cast<size_t>(lLength))
+	{
+		Logger::Write(L"Document went out of sync with the edit control, synchronizing it.");
+		SynchronizeDocument();
+	}
+
+	RefreshUndoMenuButtons(false);
+}
+
+LRESULT SourceEdit::SendColoringMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	++m_ColoringMessageCount;
+
+	return SendMessage(m_hWndSelf, uMsg, wParam, lParam);
+}
+
+/// <summary>
+/// Coloring a range means selecting it, which also scrolls the control
+/// to it, so both are put back when the colors have been applied
+/// </summary>
+void SourceEdit::BeginColoring(void)
+{
+	m_IsHighlighting = true;
+	SuspendRedraw();
+
+	SendColoringMessage(EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&m_crBeforeColoring));
+	SendColoringMessage(EM_GETSCROLLPOS, NULL, reinterpret_cast<LPARAM>(&m_ptBeforeColoring));
+}
+
+void SourceEdit::EndColoring(void)
+{
+	SendColoringMessage(EM_EXSETSEL, NULL, reinterpret_cast<LPARAM>(&m_crBeforeColoring));
+	SendColoringMessage(EM_SETSCROLLPOS, NULL, reinterpret_cast<LPARAM>(&m_ptBeforeColoring));
+
+	ResumeRedraw();
+	m_IsHighlighting = false;
+}
+
+/* Has to be called between BeginColoring and EndColoring */
+void SourceEdit::ApplyFormatBatch(const FormatBatch& batch, HighlightPassStats& stats)
+{
+	CHARFORMAT cf;
+	cf.cbSize = sizeof(cf);
+	cf.dwMask = CFM_COLOR;
+	cf.dwEffects = 0;
+
+	for (const std::vector<ColorRun>* pRuns : { &batch.GetBaseRuns(), &batch.GetColorRuns() })
+	{
+		for (const ColorRun& run : *pRuns)
+		{
+			CHARRANGE range = { static_cast<LONG>(run.position), static_cast<LONG>(run.position + run.length) };
+			SendColoringMessage(EM_EXSETSEL, NULL, reinterpret_cast<LPARAM>(&range));
+
+			cf.crTextColor = static_cast<COLORREF>(run.color);
+			SendColoringMessage(EM_SETCHARFORMAT, SCF_SELECTION, reinterpret_cast<LPARAM>(&cf));
+		}
+	}
+
+	stats.runCount += batch.GetAddedCount();
+	stats.appliedRunCount += batch.GetRunCount();
+}
+
+void SourceEdit::ReportHighlightPass(const HighlightPassStats& stats, const wchar_t* lpszWhere)
+{
+	if (stats.messageCount >= HIGHLIGHT_REPORT_MESSAGE_COUNT)
+	{
+		Logger::Write(
+			L"Highlighted %u lines %ls in %u ms: %u runs merged into %u, %u control messages",
+			static_cast<unsigned int>(stats.lineCount),
+			lpszWhere,
+			static_cast<unsigned int>(GetTickCount64() - stats.startTime),
+			static_cast<unsigned int>(stats.runCount),
+			static_cast<unsigned int>(stats.appliedRunCount),
+			static_cast<unsigned int>(stats.messageCount)
+		);
+	}
+}
+
+void SourceEdit::ApplyHighlighting(void)
+{
+	// The colors of the background pass belong to a text that doesn't exist anymore
+	if (m_pHighlightWorker != nullptr && m_pHighlightWorker->GetVersion() != m_Document.GetVersion())
+	{
+		StopBackgroundHighlighting();
+	}
+
+	HighlightViewport();
+
+	// Restarted on every edit, so that typing doesn't start a pass per key
+	if (m_SyntaxHighlighter.GetUnpaintedLineCount() > 0 && m_pHighlightWorker == nullptr)
+	{
+		SetTimer(m_hWndSelf, HIGHLIGHT_TIMER_ID, HIGHLIGHT_IDLE_DELAY_MS, NULL);
+	}
+}
+
+void SourceEdit::HighlightViewport(void)
+{
+	if (m_IsHighlighting)
+	{
+		return;
+	}
+
+	HighlightSearchMatches();
+
+	if (m_SyntaxHighlighter.GetUnpaintedLineCount() == 0)
+	{
+		return;
+	}
+
+	HighlightPassStats stats;
+	stats.startTime = GetTickCount64();
+
+	const size_t messagesBefore = m_ColoringMessageCount;
+	const size_t first = static_cast<size_t>(SendColoringMessage(EM_GETFIRSTVISIBLELINE, NULL, NULL));
+	const size_t end = min(first + GetVisibleLineCount(), m_SyntaxHighlighter.GetLineCount());
+
+	m_ColorRuns.clear();
+	m_FormatBatch.Clear();
+
+	for (size_t line = first; line < end; ++line)
+	{
+		if (!m_SyntaxHighlighter.IsLinePainted(line))
+		{
+			m_SyntaxHighlighter.GetLineColorRuns(line, m_ColorRuns);
+			m_SyntaxHighlighter.MarkPainted(line);
+			++stats.lineCount;
+		}
+	}
+
+	m_FormatBatch.Add(m_ColorRuns.data(), m_ColorRuns.size());
+
+	if (!m_FormatBatch.IsEmpty())
+	{
+		BeginColoring();
+		ApplyFormatBatch(m_FormatBatch, stats);
+		EndColoring();
+	}
+
+	stats.messageCount = m_ColoringMessageCount - messagesBefore;
+
+	ReportHighlightPass(stats, L"on screen");
+}
+
+/// <summary>
+/// Only the matches on screen are highlighted, so a search with many
+/// matches costs no more than one with a few. The background color is
+/// a separate format from the colors of the syntax highlighter, so the
+/// two don't undo each other.
+/// </summary>
+void SourceEdit::HighlightSearchMatches(void)
+{
+	size_t paintedStart = 0;
+	size_t paintedEnd = 0;
+	m_IncrementalSearch.GetPaintedRange(paintedStart, paintedEnd);
+
+	if (!m_IncrementalSearch.IsActive() && paintedStart == paintedEnd)
+	{
+		return;
+	}
+
+	const size_t lineCount = m_LineIndex.GetLineCount();
+	const size_t firstLine = min(static_cast<size_t>(SendColoringMessage(EM_GETFIRSTVISIBLELINE, NULL, NULL)), lineCount - 1);
+	const size_t endLine = firstLine + GetVisibleLineCount() + 1;
+
+	const size_t start = m_LineIndex.GetOffsetFromLine(firstLine);
+	const size_t end = endLine < lineCount ? m_LineIndex.GetOffsetFromLine(endLine) : m_Document.GetLength();
+
+	if (m_IncrementalSearch.GetVersion() == m_SearchHighlightVersion && start == m_SearchHighlightStart && end == m_SearchHighlightEnd)
+	{
+		return;
+	}
+
+	m_SearchHighlightVersion = m_IncrementalSearch.GetVersion();
+	m_SearchHighlightStart = start;
+	m_SearchHighlightEnd = end;
+
+	const std::vector<size_t>& matches = m_IncrementalSearch.GetMatches();
+	const size_t length = m_IncrementalSearch.GetPatternLength();
+
+	// Matches that begin on the line above can reach into the screen
+	size_t index = m_IncrementalSearch.FindNext(start >= length ? start - length + 1 : 0);
+
+	CHARFORMAT2 cf;
+	ZeroMemory(&cf, sizeof(cf));
+	cf.cbSize = sizeof(cf);
+	cf.dwMask = CFM_BACKCOLOR;
+
+	BeginColoring();
+
+	if (paintedStart < paintedEnd)
+	{
+		CHARRANGE range = { static_cast<LONG>(paintedStart), static_cast<LONG>(min(paintedEnd, m_Document.GetLength())) };
+		SendColoringMessage(EM_EXSETSEL, NULL, reinterpret_cast<LPARAM>(&range));
+
+		cf.dwEffects = CFE_AUTOBACKCOLOR;
+		SendColoringMessage(EM_SETCHARFORMAT, SCF_SELECTION, reinterpret_cast<LPARAM>(&cf));
+	}
+
+	paintedStart = 0;
+	paintedEnd = 0;
+
+	cf.dwEffects = 0;
+	cf.crBackColor = SEARCH_HIGHLIGHT_COLOR;
+
+	for (; index < matches.size() && matches[index] < end; ++index)
+	{
+		CHARRANGE range = { static_cast<LONG>(matches[index]), static_cast<LONG>(matches[index] + length) };
+		SendColoringMessage(EM_EXSETSEL, NULL, reinterpret_cast<LPARAM>(&range));
+		SendColoringMessage(EM_SETCHARFORMAT, SCF_SELECTION, reinterpret_cast<LPARAM>(&cf));
+
+		if (paintedStart == paintedEnd)
+		{
+			paintedStart = matches[index];
+		}
+
+		paintedEnd = matches[index] + length;
+	}
+
+	EndColoring();
+
+	m_IncrementalSearch.SetPaintedRange(paintedStart, paintedEnd);
+}
+
+void SourceEdit::StartBackgroundHighlighting(void)
+{
+	StopBackgroundHighlighting();
+
+	if (m_SyntaxHighlighter.GetUnpaintedLineCount() > 0)
+	{
+		m_BackgroundPassStats = HighlightPassStats();
+		m_BackgroundPassStats.startTime = GetTickCount64();
+
+		m_pHighlightWorker = std::make_shared<HighlightWorker>(m_hWndSelf, m_Document, m_SyntaxHighlighter);
+		m_pHighlightWorker->Start();
+	}
+}
+
+void SourceEdit::StopBackgroundHighlighting(void)
+{
+	KillTimer(m_hWndSelf, HIGHLIGHT_TIMER_ID);
+
+	SAFE_DELETE_PTR(m_pHighlightChunk);
+
+	// Doesn't wait for the thread, it lets go of the worker once it notices
+	if (m_pHighlightWorker != nullptr)
+	{
+		m_pHighlightWorker->Cancel();
+		m_pHighlightWorker.reset();
+	}
+}
+
+/// <summary>
+/// Applies the chunks a slice of lines at a time, until they run out or the
+/// time is up, in which case the message is posted again so that input and
+/// painting get through in between. The control is redrawn once per call.
+/// </summary>
+void SourceEdit::OnHighlightChunk(void)
+{
+	if (m_pHighlightWorker == nullptr)
+	{
+		return;
+	}
+
+	const std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now() + std::chrono::milliseconds(HIGHLIGHT_FRAME_BUDGET_MS);
+
+	const size_t messagesBefore = m_ColoringMessageCount;
+
+	bool isColoring = false;
+	bool isOutOfTime = false;
+
+	while (!isOutOfTime)
+	{
+		if (m_pHighlightChunk == nullptr)
+		{
+			m_pHighlightChunk = m_pHighlightWorker->TakeChunk();
+
+			if (m_pHighlightChunk == nullptr)
+			{
+				break;
+			}
+		}
+
+		HighlightChunk* pChunk = m_pHighlightChunk;
+
+		if (pChunk->version != m_Document.GetVersion())
+		{
+			SAFE_DELETE_PTR(m_pHighlightChunk);
+			continue;
+		}
+
+		const size_t end = min(pChunk->appliedLines + HIGHLIGHT_SLICE_LINES, pChunk->lines.size());
+
+		m_FormatBatch.Clear();
+
+		for (; pChunk->appliedLines < end; ++pChunk->appliedLines)
+		{
+			const size_t i = pChunk->appliedLines;
+			const size_t line = pChunk->lines[i];
+
+			// The line may have come into sight and been colored already
+			if (!m_SyntaxHighlighter.IsLinePainted(line))
+			{
+				const size_t first = i > 0 ? pChunk->runEnds[i - 1] : 0;
+
+				m_FormatBatch.Add(pChunk->runs.data() + first, pChunk->runEnds[i] - first);
+				m_SyntaxHighlighter.MarkPainted(line);
+				++m_BackgroundPassStats.lineCount;
+			}
+		}
+
+		if (!m_FormatBatch.IsEmpty())
+		{
+			if (!isColoring)
+			{
+				BeginColoring();
+				isColoring = true;
+			}
+
+			ApplyFormatBatch(m_FormatBatch, m_BackgroundPassStats);
+		}
+
+		if (pChunk->appliedLines == pChunk->lines.size())
+		{
+			SAFE_DELETE_PTR(m_pHighlightChunk);
+		}
+
+		isOutOfTime = std::chrono::steady_clock::now() >= deadline;
+	}
+
+	if (isColoring)
+	{
+		EndColoring();
+	}
+
+	m_BackgroundPassStats.messageCount += m_ColoringMessageCount - messagesBefore;
+
+	if (isOutOfTime)
+	{
+		PostMessage(m_hWndSelf, WM_HIGHLIGHT_CHUNK, NULL, NULL);
+	}
+
+	else if (m_pHighlightWorker->IsDone())
+	{
+		ReportHighlightPass(m_BackgroundPassStats, L"in the background");
+		StopBackgroundHighlighting();
+	}
+}
+
+void SourceEdit::SuspendRedraw(void)
+{
+	if (m_iRedrawLock++ == 0)
+	{
+		SendColoringMessage(WM_SETREDRAW, FALSE, NULL);
+	}
+}
+
+void SourceEdit::ResumeRedraw(void)
+{
+	if (--m_iRedrawLock == 0)
+	{
+		SendColoringMessage(WM_SETREDRAW, TRUE, NULL);
+		InvalidateRect(m_hWndSelf, NULL, TRUE);
+	}
+}
+
+void SourceEdit::ReplaceRange(LONG lStart, LONG lLength, const wchar_t* lpszText)
+{
+	CHARRANGE cr = { lStart, lStart + lLength };
+
+	SendMessage(m_hWndSelf, EM_EXSETSEL, NULL, reinterpret_cast<LPARAM>(&cr));
+	SendMessage(m_hWndSelf, EM_REPLACESEL, FALSE, reinterpret_cast<LPARAM>(lpszText));
+}
+
+/// <summary>
+/// Applies the edits that revert (or redo) a transaction without recording
+/// them, redrawing the control only once at the end
+/// </summary>
+void SourceEdit::ApplyHistoryEdits(const std::vector<TextEdit>& edits)
+{
+	m_UndoJournal.SetRecording(false);
+	SuspendRedraw();
+
+	for (const TextEdit& edit : edits)
+	{
+		ReplaceRange(static_cast<LONG>(edit.position),
+			         static_cast<LONG>(edit.removed.length()),
+			         edit.inserted.c_str());
+	}
+
+	ResumeRedraw();
+	m_UndoJournal.SetRecording(true);
+
+	::MarkSourceAsEdited(this);
+	RefreshUndoMenuButtons(false);
+	RefreshStatusBarText();
+}
+
+bool SourceEdit::Undo(void)
+{
+	std::vector<TextEdit> edits;
+
+	if (!m_UndoJournal.Undo(edits))
+	{
+		return false;
+	}
+
+	ApplyHistoryEdits(edits);
+
+	return true;
+}
+
+bool SourceEdit::Redo(void)
+{
+	std::vector<TextEdit> edits;
+
+	if (!m_UndoJournal.Redo(edits))
+	{
+		return false;
+	}
+
+	ApplyHistoryEdits(edits);
+
+	return true;
+}
+
+void SourceEdit::EndUndoGroup(void)
+{
+	m_UndoJournal.EndGroup();
+	RefreshUndoMenuButtons(false);
+}
+
+void SourceEdit::RefreshUndoMenuButtons(bool force)
+{
+	const bool canUndo = m_UndoJournal.CanUndo();
+	const bool canRedo = m_UndoJournal.CanRedo();
+
+	if (force || canUndo != m_CouldUndo || canRedo != m_CouldRedo)
+	{
+		Utility::UpdateUndoMenuButtons(GetMenu(GetAncestor(m_hWndSelf, GA_ROOT)), canUndo, canRedo);
+
+		m_CouldUndo = canUndo;
+		m_CouldRedo = canRedo;
+	}
+}
+
+bool SourceEdit::OpenLargeFile(const wchar_t* lpszPath)
+{
+	LargeFileView* pView = new LargeFileView();
+
+	if (!pView->Open(lpszPath, m_hWndSelf))
+	{
+		Logger::Write(L"Failed to open %ls as a large file", lpszPath);
+		delete pView;
+		return false;
+	}
+
+	SAFE_DELETE_PTR(m_pLargeFileView);
+	m_pLargeFileView = pView;
+
+	SendMessage(m_hWndSelf, EM_SETREADONLY, TRUE, NULL);
+
+	RefreshLargeFileView();
+
+	return true;
+}
+
+size_t SourceEdit::GetFirstLineNumber(void) const
+{
+	if (m_pLargeFileView == nullptr)
+	{
+		return 0;
+	}
+
+	return static_cast<size_t>(m_pLargeFileView->GetTopLine());
+}
+
+int SourceEdit::GetVisibleLineCount(void) const
+{
+	RECT rcClient;
+	GetClientRect(m_hWndSelf, &rcClient);
+
+	const int iLineHeight = max(static_cast<int>(::GetLineHeight(m_hWndSelf) * ::GetZoomScale(m_hWndSelf)), 1);
+
+	// The last line can be partly visible
+	return rcClient.bottom / iLineHeight + 1;
+}
+
+void SourceEdit::ScrollLargeFileView(long long lines)
+{
+	if (m_pLargeFileView != nullptr && m_pLargeFileView->ScrollLines(lines))
+	{
+		RefreshLargeFileView();
+	}
+}
+
+void SourceEdit::RefreshLargeFileView(void)
+{
+	// Replacing the text can resize the control, which would refresh the view again
+	if (m_pLargeFileView == nullptr || m_IsRefreshingLargeFileView)
+	{
+		return;
+	}
+
+	m_IsRefreshingLargeFileView = true;
+	m_pLargeFileView->UpdateTopLine();
+
+	CHARRANGE cr;
+	SendMessage(m_hWndSelf, EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&cr));
+
+	SuspendRedraw();
+	SetText(m_pLargeFileView->GetLines(GetVisibleLineCount()));
+	SendMessage(m_hWndSelf, EM_EXSETSEL, NULL, reinterpret_cast<LPARAM>(&cr));
+	ResumeRedraw();
+
+	// The scroll bar shows where the view is in the whole file, not in the control
+	SCROLLINFO sInfo = {};
+	sInfo.cbSize = sizeof(SCROLLINFO);
+	sInfo.fMask = SIF_RANGE | SIF_PAGE | SIF_POS | SIF_DISABLENOSCROLL;
+	sInfo.nMin = 0;
+	sInfo.nMax = LARGE_FILE_SCROLL_RANGE;
+	sInfo.nPage = 1;
+	sInfo.nPos = static_cast<int>(m_pLargeFileView->GetPosition() * LARGE_FILE_SCROLL_RANGE);
+
+	SetScrollInfo(m_hWndSelf, SB_VERT, &sInfo, TRUE);
+
+	m_IsRefreshingLargeFileView = false;
+
+	RefreshStatusBarText();
+}
+
+SourceEdit::~SourceEdit(void)
+{
+	StopBackgroundHighlighting();
+
 	SAFE_DELETE_GDIOBJ(m_hFont);
+	SAFE_DELETE_PTR(m_pLargeFileView);
 }
\ No newline at end of file
@@ -3,6 +3,38 @@
 #include "Window.h"
 #include "StatusBar.h"
 #include "Zoomer.h"
+#include "PieceTable.h"
+#include "LineIndex.h"
+#include "SyntaxHighlighter.h"
+#include "HighlightWorker.h"
+#include "FormatBatch.h"
+#include "UndoJournal.h"
+#include "EditJournal.h"
+#include "LargeFileView.h"
+#include "IncrementalSearch.h"
+
+#include <string>
+#include <Richedit.h>
+
+// Color of the text that isn't a keyword or a literal
+#define DEFAULT_TEXT_COLOR RGB(0, 0, 0)
+
+// Background of the matches of the text typed in the find dialog
+#define SEARCH_HIGHLIGHT_COLOR RGB(255, 235, 140)
+
+/* What a highlight pass cost, the passes that turn out big are logged */
+struct HighlightPassStats {
+	size_t lineCount = 0;
+
+	// Runs the highlighter produced, and what was left of them after merging
+	size_t runCount = 0;
+	size_t appliedRunCount = 0;
+
+	// Messages sent to the control
+	size_t messageCount = 0;
+
+	ULONGLONG startTime = 0;
+};
 
 class SourceEdit : public Window
 {
@@ -14,7 +46,66 @@ private:
 	Zoomer m_Zoomer;
 	bool m_haveContentsBeenEdited = false;
 
+	// The document is the owner of the text, the control only displays it
+	PieceTable m_Document;
+	LineIndex m_LineIndex;
+	SyntaxHighlighter m_SyntaxHighlighter;
+	UndoJournal m_UndoJournal;
+
+	// Keeps the unsaved edits on the disk in case the program crashes
+	EditJournal m_EditJournal;
+
+	// Matches of the text typed in the find dialog, and what was highlighted for them last
+	IncrementalSearch m_IncrementalSearch;
+	size_t m_SearchHighlightVersion = 0;
+	size_t m_SearchHighlightStart = 0;
+	size_t m_SearchHighlightEnd = 0;
+
+	// Set when the file is too big to be loaded, the control then only holds the lines on screen
+	LargeFileView* m_pLargeFileView = nullptr;
+	bool m_IsRefreshingLargeFileView = false;
+
+	// Last state of the undo/redo menu items set by this edit
+	bool m_CouldUndo = false;
+	bool m_CouldRedo = false;
+
+	// State of the control before the outermost message that can change the text
+	int m_iEditDepth = 0;
+	CHARRANGE m_crBeforeEdit = { 0, 0 };
+	LONG m_lLengthBeforeEdit = 0;
+
+	// Nesting depth of SuspendRedraw, the control is only redrawn when it drops back to 0
+	int m_iRedrawLock = 0;
+
+	// Set while the colors are applied, the selection moves around without the user moving it
+	bool m_IsHighlighting = false;
+	CHARRANGE m_crBeforeColoring = { 0, 0 };
+	POINT m_ptBeforeColoring = { 0, 0 };
+
+	// Colors the lines that are out of sight, and the chunk of its colors being applied.
+	// Shared with the thread of the worker, which may still be running after it's cancelled
+	std::shared_ptr<HighlightWorker> m_pHighlightWorker;
+	HighlightChunk* m_pHighlightChunk = nullptr;
+	HighlightPassStats m_BackgroundPassStats;
+
+	// Reused by every pass so that they don't allocate
+	std::vector<ColorRun> m_ColorRuns;
+	FormatBatch m_FormatBatch;
+
+	// Messages sent to the control to color it or to suspend its redrawing, since it was created
+	size_t m_ColoringMessageCount = 0;
+
+	LRESULT SendColoringMessage(UINT uMsg, WPARAM wParam, LPARAM lParam);
+	void BeginColoring(void);
+	void EndColoring(void);
+	void ApplyFormatBatch(const FormatBatch& batch, HighlightPassStats& stats);
+	void ReportHighlightPass(const HighlightPassStats& stats, const wchar_t* lpszWhere);
+
+	/* Highlights the matches on screen, unless neither the matches nor the lines on screen changed */
+	void HighlightSearchMatches(void);
+
 	void SetLineColumnStatusBar(void);
+	void ApplyHistoryEdits(const std::vector<TextEdit>& edits);
 
 public:
 	explicit SourceEdit(HWND hParentWindow);
@@ -37,6 +128,95 @@ public:
 	void ScrollTo(int line);
 
 	bool HasBeenEdited(void) const { return m_haveContentsBeenEdited; };
+
+	PieceTable& GetDocument(void) { return m_Document; }
+	const LineIndex& GetLineIndex(void) const { return m_LineIndex; }
+	EditJournal& GetEditJournal(void) { return m_EditJournal; }
+	IncrementalSearch& GetIncrementalSearch(void) { return m_IncrementalSearch; }
+	int GetLineCount(void) const { return static_cast<int>(m_LineIndex.GetLineCount()); }
+
+	/* Replaces the text of both the document and the control */
+	void SetText(std::wstring text);
+
+	/// <summary>
+	/// Shows the text in a read only control without putting it in the
+	/// document, while the file of the tab is loading or couldn't be read
+	/// </summary>
+	void SetPlaceholderText(const std::wstring& text);
+
+	/* Colors of the tokens of every language, shared by all the edit controls */
+	static TokenColorFunction GetTokenColorFunction(void);
+
+	/* Highlights the text by the rules of another language, see LanguageRegistry */
+	void SetLanguage(const Language* pLanguage);
+
+	/// <summary>
+	/// Applies whatever differs between the control and the document as one
+	/// replacement, used when an edit couldn't be tracked (e.g. drag and drop)
+	/// </summary>
+	void SynchronizeDocument(void);
+
+	/// <summary>
+	/// Called around every message that can change the text of the control.
+	/// The difference between the state before and after the message is
+	/// applied to the document as a single replacement.
+	/// </summary>
+	void BeginTrackingEdit(void);
+	void EndTrackingEdit(UINT uMsg, WPARAM wParam);
+
+	/// <summary>
+	/// Called after the text changes. The lines on screen are colored right
+	/// away, the rest by a background pass once the user stops typing.
+	/// </summary>
+	void ApplyHighlighting(void);
+	bool IsHighlighting(void) const { return m_IsHighlighting; }
+
+	/* Colors the lines on screen that aren't colored yet and highlights the matches on them, called whenever the control may have scrolled */
+	void HighlightViewport(void);
+
+	/* Starts (over) coloring the lines that aren't colored yet on another thread */
+	void StartBackgroundHighlighting(void);
+	void StopBackgroundHighlighting(void);
+
+	/* Applies the colors of the background pass, for no longer than a frame at a time */
+	void OnHighlightChunk(void);
+
+	void SuspendRedraw(void);
+	void ResumeRedraw(void);
+
+	/* Replaces a range of the text the same way a user edit would */
+	void ReplaceRange(LONG lStart, LONG lLength, const wchar_t* lpszText);
+
+	bool Undo(void);
+	bool Redo(void);
+	bool CanUndo(void) const { return m_UndoJournal.CanUndo(); }
+	bool CanRedo(void) const { return m_UndoJournal.CanRedo(); }
+
+	/* Edits made between these calls are undone as one step */
+	void BeginUndoGroup(void) { m_UndoJournal.BeginGroup(); }
+	void EndUndoGroup(void);
+
+	void SetUndoMemoryBudget(size_t bytes) { m_UndoJournal.SetMemoryBudget(bytes); }
+
+	/* Sets the state of the undo/redo menu items, 'force' even if it didn't change */
+	void RefreshUndoMenuButtons(bool force);
+
+	/// <summary>
+	/// Shows the file read only through a memory mapped view instead of
+	/// loading all of it. The text of the control is replaced every time
+	/// the view moves.
+	/// </summary>
+	bool OpenLargeFile(const wchar_t* lpszPath);
+	bool IsLargeFileView(void) const { return m_pLargeFileView != nullptr; }
+	LargeFileView* GetLargeFileView(void) const { return m_pLargeFileView; }
+
+	/* Moves the view of a large file and loads the lines that came into sight */
+	void ScrollLargeFileView(long long lines);
+	void RefreshLargeFileView(void);
+
+	/* Line of the file shown in the first line of the control, zero based */
+	size_t GetFirstLineNumber(void) const;
+	int GetVisibleLineCount(void) const;
 };
 
 extern void MarkSourceAsEdited(SourceEdit* pSourceEdit);
\ No newline at end of file
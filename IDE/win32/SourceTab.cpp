@@ -3,35 +3,55 @@
 #include "Utility.h"
 #include "WorkArea.h"
 #include "AppWindow.h"
+#include "Utf8Decoder.h"
+#include "Language.h"
 #include "resource.h"
 
 #include <fstream>
-#include <sstream>
-#include <codecvt>
+#include <vector>
+#include <thread>
 
 #define SOURCE_TAB_CLASS L"IDESourceTabClass"
 
 #define IDC_CLOSE_BUTTON 100
 
+#define FILE_READ_CHUNK_SIZE 65536
+
 static HRESULT RegisterSourceTabWindowClass(HINSTANCE hInstance);
 static LRESULT CALLBACK SourceTabWindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 SourceTab::~SourceTab(void)
 {
-	DestroyWindow(m_sInfo.m_pSourceEdit->GetHandle());
+	// Tabs are only deleted when they're closed on purpose, a crash never gets here
+	if (m_sInfo.m_pSourceEdit != nullptr)
+	{
+		m_sInfo.m_pSourceEdit->GetEditJournal().Discard();
+		DestroyWindow(m_sInfo.m_pSourceEdit->GetHandle());
+	}
+
+	else if (m_pSnapshot != nullptr && m_pSnapshot->HasBeenEdited() && m_sInfo.lpszFileName != nullptr)
+	{
+		EditJournal::DiscardFile(m_sInfo.lpszFileName);
+	}
+
 	DestroyWindow(m_hCloseButton);
 	DestroyWindow(m_hTooltip);
 
 	SAFE_DELETE_PTR(m_sInfo.m_pSourceEdit);
+	SAFE_DELETE_PTR(m_pSnapshot);
 
 	free(m_sInfo.lpszFileName);
 }
 
 SourceTab::SourceTab(HWND hParentWindow)
 {
+	// Tabs are only created on the UI thread
+	static size_t nextId = 1;
+
 	const HINSTANCE hInstance = GetModuleHandle(nullptr);
 
 	this->m_hWndParent = hParentWindow;
+	this->m_Id = nextId++;
 
 	if (FAILED(RegisterSourceTabWindowClass(hInstance)))
 	{
@@ -88,8 +108,6 @@ HRESULT SourceTab::InitializeSourceTabWindow(HINSTANCE hInstance)
 	if (!m_hWndSelf)
 		return E_FAIL;
 
-	m_sInfo.m_pSourceEdit = new SourceEdit(m_hWndParent); 
-
 	m_hCloseButton = CreateWindow(
 		L"Button",
 		nullptr,
@@ -132,9 +150,16 @@ void SourceTab::SetName(LPCWSTR lpszName)
 		m_sInfo.lpszFileName[length - 1] = L'\0';
 	}
 
+	// The journal is named after the file, so it has to follow a rename, and so may the language
+	if (m_sInfo.m_pSourceEdit != nullptr)
+	{
+		m_sInfo.m_pSourceEdit->GetEditJournal().SetFilePath(m_sInfo.lpszFileName);
+		m_sInfo.m_pSourceEdit->SetLanguage(LanguageRegistry::GetLanguageOfFile(m_sInfo.lpszFileName));
+	}
+
 	std::wstring file_name = Utility::GetFileNameFromPath(m_sInfo.lpszFileName);
 
-	if (this->m_sInfo.m_pSourceEdit->HasBeenEdited())
+	if (this->HasUnsavedChanges())
 		file_name.push_back(L'*');
 
 	SetWindowText(m_hWndSelf, file_name.c_str());
@@ -192,6 +217,9 @@ LRESULT SourceTab::WindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM l
 
 	case WM_COMMAND:
 		return OnCommand(hWnd, wParam);
+
+	case WM_TAB_FILE_LOADED:
+		return OnFileLoaded(lParam);
 	}
 
 	return DefWindowProc(hWnd, uMsg, wParam, lParam);
@@ -378,10 +406,22 @@ void SourceTab::Select(void)
 {
 	if (!m_IsSelected)
 	{
+		if (!IsMaterialized())
+		{
+			Materialize();
+		}
+
 		crButton = RGB(0xFF, 0, 0);
 
 		AppWindow* pAppWindow = GetAssociatedObject<AppWindow>(GetParent(m_hWndParent));
 		InitEditDimensions(pAppWindow);
+
+		// Restored once the edit has its size, otherwise the scroll position would be lost
+		if (IsHibernated())
+		{
+			Revive();
+		}
+
 		RefreshStatusBarInfo(pAppWindow);
 		RefreshEditMenu(pAppWindow);
 
@@ -396,8 +436,7 @@ void SourceTab::RefreshEditMenu(AppWindow* pAppWindow)
 {
 	HMENU hMenu = GetMenu(pAppWindow->GetHandle());
 	
-	HWND hEditWindow = m_sInfo.m_pSourceEdit->GetHandle();
-	Utility::UpdateUndoMenuButton(hEditWindow);
+	m_sInfo.m_pSourceEdit->RefreshUndoMenuButtons(true);
 	Utility::RefreshPasteMenuButton(hMenu);
 	Utility::SetMenuItemsState(hMenu, MF_ENABLED);
 }
@@ -446,15 +485,253 @@ bool SourceTab::IsSelected(void)
 	return m_IsSelected;
 }
 
-void SourceTab::SetEditTextToContentsOfFile(LPCWSTR lpPath)
+/// <summary>
+/// Reads and decodes a whole file, called from the loading thread so it
+/// leaves the logging to the UI thread.
+/// Files that are too big to be edited are only checked for existence,
+/// the large file view maps them later on the UI thread.
+/// </summary>
+static void ReadFileContents(FileLoadState& state)
 {
-	std::wifstream file(lpPath);
-	file.imbue(std::locale(std::locale::empty(), new std::codecvt_utf8<wchar_t>));
+	WIN32_FILE_ATTRIBUTE_DATA fileData;
+
+	if (GetFileAttributesEx(state.path.c_str(), GetFileExInfoStandard, &fileData))
+	{
+		const unsigned long long size = (static_cast<unsigned long long>(fileData.nFileSizeHigh) << 32) | fileData.nFileSizeLow;
+
+		// Only the lines on screen are read from files this big
+		if (size >= LARGE_FILE_THRESHOLD)
+		{
+			state.isLargeFile = true;
+			return;
+		}
+	}
 
-	std::wstringstream buffer;
-	buffer << file.rdbuf();
+	std::ifstream file(state.path.c_str(), std::ios::binary);
+
+	if (!file.is_open())
+	{
+		state.hasFailed = true;
+		return;
+	}
+
+	// Decoded straight out of the read buffer, the file is never copied as a whole
+	std::vector<char> buffer(FILE_READ_CHUNK_SIZE);
+	Utf8Decoder decoder;
+
+	while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+	{
+		decoder.Decode(buffer.data(), static_cast<size_t>(file.gcount()), state.text);
+	}
+
+	decoder.Finish(state.text);
+
+	state.invalidSequenceCount = decoder.GetInvalidSequenceCount();
+	state.hasByteOrderMark = decoder.HasByteOrderMark();
+}
+
+/// <summary>
+/// Creates the edit control of a deferred tab and starts reading its file
+/// in the background. The control shows a placeholder and is read only
+/// until the text arrives.
+/// </summary>
+void SourceTab::Materialize(void)
+{
+	m_sInfo.m_pSourceEdit = new SourceEdit(m_hWndParent);
+
+	if (m_sInfo.lpszFileName == nullptr)
+	{
+		return;
+	}
+
+	m_sInfo.m_pSourceEdit->GetEditJournal().SetFilePath(m_sInfo.lpszFileName);
+
+	// Loaded here rather than at startup, so only the languages of the files that are opened are loaded
+	m_sInfo.m_pSourceEdit->SetLanguage(LanguageRegistry::GetLanguageOfFile(m_sInfo.lpszFileName));
+
+	// A hibernated tab gets its text from its snapshot instead
+	if (IsHibernated())
+	{
+		return;
+	}
+
+	const HWND hEditWindow = m_sInfo.m_pSourceEdit->GetHandle();
+	SendMessage(hEditWindow, EM_SETREADONLY, TRUE, NULL);
+	m_sInfo.m_pSourceEdit->SetPlaceholderText(L"Loading " + Utility::GetFileNameFromPath(m_sInfo.lpszFileName) + L"...");
+
+	m_HasLoadFailed = false;
+
+	m_pLoadState = std::make_shared<FileLoadState>();
+	m_pLoadState->path = m_sInfo.lpszFileName;
+
+	const std::shared_ptr<FileLoadState> pState = m_pLoadState;
+	const HWND hTabWindow = m_hWndSelf;
+
+	// If the tab is closed first the message goes nowhere and the state dies with the thread
+	std::thread([pState, hTabWindow]() {
+		ReadFileContents(*pState);
+		PostMessage(hTabWindow, WM_TAB_FILE_LOADED, NULL, reinterpret_cast<LPARAM>(pState.get()));
+	}).detach();
+}
+
+LRESULT SourceTab::OnFileLoaded(LPARAM lParam)
+{
+	// lParam identifies the load, in case the message was meant for an older one
+	if (m_pLoadState == nullptr || reinterpret_cast<LPARAM>(m_pLoadState.get()) != lParam)
+	{
+		return 0;
+	}
+
+	// Moved out first, replacing the text sends messages that could get here again
+	const std::shared_ptr<FileLoadState> pState = std::move(m_pLoadState);
+
+	// An empty document would be saved over the file, so the tab stays read only
+	if (pState->hasFailed)
+	{
+		Logger::Write(L"Failed to open %ls", pState->path.c_str());
+
+		const std::wstring text = L"Failed to open " + Utility::GetFileNameFromPath(pState->path) + L".";
+		m_sInfo.m_pSourceEdit->SetPlaceholderText(text);
+		m_HasLoadFailed = true;
+
+		AppWindow* pAppWindow = GetAssociatedObject<AppWindow>(GetParent(m_hWndParent));
+
+		if (pAppWindow != nullptr)
+		{
+			pAppWindow->GetStatusBar()->SetText(text.c_str(), 0);
+		}
+
+		return 0;
+	}
+
+	if (pState->invalidSequenceCount > 0)
+	{
+		Logger::Write(L"%ls is not valid UTF-8, %u invalid sequences were replaced",
+			          pState->path.c_str(), static_cast<unsigned int>(pState->invalidSequenceCount));
+	}
+
+	m_HasByteOrderMark = pState->hasByteOrderMark;
+
+	SendMessage(m_sInfo.m_pSourceEdit->GetHandle(), EM_SETREADONLY, FALSE, NULL);
+
+	if (!pState->isLargeFile || !m_sInfo.m_pSourceEdit->OpenLargeFile(pState->path.c_str()))
+	{
+		m_sInfo.m_pSourceEdit->SetText(std::move(pState->text));
+	}
+
+	if (m_IsSelected)
+	{
+		m_sInfo.m_pSourceEdit->RefreshStatusBarText();
+	}
+
+	return 0;
+}
+
+void SourceTab::Hibernate(void)
+{
+	if (!IsMaterialized() || m_IsSelected)
+	{
+		return;
+	}
+
+	// Large files and files that haven't finished loading or couldn't be read are read again when
+	// the tab is revived, and a tab whose snapshot couldn't be revived keeps the snapshot it has
+	if (!IsLoading() && !m_HasLoadFailed && !IsHibernated() && !m_sInfo.m_pSourceEdit->IsLargeFileView())
+	{
+		m_pSnapshot = new TabSnapshot;
+
+		// Better to keep the edit than to lose its text
+		if (!m_pSnapshot->Capture(m_sInfo.m_pSourceEdit))
+		{
+			SAFE_DELETE_PTR(m_pSnapshot);
+			return;
+		}
+	}
+
+	m_pLoadState.reset();
+
+	DestroyWindow(m_sInfo.m_pSourceEdit->GetHandle());
+	SAFE_DELETE_PTR(m_sInfo.m_pSourceEdit);
+}
+
+void SourceTab::Revive(void)
+{
+	/*
+	 * The snapshot is kept as the text of the tab and the edit stays empty and read only,
+	 * saving the tab then fails instead of overwriting the file with nothing
+	 */
+	if (!m_pSnapshot->Restore(m_sInfo.m_pSourceEdit))
+	{
+		SendMessage(m_sInfo.m_pSourceEdit->GetHandle(), EM_SETREADONLY, TRUE, NULL);
+
+		MessageBox(
+			m_hWndParent,
+			L"The text of the tab could not be restored, it is kept until the tab is closed.",
+			L"Error",
+			MB_OK | MB_ICONERROR
+		);
+
+		return;
+	}
+
+	SAFE_DELETE_PTR(m_pSnapshot);
+
+	m_sInfo.m_pSourceEdit->RefreshStatusBarText();
+}
+
+bool SourceTab::HasUnsavedChanges(void) const
+{
+	// A tab whose snapshot couldn't be revived has both, the snapshot is what it holds
+	if (m_pSnapshot != nullptr)
+	{
+		return m_pSnapshot->HasBeenEdited();
+	}
+
+	return m_sInfo.m_pSourceEdit != nullptr && m_sInfo.m_pSourceEdit->HasBeenEdited();
+}
+
+/// <summary>
+/// Replaces the text of the file with the unsaved text rebuilt from its
+/// journal after a crash. The tab has to be selected.
+/// </summary>
+void SourceTab::RestoreRecoveredText(std::wstring text)
+{
+	// The file is still being read in the background, its text isn't needed anymore
+	m_pLoadState.reset();
+
+	SourceEdit* pSourceEdit = m_sInfo.m_pSourceEdit;
+	SendMessage(pSourceEdit->GetHandle(), EM_SETREADONLY, FALSE, NULL);
+
+	pSourceEdit->SetText(std::move(text));
+	::MarkSourceAsEdited(pSourceEdit);
+	pSourceEdit->RefreshStatusBarText();
+}
+
+/* Version of the text that would be saved, see PieceTable::GetVersion */
+size_t SourceTab::GetVersion(void) const
+{
+	if (m_pSnapshot != nullptr)
+	{
+		return m_pSnapshot->GetVersion();
+	}
+
+	return m_sInfo.m_pSourceEdit != nullptr ? m_sInfo.m_pSourceEdit->GetDocument().GetVersion() : 0;
+}
+
+void SourceTab::MarkAsSaved(void)
+{
+	if (m_pSnapshot != nullptr)
+	{
+		m_pSnapshot->MarkAsUnedited();
+		EditJournal::DiscardFile(m_sInfo.lpszFileName);
+	}
+
+	else if (m_sInfo.m_pSourceEdit != nullptr)
+	{
+		m_sInfo.m_pSourceEdit->MarkAsUnedited();
+	}
 
-	SetWindowText(m_sInfo.m_pSourceEdit->GetHandle(), buffer.str().c_str());
+	RemoveAsteriskFromDisplayedName();
 }
 
 void SourceTab::SetTemporary(bool temporary)
@@ -2,6 +2,10 @@
 
 #include "Window.h"
 #include "SourceEdit.h"
+#include "TabSnapshot.h"
+
+#include <memory>
+#include <string>
 
 // lParam: Pointer to the SourceTab oobject to be closed
 #define WM_CLOSE_TAB (WM_APP + 1) 
@@ -9,8 +13,21 @@
 // LPARAM = pointer to SourceTab
 #define WM_TAB_SELECTED (WM_APP + 2)
 
+// Posted to the tab by the thread that loads its file
+#define WM_TAB_FILE_LOADED (WM_APP + 3)
+
 class AppWindow;
 
+/* Shared with the loading thread, which may outlive the tab */
+struct FileLoadState {
+	std::wstring path;
+	std::wstring text;
+	size_t invalidSequenceCount = 0;
+	bool hasByteOrderMark = false;
+	bool isLargeFile = false;
+	bool hasFailed = false;
+};
+
 struct SourceInfo {
 	SourceEdit* m_pSourceEdit = nullptr;
 	wchar_t* lpszFileName = nullptr;
@@ -28,7 +45,10 @@ private:
 	LRESULT OnDrawItem(HWND hWnd, LPARAM lParam);
 	LRESULT OnSize(HWND hWnd, LPARAM lParam);
 	LRESULT OnCommand(HWND hWnd, WPARAM wParam);
+	LRESULT OnFileLoaded(LPARAM lParam);
 	void InitEditDimensions(AppWindow* pAppWindow);
+	void Materialize(void);
+	void Revive(void);
 	void RefreshStatusBarInfo(AppWindow* pAppWindow);
 	void RefreshEditMenu(AppWindow* pAppWindow);
 
@@ -41,12 +61,54 @@ private:
 	bool m_IsTrackingMouse = false;
 	bool m_IsTemporary = false;
 
+	// Set while the file is being read in the background
+	std::shared_ptr<FileLoadState> m_pLoadState;
+
+	// The tab stays read only, its file is read again when it's revived
+	bool m_HasLoadFailed = false;
+
+	// Written back when the file is saved
+	bool m_HasByteOrderMark = false;
+
+	// Replaces the edit while the tab is hibernated
+	TabSnapshot* m_pSnapshot = nullptr;
+
+	// Never reused, unlike the address of a deleted tab
+	size_t m_Id = 0;
+
 public:
 	explicit SourceTab(HWND hParentWindow);
 	~SourceTab(void);
 
+	/* Identifies the tab to work done on another thread, which may finish after it's deleted */
+	size_t GetId(void) const { return m_Id; }
+
+	/* nullptr until the tab is selected for the first time */
 	SourceEdit* GetSourceEdit(void) const { if (m_sInfo.m_pSourceEdit) return m_sInfo.m_pSourceEdit; else return nullptr; }
 
+	/* A deferred tab only knows its path until it's selected, then it loads its file */
+	bool IsMaterialized(void) const { return m_sInfo.m_pSourceEdit != nullptr; }
+	bool IsLoading(void) const { return m_pLoadState != nullptr; }
+
+	/// <summary>
+	/// Frees the edit of a closed tab, keeping only a compressed snapshot
+	/// of its state. The tab is revived the next time it's selected.
+	/// </summary>
+	void Hibernate(void);
+	bool IsHibernated(void) const { return m_pSnapshot != nullptr; }
+	TabSnapshot* GetSnapshot(void) const { return m_pSnapshot; }
+
+	bool HasByteOrderMark(void) const { return m_HasByteOrderMark; }
+
+	/* Work for tabs without an edit too */
+	bool HasUnsavedChanges(void) const;
+	size_t GetVersion(void) const;
+
+	/* Clears the unsaved changes flag and the asterisk of the name */
+	void MarkAsSaved(void);
+
+	void RestoreRecoveredText(std::wstring text);
+
 	LRESULT WindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 	bool IsSelected(void);
@@ -54,7 +116,6 @@ public:
 	void Unselect(void);
 	void SetName(LPCWSTR lpszName);
 	void HideCloseButton(void) const;
-	void SetEditTextToContentsOfFile(LPCWSTR lpPath);
 	void RemoveAsteriskFromDisplayedName(void);
 	void SetTemporary(bool temporary);
 	int GetRequiredTabWidth(void) const;
@@ -0,0 +1,320 @@
+#include "SyntaxHighlighter.h"
+#include "MultiPatternSearch.h"
+
+#include <algorithm>
+#include <iterator>
+
+// Words in comments that are colored as markers, e.g. "// TODO: ..."
+static const wchar_t* g_CommentMarkers[] = { L"TODO", L"FIXME", L"HACK", L"XXX" };
+
+/* Built the first time a comment is colored, the background pass only reads it */
+static const MultiPatternSearcher& GetMarkerSearcher(void)
+{
+	static const MultiPatternSearcher searcher = []() {
+		SearchOptions options;
+		options.matchCase = true;
+		options.wholeWord = true;
+
+		return MultiPatternSearcher(std::vector<std::wstring>(std::begin(g_CommentMarkers), std::end(g_CommentMarkers)), options);
+	}();
+
+	return searcher;
+}
+
+SyntaxHighlighter::SyntaxHighlighter(const PieceTable& document, const LineIndex& lineIndex, const Language* pLanguage)
+	: m_Document(document),
+	  m_LineIndex(lineIndex),
+	  m_pLanguage(pLanguage)
+{
+	m_LineStates.assign(1, LexerState::NORMAL);
+	m_IsLinePainted.assign(1, 0);
+	m_UnpaintedLineCount = 1;
+}
+
+const std::wstring& SyntaxHighlighter::ReadLine(size_t line)
+{
+	size_t length = m_LineIndex.GetLineLength(line);
+
+	// Every line but the last one ends with a '\r'
+	if (line + 1 < m_LineIndex.GetLineCount() && length > 0)
+	{
+		--length;
+	}
+
+	m_LineText.resize(length);
+
+	if (length > 0)
+	{
+		m_LineText.resize(m_Document.CopyTextRange(m_LineIndex.GetOffsetFromLine(line), length, &m_LineText[0]));
+	}
+
+	return m_LineText;
+}
+
+void SyntaxHighlighter::MarkUnpainted(size_t first, size_t last)
+{
+	for (size_t line = first; line <= last && line < m_IsLinePainted.size(); ++line)
+	{
+		if (m_IsLinePainted[line] != 0)
+		{
+			m_IsLinePainted[line] = 0;
+			++m_UnpaintedLineCount;
+		}
+	}
+}
+
+void SyntaxHighlighter::MarkPainted(size_t line)
+{
+	if (line < m_IsLinePainted.size() && m_IsLinePainted[line] == 0)
+	{
+		m_IsLinePainted[line] = 1;
+		--m_UnpaintedLineCount;
+	}
+}
+
+/// <summary>
+/// Lexes the lines from 'line' onwards, at least up to 'lastChangedLine',
+/// and then until the next line's cached state doesn't change
+/// </summary>
+void SyntaxHighlighter::Relex(size_t line, size_t lastChangedLine)
+{
+	const size_t count = m_LineStates.size();
+	const size_t first = line;
+
+	for (; line < count; ++line)
+	{
+		const std::wstring& text = ReadLine(line);
+		const LexerState next = Lexer::LexLine(text.c_str(), text.length(), m_LineStates[line], m_pLanguage->rules, nullptr);
+
+		if (line + 1 == count)
+		{
+			break;
+		}
+
+		if (line >= lastChangedLine && m_LineStates[line + 1] == next)
+		{
+			break;
+		}
+
+		m_LineStates[line + 1] = next;
+	}
+
+	line = std::min(line, count - 1);
+
+	m_LastRelexedLineCount = line - first + 1;
+
+	MarkUnpainted(first, line);
+}
+
+void SyntaxHighlighter::RelexAll(void)
+{
+	const size_t count = m_LineIndex.GetLineCount();
+
+	m_LineStates.assign(count, LexerState::NORMAL);
+
+	for (size_t line = 0; line + 1 < count; ++line)
+	{
+		const std::wstring& text = ReadLine(line);
+
+		m_LineStates[line + 1] = Lexer::LexLine(text.c_str(), text.length(), m_LineStates[line], m_pLanguage->rules, nullptr);
+	}
+
+	m_IsLinePainted.assign(count, 0);
+	m_UnpaintedLineCount = count;
+	m_LastRelexedLineCount = count;
+}
+
+void SyntaxHighlighter::OnDocumentEdit(const TextEdit& edit)
+{
+	const size_t line = m_LineIndex.GetLineFromOffset(edit.position);
+	const size_t removedLines = std::count(edit.removed.begin(), edit.removed.end(), L'\r');
+	const size_t insertedLines = std::count(edit.inserted.begin(), edit.inserted.end(), L'\r');
+
+	if (m_LineStates.size() + insertedLines < removedLines + 1 ||
+		m_LineStates.size() + insertedLines - removedLines != m_LineIndex.GetLineCount())
+	{
+		RelexAll();
+		return;
+	}
+
+	// The states of the lines that replaced the removed ones are unknown until they're lexed
+	if (removedLines > insertedLines)
+	{
+		const size_t first = line + 1;
+		const size_t last = first + (removedLines - insertedLines);
+
+		m_UnpaintedLineCount -= std::count(m_IsLinePainted.begin() + first, m_IsLinePainted.begin() + last, 0);
+
+		m_LineStates.erase(m_LineStates.begin() + first, m_LineStates.begin() + last);
+		m_IsLinePainted.erase(m_IsLinePainted.begin() + first, m_IsLinePainted.begin() + last);
+	}
+
+	else if (insertedLines > removedLines)
+	{
+		m_LineStates.insert(m_LineStates.begin() + line + 1, insertedLines - removedLines, LexerState::NORMAL);
+		m_IsLinePainted.insert(m_IsLinePainted.begin() + line + 1, insertedLines - removedLines, 0);
+		m_UnpaintedLineCount += insertedLines - removedLines;
+	}
+
+	Relex(line, line + insertedLines);
+}
+
+void SyntaxHighlighter::OnDocumentLoad(const PieceTable&)
+{
+	RelexAll();
+}
+
+void SyntaxHighlighter::SetLanguage(const Language* pLanguage)
+{
+	m_pLanguage = pLanguage;
+
+	RelexAll();
+}
+
+void SyntaxHighlighter::SetColorFunction(TokenColorFunction pColorFunction, uint32_t defaultColor)
+{
+	m_pColorFunction = pColorFunction;
+	m_DefaultColor = defaultColor;
+
+	MarkUnpainted(0, m_IsLinePainted.size());
+}
+
+const std::wstring& SyntaxHighlighter::GetLineTokens(size_t line, std::vector<Token>& tokens)
+{
+	tokens.clear();
+
+	const std::wstring& text = ReadLine(line);
+
+	if (line < m_LineStates.size())
+	{
+		Lexer::LexLine(text.c_str(), text.length(), m_LineStates[line], m_pLanguage->rules, &tokens);
+	}
+
+	return text;
+}
+
+void SyntaxHighlighter::GetLineColorRuns(size_t line, std::vector<ColorRun>& runs)
+{
+	if (line >= m_LineStates.size())
+	{
+		return;
+	}
+
+	const std::wstring& text = ReadLine(line);
+
+	AppendColorRuns(text.c_str(), text.length(), line + 1 < m_LineStates.size(), m_LineIndex.GetOffsetFromLine(line),
+		            m_LineStates[line], *m_pLanguage, m_pColorFunction, m_DefaultColor, m_Tokens, runs);
+}
+
+/* Extends the last run instead if it ends where this one starts and has the same color */
+static void AppendRun(std::vector<ColorRun>& runs, size_t position, size_t length, uint32_t color)
+{
+	if (!runs.empty() && runs.back().color == color && runs.back().position + runs.back().length == position)
+	{
+		runs.back().length += length;
+		return;
+	}
+
+	ColorRun run;
+	run.position = position;
+	run.length = length;
+	run.color = color;
+
+	runs.push_back(run);
+}
+
+/// <summary>
+/// Colors a comment, with the markers in it in a color of their own. All
+/// the markers are found in one pass over the comment.
+/// </summary>
+static void AppendCommentRuns(const wchar_t* pLine, size_t lineStart, const Token& comment, uint32_t commentColor,
+	                          const Language& language, TokenColorFunction pColorFunction, uint32_t defaultColor,
+	                          std::vector<ColorRun>& runs)
+{
+	const MultiPatternSearcher& searcher = GetMarkerSearcher();
+
+	std::vector<PatternMatch> markers;
+	searcher.FindAll(pLine + comment.start, comment.length, markers);
+
+	// Colored up to there, relative to the line
+	size_t colored = comment.start;
+
+	for (const PatternMatch& match : markers)
+	{
+		Token marker;
+		marker.start = static_cast<uint32_t>(comment.start + match.position);
+		marker.length = static_cast<uint32_t>(searcher.GetPatternLength(match.pattern));
+		marker.type = TokenType::MARKER;
+
+		const uint32_t markerColor = pColorFunction(language, pLine, marker);
+
+		if (markerColor == commentColor)
+		{
+			continue;
+		}
+
+		if (commentColor != defaultColor && marker.start > colored)
+		{
+			AppendRun(runs, lineStart + colored, marker.start - colored, commentColor);
+		}
+
+		if (markerColor != defaultColor)
+		{
+			AppendRun(runs, lineStart + marker.start, marker.length, markerColor);
+		}
+
+		colored = marker.start + marker.length;
+	}
+
+	const size_t end = comment.start + comment.length;
+
+	if (commentColor != defaultColor && end > colored)
+	{
+		AppendRun(runs, lineStart + colored, end - colored, commentColor);
+	}
+}
+
+LexerState SyntaxHighlighter::AppendColorRuns(const wchar_t* pLine, size_t length, bool hasLineBreak, size_t lineStart, LexerState state,
+	                                          const Language& language, TokenColorFunction pColorFunction, uint32_t defaultColor,
+	                                          std::vector<Token>& tokens, std::vector<ColorRun>& runs,
+	                                          const std::atomic<bool>* pIsCancelled)
+{
+	tokens.clear();
+
+	const LexerState next = Lexer::LexLine(pLine, length, state, language.rules, &tokens, pIsCancelled);
+
+	if ((length == 0 && !hasLineBreak) || (pIsCancelled != nullptr && *pIsCancelled))
+	{
+		return next;
+	}
+
+	// Not merged with the runs of the line before, the lines may be applied separately
+	ColorRun base;
+	base.position = lineStart;
+	base.length = length + (hasLineBreak ? 1 : 0);
+	base.color = defaultColor;
+	runs.push_back(base);
+
+	if (pColorFunction == nullptr)
+	{
+		return next;
+	}
+
+	// Tokens are never merged into the base, it has the default color
+	for (const Token& token : tokens)
+	{
+		const uint32_t color = pColorFunction(language, pLine, token);
+
+		if (token.type == TokenType::COMMENT)
+		{
+			AppendCommentRuns(pLine, lineStart, token, color, language, pColorFunction, defaultColor, runs);
+		}
+
+		else if (color != defaultColor)
+		{
+			AppendRun(runs, lineStart + token.start, token.length, color);
+		}
+	}
+
+	return next;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "PieceTable.h"
+#include "LineIndex.h"
+#include "Lexer.h"
+#include "Language.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* A range of the document and the color it's shown in */
+struct ColorRun {
+	size_t position = 0;
+	size_t length = 0;
+	uint32_t color = 0;
+};
+
+/* Color of a token, e.g. looked up in the keyword colors of the language */
+typedef uint32_t (*TokenColorFunction)(const Language& language, const wchar_t* pLine, const Token& token);
+
+/// <summary>
+/// Keeps the lexer state at the start of every line of a document, so an
+/// edit only has to lex the lines from the edited one onwards, and only
+/// until a line starts in the same state it did before. Typing inside a
+/// line touches that line alone, while opening or closing a comment goes
+/// on for as long as it changes how the following lines start.
+/// Each line is also marked as painted once the control shows its colors,
+/// a line that is lexed again has to be painted again.
+/// Must be added to the document after the line index it's given.
+/// </summary>
+class SyntaxHighlighter : public DocumentListener
+{
+private:
+	const PieceTable& m_Document;
+	const LineIndex& m_LineIndex;
+
+	const Language* m_pLanguage = nullptr;
+
+	TokenColorFunction m_pColorFunction = nullptr;
+	uint32_t m_DefaultColor = 0;
+
+	// State at the start of each line
+	std::vector<LexerState> m_LineStates;
+
+	// Whether the control shows the current colors of each line
+	std::vector<uint8_t> m_IsLinePainted;
+	size_t m_UnpaintedLineCount = 0;
+
+	// Lines lexed because of the last edit
+	size_t m_LastRelexedLineCount = 0;
+
+	std::wstring m_LineText;
+	std::vector<Token> m_Tokens;
+
+	const std::wstring& ReadLine(size_t line);
+	void MarkUnpainted(size_t first, size_t last);
+	void Relex(size_t line, size_t lastChangedLine);
+	void RelexAll(void);
+
+public:
+	SyntaxHighlighter(const PieceTable& document, const LineIndex& lineIndex, const Language* pLanguage);
+
+	SyntaxHighlighter(const SyntaxHighlighter&) = delete;
+	SyntaxHighlighter& operator=(const SyntaxHighlighter&) = delete;
+
+	void OnDocumentEdit(const TextEdit& edit) override;
+	void OnDocumentLoad(const PieceTable& document) override;
+
+	/* Lexes the whole document again with the rules of the language */
+	void SetLanguage(const Language* pLanguage);
+	const Language* GetLanguage(void) const { return m_pLanguage; }
+
+	/* Colors the text that isn't a token, or a token the function gives no color to */
+	void SetColorFunction(TokenColorFunction pColorFunction, uint32_t defaultColor);
+
+	TokenColorFunction GetColorFunction(void) const { return m_pColorFunction; }
+	uint32_t GetDefaultColor(void) const { return m_DefaultColor; }
+
+	/// <summary>
+	/// Lexes a line from its cached start state
+	/// </summary>
+	/// <returns> The text of the line without its line break, the tokens point into it </returns>
+	const std::wstring& GetLineTokens(size_t line, std::vector<Token>& tokens);
+
+	/* Appends the colors of a line, at their positions in the document */
+	void GetLineColorRuns(size_t line, std::vector<ColorRun>& runs);
+
+	/// <summary>
+	/// Lexes a line and appends its colors: a base run that puts the whole
+	/// line back in the default color, followed by the tokens that have a
+	/// color of their own. The base covers the line break too if there is
+	/// one, so the bases of consecutive lines meet and can be merged.
+	/// </summary>
+	/// <param name="pIsCancelled"> Given to the lexer, no runs are appended if it stopped. Can be null </param>
+	/// <returns> State at the start of the next line </returns>
+	static LexerState AppendColorRuns(const wchar_t* pLine, size_t length, bool hasLineBreak, size_t lineStart, LexerState state,
+		                              const Language& language, TokenColorFunction pColorFunction, uint32_t defaultColor,
+		                              std::vector<Token>& tokens, std::vector<ColorRun>& runs,
+		                              const std::atomic<bool>* pIsCancelled = nullptr);
+
+	bool IsLinePainted(size_t line) const { return line < m_IsLinePainted.size() && m_IsLinePainted[line] != 0; }
+	void MarkPainted(size_t line);
+
+	size_t GetLineCount(void) const { return m_LineStates.size(); }
+	size_t GetUnpaintedLineCount(void) const { return m_UnpaintedLineCount; }
+	const std::vector<uint8_t>& GetPaintedLines(void) const { return m_IsLinePainted; }
+
+	size_t GetLastRelexedLineCount(void) const { return m_LastRelexedLineCount; }
+};
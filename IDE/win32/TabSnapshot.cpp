@@ -0,0 +1,127 @@
+#include "TabSnapshot.h"
+#include "SourceEdit.h"
+#include "Logger.h"
+
+#include <compressapi.h>
+
+#pragma comment(lib, "Cabinet.lib")
+
+bool TabSnapshot::Capture(SourceEdit* pSourceEdit)
+{
+	const HWND hEditWindow = pSourceEdit->GetHandle();
+
+	SendMessage(hEditWindow, EM_EXGETSEL, NULL, reinterpret_cast<LPARAM>(&m_crSelection));
+	SendMessage(hEditWindow, EM_GETSCROLLPOS, NULL, reinterpret_cast<LPARAM>(&m_ptScroll));
+	m_HasBeenEdited = pSourceEdit->HasBeenEdited();
+
+	const std::wstring text = pSourceEdit->GetDocument().GetText();
+	m_Version = pSourceEdit->GetDocument().GetVersion();
+	const size_t byteCount = text.length() * sizeof(wchar_t);
+
+	m_TextLength = text.length();
+	m_CompressedText.clear();
+
+	if (byteCount == 0)
+	{
+		return true;
+	}
+
+	// Code is mostly ASCII, so every other byte of the UTF-16 text is zero and compresses very well
+	COMPRESSOR_HANDLE hCompressor = nullptr;
+
+	if (!CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &hCompressor))
+	{
+		Logger::Write(L"Failed to create a compressor (error %u)", GetLastError());
+		return false;
+	}
+
+	SIZE_T requiredSize = 0;
+	Compress(hCompressor, text.data(), byteCount, nullptr, 0, &requiredSize);
+
+	m_CompressedText.resize(requiredSize);
+
+	SIZE_T compressedSize = 0;
+	const BOOL succeeded = Compress(hCompressor,
+		                            text.data(),
+		                            byteCount,
+		                            m_CompressedText.data(),
+		                            m_CompressedText.size(),
+		                            &compressedSize);
+
+	CloseCompressor(hCompressor);
+
+	if (!succeeded)
+	{
+		Logger::Write(L"Failed to compress the text of a tab (error %u)", GetLastError());
+		m_CompressedText.clear();
+		return false;
+	}
+
+	m_CompressedText.resize(compressedSize);
+	m_CompressedText.shrink_to_fit();
+
+	return true;
+}
+
+bool TabSnapshot::GetText(std::wstring& text) const
+{
+	text.clear();
+
+	if (m_TextLength == 0)
+	{
+		return true;
+	}
+
+	DECOMPRESSOR_HANDLE hDecompressor = nullptr;
+
+	if (!CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &hDecompressor))
+	{
+		Logger::Write(L"Failed to create a decompressor (error %u)", GetLastError());
+		return false;
+	}
+
+	text.resize(m_TextLength);
+
+	SIZE_T decompressedSize = 0;
+	const BOOL succeeded = Decompress(hDecompressor,
+		                              m_CompressedText.data(),
+		                              m_CompressedText.size(),
+		                              &text[0],
+		                              m_TextLength * sizeof(wchar_t),
+		                              &decompressedSize);
+
+	CloseDecompressor(hDecompressor);
+
+	if (!succeeded || decompressedSize != m_TextLength * sizeof(wchar_t))
+	{
+		Logger::Write(L"Failed to decompress the text of a tab (error %u)", GetLastError());
+		text.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool TabSnapshot::Restore(SourceEdit* pSourceEdit) const
+{
+	const HWND hEditWindow = pSourceEdit->GetHandle();
+	std::wstring text;
+
+	// An empty edit marked as edited would overwrite the file the next time it's saved
+	if (!GetText(text))
+	{
+		return false;
+	}
+
+	pSourceEdit->SetText(std::move(text));
+
+	SendMessage(hEditWindow, EM_EXSETSEL, NULL, reinterpret_cast<LPARAM>(&m_crSelection));
+	SendMessage(hEditWindow, EM_SETSCROLLPOS, NULL, reinterpret_cast<LPARAM>(&m_ptScroll));
+
+	if (m_HasBeenEdited)
+	{
+		pSourceEdit->MarkAsEdited();
+	}
+
+	return true;
+}
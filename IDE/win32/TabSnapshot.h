@@ -0,0 +1,45 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <Richedit.h>
+
+#include <string>
+#include <vector>
+
+class SourceEdit;
+
+/// <summary>
+/// Compressed copy of the state of a closed tab, kept instead of its edit
+/// control once it hasn't been used for a while. Holds the text, the
+/// selection, the scroll position and whether there are unsaved changes.
+/// The undo history isn't kept.
+/// </summary>
+class TabSnapshot
+{
+private:
+	std::vector<unsigned char> m_CompressedText;
+	size_t m_TextLength = 0;
+	size_t m_Version = 0;
+
+	CHARRANGE m_crSelection = { 0, 0 };
+	POINT m_ptScroll = { 0, 0 };
+	bool m_HasBeenEdited = false;
+
+public:
+	/* Copies the state of the edit, which can be destroyed afterwards */
+	bool Capture(SourceEdit* pSourceEdit);
+
+	/* Gives a newly created edit the state it had when it was captured, the edit is left alone if the text can't be read back */
+	bool Restore(SourceEdit* pSourceEdit) const;
+
+	/* Safe to call from any thread, false if the text couldn't be decompressed */
+	bool GetText(std::wstring& text) const;
+
+	bool HasBeenEdited(void) const { return m_HasBeenEdited; }
+	void MarkAsUnedited(void) { m_HasBeenEdited = false; }
+
+	/* Version of the document the snapshot was taken from */
+	size_t GetVersion(void) const { return m_Version; }
+	size_t GetCompressedSize(void) const { return m_CompressedText.size(); }
+};
@@ -0,0 +1,186 @@
+#include "TextFileWriter.h"
+#include "Logger.h"
+
+TextFileWriter::~TextFileWriter(void)
+{
+	Abort();
+}
+
+bool TextFileWriter::Open(const wchar_t* lpszPath, bool writeByteOrderMark)
+{
+	Abort();
+
+	m_Path = lpszPath;
+	m_Buffer.clear();
+	m_Encoder.Reset();
+	m_HasFailed = false;
+
+	// In the same directory, so that replacing the target is a rename and not a copy
+	const size_t last_backslash_index = m_Path.find_last_of(L"\\/");
+	const std::wstring directory = last_backslash_index == std::wstring::npos ? L"." : m_Path.substr(0, last_backslash_index);
+
+	wchar_t buffer[MAX_PATH];
+
+	if (GetTempFileName(directory.c_str(), L"ide", 0, buffer) == 0)
+	{
+		Logger::Write(L"Failed to create a temporary file to save %ls (error %u)", lpszPath, GetLastError());
+		return false;
+	}
+
+	m_TemporaryPath = buffer;
+
+	m_hFile = CreateFile(m_TemporaryPath.c_str(),
+		                 GENERIC_WRITE,
+		                 0,
+		                 nullptr,
+		                 TRUNCATE_EXISTING,
+		                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		                 nullptr);
+
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		Logger::Write(L"Failed to open %ls (error %u)", m_TemporaryPath.c_str(), GetLastError());
+		DeleteFile(m_TemporaryPath.c_str());
+		m_TemporaryPath.clear();
+		return false;
+	}
+
+	if (writeByteOrderMark)
+	{
+		m_Buffer.append("\xEF\xBB\xBF");
+	}
+
+	return true;
+}
+
+bool TextFileWriter::Flush(void)
+{
+	if (m_HasFailed)
+	{
+		return false;
+	}
+
+	size_t written = 0;
+
+	while (written < m_Buffer.size())
+	{
+		DWORD dwWritten = 0;
+
+		if (!WriteFile(m_hFile, m_Buffer.data() + written, static_cast<DWORD>(m_Buffer.size() - written), &dwWritten, nullptr))
+		{
+			Logger::Write(L"Failed to write to %ls (error %u)", m_TemporaryPath.c_str(), GetLastError());
+			m_HasFailed = true;
+			return false;
+		}
+
+		written += static_cast<size_t>(dwWritten);
+	}
+
+	m_Buffer.clear();
+
+	return true;
+}
+
+bool TextFileWriter::Write(const wchar_t* pText, size_t length)
+{
+	if (m_TemporaryPath.empty() || m_HasFailed)
+	{
+		return false;
+	}
+
+	const wchar_t* const pEnd = pText + length;
+
+	while (pText < pEnd)
+	{
+		const wchar_t* pLineBreak = pText;
+
+		while (pLineBreak < pEnd && *pLineBreak != L'\r')
+		{
+			++pLineBreak;
+		}
+
+		m_Encoder.Encode(pText, pLineBreak - pText, m_Buffer);
+
+		if (pLineBreak < pEnd)
+		{
+			m_Buffer.append("\r\n");
+			++pLineBreak;
+		}
+
+		pText = pLineBreak;
+
+		if (m_Buffer.size() >= TEXT_WRITE_BUFFER_SIZE && !Flush())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TextFileWriter::CloseTemporaryFile(void)
+{
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool TextFileWriter::Commit(void)
+{
+	if (m_TemporaryPath.empty())
+	{
+		return false;
+	}
+
+	m_Encoder.Finish(m_Buffer);
+
+	if (!Flush())
+	{
+		Abort();
+		return false;
+	}
+
+	// The data has to be on the disk before the rename is, or a crash could leave an empty file
+	if (!FlushFileBuffers(m_hFile))
+	{
+		Logger::Write(L"Failed to flush %ls (error %u)", m_TemporaryPath.c_str(), GetLastError());
+		Abort();
+		return false;
+	}
+
+	CloseTemporaryFile();
+
+	// ReplaceFile keeps the attributes and permissions of the target, it fails if there's none yet
+	bool succeeded = ReplaceFile(m_Path.c_str(), m_TemporaryPath.c_str(), nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr) != FALSE;
+
+	if (!succeeded)
+	{
+		succeeded = MoveFileEx(m_TemporaryPath.c_str(), m_Path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+	}
+
+	if (!succeeded)
+	{
+		Logger::Write(L"Failed to replace %ls (error %u)", m_Path.c_str(), GetLastError());
+		Abort();
+		return false;
+	}
+
+	m_TemporaryPath.clear();
+
+	return true;
+}
+
+void TextFileWriter::Abort(void)
+{
+	CloseTemporaryFile();
+
+	if (!m_TemporaryPath.empty())
+	{
+		DeleteFile(m_TemporaryPath.c_str());
+		m_TemporaryPath.clear();
+	}
+
+	m_Buffer.clear();
+}
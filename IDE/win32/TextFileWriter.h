@@ -0,0 +1,58 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include "Utf8Encoder.h"
+
+#include <string>
+
+// Encoded bytes are written to the file whenever this many have piled up
+#define TEXT_WRITE_BUFFER_SIZE (256 * 1024)
+
+/// <summary>
+/// Saves text as UTF-8 without ever holding the whole file in memory. The
+/// text is written to a temporary file next to the target, which replaces
+/// the target only once everything has reached the disk, so a crash or a
+/// full disk in the middle of a save leaves the old file untouched.
+/// Line breaks stored as a single '\r' are written as CRLF. The target is
+/// replaced with ReplaceFile (MoveFileEx when it doesn't exist yet), the
+/// Win32 calls that take the place of rename on Windows.
+/// </summary>
+class TextFileWriter
+{
+private:
+	HANDLE m_hFile = INVALID_HANDLE_VALUE;
+
+	std::wstring m_Path;
+	std::wstring m_TemporaryPath;
+
+	Utf8Encoder m_Encoder;
+	std::string m_Buffer;
+	bool m_HasFailed = false;
+
+	bool Flush(void);
+	void CloseTemporaryFile(void);
+
+public:
+	TextFileWriter(void) = default;
+	~TextFileWriter(void);
+
+	TextFileWriter(const TextFileWriter&) = delete;
+	TextFileWriter& operator=(const TextFileWriter&) = delete;
+
+	/* Creates the temporary file, the target isn't touched yet */
+	bool Open(const wchar_t* lpszPath, bool writeByteOrderMark);
+
+	bool Write(const wchar_t* pText, size_t length);
+
+	/// <summary>
+	/// Flushes everything to the disk and replaces the target with the
+	/// temporary file. If anything went wrong the temporary file is deleted
+	/// and the target keeps its old contents.
+	/// </summary>
+	bool Commit(void);
+
+	/* Deletes the temporary file, called by the destructor if the file wasn't committed */
+	void Abort(void);
+};
@@ -0,0 +1,832 @@
+#include "TextSearch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SEARCH_USE_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Returned by the filters when no position is left
+#define NO_CANDIDATE SIZE_MAX
+
+// Characters compared on candidates that didn't match, before the search may switch to Two-Way
+#define MIN_WASTED_COMPARES 1024
+
+// Switches to Two-Way once the wasted compares are this many times the characters scanned
+#define MAX_WASTED_COMPARES_PER_CHAR 8
+
+// Every character of the BMP, folded
+#define FOLD_TABLE_SIZE 0x10000
+
+bool TextSearch::IsWordChar(wchar_t ch)
+{
+	return ch == L'_' || iswalnum(ch);
+}
+
+static bool IsWholeWord(const wchar_t* pText, size_t length, size_t position, size_t matchLength)
+{
+	return (position == 0 || !TextSearch::IsWordChar(pText[position - 1])) &&
+		   (position + matchLength == length || !TextSearch::IsWordChar(pText[position + matchLength]));
+}
+
+/* Lower case, the way the find dialog compares without matching case */
+static std::vector<wchar_t> BuildFoldTable(void)
+{
+	std::vector<wchar_t> table(FOLD_TABLE_SIZE);
+
+	for (size_t i = 0; i < FOLD_TABLE_SIZE; ++i)
+	{
+		table[i] = static_cast<wchar_t>(i);
+	}
+
+	CharLowerBuff(table.data(), FOLD_TABLE_SIZE);
+
+	return table;
+}
+
+/* Built the first time a search ignores case, safe to call from any thread */
+static const wchar_t* GetFoldTable(void)
+{
+	static const std::vector<wchar_t> table = BuildFoldTable();
+
+	return table.data();
+}
+
+static inline wchar_t Fold(const wchar_t* pFoldTable, wchar_t ch)
+{
+	// Past the BMP, with 32 bit characters, is compared as it is
+	if (static_cast<uint32_t>(ch) >= FOLD_TABLE_SIZE)
+	{
+		return ch;
+	}
+
+	return pFoldTable[static_cast<uint32_t>(ch)];
+}
+
+wchar_t TextSearch::FoldChar(wchar_t ch)
+{
+	return Fold(GetFoldTable(), ch);
+}
+
+/* 'ch' of the text against the already folded 'folded' of the pattern */
+static inline bool IsSameChar(const wchar_t* pFoldTable, wchar_t folded, wchar_t ch)
+{
+	return pFoldTable == nullptr ? folded == ch : folded == Fold(pFoldTable, ch);
+}
+
+/// <summary>
+/// Start of the maximal suffix of the pattern, by one order of the
+/// characters or by the reverse of it
+/// </summary>
+static size_t GetMaximalSuffix(const wchar_t* pPattern, size_t length, bool isOrderReversed, size_t& period)
+{
+	// One before the start, wraps around on purpose
+	size_t suffix = SIZE_MAX;
+	size_t j = 0;
+	size_t k = 1;
+
+	period = 1;
+
+	while (j + k < length)
+	{
+		const wchar_t a = pPattern[j + k];
+		const wchar_t b = pPattern[suffix + k];
+
+		if (isOrderReversed ? a > b : a < b)
+		{
+			j += k;
+			k = 1;
+			period = j - suffix;
+		}
+
+		else if (a == b)
+		{
+			if (k != period)
+			{
+				++k;
+			}
+
+			else
+			{
+				j += period;
+				k = 1;
+			}
+		}
+
+		else
+		{
+			suffix = j++;
+			k = period = 1;
+		}
+	}
+
+	return suffix + 1;
+}
+
+/// <summary>
+/// Splits the pattern where Two-Way has to start comparing, the later of
+/// the two maximal suffixes
+/// </summary>
+template <class Factorization>
+static Factorization Factorize(const wchar_t* pPattern, size_t length)
+{
+	Factorization factorization;
+
+	if (length < 3)
+	{
+		factorization.suffix = length - 1;
+		factorization.period = 1;
+	}
+
+	else
+	{
+		size_t period, reversedPeriod;
+
+		const size_t suffix = GetMaximalSuffix(pPattern, length, false, period);
+		const size_t reversedSuffix = GetMaximalSuffix(pPattern, length, true, reversedPeriod);
+
+		factorization.suffix = std::max(suffix, reversedSuffix);
+		factorization.period = suffix >= reversedSuffix ? period : reversedPeriod;
+	}
+
+	factorization.isPeriodic = factorization.suffix + factorization.period <= length &&
+		                       memcmp(pPattern, pPattern + factorization.period, factorization.suffix * sizeof(wchar_t)) == 0;
+
+	// Without a period, any shift past the right half is safe
+	if (!factorization.isPeriodic)
+	{
+		factorization.period = std::max(factorization.suffix, length - factorization.suffix) + 1;
+	}
+
+	return factorization;
+}
+
+/* Text read from left to right */
+struct ForwardText {
+	const wchar_t* pFirst;
+
+	wchar_t operator[](size_t index) const { return pFirst[index]; }
+};
+
+/* Text read from right to left, for the reversed pattern */
+struct BackwardText {
+	const wchar_t* pLast;
+
+	wchar_t operator[](size_t index) const { return *(pLast - index); }
+};
+
+/// <summary>
+/// Crochemore and Perrin's Two-Way: the right half of the pattern is
+/// compared first, then the left half. Periodic patterns remember how
+/// much of the previous window is known to match so nothing is compared
+/// twice.
+/// </summary>
+/// <returns> Whether the pattern is in the first 'length' characters of the text, at 'position' </returns>
+template <class Text, class Factorization>
+static bool FindTwoWay(const wchar_t* pPattern, size_t patternLength, const Factorization& factorization, const wchar_t* pFoldTable,
+	                   const Text& text, size_t length, size_t& position)
+{
+	if (length < patternLength)
+	{
+		return false;
+	}
+
+	const size_t suffix = factorization.suffix;
+	const size_t period = factorization.period;
+
+	// Characters at the start of the window that are already known to match
+	size_t memory = 0;
+	size_t j = 0;
+
+	while (j <= length - patternLength)
+	{
+		size_t i = std::max(suffix, memory);
+
+		while (i < patternLength && IsSameChar(pFoldTable, pPattern[i], text[i + j]))
+		{
+			++i;
+		}
+
+		if (i < patternLength)
+		{
+			j += i - suffix + 1;
+			memory = 0;
+
+			continue;
+		}
+
+		i = suffix;
+
+		while (i > memory && IsSameChar(pFoldTable, pPattern[i - 1], text[i - 1 + j]))
+		{
+			--i;
+		}
+
+		if (i <= memory)
+		{
+			position = j;
+			return true;
+		}
+
+		j += period;
+
+		if (factorization.isPeriodic)
+		{
+			memory = patternLength - period;
+		}
+	}
+
+	return false;
+}
+
+/* Scalar filters, for the ends of the text and when the filter characters don't fit in the vector compares */
+template <class CharFilter>
+static inline bool IsFilterMatch(const CharFilter& filter, const wchar_t* pFoldTable, wchar_t ch)
+{
+	if (filter.count == 0)
+	{
+		return Fold(pFoldTable, ch) == filter.folded;
+	}
+
+	for (size_t i = 0; i < filter.count; ++i)
+	{
+		if (filter.chars[i] == ch)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template <class CharFilter>
+static size_t FindCandidateForwardScalar(const CharFilter& first, const CharFilter& last, const wchar_t* pFoldTable,
+	                                     const wchar_t* pText, size_t start, size_t lastStart, size_t lastOffset)
+{
+	for (size_t i = start; i <= lastStart; ++i)
+	{
+		if (IsFilterMatch(first, pFoldTable, pText[i]) && IsFilterMatch(last, pFoldTable, pText[i + lastOffset]))
+		{
+			return i;
+		}
+	}
+
+	return NO_CANDIDATE;
+}
+
+template <class CharFilter>
+static size_t FindCandidateBackwardScalar(const CharFilter& first, const CharFilter& last, const wchar_t* pFoldTable,
+	                                      const wchar_t* pText, size_t firstStart, size_t start, size_t lastOffset)
+{
+	for (size_t i = start + 1; i-- > firstStart; )
+	{
+		if (IsFilterMatch(first, pFoldTable, pText[i]) && IsFilterMatch(last, pFoldTable, pText[i + lastOffset]))
+		{
+			return i;
+		}
+	}
+
+	return NO_CANDIDATE;
+}
+
+#ifdef SEARCH_USE_SIMD
+
+static bool IsAvx2Supported(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(info, 1);
+
+	// The OS has to save the AVX registers too
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool g_IsAvx2Supported = IsAvx2Supported();
+
+static inline unsigned long GetLowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline unsigned long GetHighestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+
+	return index;
+#else
+	return 31 - __builtin_clz(mask);
+#endif
+}
+
+/* Every character takes sizeof(wchar_t) bits of the masks below */
+
+static inline __m128i SetChars(wchar_t ch)
+{
+	return sizeof(wchar_t) == 2 ? _mm_set1_epi16(static_cast<short>(ch)) : _mm_set1_epi32(static_cast<int>(ch));
+}
+
+static inline __m128i CompareChars(__m128i a, __m128i b)
+{
+	return sizeof(wchar_t) == 2 ? _mm_cmpeq_epi16(a, b) : _mm_cmpeq_epi32(a, b);
+}
+
+/// <returns> Bits set for the characters of the block that pass the filter </returns>
+static inline __m128i MatchFilter(const __m128i* pChars, size_t count, __m128i block)
+{
+	__m128i matches = CompareChars(block, pChars[0]);
+
+	for (size_t i = 1; i < count; ++i)
+	{
+		matches = _mm_or_si128(matches, CompareChars(block, pChars[i]));
+	}
+
+	return matches;
+}
+
+TARGET_AVX2 static inline __m256i SetChars256(wchar_t ch)
+{
+	return sizeof(wchar_t) == 2 ? _mm256_set1_epi16(static_cast<short>(ch)) : _mm256_set1_epi32(static_cast<int>(ch));
+}
+
+TARGET_AVX2 static inline __m256i MatchFilter256(const __m256i* pChars, size_t count, __m256i block)
+{
+	__m256i matches = sizeof(wchar_t) == 2 ? _mm256_cmpeq_epi16(block, pChars[0]) : _mm256_cmpeq_epi32(block, pChars[0]);
+
+	for (size_t i = 1; i < count; ++i)
+	{
+		matches = _mm256_or_si256(matches, sizeof(wchar_t) == 2 ? _mm256_cmpeq_epi16(block, pChars[i]) : _mm256_cmpeq_epi32(block, pChars[i]));
+	}
+
+	return matches;
+}
+
+/// <summary>
+/// Compares a block of positions at a time: the characters under the
+/// first character of the pattern and the ones under the last
+/// </summary>
+/// <returns> First position in [start, lastStart] where both pass, or NO_CANDIDATE </returns>
+template <class CharFilter>
+static size_t FindCandidateForwardSSE2(const CharFilter& first, const CharFilter& last,
+	                                   const wchar_t* pText, size_t start, size_t lastStart, size_t lastOffset)
+{
+	const size_t width = sizeof(__m128i) / sizeof(wchar_t);
+
+	__m128i firstChars[MAX_FILTER_CHARS], lastChars[MAX_FILTER_CHARS];
+
+	for (size_t i = 0; i < first.count; ++i) firstChars[i] = SetChars(first.chars[i]);
+	for (size_t i = 0; i < last.count; ++i) lastChars[i] = SetChars(last.chars[i]);
+
+	for (; start <= lastStart && lastStart - start >= width - 1; start += width)
+	{
+		const __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pText + start));
+		const __m128i lastBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pText + start + lastOffset));
+
+		const uint32_t mask = _mm_movemask_epi8(_mm_and_si128(MatchFilter(firstChars, first.count, firstBlock),
+			                                                  MatchFilter(lastChars, last.count, lastBlock)));
+
+		if (mask != 0)
+		{
+			return start + GetLowestBit(mask) / sizeof(wchar_t);
+		}
+	}
+
+	return FindCandidateForwardScalar(first, last, nullptr, pText, start, lastStart, lastOffset);
+}
+
+template <class CharFilter>
+static size_t FindCandidateBackwardSSE2(const CharFilter& first, const CharFilter& last,
+	                                    const wchar_t* pText, size_t firstStart, size_t start, size_t lastOffset)
+{
+	const size_t width = sizeof(__m128i) / sizeof(wchar_t);
+
+	__m128i firstChars[MAX_FILTER_CHARS], lastChars[MAX_FILTER_CHARS];
+
+	for (size_t i = 0; i < first.count; ++i) firstChars[i] = SetChars(first.chars[i]);
+	for (size_t i = 0; i < last.count; ++i) lastChars[i] = SetChars(last.chars[i]);
+
+	while (start - firstStart >= width - 1)
+	{
+		// The block ends at 'start'
+		const size_t block = start - (width - 1);
+
+		const __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pText + block));
+		const __m128i lastBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pText + block + lastOffset));
+
+		const uint32_t mask = _mm_movemask_epi8(_mm_and_si128(MatchFilter(firstChars, first.count, firstBlock),
+			                                                  MatchFilter(lastChars, last.count, lastBlock)));
+
+		if (mask != 0)
+		{
+			return block + GetHighestBit(mask) / sizeof(wchar_t);
+		}
+
+		if (block == firstStart)
+		{
+			return NO_CANDIDATE;
+		}
+
+		start = block - 1;
+	}
+
+	return FindCandidateBackwardScalar(first, last, nullptr, pText, firstStart, start, lastOffset);
+}
+
+template <class CharFilter>
+TARGET_AVX2 static size_t FindCandidateForwardAVX2(const CharFilter& first, const CharFilter& last,
+	                                               const wchar_t* pText, size_t start, size_t lastStart, size_t lastOffset)
+{
+	const size_t width = sizeof(__m256i) / sizeof(wchar_t);
+
+	__m256i firstChars[MAX_FILTER_CHARS], lastChars[MAX_FILTER_CHARS];
+
+	for (size_t i = 0; i < first.count; ++i) firstChars[i] = SetChars256(first.chars[i]);
+	for (size_t i = 0; i < last.count; ++i) lastChars[i] = SetChars256(last.chars[i]);
+
+	for (; start <= lastStart && lastStart - start >= width - 1; start += width)
+	{
+		const __m256i firstBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pText + start));
+		const __m256i lastBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pText + start + lastOffset));
+
+		const uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(MatchFilter256(firstChars, first.count, firstBlock),
+			                                                        MatchFilter256(lastChars, last.count, lastBlock)));
+
+		if (mask != 0)
+		{
+			return start + GetLowestBit(mask) / sizeof(wchar_t);
+		}
+	}
+
+	// Whatever is left is shorter than a 32 byte block
+	return FindCandidateForwardSSE2(first, last, pText, start, lastStart, lastOffset);
+}
+
+template <class CharFilter>
+TARGET_AVX2 static size_t FindCandidateBackwardAVX2(const CharFilter& first, const CharFilter& last,
+	                                                const wchar_t* pText, size_t firstStart, size_t start, size_t lastOffset)
+{
+	const size_t width = sizeof(__m256i) / sizeof(wchar_t);
+
+	__m256i firstChars[MAX_FILTER_CHARS], lastChars[MAX_FILTER_CHARS];
+
+	for (size_t i = 0; i < first.count; ++i) firstChars[i] = SetChars256(first.chars[i]);
+	for (size_t i = 0; i < last.count; ++i) lastChars[i] = SetChars256(last.chars[i]);
+
+	while (start - firstStart >= width - 1)
+	{
+		const size_t block = start - (width - 1);
+
+		const __m256i firstBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pText + block));
+		const __m256i lastBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pText + block + lastOffset));
+
+		const uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(MatchFilter256(firstChars, first.count, firstBlock),
+			                                                        MatchFilter256(lastChars, last.count, lastBlock)));
+
+		if (mask != 0)
+		{
+			return block + GetHighestBit(mask) / sizeof(wchar_t);
+		}
+
+		if (block == firstStart)
+		{
+			return NO_CANDIDATE;
+		}
+
+		start = block - 1;
+	}
+
+	return FindCandidateBackwardSSE2(first, last, pText, firstStart, start, lastOffset);
+}
+
+#endif
+
+TextSearcher::TextSearcher(const std::wstring& pattern, const SearchOptions& options)
+	: m_Options(options), m_Pattern(pattern)
+{
+	if (!options.matchCase)
+	{
+		m_pFoldTable = GetFoldTable();
+
+		for (wchar_t& ch : m_Pattern)
+		{
+			ch = Fold(m_pFoldTable, ch);
+		}
+	}
+
+	if (m_Pattern.empty())
+	{
+		return;
+	}
+
+	m_ReversedPattern.assign(m_Pattern.rbegin(), m_Pattern.rend());
+
+	m_FirstChar = GetFilter(m_Pattern.front());
+	m_LastChar = GetFilter(m_Pattern.back());
+
+	m_Forward = Factorize<Factorization>(m_Pattern.c_str(), m_Pattern.length());
+	m_Backward = Factorize<Factorization>(m_ReversedPattern.c_str(), m_ReversedPattern.length());
+}
+
+TextSearcher::CharFilter TextSearcher::GetFilter(wchar_t ch) const
+{
+	CharFilter filter;
+	filter.folded = ch;
+
+	if (m_pFoldTable == nullptr || static_cast<uint32_t>(ch) >= FOLD_TABLE_SIZE)
+	{
+		filter.chars[0] = ch;
+		filter.count = 1;
+
+		return filter;
+	}
+
+	// Every character that folds to it, e.g. 'a' and 'A'
+	for (uint32_t i = 0; i < FOLD_TABLE_SIZE; ++i)
+	{
+		if (m_pFoldTable[i] != ch)
+		{
+			continue;
+		}
+
+		if (filter.count == MAX_FILTER_CHARS)
+		{
+			filter.count = 0;
+			break;
+		}
+
+		filter.chars[filter.count++] = static_cast<wchar_t>(i);
+	}
+
+	return filter;
+}
+
+bool TextSearcher::IsMatchAt(const wchar_t* pText, size_t length, size_t position) const
+{
+	const size_t patternLength = m_Pattern.length();
+	const wchar_t* pCandidate = pText + position;
+
+	if (m_pFoldTable == nullptr)
+	{
+		if (memcmp(pCandidate, m_Pattern.c_str(), patternLength * sizeof(wchar_t)) != 0)
+		{
+			return false;
+		}
+	}
+
+	else
+	{
+		for (size_t i = 0; i < patternLength; ++i)
+		{
+			if (Fold(m_pFoldTable, pCandidate[i]) != m_Pattern[i])
+			{
+				return false;
+			}
+		}
+	}
+
+	return !m_Options.wholeWord || IsWholeWord(pText, length, position, patternLength);
+}
+
+size_t TextSearcher::FindCandidateForward(const wchar_t* pText, size_t start, size_t lastStart) const
+{
+	const size_t lastOffset = m_Pattern.length() - 1;
+
+#ifdef SEARCH_USE_SIMD
+	if (m_FirstChar.count != 0 && m_LastChar.count != 0)
+	{
+		return g_IsAvx2Supported ? FindCandidateForwardAVX2(m_FirstChar, m_LastChar, pText, start, lastStart, lastOffset)
+			                     : FindCandidateForwardSSE2(m_FirstChar, m_LastChar, pText, start, lastStart, lastOffset);
+	}
+#endif
+
+	return FindCandidateForwardScalar(m_FirstChar, m_LastChar, m_pFoldTable, pText, start, lastStart, lastOffset);
+}
+
+size_t TextSearcher::FindCandidateBackward(const wchar_t* pText, size_t firstStart, size_t start) const
+{
+	const size_t lastOffset = m_Pattern.length() - 1;
+
+#ifdef SEARCH_USE_SIMD
+	if (m_FirstChar.count != 0 && m_LastChar.count != 0)
+	{
+		return g_IsAvx2Supported ? FindCandidateBackwardAVX2(m_FirstChar, m_LastChar, pText, firstStart, start, lastOffset)
+			                     : FindCandidateBackwardSSE2(m_FirstChar, m_LastChar, pText, firstStart, start, lastOffset);
+	}
+#endif
+
+	return FindCandidateBackwardScalar(m_FirstChar, m_LastChar, m_pFoldTable, pText, firstStart, start, lastOffset);
+}
+
+bool TextSearcher::FindForwardTwoWay(const wchar_t* pText, size_t length, size_t from, size_t& position) const
+{
+	const size_t patternLength = m_Pattern.length();
+	size_t found;
+
+	while (from <= length && FindTwoWay(m_Pattern.c_str(), patternLength, m_Forward, m_pFoldTable, ForwardText{ pText + from }, length - from, found))
+	{
+		position = from + found;
+
+		if (!m_Options.wholeWord || IsWholeWord(pText, length, position, patternLength))
+		{
+			return true;
+		}
+
+		from = position + 1;
+	}
+
+	return false;
+}
+
+bool TextSearcher::FindBackwardTwoWay(const wchar_t* pText, size_t length, size_t end, size_t& position) const
+{
+	const size_t patternLength = m_Pattern.length();
+	size_t found;
+
+	while (end >= patternLength && FindTwoWay(m_ReversedPattern.c_str(), patternLength, m_Backward, m_pFoldTable, BackwardText{ pText + end - 1 }, end, found))
+	{
+		position = end - found - patternLength;
+
+		if (!m_Options.wholeWord || IsWholeWord(pText, length, position, patternLength))
+		{
+			return true;
+		}
+
+		// The next one has to start before this one
+		end = position + patternLength - 1;
+	}
+
+	return false;
+}
+
+bool TextSearcher::FindForward(const wchar_t* pText, size_t length, size_t from, size_t& position) const
+{
+	const size_t patternLength = m_Pattern.length();
+
+	if (patternLength == 0 || from > length || length - from < patternLength)
+	{
+		return false;
+	}
+
+	const size_t lastStart = length - patternLength;
+	size_t wastedCompares = 0;
+
+	for (size_t start = from; start <= lastStart; )
+	{
+		const size_t candidate = FindCandidateForward(pText, start, lastStart);
+
+		if (candidate == NO_CANDIDATE)
+		{
+			return false;
+		}
+
+		if (IsMatchAt(pText, length, candidate))
+		{
+			position = candidate;
+			return true;
+		}
+
+		start = candidate + 1;
+		wastedCompares += patternLength;
+
+		// The filter lets too much through for this text
+		if (wastedCompares > MIN_WASTED_COMPARES && wastedCompares / MAX_WASTED_COMPARES_PER_CHAR > start - from)
+		{
+			return FindForwardTwoWay(pText, length, start, position);
+		}
+	}
+
+	return false;
+}
+
+bool TextSearcher::FindBackward(const wchar_t* pText, size_t length, size_t end, size_t& position) const
+{
+	const size_t patternLength = m_Pattern.length();
+
+	end = std::min(end, length);
+
+	if (patternLength == 0 || end < patternLength)
+	{
+		return false;
+	}
+
+	const size_t lastStart = end - patternLength;
+	size_t wastedCompares = 0;
+
+	for (size_t start = lastStart; ; )
+	{
+		const size_t candidate = FindCandidateBackward(pText, 0, start);
+
+		if (candidate == NO_CANDIDATE)
+		{
+			return false;
+		}
+
+		if (IsMatchAt(pText, length, candidate))
+		{
+			position = candidate;
+			return true;
+		}
+
+		if (candidate == 0)
+		{
+			return false;
+		}
+
+		start = candidate - 1;
+		wastedCompares += patternLength;
+
+		if (wastedCompares > MIN_WASTED_COMPARES && wastedCompares / MAX_WASTED_COMPARES_PER_CHAR > lastStart - start)
+		{
+			return FindBackwardTwoWay(pText, length, start + patternLength, position);
+		}
+	}
+}
+
+void TextSearch::FindAll(const wchar_t* pText, size_t length, const std::wstring& pattern, const SearchOptions& options, std::vector<size_t>& matches)
+{
+	const TextSearcher searcher(pattern, options);
+	const size_t patternLength = searcher.GetPatternLength();
+
+	size_t position = 0;
+	size_t match;
+
+	// A match starts only after the previous one ends
+	while (searcher.FindForward(pText, length, position, match))
+	{
+		matches.push_back(match);
+		position = match + patternLength;
+	}
+}
+
+bool TextSearch::ReplaceAll(const std::wstring& text, const std::wstring& pattern, const std::wstring& replacement,
+	                        const SearchOptions& options, ReplaceAllResult& result)
+{
+	std::vector<size_t> matches;
+	FindAll(text.c_str(), text.length(), pattern, options, matches);
+
+	if (matches.empty())
+	{
+		return false;
+	}
+
+	const size_t patternLength = pattern.length();
+
+	result.matchCount = matches.size();
+	result.position = matches.front();
+	result.removedLength = matches.back() + patternLength - result.position;
+
+	result.inserted.clear();
+	result.inserted.reserve(result.removedLength - matches.size() * patternLength + matches.size() * replacement.length());
+
+	size_t copied = result.position;
+
+	for (size_t match : matches)
+	{
+		result.inserted.append(text, copied, match - copied);
+		result.inserted.append(replacement);
+
+		copied = match + patternLength;
+	}
+
+	return true;
+}
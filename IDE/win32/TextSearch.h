@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// A character of the pattern is compared against up to this many characters of the text at once
+#define MAX_FILTER_CHARS 4
+
+/* How the text has to match, the same options the find dialog has */
+struct SearchOptions {
+	bool matchCase = false;
+
+	// The match can't have a letter, digit or underscore right before or after it
+	bool wholeWord = false;
+};
+
+/* Every match of a Replace All, as a single edit of the range they span */
+struct ReplaceAllResult {
+	size_t matchCount = 0;
+
+	// From the start of the first match to the end of the last one
+	size_t position = 0;
+	size_t removedLength = 0;
+
+	std::wstring inserted;
+};
+
+/// <summary>
+/// Finds a pattern in any text, forward or backward, without going through
+/// the edit control. The pattern is prepared once and can be looked for in
+/// as many texts as needed.
+/// Vector compares of the first and the last character of the pattern
+/// skip most of the text, and only the few positions where both are in
+/// place are compared in full. When too many of those turn out not to be
+/// matches (a text like "aaaa..." and a pattern like "aaab"), the search
+/// switches to Two-Way, which never looks at a character more than twice.
+/// Without matching case, characters are folded through a table, so the
+/// text is never copied.
+/// </summary>
+class TextSearcher
+{
+private:
+	/* Characters of the text that match one character of the pattern */
+	struct CharFilter {
+		wchar_t folded = 0;
+		wchar_t chars[MAX_FILTER_CHARS] = {};
+
+		// Zero if there are too many to compare one by one, the text is folded then
+		size_t count = 0;
+	};
+
+	/* Critical factorization of the pattern, for Two-Way */
+	struct Factorization {
+		size_t suffix = 0;
+		size_t period = 1;
+		bool isPeriodic = false;
+	};
+
+	SearchOptions m_Options;
+
+	// Folded if case doesn't matter, backward searches look for the reversed one in the reversed text
+	std::wstring m_Pattern;
+	std::wstring m_ReversedPattern;
+
+	// Null when matching case
+	const wchar_t* m_pFoldTable = nullptr;
+
+	CharFilter m_FirstChar;
+	CharFilter m_LastChar;
+
+	Factorization m_Forward;
+	Factorization m_Backward;
+
+	CharFilter GetFilter(wchar_t ch) const;
+	bool IsMatchAt(const wchar_t* pText, size_t length, size_t position) const;
+
+	size_t FindCandidateForward(const wchar_t* pText, size_t start, size_t lastStart) const;
+	size_t FindCandidateBackward(const wchar_t* pText, size_t firstStart, size_t start) const;
+
+	bool FindForwardTwoWay(const wchar_t* pText, size_t length, size_t from, size_t& position) const;
+	bool FindBackwardTwoWay(const wchar_t* pText, size_t length, size_t end, size_t& position) const;
+
+public:
+	TextSearcher(const std::wstring& pattern, const SearchOptions& options);
+
+	/// <summary>
+	/// Finds the first match that starts at or after 'from'
+	/// </summary>
+	/// <returns> False if there is none, or if the pattern is empty </returns>
+	bool FindForward(const wchar_t* pText, size_t length, size_t from, size_t& position) const;
+
+	/// <summary>
+	/// Finds the last match that ends at or before 'end', the way the find
+	/// dialog searches up from the start of the selection
+	/// </summary>
+	/// <returns> False if there is none, or if the pattern is empty </returns>
+	bool FindBackward(const wchar_t* pText, size_t length, size_t end, size_t& position) const;
+
+	size_t GetPatternLength(void) const { return m_Pattern.length(); }
+};
+
+namespace TextSearch
+{
+	/* Letters, digits and underscores, what whole word matching won't let touch a match */
+	bool IsWordChar(wchar_t ch);
+
+	/* Lower case, the way searches that don't match case compare characters */
+	wchar_t FoldChar(wchar_t ch);
+
+	/// <summary>
+	/// Finds every match in one scan of the text. A match starts only after
+	/// the previous one ends, the same way replacing them one by one would.
+	/// </summary>
+	/// <param name="matches"> Receives the position of every match, in order </param>
+	void FindAll(const wchar_t* pText, size_t length, const std::wstring& pattern, const SearchOptions& options, std::vector<size_t>& matches);
+
+	/// <summary>
+	/// Finds every match and builds the text that replaces the range they
+	/// span in a single pass, so the result can be applied as one edit no
+	/// matter how many matches there are
+	/// </summary>
+	/// <returns> False if nothing matched </returns>
+	bool ReplaceAll(const std::wstring& text, const std::wstring& pattern, const std::wstring& replacement,
+		            const SearchOptions& options, ReplaceAllResult& result);
+}
@@ -0,0 +1,1300 @@
+#include "TrigramIndex.h"
+#include "FileSearch.h"
+#include "TextSearch.h"
+#include "Utf8Decoder.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+// Trigrams of three ASCII characters are told apart with a bitmap of this many bits, the rest are sorted
+#define ASCII_TRIGRAM_COUNT (128 * 128 * 128)
+
+// ReadFile and WriteFile take a DWORD, the index is read and written in chunks of this size
+#define IO_CHUNK_SIZE (16 * 1024 * 1024)
+
+/* Followed by the files, then by every trigram with its list */
+struct IndexHeader {
+	uint32_t magic;
+	uint32_t version;
+
+	// Paths are stored as they are in memory
+	uint32_t charSize;
+	uint32_t fileCount;
+	uint64_t trigramCount;
+	uint64_t indexedBytes;
+
+	// FNV-1a of everything after the header, the file is in the project folder and anything can happen to it
+	uint64_t checksum;
+};
+
+struct IndexFileRecord {
+	uint64_t size;
+	uint64_t writeTime;
+	uint32_t isDeleted;
+	uint32_t pathLength;
+};
+
+struct IndexTrigramRecord {
+	uint64_t trigram;
+	uint32_t count;
+	uint32_t next;
+	uint64_t byteCount;
+};
+
+static inline uint64_t MakeTrigram(wchar_t a, wchar_t b, wchar_t c)
+{
+	return (static_cast<uint64_t>(static_cast<uint16_t>(a)) << 32) |
+		   (static_cast<uint64_t>(static_cast<uint16_t>(b)) << 16) |
+		    static_cast<uint64_t>(static_cast<uint16_t>(c));
+}
+
+static inline bool IsLineBreak(wchar_t ch)
+{
+	return ch == L'\r' || ch == L'\n';
+}
+
+static std::wstring FoldPath(std::wstring path)
+{
+	if (!path.empty())
+	{
+		CharLowerBuff(&path[0], static_cast<DWORD>(path.length()));
+	}
+
+	return path;
+}
+
+static inline unsigned long long GetFileTime(const FILETIME& fileTime)
+{
+	return (static_cast<unsigned long long>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+}
+
+/* Whether a part of the path starts with a dot, like the folder the index is saved in */
+static bool IsHiddenPath(const std::wstring& relativePath)
+{
+	size_t start = 0;
+
+	while (start < relativePath.length())
+	{
+		if (relativePath[start] == L'.')
+		{
+			return true;
+		}
+
+		const size_t separator = relativePath.find(L'\\', start);
+
+		if (separator == std::wstring::npos)
+		{
+			break;
+		}
+
+		start = separator + 1;
+	}
+
+	return false;
+}
+
+template <typename T>
+static void AppendRecord(std::vector<char>& data, const T& record)
+{
+	const char* pBytes = reinterpret_cast<const char*>(&record);
+	data.insert(data.end(), pBytes, pBytes + sizeof(T));
+}
+
+/* Reads the saved index one record at a time, never past its end */
+class IndexReader
+{
+private:
+	const std::vector<char>& m_Data;
+	size_t m_Position = 0;
+
+public:
+	explicit IndexReader(const std::vector<char>& data)
+		: m_Data(data) {}
+
+	bool Read(void* pOut, size_t size)
+	{
+		if (m_Data.size() - m_Position < size)
+		{
+			return false;
+		}
+
+		memcpy(pOut, m_Data.data() + m_Position, size);
+		m_Position += size;
+
+		return true;
+	}
+
+	bool IsAtEnd(void) const { return m_Position == m_Data.size(); }
+
+	size_t GetRemaining(void) const { return m_Data.size() - m_Position; }
+};
+
+void TrigramIndex::PostingList::Add(uint32_t id)
+{
+	uint32_t delta = id - next;
+
+	while (delta >= 0x80)
+	{
+		ids.push_back(static_cast<uint8_t>(delta | 0x80));
+		delta >>= 7;
+	}
+
+	ids.push_back(static_cast<uint8_t>(delta));
+
+	next = id + 1;
+	++count;
+}
+
+void TrigramIndex::PostingList::Decode(std::vector<uint32_t>& out) const
+{
+	out.clear();
+	out.reserve(count);
+
+	uint32_t id = 0;
+	size_t i = 0;
+
+	while (i < ids.size())
+	{
+		uint32_t delta = 0;
+		uint32_t shift = 0;
+
+		do {
+			delta |= static_cast<uint32_t>(ids[i] & 0x7F) << shift;
+			shift += 7;
+		} while (ids[i++] & 0x80);
+
+		id += delta;
+		out.push_back(id);
+		++id;
+	}
+}
+
+bool TrigramIndex::PostingList::IsValid(uint32_t fileCount) const
+{
+	if (count == 0 || next == 0 || next > fileCount)
+	{
+		return false;
+	}
+
+	uint64_t id = 0;
+	size_t decoded = 0;
+	size_t i = 0;
+
+	while (i < ids.size())
+	{
+		uint64_t delta = 0;
+		uint32_t shift = 0;
+
+		// An id takes at most five bytes, and the last byte of the list has to end one
+		do {
+			if (i == ids.size() || shift > 28)
+			{
+				return false;
+			}
+
+			delta |= static_cast<uint64_t>(ids[i] & 0x7F) << shift;
+			shift += 7;
+		} while (ids[i++] & 0x80);
+
+		id += delta;
+
+		if (id >= next)
+		{
+			return false;
+		}
+
+		++id;
+		++decoded;
+	}
+
+	return decoded == count && id == next;
+}
+
+TrigramIndex::TrigramIndex(void)
+	: m_IsStopping(false)
+{
+	m_hStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	m_hQueueEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+}
+
+TrigramIndex::~TrigramIndex(void)
+{
+	Close();
+
+	CloseHandle(m_hStopEvent);
+	CloseHandle(m_hQueueEvent);
+}
+
+void TrigramIndex::Open(const std::wstring& folder)
+{
+	Close();
+
+	m_Folder = folder;
+	m_IsStopping = false;
+	ResetEvent(m_hStopEvent);
+
+	m_Thread = std::thread(&TrigramIndex::Run, this);
+}
+
+void TrigramIndex::Close(void)
+{
+	if (m_Thread.joinable())
+	{
+		m_IsStopping = true;
+		SetEvent(m_hStopEvent);
+
+		// Saves what changed before it returns
+		m_Thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	m_Files.clear();
+	m_FileIds.clear();
+	m_Postings.clear();
+	m_QueuedPaths.clear();
+	m_PendingPaths.clear();
+	m_NeedsReconcile = false;
+	m_DeletedCount = 0;
+	m_IndexedBytes = 0;
+	m_IsReady = false;
+	m_IsDirty = false;
+}
+
+void TrigramIndex::Build(const std::wstring& folder)
+{
+	Close();
+
+	m_Folder = folder;
+	m_IsStopping = false;
+
+	Reconcile();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_IsReady = true;
+}
+
+void TrigramIndex::Update(const std::wstring& path)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_QueuedPaths.push_back(path);
+	}
+
+	SetEvent(m_hQueueEvent);
+}
+
+bool TrigramIndex::IsReady(void) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	return m_IsReady;
+}
+
+size_t TrigramIndex::GetFileCount(void) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	return m_Files.size() - m_DeletedCount;
+}
+
+size_t TrigramIndex::GetTrigramCount(void) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	return m_Postings.size();
+}
+
+unsigned long long TrigramIndex::GetIndexedBytes(void) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	return m_IndexedBytes;
+}
+
+std::wstring TrigramIndex::GetRelativePath(const std::wstring& path) const
+{
+	if (path.length() > m_Folder.length() && path[m_Folder.length()] == L'\\' &&
+		FoldPath(path.substr(0, m_Folder.length())) == FoldPath(m_Folder))
+	{
+		return path.substr(m_Folder.length() + 1);
+	}
+
+	return std::wstring();
+}
+
+std::wstring TrigramIndex::GetIndexPath(void) const
+{
+	return m_Folder + L"\\" TRIGRAM_INDEX_DIRECTORY L"\\" TRIGRAM_INDEX_FILE;
+}
+
+/// <summary>
+/// Loads the saved index, then watches the folder while it brings the
+/// index up to date, so that nothing that changes in the meantime is
+/// missed. Changes are gathered until the folder has been quiet for a
+/// moment, editors write files in several steps.
+/// </summary>
+void TrigramIndex::Run(void)
+{
+	Load(m_Folder, GetIndexPath());
+
+	HANDLE hDirectory = CreateFile(m_Folder.c_str(),
+		                           FILE_LIST_DIRECTORY,
+		                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		                           nullptr,
+		                           OPEN_EXISTING,
+		                           FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		                           nullptr);
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+	// Notifications have to be DWORD aligned
+	std::vector<DWORD> buffer(TRIGRAM_INDEX_WATCH_BUFFER_SIZE / sizeof(DWORD));
+	const DWORD dwNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+		                         FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+	bool isWatching = hDirectory != INVALID_HANDLE_VALUE &&
+		              ReadDirectoryChangesW(hDirectory, buffer.data(), TRIGRAM_INDEX_WATCH_BUFFER_SIZE, TRUE,
+		                                    dwNotifyFilter, nullptr, &overlapped, nullptr);
+
+	Reconcile();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsReady = !m_IsStopping;
+	}
+
+	while (!m_IsStopping)
+	{
+		std::vector<HANDLE> handles = { m_hStopEvent, m_hQueueEvent };
+
+		if (isWatching)
+		{
+			handles.push_back(overlapped.hEvent);
+		}
+
+		DWORD dwTimeout = INFINITE;
+
+		// Only this thread changes the pending paths, the lock is for the searches that read them
+		if (!m_PendingPaths.empty() || m_NeedsReconcile)
+		{
+			dwTimeout = TRIGRAM_INDEX_SETTLE_TIME;
+		}
+
+		else if (m_IsDirty)
+		{
+			dwTimeout = TRIGRAM_INDEX_SAVE_DELAY;
+		}
+
+		const DWORD dwWait = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, dwTimeout);
+
+		if (dwWait == WAIT_OBJECT_0)
+		{
+			break;
+		}
+
+		if (dwWait == WAIT_OBJECT_0 + 1)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_PendingPaths.insert(m_QueuedPaths.begin(), m_QueuedPaths.end());
+			m_QueuedPaths.clear();
+		}
+
+		else if (dwWait == WAIT_OBJECT_0 + 2)
+		{
+			DWORD dwBytes = 0;
+
+			// Nothing was returned because more changed than the buffer could hold
+			if (!GetOverlappedResult(hDirectory, &overlapped, &dwBytes, FALSE) || dwBytes == 0)
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_NeedsReconcile = true;
+			}
+
+			else
+			{
+				const char* pNotification = reinterpret_cast<const char*>(buffer.data());
+				std::lock_guard<std::mutex> lock(m_Mutex);
+
+				for (;;)
+				{
+					const FILE_NOTIFY_INFORMATION* pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(pNotification);
+					const std::wstring relativePath(pInfo->FileName, pInfo->FileNameLength / sizeof(wchar_t));
+
+					if (!IsHiddenPath(relativePath))
+					{
+						m_PendingPaths.insert(m_Folder + L"\\" + relativePath);
+					}
+
+					if (pInfo->NextEntryOffset == 0)
+					{
+						break;
+					}
+
+					pNotification += pInfo->NextEntryOffset;
+				}
+			}
+
+			ResetEvent(overlapped.hEvent);
+			isWatching = ReadDirectoryChangesW(hDirectory, buffer.data(), TRIGRAM_INDEX_WATCH_BUFFER_SIZE, TRUE,
+				                               dwNotifyFilter, nullptr, &overlapped, nullptr) != FALSE;
+		}
+
+		else if (dwWait == WAIT_TIMEOUT)
+		{
+			if (m_NeedsReconcile)
+			{
+				Reconcile();
+			}
+
+			else if (!m_PendingPaths.empty())
+			{
+				Refresh(m_PendingPaths);
+			}
+
+			else if (m_IsDirty)
+			{
+				Save(GetIndexPath());
+			}
+
+			// Searches went on treating the paths as changed until the index had them
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_PendingPaths.clear();
+			m_NeedsReconcile = false;
+		}
+
+		else
+		{
+			break;
+		}
+	}
+
+	if (hDirectory != INVALID_HANDLE_VALUE)
+	{
+		if (isWatching)
+		{
+			CancelIoEx(hDirectory, &overlapped);
+
+			DWORD dwBytes = 0;
+			GetOverlappedResult(hDirectory, &overlapped, &dwBytes, TRUE);
+		}
+
+		CloseHandle(hDirectory);
+	}
+
+	CloseHandle(overlapped.hEvent);
+
+	if (m_IsDirty)
+	{
+		Save(GetIndexPath());
+	}
+}
+
+void TrigramIndex::ListFolder(const std::wstring& folder, std::vector<FileEntry>& entries)
+{
+	std::vector<std::wstring> directories(1, folder);
+
+	while (!directories.empty())
+	{
+		const std::wstring directory = std::move(directories.back());
+		directories.pop_back();
+
+		const std::wstring wildcard = directory + L"\\*";
+
+		WIN32_FIND_DATA find_data;
+		HANDLE hFind = FindFirstFileEx(wildcard.c_str(),
+			                           FindExInfoBasic,
+			                           &find_data,
+			                           FindExSearchNameMatch,
+			                           nullptr,
+			                           FIND_FIRST_EX_LARGE_FETCH);
+
+		if (hFind == INVALID_HANDLE_VALUE)
+		{
+			continue;
+		}
+
+		do {
+			if (!FileSearch::IsSearched(find_data))
+			{
+				continue;
+			}
+
+			std::wstring path = directory;
+			path += L'\\';
+			path += find_data.cFileName;
+
+			if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			{
+				directories.push_back(std::move(path));
+			}
+
+			else
+			{
+				FileEntry entry;
+				entry.path = std::move(path);
+				entry.size = (static_cast<unsigned long long>(find_data.nFileSizeHigh) << 32) | find_data.nFileSizeLow;
+				entry.writeTime = GetFileTime(find_data.ftLastWriteTime);
+
+				entries.push_back(std::move(entry));
+			}
+		} while (FindNextFile(hFind, &find_data));
+
+		FindClose(hFind);
+	}
+}
+
+void TrigramIndex::Reconcile(void)
+{
+	std::vector<FileEntry> entries;
+	ListFolder(m_Folder, entries);
+
+	std::vector<FileEntry> changed;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::vector<bool> isFound(m_Files.size(), false);
+
+		for (FileEntry& entry : entries)
+		{
+			const auto it = m_FileIds.find(FoldPath(GetRelativePath(entry.path)));
+
+			if (it != m_FileIds.end())
+			{
+				const IndexedFile& file = m_Files[it->second];
+				isFound[it->second] = true;
+
+				if (file.size == entry.size && file.writeTime == entry.writeTime)
+				{
+					continue;
+				}
+			}
+
+			changed.push_back(std::move(entry));
+		}
+
+		// The ones that changed are replaced when they are indexed
+		for (size_t id = 0; id < m_Files.size(); ++id)
+		{
+			if (!m_Files[id].isDeleted && !isFound[id])
+			{
+				m_FileIds.erase(FoldPath(m_Files[id].path));
+				m_Files[id].isDeleted = true;
+				++m_DeletedCount;
+				m_IsDirty = true;
+			}
+		}
+	}
+
+	IndexFiles(changed);
+}
+
+void TrigramIndex::Refresh(const std::unordered_set<std::wstring>& paths)
+{
+	std::vector<FileEntry> entries;
+
+	for (const std::wstring& path : paths)
+	{
+		const std::wstring relativePath = GetRelativePath(path);
+		WIN32_FILE_ATTRIBUTE_DATA data;
+
+		if (relativePath.empty() || IsHiddenPath(relativePath))
+		{
+			continue;
+		}
+
+		if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &data))
+		{
+			RemoveFile(relativePath);
+		}
+
+		// A folder that was created or renamed brings its files with it
+		else if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+			{
+				ListFolder(path, entries);
+			}
+		}
+
+		else
+		{
+			FileEntry entry;
+			entry.path = path;
+			entry.size = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+			entry.writeTime = GetFileTime(data.ftLastWriteTime);
+
+			entries.push_back(std::move(entry));
+		}
+	}
+
+	std::vector<FileEntry> changed;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		for (FileEntry& entry : entries)
+		{
+			const auto it = m_FileIds.find(FoldPath(GetRelativePath(entry.path)));
+
+			if (it == m_FileIds.end() || m_Files[it->second].size != entry.size || m_Files[it->second].writeTime != entry.writeTime)
+			{
+				changed.push_back(std::move(entry));
+			}
+		}
+	}
+
+	IndexFiles(changed);
+}
+
+void TrigramIndex::RemoveFile(const std::wstring& relativePath)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	const std::wstring folded = FoldPath(relativePath);
+	const std::wstring prefix = folded + L"\\";
+
+	for (auto it = m_FileIds.begin(); it != m_FileIds.end();)
+	{
+		if (it->first == folded || it->first.compare(0, prefix.length(), prefix) == 0)
+		{
+			m_Files[it->second].isDeleted = true;
+			++m_DeletedCount;
+			m_IsDirty = true;
+
+			it = m_FileIds.erase(it);
+		}
+
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void TrigramIndex::ExtractTrigrams(const std::wstring& text, std::vector<uint8_t>& seen, std::vector<uint64_t>& trigrams)
+{
+	trigrams.clear();
+
+	if (text.length() < 3)
+	{
+		return;
+	}
+
+	bool hasOtherTrigrams = false;
+	wchar_t a = TextSearch::FoldChar(text[0]);
+	wchar_t b = TextSearch::FoldChar(text[1]);
+
+	for (size_t i = 2; i < text.length(); ++i)
+	{
+		const wchar_t c = TextSearch::FoldChar(text[i]);
+
+		if (static_cast<uint32_t>(a | b | c) < 128)
+		{
+			const uint32_t bit = (static_cast<uint32_t>(a) << 14) | (static_cast<uint32_t>(b) << 7) | static_cast<uint32_t>(c);
+
+			if (!(seen[bit >> 3] & (1 << (bit & 7))))
+			{
+				seen[bit >> 3] |= static_cast<uint8_t>(1 << (bit & 7));
+				trigrams.push_back(MakeTrigram(a, b, c));
+			}
+		}
+
+		else
+		{
+			trigrams.push_back(MakeTrigram(a, b, c));
+			hasOtherTrigrams = true;
+		}
+
+		a = b;
+		b = c;
+	}
+
+	// Only the bits that were set are cleared, the bitmap is reused for the next file
+	for (uint64_t trigram : trigrams)
+	{
+		const uint32_t a16 = static_cast<uint32_t>(trigram >> 32);
+		const uint32_t b16 = static_cast<uint32_t>(trigram >> 16) & 0xFFFF;
+		const uint32_t c16 = static_cast<uint32_t>(trigram) & 0xFFFF;
+
+		if ((a16 | b16 | c16) < 128)
+		{
+			const uint32_t bit = (a16 << 14) | (b16 << 7) | c16;
+			seen[bit >> 3] = 0;
+		}
+	}
+
+	if (hasOtherTrigrams)
+	{
+		std::sort(trigrams.begin(), trigrams.end());
+		trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+	}
+}
+
+void TrigramIndex::AddPostings(PostingMap& postings, const std::vector<uint64_t>& trigrams, uint32_t id)
+{
+	for (uint64_t trigram : trigrams)
+	{
+		postings[trigram].Add(id);
+	}
+}
+
+/// <summary>
+/// Appends the lists of a block, whose ids all come after the ones in the
+/// index. Only the first id of each list has to be encoded again, as the
+/// difference from the last id of the list it's appended to.
+/// </summary>
+void TrigramIndex::MergePostings(PostingMap& postings)
+{
+	for (auto& entry : postings)
+	{
+		PostingList& source = entry.second;
+		PostingList& target = m_Postings[entry.first];
+
+		uint32_t first = 0;
+		uint32_t shift = 0;
+		size_t i = 0;
+
+		do {
+			first |= static_cast<uint32_t>(source.ids[i] & 0x7F) << shift;
+			shift += 7;
+		} while (source.ids[i++] & 0x80);
+
+		const uint32_t count = target.count;
+		target.Add(first);
+		target.ids.insert(target.ids.end(), source.ids.begin() + i, source.ids.end());
+		target.count = count + source.count;
+		target.next = source.next;
+	}
+}
+
+/// <summary>
+/// Indexes the files on up to one thread per processor. Each worker takes
+/// a block of files at a time and indexes it on its own, and the blocks
+/// are appended to the index in order as soon as the ones before them are.
+/// </summary>
+void TrigramIndex::IndexFiles(const std::vector<FileEntry>& entries)
+{
+	if (entries.empty())
+	{
+		return;
+	}
+
+	uint32_t firstId = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		firstId = static_cast<uint32_t>(m_Files.size());
+
+		for (const FileEntry& entry : entries)
+		{
+			IndexedFile file;
+			file.path = GetRelativePath(entry.path);
+			file.size = entry.size;
+			file.writeTime = entry.writeTime;
+
+			const std::wstring folded = FoldPath(file.path);
+			const auto it = m_FileIds.find(folded);
+
+			// Was indexed before, the old lists keep the old id
+			if (it != m_FileIds.end())
+			{
+				m_Files[it->second].isDeleted = true;
+				++m_DeletedCount;
+			}
+
+			m_FileIds[folded] = static_cast<uint32_t>(m_Files.size());
+			m_Files.push_back(std::move(file));
+		}
+
+		m_IsDirty = true;
+	}
+
+	const size_t blockCount = (entries.size() + TRIGRAM_INDEX_BLOCK_SIZE - 1) / TRIGRAM_INDEX_BLOCK_SIZE;
+
+	// Blocks that are done but wait for the ones before them
+	std::vector<std::unique_ptr<PostingMap>> blocks(blockCount);
+	std::atomic<size_t> nextBlock(0);
+	size_t mergedCount = 0;
+
+	auto work = [&]() {
+		std::vector<char> buffer;
+		std::wstring text;
+		Utf8Decoder decoder;
+		std::vector<uint8_t> seen(ASCII_TRIGRAM_COUNT / 8);
+		std::vector<uint64_t> trigrams;
+
+		size_t block = 0;
+
+		while ((block = nextBlock++) < blockCount && !m_IsStopping)
+		{
+			std::unique_ptr<PostingMap> pPostings(new PostingMap);
+			unsigned long long bytes = 0;
+
+			const size_t end = std::min(entries.size(), (block + 1) * TRIGRAM_INDEX_BLOCK_SIZE);
+
+			for (size_t i = block * TRIGRAM_INDEX_BLOCK_SIZE; i < end; ++i)
+			{
+				// Files that Find in Files wouldn't read are kept, so they aren't read again, but have no trigrams
+				if (FileSearch::ReadSourceFile(entries[i].path, buffer))
+				{
+					text.clear();
+					decoder.Reset();
+					decoder.Decode(buffer.data(), buffer.size(), text);
+					decoder.Finish(text);
+
+					ExtractTrigrams(text, seen, trigrams);
+					AddPostings(*pPostings, trigrams, firstId + static_cast<uint32_t>(i));
+
+					bytes += buffer.size();
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			blocks[block] = std::move(pPostings);
+			m_IndexedBytes += bytes;
+
+			while (mergedCount < blockCount && blocks[mergedCount] != nullptr)
+			{
+				MergePostings(*blocks[mergedCount]);
+				blocks[mergedCount].reset();
+				++mergedCount;
+			}
+		}
+	};
+
+	const size_t workerCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), blockCount);
+	std::vector<std::thread> workers;
+
+	for (size_t i = 1; i < workerCount; ++i)
+	{
+		workers.emplace_back(work);
+	}
+
+	work();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	// Stopped halfway, the files that weren't indexed get a stamp that makes the next reconcile index them
+	if (mergedCount < blockCount)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		for (size_t i = mergedCount * TRIGRAM_INDEX_BLOCK_SIZE; i < entries.size(); ++i)
+		{
+			m_Files[firstId + i].writeTime = 0;
+		}
+	}
+}
+
+/* Drops the deleted files and numbers the others again from 0 */
+void TrigramIndex::Compact(void)
+{
+	std::vector<uint32_t> newIds(m_Files.size(), UINT32_MAX);
+	std::vector<IndexedFile> files;
+	files.reserve(m_Files.size() - m_DeletedCount);
+
+	for (size_t id = 0; id < m_Files.size(); ++id)
+	{
+		if (!m_Files[id].isDeleted)
+		{
+			newIds[id] = static_cast<uint32_t>(files.size());
+			files.push_back(std::move(m_Files[id]));
+		}
+	}
+
+	std::vector<uint32_t> ids;
+
+	for (auto it = m_Postings.begin(); it != m_Postings.end();)
+	{
+		it->second.Decode(ids);
+		it->second = PostingList();
+
+		for (uint32_t id : ids)
+		{
+			if (newIds[id] != UINT32_MAX)
+			{
+				it->second.Add(newIds[id]);
+			}
+		}
+
+		it = it->second.count == 0 ? m_Postings.erase(it) : std::next(it);
+	}
+
+	m_Files = std::move(files);
+	m_DeletedCount = 0;
+	m_FileIds.clear();
+
+	for (size_t id = 0; id < m_Files.size(); ++id)
+	{
+		m_FileIds[FoldPath(m_Files[id].path)] = static_cast<uint32_t>(id);
+	}
+}
+
+bool TrigramIndex::FindCandidates(const std::wstring& text, std::vector<std::wstring>& paths) const
+{
+	paths.clear();
+
+	std::vector<uint64_t> trigrams;
+
+	for (size_t i = 0; i + 3 <= text.length(); ++i)
+	{
+		if (!IsLineBreak(text[i]) && !IsLineBreak(text[i + 1]) && !IsLineBreak(text[i + 2]))
+		{
+			trigrams.push_back(MakeTrigram(TextSearch::FoldChar(text[i]), TextSearch::FoldChar(text[i + 1]), TextSearch::FoldChar(text[i + 2])));
+		}
+	}
+
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	// Files the index may be wrong about, looked at once the lock is released
+	std::vector<std::wstring> changedPaths;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (!m_IsReady || m_NeedsReconcile || trigrams.empty())
+		{
+			return false;
+		}
+
+		std::vector<const PostingList*> lists;
+		bool isTrigramMissing = false;
+
+		for (uint64_t trigram : trigrams)
+		{
+			const auto it = m_Postings.find(trigram);
+
+			// No file has it, so none can match
+			if (it == m_Postings.end())
+			{
+				isTrigramMissing = true;
+				break;
+			}
+
+			lists.push_back(&it->second);
+		}
+
+		std::vector<uint32_t> candidates;
+
+		if (!isTrigramMissing)
+		{
+			// The shortest list first, the others can only make it shorter
+			std::sort(lists.begin(), lists.end(), [](const PostingList* pA, const PostingList* pB) { return pA->count < pB->count; });
+
+			std::vector<uint32_t> ids;
+			std::vector<uint32_t> intersection;
+
+			lists[0]->Decode(candidates);
+
+			for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+			{
+				lists[i]->Decode(ids);
+
+				intersection.clear();
+				std::set_intersection(candidates.begin(), candidates.end(), ids.begin(), ids.end(), std::back_inserter(intersection));
+				candidates.swap(intersection);
+			}
+
+			for (uint32_t id : candidates)
+			{
+				if (!m_Files[id].isDeleted)
+				{
+					paths.push_back(m_Folder + L"\\" + m_Files[id].path);
+				}
+			}
+		}
+
+		changedPaths.assign(m_PendingPaths.begin(), m_PendingPaths.end());
+		changedPaths.insert(changedPaths.end(), m_QueuedPaths.begin(), m_QueuedPaths.end());
+
+		// Already a candidate
+		changedPaths.erase(std::remove_if(changedPaths.begin(), changedPaths.end(), [&](const std::wstring& path) {
+			const std::wstring relativePath = GetRelativePath(path);
+
+			if (relativePath.empty() || IsHiddenPath(relativePath))
+			{
+				return true;
+			}
+
+			const auto it = m_FileIds.find(FoldPath(relativePath));
+
+			return it != m_FileIds.end() && std::binary_search(candidates.begin(), candidates.end(), it->second);
+		}), changedPaths.end());
+	}
+
+	std::sort(changedPaths.begin(), changedPaths.end());
+	changedPaths.erase(std::unique(changedPaths.begin(), changedPaths.end()), changedPaths.end());
+
+	for (const std::wstring& path : changedPaths)
+	{
+		const DWORD dwAttributes = GetFileAttributes(path.c_str());
+
+		// Deleted since, there's nothing to search
+		if (dwAttributes == INVALID_FILE_ATTRIBUTES)
+		{
+			continue;
+		}
+
+		// Which of its files changed isn't known
+		if (dwAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			paths.clear();
+			return false;
+		}
+
+		paths.push_back(path);
+	}
+
+	return true;
+}
+
+bool TrigramIndex::Save(const std::wstring& path)
+{
+	IndexHeader header;
+	std::vector<IndexedFile> files;
+	std::vector<std::pair<uint64_t, PostingList>> postings;
+
+	// Copied under the lock and written out without it, searches don't wait for the serialization
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// The lists only grow otherwise
+		if (m_DeletedCount * 4 > m_Files.size())
+		{
+			Compact();
+		}
+
+		header.magic = TRIGRAM_INDEX_MAGIC;
+		header.version = TRIGRAM_INDEX_FORMAT_VERSION;
+		header.charSize = sizeof(wchar_t);
+		header.fileCount = static_cast<uint32_t>(m_Files.size());
+		header.trigramCount = m_Postings.size();
+		header.indexedBytes = m_IndexedBytes;
+
+		files = m_Files;
+		postings.assign(m_Postings.begin(), m_Postings.end());
+
+		m_IsDirty = false;
+	}
+
+	// The header goes first once the checksum of the rest is known
+	std::vector<char> data(sizeof(header));
+
+	for (const IndexedFile& file : files)
+	{
+		IndexFileRecord record;
+		record.size = file.size;
+		record.writeTime = file.writeTime;
+		record.isDeleted = file.isDeleted ? 1 : 0;
+		record.pathLength = static_cast<uint32_t>(file.path.length());
+
+		AppendRecord(data, record);
+
+		const char* pPath = reinterpret_cast<const char*>(file.path.data());
+		data.insert(data.end(), pPath, pPath + file.path.length() * sizeof(wchar_t));
+	}
+
+	// Sorted, so that the same index is always saved the same way
+	std::sort(postings.begin(), postings.end(), [](const std::pair<uint64_t, PostingList>& a, const std::pair<uint64_t, PostingList>& b) {
+		return a.first < b.first;
+	});
+
+	for (const auto& entry : postings)
+	{
+		const PostingList& list = entry.second;
+
+		IndexTrigramRecord record;
+		record.trigram = entry.first;
+		record.count = list.count;
+		record.next = list.next;
+		record.byteCount = list.ids.size();
+
+		AppendRecord(data, record);
+		data.insert(data.end(), list.ids.begin(), list.ids.end());
+	}
+
+	header.checksum = Hash::Fnv1a64(data.data() + sizeof(header), data.size() - sizeof(header));
+	memcpy(data.data(), &header, sizeof(header));
+
+	const size_t separator = path.find_last_of(L'\\');
+
+	if (separator != std::wstring::npos)
+	{
+		const std::wstring directory = path.substr(0, separator);
+
+		if (CreateDirectory(directory.c_str(), nullptr))
+		{
+			SetFileAttributes(directory.c_str(), FILE_ATTRIBUTE_HIDDEN);
+		}
+	}
+
+	// Written next to it first, so that a crash never leaves half an index behind
+	const std::wstring temporaryPath = path + L".tmp";
+	const HANDLE hFile = CreateFile(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	bool succeeded = true;
+	size_t position = 0;
+
+	while (succeeded && position < data.size())
+	{
+		const DWORD dwChunk = static_cast<DWORD>(std::min<size_t>(data.size() - position, IO_CHUNK_SIZE));
+		DWORD dwWritten = 0;
+
+		succeeded = WriteFile(hFile, data.data() + position, dwChunk, &dwWritten, nullptr) && dwWritten == dwChunk;
+		position += dwWritten;
+	}
+
+	CloseHandle(hFile);
+
+	succeeded = succeeded && MoveFileEx(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+
+	if (!succeeded)
+	{
+		DeleteFile(temporaryPath.c_str());
+	}
+
+	return succeeded;
+}
+
+bool TrigramIndex::Load(const std::wstring& folder, const std::wstring& path)
+{
+	const HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	std::vector<char> data;
+	LARGE_INTEGER liSize;
+	bool succeeded = GetFileSizeEx(hFile, &liSize) != FALSE;
+
+	if (succeeded)
+	{
+		data.resize(static_cast<size_t>(liSize.QuadPart));
+
+		size_t position = 0;
+		DWORD dwRead = 0;
+
+		while (position < data.size() &&
+			   ReadFile(hFile, data.data() + position, static_cast<DWORD>(std::min<size_t>(data.size() - position, IO_CHUNK_SIZE)), &dwRead, nullptr) &&
+			   dwRead > 0)
+		{
+			position += dwRead;
+		}
+
+		succeeded = position == data.size();
+	}
+
+	CloseHandle(hFile);
+
+	IndexReader reader(data);
+	IndexHeader header;
+
+	if (!succeeded || !reader.Read(&header, sizeof(header)) ||
+		header.magic != TRIGRAM_INDEX_MAGIC || header.version != TRIGRAM_INDEX_FORMAT_VERSION || header.charSize != sizeof(wchar_t) ||
+		header.checksum != Hash::Fnv1a64(data.data() + sizeof(header), data.size() - sizeof(header)))
+	{
+		return false;
+	}
+
+	// Every count is checked against the bytes left before anything is allocated for it
+	if (header.fileCount > reader.GetRemaining() / sizeof(IndexFileRecord))
+	{
+		return false;
+	}
+
+	std::vector<IndexedFile> files(header.fileCount);
+	std::unordered_map<std::wstring, uint32_t> fileIds;
+	size_t deletedCount = 0;
+
+	for (size_t id = 0; id < files.size(); ++id)
+	{
+		IndexFileRecord record;
+
+		if (!reader.Read(&record, sizeof(record)) || record.pathLength > reader.GetRemaining() / sizeof(wchar_t))
+		{
+			return false;
+		}
+
+		IndexedFile& file = files[id];
+		file.size = record.size;
+		file.writeTime = record.writeTime;
+		file.isDeleted = record.isDeleted != 0;
+		file.path.resize(record.pathLength);
+
+		if (!reader.Read(&file.path[0], record.pathLength * sizeof(wchar_t)))
+		{
+			return false;
+		}
+
+		if (file.isDeleted)
+		{
+			++deletedCount;
+		}
+
+		else
+		{
+			fileIds[FoldPath(file.path)] = static_cast<uint32_t>(id);
+		}
+	}
+
+	if (header.trigramCount > reader.GetRemaining() / sizeof(IndexTrigramRecord))
+	{
+		return false;
+	}
+
+	PostingMap postings;
+	postings.reserve(static_cast<size_t>(header.trigramCount));
+
+	for (uint64_t i = 0; i < header.trigramCount; ++i)
+	{
+		IndexTrigramRecord record;
+
+		if (!reader.Read(&record, sizeof(record)) || record.byteCount > reader.GetRemaining())
+		{
+			return false;
+		}
+
+		PostingList& list = postings[record.trigram];
+		list.count = record.count;
+		list.next = record.next;
+		list.ids.resize(static_cast<size_t>(record.byteCount));
+
+		if (!reader.Read(list.ids.data(), list.ids.size()) || !list.IsValid(header.fileCount))
+		{
+			return false;
+		}
+	}
+
+	if (!reader.IsAtEnd())
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	m_Folder = folder;
+	m_Files = std::move(files);
+	m_FileIds = std::move(fileIds);
+	m_Postings = std::move(postings);
+	m_DeletedCount = deletedCount;
+	m_IndexedBytes = header.indexedBytes;
+	m_IsDirty = false;
+
+	return true;
+}
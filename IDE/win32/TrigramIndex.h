@@ -0,0 +1,187 @@
+#pragma once
+
+#include "Window.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Kept in the project folder, which the explorer and Find in Files don't show since it starts with a dot
+#define TRIGRAM_INDEX_DIRECTORY L".ide"
+#define TRIGRAM_INDEX_FILE L"trigrams.idx"
+
+#define TRIGRAM_INDEX_MAGIC 0x58495449 // "ITIX"
+#define TRIGRAM_INDEX_FORMAT_VERSION 2
+
+// Changes to the files are indexed once nothing has changed for this many milliseconds
+#define TRIGRAM_INDEX_SETTLE_TIME 200
+
+// And the index is saved once nothing has changed for this long
+#define TRIGRAM_INDEX_SAVE_DELAY 5000
+
+// Files indexed by a worker at a time, the lists of a block are appended to the index in one go
+#define TRIGRAM_INDEX_BLOCK_SIZE 256
+
+// Bytes of change notifications that can pile up between two reads
+#define TRIGRAM_INDEX_WATCH_BUFFER_SIZE (64 * 1024)
+
+/// <summary>
+/// Which files of a project contain each sequence of three characters,
+/// so that a search only has to read the files that have all the
+/// trigrams of the text it looks for. Characters are folded the way a
+/// search that ignores case folds them, so the same index serves searches
+/// that match case and searches that don't, and every file it returns
+/// still has to be searched to be sure.
+/// Each list of files is sorted and stored as the differences between
+/// consecutive file ids, one to five bytes each. A file that changes is
+/// removed by marking its id as deleted and indexed again under a new id,
+/// so lists are only ever appended to. The deleted ids are dropped when
+/// there are many of them.
+/// The index is built, saved and loaded on a background thread, which
+/// then watches the folder with ReadDirectoryChangesW and indexes the
+/// files that change. Searches use it only once it is up to date with
+/// the folder, until then they read every file.
+/// </summary>
+class TrigramIndex
+{
+private:
+	/* Files that contain a trigram, as differences between ascending ids */
+	struct PostingList {
+		std::vector<uint8_t> ids;
+		uint32_t count = 0;
+
+		// The smallest id that can be added next
+		uint32_t next = 0;
+
+		void Add(uint32_t id);
+		void Decode(std::vector<uint32_t>& out) const;
+
+		/* Whether the bytes decode to exactly 'count' ascending ids that end at next - 1, with next <= fileCount */
+		bool IsValid(uint32_t fileCount) const;
+	};
+
+	typedef std::unordered_map<uint64_t, PostingList> PostingMap;
+
+	struct IndexedFile {
+		// Relative to the folder
+		std::wstring path;
+		unsigned long long size = 0;
+		unsigned long long writeTime = 0;
+		bool isDeleted = false;
+	};
+
+	/* A file that was found in the folder, or that changed */
+	struct FileEntry {
+		std::wstring path;
+		unsigned long long size = 0;
+		unsigned long long writeTime = 0;
+	};
+
+	std::wstring m_Folder;
+
+	// Guards everything below, the background thread holds it only to change or save the index
+	mutable std::mutex m_Mutex;
+
+	std::vector<IndexedFile> m_Files;
+	size_t m_DeletedCount = 0;
+
+	// Folded relative path of each file that isn't deleted, to its id
+	std::unordered_map<std::wstring, uint32_t> m_FileIds;
+
+	PostingMap m_Postings;
+	unsigned long long m_IndexedBytes = 0;
+
+	bool m_IsReady = false;
+	bool m_IsDirty = false;
+
+	// Paths that were saved from a tab, indexed by the background thread
+	std::vector<std::wstring> m_QueuedPaths;
+
+	// Paths that changed and haven't been indexed again yet, and whether more changed
+	// than the notifications could tell. Only the background thread changes them
+	std::unordered_set<std::wstring> m_PendingPaths;
+	bool m_NeedsReconcile = false;
+
+	std::thread m_Thread;
+	std::atomic<bool> m_IsStopping;
+	HANDLE m_hStopEvent = nullptr;
+	HANDLE m_hQueueEvent = nullptr;
+
+	void Run(void);
+
+	/* Compares the folder with the index and indexes what changed, in parallel */
+	void Reconcile(void);
+
+	/* Indexes files that changed, or removes them if they don't exist anymore */
+	void Refresh(const std::unordered_set<std::wstring>& paths);
+
+	void IndexFiles(const std::vector<FileEntry>& entries);
+	void MergePostings(PostingMap& postings);
+
+	/* Removes the file, or every file in it if it's a folder */
+	void RemoveFile(const std::wstring& relativePath);
+	void Compact(void);
+
+	std::wstring GetRelativePath(const std::wstring& path) const;
+	std::wstring GetIndexPath(void) const;
+
+	static void ListFolder(const std::wstring& folder, std::vector<FileEntry>& entries);
+	static void ExtractTrigrams(const std::wstring& text, std::vector<uint8_t>& seen, std::vector<uint64_t>& trigrams);
+	static void AddPostings(PostingMap& postings, const std::vector<uint64_t>& trigrams, uint32_t id);
+
+public:
+	TrigramIndex(void);
+
+	/* Stops watching and saves the index */
+	~TrigramIndex(void);
+
+	TrigramIndex(const TrigramIndex&) = delete;
+	TrigramIndex& operator=(const TrigramIndex&) = delete;
+
+	/// <summary>
+	/// Loads the saved index of the folder and brings it up to date on a
+	/// background thread, then keeps it up to date. Closes the index of
+	/// the previous folder first.
+	/// </summary>
+	void Open(const std::wstring& folder);
+	void Close(void);
+
+	/// <summary>
+	/// Builds the index of the folder from scratch and waits for it,
+	/// without saving or watching anything. Used by the benchmark.
+	/// </summary>
+	void Build(const std::wstring& folder);
+
+	/* Indexes the file again soon, e.g. after it was saved */
+	void Update(const std::wstring& path);
+
+	/* Whether the index has caught up with the folder */
+	bool IsReady(void) const;
+
+	/// <summary>
+	/// Finds the files that have every trigram of the text. Trigrams that
+	/// span a line break are left out, the text of a regular expression
+	/// can't say which line break a file has. Files that changed and
+	/// haven't been indexed again yet are always candidates.
+	/// </summary>
+	/// <param name="paths"> Receives the absolute paths of the files </param>
+	/// <returns> False if the index can't narrow down the files: it isn't
+	/// ready, the text is shorter than a trigram, or a folder changed or
+	/// too much changed at once and the files that changed aren't known </returns>
+	bool FindCandidates(const std::wstring& text, std::vector<std::wstring>& paths) const;
+
+	/* Replaces the file, writing it next to it first. Searches only wait for the index to be copied */
+	bool Save(const std::wstring& path);
+
+	/* Replaces the index with the one saved for the folder */
+	bool Load(const std::wstring& folder, const std::wstring& path);
+
+	size_t GetFileCount(void) const;
+	size_t GetTrigramCount(void) const;
+	unsigned long long GetIndexedBytes(void) const;
+};
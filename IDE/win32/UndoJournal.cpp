@@ -0,0 +1,248 @@
+#include "UndoJournal.h"
+
+#include <cwctype>
+
+static inline bool IsWordCharacter(wchar_t ch)
+{
+	return std::iswalnum(ch) || ch == L'_';
+}
+
+static inline bool IsSingleInsertion(const TextEdit& edit)
+{
+	return edit.removed.empty() && edit.inserted.length() == 1;
+}
+
+static inline bool IsSingleDeletion(const TextEdit& edit)
+{
+	return edit.inserted.empty() && edit.removed.length() == 1;
+}
+
+size_t UndoJournal::GetMemoryUsage(const TextEdit& edit)
+{
+	return sizeof(TextEdit) + (edit.removed.capacity() + edit.inserted.capacity()) * sizeof(wchar_t);
+}
+
+size_t UndoJournal::GetMemoryUsage(const Transaction& transaction)
+{
+	size_t usage = sizeof(Transaction);
+
+	for (const TextEdit& edit : transaction.edits)
+	{
+		usage += GetMemoryUsage(edit);
+	}
+
+	return usage;
+}
+
+/// <summary>
+/// Merges a typed character (or one removed with backspace/delete) into the
+/// last transaction if it continues it. Typing a word character after a
+/// space or a line break starts a new transaction so undo goes word by word.
+/// </summary>
+bool UndoJournal::TryCoalesce(const TextEdit& edit)
+{
+	if (!m_CanCoalesce || m_UndoStack.empty() || !m_UndoStack.back().isTyping)
+	{
+		return false;
+	}
+
+	TextEdit& last = m_UndoStack.back().edits.back();
+
+	m_MemoryUsage -= GetMemoryUsage(last);
+
+	bool merged = false;
+
+	if (IsSingleInsertion(edit) && last.removed.empty() &&
+		edit.position == last.position + last.inserted.length())
+	{
+		const bool startsNewWord = IsWordCharacter(edit.inserted[0]) && !IsWordCharacter(last.inserted.back());
+
+		if (!startsNewWord)
+		{
+			last.inserted += edit.inserted;
+			merged = true;
+		}
+	}
+
+	else if (IsSingleDeletion(edit) && last.inserted.empty())
+	{
+		// Backspace
+		if (edit.position + 1 == last.position)
+		{
+			last.removed.insert(0, edit.removed);
+			last.position = edit.position;
+			merged = true;
+		}
+
+		// Delete
+		else if (edit.position == last.position)
+		{
+			last.removed += edit.removed;
+			merged = true;
+		}
+	}
+
+	m_MemoryUsage += GetMemoryUsage(last);
+
+	return merged;
+}
+
+void UndoJournal::OnDocumentEdit(const TextEdit& edit)
+{
+	if (!m_IsRecording)
+	{
+		return;
+	}
+
+	ClearRedoStack();
+
+	if (m_GroupDepth > 0)
+	{
+		m_UndoStack.back().edits.push_back(edit);
+		m_MemoryUsage += GetMemoryUsage(edit);
+		EnforceMemoryBudget();
+		return;
+	}
+
+	const bool isTyping = IsSingleInsertion(edit) || IsSingleDeletion(edit);
+
+	if (!isTyping || !TryCoalesce(edit))
+	{
+		Transaction transaction;
+		transaction.isTyping = isTyping;
+		transaction.edits.push_back(edit);
+
+		m_MemoryUsage += GetMemoryUsage(transaction);
+		m_UndoStack.push_back(std::move(transaction));
+	}
+
+	m_CanCoalesce = isTyping;
+
+	EnforceMemoryBudget();
+}
+
+void UndoJournal::OnDocumentLoad(const PieceTable&)
+{
+	Clear();
+}
+
+void UndoJournal::ClearRedoStack(void)
+{
+	for (const Transaction& transaction : m_RedoStack)
+	{
+		m_MemoryUsage -= GetMemoryUsage(transaction);
+	}
+
+	m_RedoStack.clear();
+}
+
+/// <summary>
+/// Throws away the steps furthest from the current text until the history
+/// fits in the budget: the oldest undo steps first, then the redo steps
+/// that would be redone last. The transaction next to the current text is
+/// always kept, even if it's bigger than the budget.
+/// </summary>
+void UndoJournal::EnforceMemoryBudget(void)
+{
+	while (m_MemoryUsage > m_MemoryBudget && m_UndoStack.size() > 1)
+	{
+		m_MemoryUsage -= GetMemoryUsage(m_UndoStack.front());
+		m_UndoStack.pop_front();
+	}
+
+	// The front of the redo stack was undone first, so it's the furthest step ahead
+	while (m_MemoryUsage > m_MemoryBudget && m_RedoStack.size() > (m_UndoStack.empty() ? 1U : 0U))
+	{
+		m_MemoryUsage -= GetMemoryUsage(m_RedoStack.front());
+		m_RedoStack.pop_front();
+	}
+}
+
+void UndoJournal::SetMemoryBudget(size_t bytes)
+{
+	m_MemoryBudget = bytes;
+	EnforceMemoryBudget();
+}
+
+void UndoJournal::BeginGroup(void)
+{
+	if (m_GroupDepth++ == 0)
+	{
+		ClearRedoStack();
+
+		Transaction transaction;
+		m_MemoryUsage += GetMemoryUsage(transaction);
+		m_UndoStack.push_back(std::move(transaction));
+	}
+
+	m_CanCoalesce = false;
+}
+
+void UndoJournal::EndGroup(void)
+{
+	if (m_GroupDepth > 0 && --m_GroupDepth == 0)
+	{
+		// Nothing was edited, don't leave an empty step behind
+		if (m_UndoStack.back().edits.empty())
+		{
+			m_MemoryUsage -= GetMemoryUsage(m_UndoStack.back());
+			m_UndoStack.pop_back();
+		}
+
+		EnforceMemoryBudget();
+	}
+}
+
+bool UndoJournal::Undo(std::vector<TextEdit>& edits)
+{
+	edits.clear();
+
+	if (m_UndoStack.empty() || m_GroupDepth > 0)
+	{
+		return false;
+	}
+
+	const Transaction& transaction = m_UndoStack.back();
+
+	for (auto it = transaction.edits.rbegin(); it != transaction.edits.rend(); ++it)
+	{
+		TextEdit inverse;
+		inverse.position = it->position;
+		inverse.removed = it->inserted;
+		inverse.inserted = it->removed;
+		edits.push_back(std::move(inverse));
+	}
+
+	m_RedoStack.push_back(std::move(m_UndoStack.back()));
+	m_UndoStack.pop_back();
+	m_CanCoalesce = false;
+
+	return true;
+}
+
+bool UndoJournal::Redo(std::vector<TextEdit>& edits)
+{
+	edits.clear();
+
+	if (m_RedoStack.empty() || m_GroupDepth > 0)
+	{
+		return false;
+	}
+
+	edits = m_RedoStack.back().edits;
+
+	m_UndoStack.push_back(std::move(m_RedoStack.back()));
+	m_RedoStack.pop_back();
+	m_CanCoalesce = false;
+
+	return true;
+}
+
+void UndoJournal::Clear(void)
+{
+	m_UndoStack.clear();
+	m_RedoStack.clear();
+	m_MemoryUsage = 0;
+	m_GroupDepth = 0;
+	m_CanCoalesce = false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "PieceTable.h"
+
+#include <deque>
+#include <vector>
+
+#define DEFAULT_UNDO_MEMORY_BUDGET (64 * 1024 * 1024)
+
+/// <summary>
+/// Undo/redo history of a document. Every edit of the document is recorded
+/// together with the text it removed, so undoing or redoing only costs as
+/// much as the edit itself. Characters typed one after the other are merged
+/// into word sized transactions and edits made between BeginGroup/EndGroup
+/// are undone as one step. When the history takes up more memory than the
+/// budget allows, the oldest transactions are thrown away first, then the
+/// redo steps furthest ahead.
+/// </summary>
+class UndoJournal : public DocumentListener
+{
+private:
+	struct Transaction {
+		std::vector<TextEdit> edits;
+		bool isTyping = false;
+	};
+
+	std::deque<Transaction> m_UndoStack;
+	std::deque<Transaction> m_RedoStack;
+
+	size_t m_MemoryBudget = DEFAULT_UNDO_MEMORY_BUDGET;
+	size_t m_MemoryUsage = 0;
+	int m_GroupDepth = 0;
+	bool m_IsRecording = true;
+	bool m_CanCoalesce = false;
+
+	static size_t GetMemoryUsage(const TextEdit& edit);
+	static size_t GetMemoryUsage(const Transaction& transaction);
+
+	bool TryCoalesce(const TextEdit& edit);
+	void ClearRedoStack(void);
+	void EnforceMemoryBudget(void);
+
+public:
+	void OnDocumentEdit(const TextEdit& edit) override;
+	void OnDocumentLoad(const PieceTable& document) override;
+
+	void SetMemoryBudget(size_t bytes);
+	size_t GetMemoryUsage(void) const { return m_MemoryUsage; }
+
+	/* Everything edited until the matching EndGroup is undone in one step */
+	void BeginGroup(void);
+	void EndGroup(void);
+
+	/* The next typed character starts a new transaction */
+	void BreakCoalescing(void) { m_CanCoalesce = false; }
+
+	/* Edits aren't recorded while the history itself is being replayed */
+	void SetRecording(bool isRecording) { m_IsRecording = isRecording; }
+
+	bool CanUndo(void) const { return !m_UndoStack.empty(); }
+	bool CanRedo(void) const { return !m_RedoStack.empty(); }
+
+	/// <summary>
+	/// Moves the last transaction to the redo stack and fills 'edits' with
+	/// the replacements that have to be applied, in order, to revert it
+	/// </summary>
+	bool Undo(std::vector<TextEdit>& edits);
+
+	/* Same as Undo but for the transaction that was undone last */
+	bool Redo(std::vector<TextEdit>& edits);
+
+	void Clear(void);
+};
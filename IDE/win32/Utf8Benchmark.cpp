@@ -0,0 +1,297 @@
+// std::codecvt_utf8 is what is being measured against, it's deprecated since C++17
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+
+#include "Utf8Benchmark.h"
+#include "Benchmark.h"
+#include "Utf8Decoder.h"
+#include "Utf8Encoder.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <cstdio>
+#include <fstream>
+#include <locale>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Characters of each generated corpus, before it's encoded
+#define UTF8_BENCHMARK_CORPUS_SIZE (16 * 1024 * 1024)
+
+// A corpus is decoded at least this many times and for at least this long
+#define UTF8_BENCHMARK_MIN_PASSES 3
+#define UTF8_BENCHMARK_MIN_DURATION_MS 1000
+
+// Bytes read from the file at a time, the same as a tab reads
+#define UTF8_BENCHMARK_CHUNK_SIZE 65536
+
+// One byte in this many of the invalid corpus is replaced with 0xFF
+#define UTF8_BENCHMARK_INVALID_BYTE_INTERVAL 4096
+
+/* What decoding a corpus cost one of the decoders */
+struct DecodeResult {
+	size_t characterCount = 0;
+	bool hasSucceeded = true;
+	double megabytesPerSecond = 0;
+	double fileMilliseconds = 0;
+};
+
+static const wchar_t* g_Statements[] = {
+	L"\tconst size_t length = std::min(text.length(), m_Buffer.size());\n",
+	L"\tif (pSourceEdit == nullptr || !pSourceEdit->HasBeenEdited())\n\t{\n\t\treturn false;\n\t}\n",
+	L"#include \"Utf8Decoder.h\"\n",
+	L"\tLogger::Write(L\"Failed to open %ls\", lpszPath);\n",
+	L"\n"
+};
+
+// Comments and strings, in Greek, Russian, Chinese and Japanese
+static const wchar_t* g_Phrases[] = {
+	L"\t// \u0391\u03BD\u03BF\u03AF\u03B3\u03B5\u03B9 \u03C4\u03BF \u03B1\u03C1\u03C7\u03B5\u03AF\u03BF \u03BA\u03B1\u03B9 \u03B4\u03B9\u03B1\u03B2\u03AC\u03B6\u03B5\u03B9 \u03C4\u03BF \u03BA\u03B5\u03AF\u03BC\u03B5\u03BD\u03BF\n",
+	L"\t// \u041E\u0442\u043A\u0440\u044B\u0432\u0430\u0435\u0442 \u0444\u0430\u0439\u043B \u0438 \u0447\u0438\u0442\u0430\u0435\u0442 \u0442\u0435\u043A\u0441\u0442\n",
+	L"\tMessageBox(hWnd, L\"\u6587\u4EF6\u65E0\u6CD5\u6253\u5F00\", L\"\u9519\u8BEF\", MB_OK);\n",
+	L"\t/* \u30D5\u30A1\u30A4\u30EB\u3092\u958B\u3044\u3066\u30C6\u30AD\u30B9\u30C8\u3092\u8AAD\u307F\u8FBC\u3080 */\n"
+};
+
+/* Generated text, encoded as UTF-8 */
+struct Corpus {
+	const char* lpszName;
+	std::string bytes;
+};
+
+static std::string GenerateSource(bool isMultilingual)
+{
+	std::mt19937 random(0x5538);
+	std::wstring text;
+
+	while (text.length() < UTF8_BENCHMARK_CORPUS_SIZE)
+	{
+		if (isMultilingual && random() % 2 == 0)
+		{
+			text += g_Phrases[random() % (sizeof(g_Phrases) / sizeof(g_Phrases[0]))];
+		}
+
+		else
+		{
+			text += g_Statements[random() % (sizeof(g_Statements) / sizeof(g_Statements[0]))];
+		}
+	}
+
+	std::string bytes;
+	Utf8Encoder encoder;
+
+	encoder.Encode(text.data(), text.length(), bytes);
+	encoder.Finish(bytes);
+
+	return bytes;
+}
+
+/* Decodes the bytes until it has run long enough, in megabytes per second */
+template <typename Function>
+static double MeasureThroughput(size_t byteCount, Function decode)
+{
+	size_t passCount = 0;
+
+	const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+	Benchmark::Clock::duration elapsed;
+
+	do
+	{
+		decode();
+
+		++passCount;
+		elapsed = Benchmark::Clock::now() - start;
+	} while (passCount < UTF8_BENCHMARK_MIN_PASSES || elapsed < std::chrono::milliseconds(UTF8_BENCHMARK_MIN_DURATION_MS));
+
+	return byteCount * static_cast<double>(passCount) / BYTES_PER_MEGABYTE / (Benchmark::GetMilliseconds(elapsed) / 1000.0);
+}
+
+/* Decodes the whole buffer in one call to the facet, as fast as codecvt can go */
+static bool DecodeWithCodecvt(const std::string& bytes, std::wstring& text)
+{
+	const std::codecvt_utf8<wchar_t> converter;
+	std::mbstate_t state = std::mbstate_t();
+
+	// Never more characters than bytes
+	text.resize(bytes.size());
+
+	const char* pNext = nullptr;
+	wchar_t* pNextOut = nullptr;
+
+	const std::codecvt_base::result result = converter.in(state,
+		                                                  bytes.data(),
+		                                                  bytes.data() + bytes.size(),
+		                                                  pNext,
+		                                                  &text[0],
+		                                                  &text[0] + text.size(),
+		                                                  pNextOut);
+
+	text.resize(static_cast<size_t>(pNextOut - text.data()));
+
+	return result == std::codecvt_base::ok;
+}
+
+/* The way files were opened before */
+static size_t ReadWithCodecvt(const wchar_t* lpszPath)
+{
+	std::wifstream file(lpszPath);
+	file.imbue(std::locale(std::locale::empty(), new std::codecvt_utf8<wchar_t>));
+
+	std::wstringstream buffer;
+	buffer << file.rdbuf();
+
+	return buffer.str().length();
+}
+
+/* The way a tab reads its file */
+static size_t ReadWithDecoder(const wchar_t* lpszPath)
+{
+	std::ifstream file(lpszPath, std::ios::binary);
+	std::vector<char> buffer(UTF8_BENCHMARK_CHUNK_SIZE);
+	std::wstring text;
+	Utf8Decoder decoder;
+
+	while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+	{
+		decoder.Decode(buffer.data(), static_cast<size_t>(file.gcount()), text);
+	}
+
+	decoder.Finish(text);
+
+	return text.length();
+}
+
+static bool WriteCorpusFile(const std::string& bytes)
+{
+	FILE* pFile = nullptr;
+
+	if (_wfopen_s(&pFile, UTF8_BENCHMARK_CORPUS_FILE, L"wb") != 0 || pFile == nullptr)
+	{
+		return false;
+	}
+
+	const bool hasSucceeded = fwrite(bytes.data(), 1, bytes.size(), pFile) == bytes.size();
+
+	return fclose(pFile) == 0 && hasSucceeded;
+}
+
+static DecodeResult MeasureDecoder(const std::string& bytes, bool isFileWritten)
+{
+	DecodeResult result;
+	std::wstring text;
+
+	result.megabytesPerSecond = MeasureThroughput(bytes.size(), [&]() {
+		text.clear();
+		Utf8Decoder decoder;
+
+		for (size_t offset = 0; offset < bytes.size(); offset += UTF8_BENCHMARK_CHUNK_SIZE)
+		{
+			decoder.Decode(bytes.data() + offset, std::min<size_t>(UTF8_BENCHMARK_CHUNK_SIZE, bytes.size() - offset), text);
+		}
+
+		decoder.Finish(text);
+	});
+
+	result.characterCount = text.length();
+
+	if (isFileWritten)
+	{
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+		ReadWithDecoder(UTF8_BENCHMARK_CORPUS_FILE);
+		result.fileMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - start);
+	}
+
+	return result;
+}
+
+static DecodeResult MeasureCodecvt(const std::string& bytes, bool isFileWritten)
+{
+	DecodeResult result;
+	std::wstring text;
+
+	result.megabytesPerSecond = MeasureThroughput(bytes.size(), [&]() {
+		result.hasSucceeded = DecodeWithCodecvt(bytes, text);
+	});
+
+	result.characterCount = text.length();
+
+	if (isFileWritten)
+	{
+		const Benchmark::Clock::time_point start = Benchmark::Clock::now();
+		ReadWithCodecvt(UTF8_BENCHMARK_CORPUS_FILE);
+		result.fileMilliseconds = Benchmark::GetMilliseconds(Benchmark::Clock::now() - start);
+	}
+
+	return result;
+}
+
+bool Utf8Benchmark::Run(const wchar_t* lpszOutputPath)
+{
+	FILE* pOutput = Benchmark::OpenOutputFile(lpszOutputPath);
+
+	if (pOutput == nullptr)
+	{
+		return false;
+	}
+
+	Corpus corpora[3] = {
+		{ "ascii-source", GenerateSource(false) },
+		{ "multilingual-source", GenerateSource(true) },
+		{ "invalid-bytes", GenerateSource(true) }
+	};
+
+	for (size_t i = UTF8_BENCHMARK_INVALID_BYTE_INTERVAL / 2; i < corpora[2].bytes.size(); i += UTF8_BENCHMARK_INVALID_BYTE_INTERVAL)
+	{
+		corpora[2].bytes[i] = static_cast<char>(0xFF);
+	}
+
+	for (const Corpus& corpus : corpora)
+	{
+		const bool isFileWritten = WriteCorpusFile(corpus.bytes);
+
+		// Read once before either is timed, so that both find the file in the cache
+		if (isFileWritten)
+		{
+			ReadWithDecoder(UTF8_BENCHMARK_CORPUS_FILE);
+		}
+
+		const DecodeResult decoder = MeasureDecoder(corpus.bytes, isFileWritten);
+		const DecodeResult codecvt = MeasureCodecvt(corpus.bytes, isFileWritten);
+
+		DeleteFile(UTF8_BENCHMARK_CORPUS_FILE);
+
+		fprintf(pOutput, "{\"corpus\":\"%s\",\"bytes\":%llu,\"decoder_characters\":%llu,\"codecvt_characters\":%llu,\"codecvt_ok\":%s,"
+			             "\"decoder_mb_per_s\":%.1f,\"codecvt_mb_per_s\":%.1f,",
+			    corpus.lpszName, static_cast<unsigned long long>(corpus.bytes.size()),
+			    static_cast<unsigned long long>(decoder.characterCount), static_cast<unsigned long long>(codecvt.characterCount),
+			    codecvt.hasSucceeded ? "true" : "false", decoder.megabytesPerSecond, codecvt.megabytesPerSecond);
+
+		// codecvt gives up at the first invalid byte, it only went fast because it stopped early
+		if (codecvt.hasSucceeded && codecvt.megabytesPerSecond > 0)
+		{
+			fprintf(pOutput, "\"speedup\":%.1f,", decoder.megabytesPerSecond / codecvt.megabytesPerSecond);
+		}
+
+		else
+		{
+			fputs("\"speedup\":null,", pOutput);
+		}
+
+		if (isFileWritten)
+		{
+			fprintf(pOutput, "\"decoder_file_ms\":%.1f,\"codecvt_file_ms\":%.1f}\n", decoder.fileMilliseconds, codecvt.fileMilliseconds);
+		}
+
+		else
+		{
+			fputs("\"decoder_file_ms\":null,\"codecvt_file_ms\":null}\n", pOutput);
+		}
+
+		fflush(pOutput);
+	}
+
+	return fclose(pOutput) == 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Runs the benchmark instead of opening the window, e.g. IDE.exe --benchmark-utf8
+#define UTF8_BENCHMARK_ARGUMENT L"--benchmark-utf8"
+
+// Written to the current directory, one line of JSON per corpus
+#define UTF8_BENCHMARK_OUTPUT_FILE L"utf8-benchmark.jsonl"
+
+// The corpora are written here to be read back the way a file is opened, and deleted afterwards
+#define UTF8_BENCHMARK_CORPUS_FILE L"utf8-benchmark.tmp"
+
+/// <summary>
+/// Measures Utf8Decoder against std::codecvt_utf8, which files were opened
+/// with before, on generated corpora: source code that is all ASCII,
+/// source code with comments and strings in Greek, Russian, Chinese and
+/// Japanese, and the same text with invalid bytes here and there. Both
+/// decode the corpus in memory over and over for the throughput, and each
+/// reads it once from a file the way it was used to open files: a
+/// wifstream imbued with the facet, and the chunked read of the tab. The
+/// number of characters each of them produced is written next to the
+/// results, codecvt stops at the first invalid byte.
+/// </summary>
+namespace Utf8Benchmark
+{
+	/// <returns> False if the output couldn't be written </returns>
+	bool Run(const wchar_t* lpszOutputPath);
+}
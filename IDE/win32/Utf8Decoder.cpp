@@ -0,0 +1,423 @@
+#include "Utf8Decoder.h"
+
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define UTF8_USE_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+
+// Returned by DecodeSequence for bytes that aren't valid UTF-8
+#define INVALID_SEQUENCE 0xFFFFFFFF
+
+static const unsigned char BYTE_ORDER_MARK[] = { 0xEF, 0xBB, 0xBF };
+
+/// <summary>
+/// Decodes the sequence at the start of the data
+/// </summary>
+/// <returns> Number of bytes consumed, or 0 if the data ends before the sequence does.
+/// An invalid sequence consumes its longest valid prefix (at least one byte). </returns>
+static size_t DecodeSequence(const unsigned char* p, size_t length, unsigned long& cp)
+{
+	const unsigned char lead = p[0];
+
+	if (lead < 0x80)
+	{
+		cp = lead;
+		return 1;
+	}
+
+	size_t count;
+	unsigned char min = 0x80, max = 0xBF;
+
+	if (lead >= 0xC2 && lead <= 0xDF)
+	{
+		count = 2;
+		cp = lead & 0x1F;
+	}
+
+	else if (lead >= 0xE0 && lead <= 0xEF)
+	{
+		count = 3;
+		cp = lead & 0x0F;
+
+		if (lead == 0xE0) min = 0xA0;      // Overlong
+		else if (lead == 0xED) max = 0x9F; // Surrogates
+	}
+
+	else if (lead >= 0xF0 && lead <= 0xF4)
+	{
+		count = 4;
+		cp = lead & 0x07;
+
+		if (lead == 0xF0) min = 0x90;      // Overlong
+		else if (lead == 0xF4) max = 0x8F; // Above U+10FFFF
+	}
+
+	else
+	{
+		cp = INVALID_SEQUENCE;
+		return 1;
+	}
+
+	for (size_t i = 1; i < count; ++i)
+	{
+		if (i >= length)
+		{
+			return 0;
+		}
+
+		// Only the second byte has a narrower range
+		if (p[i] < (i == 1 ? min : 0x80) || p[i] > (i == 1 ? max : 0xBF))
+		{
+			cp = INVALID_SEQUENCE;
+			return i;
+		}
+
+		cp = (cp << 6) | (p[i] & 0x3F);
+	}
+
+	return count;
+}
+
+static inline wchar_t* WriteCodePoint(wchar_t* out, unsigned long cp)
+{
+	if (cp >= 0x10000 && sizeof(wchar_t) == 2)
+	{
+		cp -= 0x10000;
+		*out++ = static_cast<wchar_t>(0xD800 + (cp >> 10));
+		*out++ = static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+	}
+
+	else
+	{
+		*out++ = static_cast<wchar_t>(cp);
+	}
+
+	return out;
+}
+
+#ifdef UTF8_USE_SIMD
+
+static bool IsAvx2Supported(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(info, 1);
+
+	// The OS has to save the AVX registers too
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool g_IsAvx2Supported = IsAvx2Supported();
+
+/* Widens 16 ASCII bytes into 16 characters */
+static inline void WidenAscii(wchar_t* out, __m128i bytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+	const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+	if (sizeof(wchar_t) == 2)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), low);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), high);
+	}
+
+	else
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(low, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(low, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(high, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(high, zero));
+	}
+}
+
+/// <returns> Number of ASCII bytes at the start of the data that were widened </returns>
+static size_t DecodeAsciiSSE2(const unsigned char* p, size_t length, wchar_t* out)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= length; i += 16)
+	{
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+
+		if (_mm_movemask_epi8(bytes) != 0)
+		{
+			break;
+		}
+
+		WidenAscii(out + i, bytes);
+	}
+
+	return i;
+}
+
+TARGET_AVX2 static size_t DecodeAsciiAVX2(const unsigned char* p, size_t length, wchar_t* out)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= length; i += 32)
+	{
+		const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+
+		if (_mm256_movemask_epi8(bytes) != 0)
+		{
+			break;
+		}
+
+		const __m128i low = _mm256_castsi256_si128(bytes);
+		const __m128i high = _mm256_extracti128_si256(bytes, 1);
+
+		if (sizeof(wchar_t) == 2)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtepu8_epi16(low));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 16), _mm256_cvtepu8_epi16(high));
+		}
+
+		else
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtepu8_epi32(low));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 16), _mm256_cvtepu8_epi32(high));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+		}
+	}
+
+	// Whatever is left is shorter than a 32 byte block or has a multibyte sequence in it
+	return i + DecodeAsciiSSE2(p + i, length - i, out + i);
+}
+
+#endif
+
+/// <summary>
+/// Widens the run of ASCII bytes at the start of the data
+/// </summary>
+/// <returns> Number of bytes widened </returns>
+static size_t DecodeAscii(const unsigned char* p, size_t length, wchar_t* out)
+{
+	size_t i = 0;
+
+	// Short runs, like the spaces between words, aren't worth a trip to the vector code
+	for (; i < 16 && i < length && p[i] < 0x80; ++i)
+	{
+		out[i] = static_cast<wchar_t>(p[i]);
+	}
+
+#ifdef UTF8_USE_SIMD
+	if (i == 16)
+	{
+		i += g_IsAvx2Supported ? DecodeAsciiAVX2(p + i, length - i, out + i) : DecodeAsciiSSE2(p + i, length - i, out + i);
+	}
+#endif
+
+	for (; i < length && p[i] < 0x80; ++i)
+	{
+		out[i] = static_cast<wchar_t>(p[i]);
+	}
+
+	return i;
+}
+
+void Utf8Decoder::DecodeChunk(const unsigned char* pData, size_t length, std::wstring& text, bool isFinal)
+{
+	if (m_IsAtStart)
+	{
+		// Wait until there are enough bytes to tell whether the stream starts with a byte order mark
+		while (m_PendingLength < sizeof(BYTE_ORDER_MARK) && length > 0)
+		{
+			m_Pending[m_PendingLength++] = *pData++;
+			--length;
+		}
+
+		if (m_PendingLength < sizeof(BYTE_ORDER_MARK) && !isFinal)
+		{
+			return;
+		}
+
+		m_IsAtStart = false;
+
+		if (m_PendingLength == sizeof(BYTE_ORDER_MARK) && memcmp(m_Pending, BYTE_ORDER_MARK, m_PendingLength) == 0)
+		{
+			m_HasByteOrderMark = true;
+			m_PendingLength = 0;
+		}
+	}
+
+	// Every byte turns into at most one UTF-16 code unit
+	const size_t previous_length = text.length();
+	text.resize(previous_length + m_PendingLength + length);
+
+	wchar_t* const begin = &text[0] + previous_length;
+	wchar_t* out = begin;
+
+	// Finish the sequence that was cut off by the end of the previous chunk
+	while (m_PendingLength > 0)
+	{
+		unsigned char buffer[sizeof(m_Pending) * 2];
+		const size_t taken = length < sizeof(buffer) - m_PendingLength ? length : sizeof(buffer) - m_PendingLength;
+
+		memcpy(buffer, m_Pending, m_PendingLength);
+
+		if (taken > 0)
+		{
+			memcpy(buffer + m_PendingLength, pData, taken);
+		}
+
+		const size_t available = m_PendingLength + taken;
+
+		unsigned long cp;
+		size_t consumed = DecodeSequence(buffer, available, cp);
+
+		if (consumed == 0)
+		{
+			// Still not enough, which means this chunk has been used up
+			if (!isFinal)
+			{
+				memcpy(m_Pending, buffer, available);
+				m_PendingLength = available;
+				length = 0;
+				break;
+			}
+
+			consumed = available;
+			cp = INVALID_SEQUENCE;
+		}
+
+		if (cp == INVALID_SEQUENCE)
+		{
+			cp = REPLACEMENT_CHARACTER;
+			++m_InvalidSequenceCount;
+		}
+
+		out = WriteCodePoint(out, cp);
+
+		if (consumed >= m_PendingLength)
+		{
+			pData += consumed - m_PendingLength;
+			length -= consumed - m_PendingLength;
+			m_PendingLength = 0;
+		}
+
+		else
+		{
+			memmove(m_Pending, m_Pending + consumed, m_PendingLength - consumed);
+			m_PendingLength -= consumed;
+		}
+	}
+
+	size_t i = 0;
+
+	while (i < length)
+	{
+		const unsigned char lead = pData[i];
+
+		if (lead < 0x80)
+		{
+			const size_t count = DecodeAscii(pData + i, length - i, out);
+			out += count;
+			i += count;
+			continue;
+		}
+
+		// Two and three byte sequences make up most text that isn't ASCII, so
+		// the common valid cases skip the range checks of DecodeSequence
+		if (lead >= 0xC2 && lead <= 0xDF && i + 1 < length && (pData[i + 1] & 0xC0) == 0x80)
+		{
+			*out++ = static_cast<wchar_t>(((lead & 0x1F) << 6) | (pData[i + 1] & 0x3F));
+			i += 2;
+			continue;
+		}
+
+		if (lead >= 0xE1 && lead <= 0xEC && i + 2 < length &&
+			(pData[i + 1] & 0xC0) == 0x80 && (pData[i + 2] & 0xC0) == 0x80)
+		{
+			*out++ = static_cast<wchar_t>(((lead & 0x0F) << 12) | ((pData[i + 1] & 0x3F) << 6) | (pData[i + 2] & 0x3F));
+			i += 3;
+			continue;
+		}
+
+		unsigned long cp;
+		size_t consumed = DecodeSequence(pData + i, length - i, cp);
+
+		if (consumed == 0)
+		{
+			if (!isFinal)
+			{
+				m_PendingLength = length - i;
+				memcpy(m_Pending, pData + i, m_PendingLength);
+				break;
+			}
+
+			consumed = length - i;
+			cp = INVALID_SEQUENCE;
+		}
+
+		if (cp == INVALID_SEQUENCE)
+		{
+			cp = REPLACEMENT_CHARACTER;
+			++m_InvalidSequenceCount;
+		}
+
+		out = WriteCodePoint(out, cp);
+		i += consumed;
+	}
+
+	text.resize(previous_length + (out - begin));
+}
+
+void Utf8Decoder::Decode(const char* pData, size_t length, std::wstring& text)
+{
+	DecodeChunk(reinterpret_cast<const unsigned char*>(pData), length, text, false);
+}
+
+void Utf8Decoder::Finish(std::wstring& text)
+{
+	DecodeChunk(nullptr, 0, text, true);
+}
+
+void Utf8Decoder::Reset(void)
+{
+	m_PendingLength = 0;
+	m_IsAtStart = true;
+	m_HasByteOrderMark = false;
+	m_InvalidSequenceCount = 0;
+}
+
+std::wstring Utf8Decoder::DecodeAll(const char* pData, size_t length)
+{
+	std::wstring text;
+	text.reserve(length);
+
+	Utf8Decoder decoder;
+	decoder.Decode(pData, length, text);
+	decoder.Finish(text);
+
+	return text;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/// <summary>
+/// Validating UTF-8 to UTF-16 decoder that is fed a file chunk by chunk.
+/// Runs of ASCII are widened 16 or 32 bytes at a time with SSE2/AVX2 when
+/// the processor has them, everything else goes through a scalar decoder.
+/// A byte order mark at the start of the stream is skipped and every
+/// invalid sequence is replaced with U+FFFD, one per maximal subpart as
+/// recommended by the Unicode standard.
+/// </summary>
+class Utf8Decoder
+{
+private:
+	// Bytes of a sequence that was cut off at the end of the previous chunk
+	unsigned char m_Pending[4] = {};
+	size_t m_PendingLength = 0;
+
+	bool m_IsAtStart = true;
+	bool m_HasByteOrderMark = false;
+	size_t m_InvalidSequenceCount = 0;
+
+	void DecodeChunk(const unsigned char* pData, size_t length, std::wstring& text, bool isFinal);
+
+public:
+	/// <summary>
+	/// Decodes a chunk and appends it to the text. A sequence that
+	/// doesn't end in this chunk is completed by the next one.
+	/// </summary>
+	void Decode(const char* pData, size_t length, std::wstring& text);
+
+	/* Called after the last chunk, a sequence that was left unfinished becomes U+FFFD */
+	void Finish(std::wstring& text);
+
+	void Reset(void);
+
+	bool HasByteOrderMark(void) const { return m_HasByteOrderMark; }
+	size_t GetInvalidSequenceCount(void) const { return m_InvalidSequenceCount; }
+
+	/* Decodes a whole buffer at once */
+	static std::wstring DecodeAll(const char* pData, size_t length);
+};
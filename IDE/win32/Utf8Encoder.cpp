@@ -0,0 +1,126 @@
+#include "Utf8Encoder.h"
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+
+static inline bool IsHighSurrogate(unsigned int unit)
+{
+	return unit >= 0xD800 && unit <= 0xDBFF;
+}
+
+static inline bool IsLowSurrogate(unsigned int unit)
+{
+	return unit >= 0xDC00 && unit <= 0xDFFF;
+}
+
+static inline void AppendCodePoint(unsigned int codePoint, std::string& bytes)
+{
+	if (codePoint < 0x80)
+	{
+		bytes.push_back(static_cast<char>(codePoint));
+	}
+
+	else if (codePoint < 0x800)
+	{
+		bytes.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+		bytes.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+	}
+
+	else if (codePoint < 0x10000)
+	{
+		bytes.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+		bytes.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+		bytes.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+	}
+
+	else
+	{
+		bytes.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+		bytes.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+		bytes.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+		bytes.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+	}
+}
+
+void Utf8Encoder::Encode(const wchar_t* pText, size_t length, std::string& bytes)
+{
+	// Enough for the worst case, three bytes for every unit
+	bytes.reserve(bytes.size() + length * 3 + 3);
+
+	size_t i = 0;
+
+	if (m_PendingSurrogate != 0 && length > 0)
+	{
+		const unsigned int unit = static_cast<unsigned int>(pText[0]);
+
+		if (IsLowSurrogate(unit))
+		{
+			AppendCodePoint(0x10000 + ((m_PendingSurrogate - 0xD800) << 10) + (unit - 0xDC00), bytes);
+			i = 1;
+		}
+
+		else
+		{
+			AppendCodePoint(REPLACEMENT_CHARACTER, bytes);
+		}
+
+		m_PendingSurrogate = 0;
+	}
+
+	while (i < length)
+	{
+		// Most source code is ASCII, which is copied as is
+		while (i < length && static_cast<unsigned int>(pText[i]) < 0x80)
+		{
+			bytes.push_back(static_cast<char>(pText[i]));
+			++i;
+		}
+
+		if (i == length)
+		{
+			break;
+		}
+
+		const unsigned int unit = static_cast<unsigned int>(pText[i]);
+
+		if (IsHighSurrogate(unit))
+		{
+			if (i + 1 == length)
+			{
+				m_PendingSurrogate = pText[i];
+				break;
+			}
+
+			const unsigned int next = static_cast<unsigned int>(pText[i + 1]);
+
+			if (IsLowSurrogate(next))
+			{
+				AppendCodePoint(0x10000 + ((unit - 0xD800) << 10) + (next - 0xDC00), bytes);
+				i += 2;
+				continue;
+			}
+
+			AppendCodePoint(REPLACEMENT_CHARACTER, bytes);
+		}
+
+		else if (IsLowSurrogate(unit))
+		{
+			AppendCodePoint(REPLACEMENT_CHARACTER, bytes);
+		}
+
+		else
+		{
+			AppendCodePoint(unit, bytes);
+		}
+
+		++i;
+	}
+}
+
+void Utf8Encoder::Finish(std::string& bytes)
+{
+	if (m_PendingSurrogate != 0)
+	{
+		AppendCodePoint(REPLACEMENT_CHARACTER, bytes);
+		m_PendingSurrogate = 0;
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/// <summary>
+/// UTF-16 to UTF-8 encoder that is fed the text block by block. A surrogate
+/// pair split between two blocks is completed by the next one, surrogates
+/// that aren't part of a pair are written as U+FFFD.
+/// </summary>
+class Utf8Encoder
+{
+private:
+	// High surrogate that ended the previous block
+	wchar_t m_PendingSurrogate = 0;
+
+public:
+	/* Encodes a block and appends it to the bytes */
+	void Encode(const wchar_t* pText, size_t length, std::string& bytes);
+
+	/* Called after the last block, a high surrogate that was left unpaired becomes U+FFFD */
+	void Finish(std::string& bytes);
+
+	void Reset(void) { m_PendingSurrogate = 0; }
+};
@@ -92,13 +92,19 @@ std::wstring Utility::GetFileExtension(const wchar_t* lpszFileName)
 
 	std::wstring extension;
 
-	for (size_t i = 0; i < length; ++i)
+	// The last dot of the file name, a dot in a folder name doesn't count
+	for (size_t i = length; i-- > 0;)
 	{
 		if (lpszFileName[i] == L'.')
 		{
 			dot_index = i;
 			break;
 		}
+
+		if (lpszFileName[i] == L'\\' || lpszFileName[i] == L'/')
+		{
+			break;
+		}
 	}
 
 	if (dot_index != DOT_NOT_FOUND)
@@ -109,6 +115,31 @@ std::wstring Utility::GetFileExtension(const wchar_t* lpszFileName)
 	return extension;
 }
 
+void Utility::NormalizeLineBreaks(std::wstring& text)
+{
+	size_t length = 0;
+	wchar_t previous = L'\0';
+
+	for (size_t i = 0; i < text.length(); ++i)
+	{
+		const wchar_t current = text[i];
+
+		if (current != L'\n')
+		{
+			text[length++] = current;
+		}
+
+		else if (previous != L'\r')
+		{
+			text[length++] = L'\r';
+		}
+
+		previous = current;
+	}
+
+	text.resize(length);
+}
+
 void Utility::DrawTextCentered(HDC hDC, const RECT& rc, const wchar_t* lpszText)
 {
 	const int length = lstrlen(lpszText);
@@ -226,17 +257,17 @@ void Utility::SetMenuItemsState(HMENU hMenu, UINT uState)
 	if (uState == MF_GRAYED)
 	{
 		EnableMenuItem(hMenu, ID_EDIT_UNDO, uState | MF_BYCOMMAND);
+		EnableMenuItem(hMenu, ID_EDIT_REDO, uState | MF_BYCOMMAND);
 		EnableMenuItem(hMenu, ID_EDIT_CUT, uState | MF_BYCOMMAND);
 		EnableMenuItem(hMenu, ID_EDIT_COPY, uState | MF_BYCOMMAND);
 		EnableMenuItem(hMenu, ID_EDIT_DELETE, uState | MF_BYCOMMAND);
 	}
 }
 
-void Utility::UpdateUndoMenuButton(HWND hEditWindow)
+void Utility::UpdateUndoMenuButtons(HMENU hMenu, bool canUndo, bool canRedo)
 {
-	HMENU hMenu = GetMenu(GetAncestor(hEditWindow, GA_ROOT));
-	DWORD uEnable = SendMessage(hEditWindow, EM_CANUNDO, NULL, NULL) ? MF_ENABLED : MF_GRAYED;
-	EnableMenuItem(hMenu, ID_EDIT_UNDO, MF_BYCOMMAND | uEnable);
+	EnableMenuItem(hMenu, ID_EDIT_UNDO, MF_BYCOMMAND | (canUndo ? MF_ENABLED : MF_GRAYED));
+	EnableMenuItem(hMenu, ID_EDIT_REDO, MF_BYCOMMAND | (canRedo ? MF_ENABLED : MF_GRAYED));
 }
 
 void Utility::RefreshPasteMenuButton(HMENU hMenu)
@@ -70,6 +70,12 @@ namespace Utility
 	/// <returns> File Extension </returns>
 	extern std::wstring GetFileExtension(const wchar_t* lpszFileName);
 
+	/// <summary>
+	/// Files can use any kind of line break but the edit control only
+	/// keeps a '\r' for each one, so the text has to do the same
+	/// </summary>
+	extern void NormalizeLineBreaks(std::wstring& text);
+
 	// Pretty self explanatory
 	extern void DrawTextCentered(HDC hDC, const RECT& rc, const wchar_t* lpszText);
 
@@ -83,7 +89,7 @@ namespace Utility
 
 	extern void SetMenuItemsState(HMENU hMenu, UINT uState);
 
-	extern void UpdateUndoMenuButton(HWND hEditWindow);
+	extern void UpdateUndoMenuButtons(HMENU hMenu, bool canUndo, bool canRedo);
 
 	extern void RefreshPasteMenuButton(HMENU hMenu);
 }
\ No newline at end of file
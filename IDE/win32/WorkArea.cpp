@@ -10,6 +10,9 @@
 
 #define NO_TABS_AVAILABLE (-1)
 
+// Closed tabs that keep their edit, the ones closed before them are hibernated
+#define MAX_LIVE_CLOSED_TABS 8
+
 static HRESULT RegisterSourceEditorWindowClass(HINSTANCE hInstance);
 static LRESULT CALLBACK SourceEditorWindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
@@ -44,6 +47,13 @@ WorkArea::~WorkArea(void)
 
 	m_Tabs.clear();
 
+	// Deleting the closed tabs too deletes their edit journals
+	for (SourceTab* pSourceTab : m_ClosedTabs) {
+		delete pSourceTab;
+	}
+
+	m_ClosedTabs.clear();
+
 	SAFE_DELETE_GDIOBJ(hBkFont);
 }
 
@@ -144,8 +154,13 @@ void WorkArea::OnDPIChanged(void)
 		for (size_t i = 0; i < m_Tabs.size(); ++i)
 		{
 			SourceEdit* pSourceEdit = m_Tabs[i]->GetSourceEdit();
-			pSourceEdit->AdjustLeftMarginForDPI();
-			pSourceEdit->AdjustFontForDPI();
+
+			// Deferred tabs pick up the DPI when their edit is created
+			if (pSourceEdit != nullptr)
+			{
+				pSourceEdit->AdjustLeftMarginForDPI();
+				pSourceEdit->AdjustFontForDPI();
+			}
 
 			int iTabWidth = m_Tabs[i]->GetRequiredTabWidth();
 
@@ -193,6 +208,9 @@ LRESULT WorkArea::WindowProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
 	case WM_CLOSE_TAB:
 		return OnCloseTab(hWnd, lParam);
 
+	case WM_NOTIFY:
+		return OnNotify(hWnd, lParam);
+
 	case WM_TAB_SELECTED:
 	{
 		SourceTab* pSourceTab = reinterpret_cast<SourceTab*>(lParam);
@@ -316,6 +334,7 @@ LRESULT WorkArea::OnCloseTab(HWND hWnd, LPARAM lParam)
 			// Move the tab to the closed tabs
 			if (!m_Tabs[i]->IsTemporary()) {
 				m_ClosedTabs.push_back(m_Tabs[i]);
+				HibernateClosedTabs();
 			}
 
 			else {
@@ -340,6 +359,28 @@ LRESULT WorkArea::OnCloseTab(HWND hWnd, LPARAM lParam)
 	return 0;
 }
 
+LRESULT WorkArea::OnNotify(HWND hWnd, LPARAM lParam)
+{
+	LPNMHDR lpNmHdr = reinterpret_cast<LPNMHDR>(lParam);
+
+	if (lpNmHdr->code == EN_DRAGDROPDONE)
+	{
+		for (SourceTab* pSourceTab : m_Tabs)
+		{
+			SourceEdit* pSourceEdit = pSourceTab->GetSourceEdit();
+
+			if (pSourceEdit != nullptr && pSourceEdit->GetHandle() == lpNmHdr->hwndFrom)
+			{
+				pSourceEdit->SynchronizeDocument();
+				::MarkSourceAsEdited(pSourceEdit);
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
 // Compare the tabs' full paths so there aren't any mix ups
 // For example: directory1/main.cpp and directory2/main.cpp
 // Have to open different tabs
@@ -403,6 +444,26 @@ void WorkArea::SelectFileFromName(wchar_t* lpszName)
 	CreateTab(lpszName);
 }
 
+/// <summary>
+/// Hibernates every closed tab but the ones closed last. The closed tabs
+/// are kept in the order they were closed, and a revived tab leaves the
+/// list, so the ones at the front are the least recently used.
+/// </summary>
+void WorkArea::HibernateClosedTabs(void)
+{
+	size_t liveCount = 0;
+
+	for (size_t i = m_ClosedTabs.size(); i > 0; --i)
+	{
+		SourceTab* pSourceTab = m_ClosedTabs[i - 1];
+
+		if (pSourceTab->IsMaterialized() && ++liveCount > MAX_LIVE_CLOSED_TABS)
+		{
+			pSourceTab->Hibernate();
+		}
+	}
+}
+
 TabList& WorkArea::GetVisibleTabs(void)
 {
 	return m_Tabs;
@@ -456,14 +517,21 @@ SourceTab* WorkArea::CreateTab(wchar_t* lpszFileName)
 		m_Tabs[m_SourceIndex]->Unselect();
 	}
 
+	SourceTab* pSourceTab = CreateDeferredTab(lpszFileName);
+
+	// Selecting the tab loads the file in the background
+	pSourceTab->Select();
+	m_SourceIndex = m_Tabs.size() - 1;
+
+	return pSourceTab;
+}
+
+SourceTab* WorkArea::CreateDeferredTab(wchar_t* lpszFileName)
+{
 	SourceTab* pSourceTab = new SourceTab(m_hWndSelf);
 	pSourceTab->SetName(lpszFileName);
-	pSourceTab->SetEditTextToContentsOfFile(lpszFileName);
 	InsertSourceTab(pSourceTab);
 
-	m_Tabs.back()->Select();
-	m_SourceIndex = m_Tabs.size() - 1;
-
 	return pSourceTab;
 }
 
@@ -20,6 +20,9 @@ public:
 	void CloseAllTabs(void);
 	SourceTab* CreateTab(wchar_t* lpszFileName);
 
+	// Only the tab itself is created, the file is loaded the first time it's selected
+	SourceTab* CreateDeferredTab(wchar_t* lpszFileName);
+
 	// A temporary tab is deleted after it has been closed
 	SourceTab* CreateTemporaryTab(wchar_t* lpszFileName);
 
@@ -34,10 +37,12 @@ private:
 	HRESULT InitializeSourceEditorWindow(HINSTANCE hInstance);
 	LRESULT OnSize(HWND hWnd, LPARAM lParam);
 	LRESULT OnCloseTab(HWND hWnd, LPARAM lParam);
+	LRESULT OnNotify(HWND hWnd, LPARAM lParam);
 	LRESULT OnPaint(HWND hWnd);
 
 	void UpdateBackgroundFont(void);
 	void InsertSourceTab(SourceTab* pSourceTab);
+	void HibernateClosedTabs(void);
 	int GetSelectedTabIndex(void) const;
 
 private:
@@ -1,6 +1,17 @@
 #include "Application.h"
 #include "Logger.h"
 #include "Utility.h"
+#include "SourceEdit.h"
+#include "HighlightBenchmark.h"
+#include "SearchBenchmark.h"
+#include "IndexBenchmark.h"
+#include "GotoFileBenchmark.h"
+#include "PieceTableBenchmark.h"
+#include "LineIndexBenchmark.h"
+#include "Utf8Benchmark.h"
+#include "SaveBenchmark.h"
+#include "JournalBenchmark.h"
+#include "LargeFileBenchmark.h"
 
 #include <CommCtrl.h>
 #include <Uxtheme.h>
@@ -12,6 +23,105 @@
 #pragma comment(linker,"/manifestdependency:\"type='win32' name='Microsoft.Windows.Common-Controls' " \
 	"version='6.0.0.0' processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
 
+/* Run instead of opening the window when its argument is the first one on the command line */
+struct BenchmarkCommand {
+	LPCWSTR lpszArgument;
+	LPCWSTR lpszOutputPath;
+
+	// The parameter is the argument after it, or nullptr
+	bool (*pRun)(LPCWSTR lpszParameter, LPCWSTR lpszOutputPath);
+};
+
+static const BenchmarkCommand g_BenchmarkCommands[] = {
+	// The coloring path, on the files of a folder if one is given
+	{ BENCHMARK_ARGUMENT, BENCHMARK_OUTPUT_FILE, [](LPCWSTR lpszCorpusDirectory, LPCWSTR lpszOutputPath) {
+		return HighlightBenchmark::Run(lpszCorpusDirectory, lpszOutputPath, SourceEdit::GetTokenColorFunction(), DEFAULT_TEXT_COLOR);
+	} },
+
+	// The search engine against the standard library
+	{ SEARCH_BENCHMARK_ARGUMENT, SEARCH_BENCHMARK_OUTPUT_FILE, [](LPCWSTR, LPCWSTR lpszOutputPath) {
+		return SearchBenchmark::Run(lpszOutputPath);
+	} },
+
+	// The trigram index of a project folder
+	{ INDEX_BENCHMARK_ARGUMENT, INDEX_BENCHMARK_OUTPUT_FILE, [](LPCWSTR lpszFolder, LPCWSTR lpszOutputPath) {
+		return IndexBenchmark::Run(lpszFolder, lpszOutputPath);
+	} },
+
+	// Go to File on a project folder, or on generated paths
+	{ GOTO_FILE_BENCHMARK_ARGUMENT, GOTO_FILE_BENCHMARK_OUTPUT_FILE, [](LPCWSTR lpszFolder, LPCWSTR lpszOutputPath) {
+		return GotoFileBenchmark::Run(lpszFolder, lpszOutputPath);
+	} },
+
+	// The document on a generated 100 MB file
+	{ PIECE_TABLE_BENCHMARK_ARGUMENT, PIECE_TABLE_BENCHMARK_OUTPUT_FILE, [](LPCWSTR, LPCWSTR lpszOutputPath) {
+		return PieceTableBenchmark::Run(lpszOutputPath);
+	} },
+
+	// The line index on a generated file of a million lines
+	{ LINE_INDEX_BENCHMARK_ARGUMENT, LINE_INDEX_BENCHMARK_OUTPUT_FILE, [](LPCWSTR, LPCWSTR lpszOutputPath) {
+		return LineIndexBenchmark::Run(lpszOutputPath);
+	} },
+
+	// The UTF-8 decoder against codecvt
+	{ UTF8_BENCHMARK_ARGUMENT, UTF8_BENCHMARK_OUTPUT_FILE, [](LPCWSTR, LPCWSTR lpszOutputPath) {
+		return Utf8Benchmark::Run(lpszOutputPath);
+	} },
+
+	// A batch of dirty buffers saved one by one and through the scheduler
+	{ SAVE_BENCHMARK_ARGUMENT, SAVE_BENCHMARK_OUTPUT_FILE, [](LPCWSTR, LPCWSTR lpszOutputPath) {
+		return SaveBenchmark::Run(lpszOutputPath);
+	} },
+
+	// Typing into a journaled document in a second process, which is killed, then the recovery
+	{ JOURNAL_BENCHMARK_ARGUMENT, JOURNAL_BENCHMARK_OUTPUT_FILE, [](LPCWSTR, LPCWSTR lpszOutputPath) {
+		return JournalBenchmark::Run(lpszOutputPath);
+	} },
+
+	// The process the journal benchmark starts, given the file to write, it only returns if it couldn't write it
+	{ JOURNAL_BENCHMARK_WRITER_ARGUMENT, JOURNAL_BENCHMARK_OUTPUT_FILE, [](LPCWSTR lpszGivenPath, LPCWSTR lpszOutputPath) {
+		return JournalBenchmark::RunWriter(lpszGivenPath != nullptr ? lpszGivenPath : lpszOutputPath);
+	} },
+
+	// Generated files of growing size viewed through LargeFileView
+	{ LARGE_FILE_BENCHMARK_ARGUMENT, LARGE_FILE_BENCHMARK_OUTPUT_FILE, [](LPCWSTR, LPCWSTR lpszOutputPath) {
+		return LargeFileBenchmark::Run(lpszOutputPath);
+	} }
+};
+
+/// <summary>
+/// Runs the benchmark the command line asks for, if any
+/// </summary>
+/// <param name="exitCode"> Receives the exit code of the process if a benchmark was run </param>
+/// <returns> Whether a benchmark was run </returns>
+static bool RunBenchmark(int argc, LPWSTR* argv, int& exitCode)
+{
+	if (argv == nullptr || argc < 2)
+	{
+		return false;
+	}
+
+	for (const BenchmarkCommand& command : g_BenchmarkCommands)
+	{
+		if (lstrcmp(argv[1], command.lpszArgument) == 0)
+		{
+			const LPCWSTR lpszParameter = argc >= 3 ? argv[2] : nullptr;
+
+			exitCode = 0;
+
+			if (!command.pRun(lpszParameter, command.lpszOutputPath))
+			{
+				Logger::Write(L"Failed to write the results of the benchmark to %ls", command.lpszOutputPath);
+				exitCode = 1;
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
 class COleInitialize 
 {
 private:
@@ -45,6 +155,19 @@ INT APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	output_path.append(L"logs.txt");
 	Logger::SetOutputPath(output_path.c_str());
 
+	int argc = 0;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLine(), &argc);
+
+	int exit_code = 0;
+	const bool isBenchmark = RunBenchmark(argc, argv, exit_code);
+
+	LocalFree(argv);
+
+	if (isBenchmark)
+	{
+		return exit_code;
+	}
+
 	InitCommonControls();
 	COleInitialize init;
 
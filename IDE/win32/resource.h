@@ -6,10 +6,19 @@
 #define IDR_ACCELERATOR1                102
 #define IDD_ENTER_NAME_DIALOG           103
 #define IDD_GOTO_LINE                   105
+#define IDD_FIND_IN_FILES               107
+#define IDD_GOTO_FILE                   108
 #define IDC_NAME_EDIT                   1001
 #define IDC_MESSAGE_STATIC              1002
 #define IDC_LINE_NUMBER_EDIT            1003
 #define IDC_LINE_NUMBER_STATIC          1004
+#define IDC_FIND_IN_FILES_EDIT          1005
+#define IDC_FIND_IN_FILES_STATIC        1006
+#define IDC_MATCH_CASE_CHECK            1007
+#define IDC_WHOLE_WORD_CHECK            1008
+#define IDC_REGEX_CHECK                 1009
+#define IDC_GOTO_FILE_EDIT              1010
+#define IDC_GOTO_FILE_LIST              1011
 #define ID_FILE_CLOSE                   40001
 #define ID_FILE_SAVEFILE                40002
 #define ID_FILE_SAVEFILEAS              40003
@@ -42,14 +51,18 @@
 #define ID_ZOOM_ZOOMOUT                 40053
 #define ID_ZOOM_RESTOREDEFAULTZOOM      40054
 #define ID_PROGRAM                      40055
+#define ID_EDIT_REDO                    40069
+#define ID_EDIT_REGEX                   40070
+#define ID_EDIT_FINDINFILES             40071
+#define ID_FILE_GOTOFILE                40072
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        107
-#define _APS_NEXT_COMMAND_VALUE         40069
-#define _APS_NEXT_CONTROL_VALUE         1005
+#define _APS_NEXT_RESOURCE_VALUE        109
+#define _APS_NEXT_COMMAND_VALUE         40073
+#define _APS_NEXT_CONTROL_VALUE         1012
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif